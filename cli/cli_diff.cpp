@@ -26,12 +26,26 @@
  *********************************************************************/
 
 #include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include "cli.hpp"
 #include "os_string.hpp"
 #include "os_process.hpp"
 #include "cli_resources.hpp"
+#include "cli_diff_frames.hpp"
+
+#include "trace_parser.hpp"
+#include "trace_dump.hpp"
+#include "trace_hash.hpp"
 
 static const char *synopsis = "Identify differences between two traces.";
 
@@ -41,9 +55,292 @@ find_command(void)
     return findScript("tracediff.py");
 }
 
+/*
+ * Native diff engine.
+ *
+ * Both traces are parsed in parallel, hashing every call and grouping the
+ * hashes per frame.  Frames whose hashes match are skipped altogether; only
+ * the frames that differ are parsed again, diffed call by call, and dumped.
+ */
+
+
+enum EditOp {
+    EDIT_EQUAL,
+    EDIT_DELETE,
+    EDIT_INSERT,
+};
+
+
+/*
+ * Myers' O(ND) difference algorithm.
+ *
+ * Gives up, replacing the whole range, once the edit distance exceeds
+ * maxDistance, as the memory needed for backtracking grows quadratically.
+ */
+static void
+diffSequences(const std::vector<uint64_t> &a,
+              const std::vector<uint64_t> &b,
+              std::vector<EditOp> &script)
+{
+    static const int maxDistance = 2048;
+
+    script.clear();
+
+    // Strip common prefix and suffix
+    size_t prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    const uint64_t *x = a.data() + prefix;
+    const uint64_t *y = b.data() + prefix;
+    int n = int(a.size() - prefix - suffix);
+    int m = int(b.size() - prefix - suffix);
+
+    script.insert(script.end(), prefix, EDIT_EQUAL);
+
+    int max = n + m;
+    std::vector<int> v(2 * max + 3, 0);
+    const int offset = max + 1;
+    std::vector<std::vector<int>> history;
+
+    int distance = -1;
+    for (int d = 0; d <= max && d <= maxDistance; ++d) {
+        for (int k = -d; k <= d; k += 2) {
+            int i;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+                i = v[offset + k + 1];
+            } else {
+                i = v[offset + k - 1] + 1;
+            }
+            int j = i - k;
+            while (i < n && j < m && x[i] == y[j]) {
+                ++i;
+                ++j;
+            }
+            v[offset + k] = i;
+            if (i >= n && j >= m) {
+                distance = d;
+                break;
+            }
+        }
+        history.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+        if (distance >= 0) {
+            break;
+        }
+    }
+
+    if (distance < 0) {
+        script.insert(script.end(), n, EDIT_DELETE);
+        script.insert(script.end(), m, EDIT_INSERT);
+    } else {
+        std::vector<EditOp> middle;
+        int i = n;
+        int j = m;
+        for (int d = distance; d > 0; --d) {
+            const std::vector<int> &prev = history[d - 1];
+            auto prevV = [&] (int k) { return prev[k + d - 1]; };
+            int k = i - j;
+            bool insertion = k == -d || (k != d && prevV(k - 1) < prevV(k + 1));
+            int prevK = insertion ? k + 1 : k - 1;
+            int prevI = prevV(prevK);
+            int prevJ = prevI - prevK;
+            int midI = insertion ? prevI : prevI + 1;
+            middle.insert(middle.end(), i - midI, EDIT_EQUAL);
+            middle.push_back(insertion ? EDIT_INSERT : EDIT_DELETE);
+            i = prevI;
+            j = prevJ;
+        }
+        middle.insert(middle.end(), i, EDIT_EQUAL);
+        script.insert(script.end(), middle.rbegin(), middle.rend());
+    }
+
+    script.insert(script.end(), suffix, EDIT_EQUAL);
+}
+
+
+static void
+diffFrame(size_t frameNo,
+          const CallVector &callsA,
+          const CallVector &callsB,
+          trace::DumpFlags dumpFlags,
+          std::string &output)
+{
+    std::vector<uint64_t> hashesA;
+    std::vector<uint64_t> hashesB;
+    hashesA.reserve(callsA.size());
+    hashesB.reserve(callsB.size());
+    // Number pointers like hashTrace() does
+    trace::PointerOrdinals pointersA;
+    trace::PointerOrdinals pointersB;
+    for (auto & call : callsA) {
+        hashesA.push_back(trace::hashCall(*call, &pointersA));
+    }
+    for (auto & call : callsB) {
+        hashesB.push_back(trace::hashCall(*call, &pointersB));
+    }
+
+    std::vector<EditOp> script;
+    diffSequences(hashesA, hashesB, script);
+
+    std::ostringstream os;
+    os << "@@ frame " << frameNo << " @@\n";
+    size_t i = 0;
+    size_t j = 0;
+    for (EditOp op : script) {
+        switch (op) {
+        case EDIT_EQUAL:
+            ++i;
+            ++j;
+            break;
+        case EDIT_DELETE:
+            os << "- ";
+            trace::dump(*callsA[i++], os, dumpFlags);
+            os << '\n';
+            break;
+        case EDIT_INSERT:
+            os << "+ ";
+            trace::dump(*callsB[j++], os, dumpFlags);
+            os << '\n';
+            break;
+        }
+    }
+    output = os.str();
+}
+
+
+static int
+nativeDiff(const char *filenameA, const char *filenameB,
+           bool useCache, unsigned numThreads)
+{
+    TraceHashes traces[2];
+    traces[0].filename = filenameA;
+    traces[1].filename = filenameB;
+
+    bool ok[2] = {true, true};
+    bool cached[2] = {false, false};
+    {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < 2; ++t) {
+            threads.emplace_back([&, t] () {
+                TraceHashes &trace = traces[t];
+                if (useCache) {
+                    cached[t] = readHashes(trace);
+                }
+                if (!cached[t]) {
+                    ok[t] = hashTrace(trace);
+                }
+            });
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (unsigned t = 0; t < 2; ++t) {
+        if (!ok[t]) {
+            return 1;
+        }
+        if (useCache && !cached[t]) {
+            writeHashes(traces[t]);
+        }
+    }
+
+    // Find the frames that differ
+    std::vector<size_t> changedFrames;
+    size_t frameCount = std::max(traces[0].frames.size(), traces[1].frames.size());
+    for (size_t frameNo = 0; frameNo < frameCount; ++frameNo) {
+        if (frameNo >= traces[0].frames.size() ||
+            frameNo >= traces[1].frames.size() ||
+            traces[0].frames[frameNo].hash != traces[1].frames[frameNo].hash) {
+            changedFrames.push_back(frameNo);
+        }
+    }
+
+    if (changedFrames.empty()) {
+        return 0;
+    }
+
+    // Parse the changed frames of both traces
+    std::vector<CallVector> frameCalls[2];
+    {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < 2; ++t) {
+            threads.emplace_back([&, t] () {
+                std::vector<size_t> frameIndices;
+                for (size_t frameNo : changedFrames) {
+                    if (frameNo < traces[t].frames.size()) {
+                        frameIndices.push_back(frameNo);
+                    }
+                }
+                std::vector<CallVector> calls;
+                ok[t] = loadFrames(traces[t], frameIndices, calls);
+                frameCalls[t].resize(changedFrames.size());
+                for (size_t i = 0; i < calls.size(); ++i) {
+                    frameCalls[t][i] = std::move(calls[i]);
+                }
+            });
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+
+    if (!ok[0] || !ok[1]) {
+        return 1;
+    }
+
+    // Diff the changed frames in parallel, but print them in order
+    trace::DumpFlags dumpFlags = trace::DUMP_FLAG_NO_COLOR |
+                                 trace::DUMP_FLAG_NO_MULTILINE;
+    std::vector<std::string> outputs(changedFrames.size());
+    std::atomic<size_t> nextFrame(0);
+    {
+        std::vector<std::thread> threads;
+        numThreads = std::max(1U, std::min<unsigned>(numThreads, changedFrames.size()));
+        for (unsigned t = 0; t < numThreads; ++t) {
+            threads.emplace_back([&] () {
+                size_t i;
+                while ((i = nextFrame++) < changedFrames.size()) {
+                    diffFrame(changedFrames[i], frameCalls[0][i], frameCalls[1][i],
+                              dumpFlags, outputs[i]);
+                }
+            });
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (auto & output : outputs) {
+        std::cout << output;
+    }
+    std::cout << std::flush;
+
+    return 0;
+}
+
+
+
 static void
 usage(void)
 {
+    std::cout
+        << "usage: apitrace diff --native [OPTIONS] TRACE1 TRACE2\n"
+        << "Identify differences between two traces, by comparing per-frame call\n"
+           "hashes and only diffing the frames that differ.\n"
+           "\n"
+           "    -h, --help           show this help message and exit\n"
+           "    --cache              read/write call hashes from/to TRACE.hashes\n"
+           "    -j, --jobs=N         number of threads for diffing frames\n"
+           "\n"
+        << std::flush;
+
     os::String command = find_command();
 
     char *args[4];
@@ -55,11 +352,70 @@ usage(void)
     os::execute(args);
 }
 
+enum {
+    NATIVE_OPT = CHAR_MAX + 1,
+    CACHE_OPT,
+};
+
+const static char *
+shortOptions = "hj:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"native", no_argument, 0, NATIVE_OPT},
+    {"cache", no_argument, 0, CACHE_OPT},
+    {"jobs", required_argument, 0, 'j'},
+    {0, 0, 0, 0}
+};
+
+static int
+native_command(int argc, char *argv[])
+{
+    bool useCache = false;
+    unsigned numThreads = std::thread::hardware_concurrency();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case NATIVE_OPT:
+            break;
+        case CACHE_OPT:
+            useCache = true;
+            break;
+        case 'j':
+            numThreads = atoi(optarg);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: expected two trace files\n";
+        usage();
+        return 1;
+    }
+
+    return nativeDiff(argv[optind], argv[optind + 1], useCache, numThreads);
+}
+
 static int
 command(int argc, char *argv[])
 {
     int i;
 
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--native") == 0) {
+            return native_command(argc, argv);
+        }
+    }
+
     os::String command = find_command();
 
     os::String apitracePath = os::getProcessName();
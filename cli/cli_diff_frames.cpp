@@ -0,0 +1,364 @@
+/*********************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *********************************************************************/
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "cli_diff_frames.hpp"
+
+#include "trace_hash.hpp"
+
+
+static const char *
+ignoredFunctionNames[] = {
+    "glGetString",
+    "glXGetClientString",
+    "glXGetCurrentDisplay",
+    "glXGetCurrentContext",
+    "glXGetProcAddress",
+    "glXGetProcAddressARB",
+    "glXGetFBConfigAttrib",
+    "wglGetProcAddress",
+};
+
+
+/*
+ * Calls that are not expected to match between traces, e.g., because they
+ * return pointers, and are therefore left out of the comparison.
+ */
+class CallFilter
+{
+    std::unordered_map<const trace::FunctionSig *, bool> ignoredSigs;
+
+public:
+    bool
+    ignored(const trace::Call *call) {
+        auto it = ignoredSigs.find(call->sig);
+        if (it == ignoredSigs.end()) {
+            bool ignore = false;
+            for (const char *name : ignoredFunctionNames) {
+                if (strcmp(call->sig->name, name) == 0) {
+                    ignore = true;
+                    break;
+                }
+            }
+            it = ignoredSigs.emplace(call->sig, ignore).first;
+        }
+        if (it->second) {
+            return true;
+        }
+
+        // glGetError calls that return GL_NO_ERROR
+        return (call->flags & trace::CALL_FLAG_VERBOSE) &&
+               call->ret &&
+               call->ret->toUInt() == 0 &&
+               strcmp(call->sig->name, "glGetError") == 0;
+    }
+};
+
+
+void
+FrameHashes::finish(void)
+{
+    trace::Hasher hasher;
+    hasher.update(callHashes.data(), callHashes.size() * sizeof callHashes[0]);
+    hash = hasher.digest();
+}
+
+
+
+
+
+static const uint32_t hashesMagic = 0x48544150; // "PATH"
+static const uint32_t hashesVersion = 3;
+
+struct HashesHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t frameCount;
+};
+
+
+static bool
+getFileStamp(const char *filename, uint64_t &size, int64_t &mtime)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+
+static std::string
+getHashesFilename(const char *filename)
+{
+    return std::string(filename) + ".hashes";
+}
+
+
+bool
+readHashes(TraceHashes &trace)
+{
+    HashesHeader expected;
+    if (!getFileStamp(trace.filename, expected.size, expected.mtime)) {
+        return false;
+    }
+
+    std::ifstream stream(getHashesFilename(trace.filename), std::ifstream::binary);
+    if (!stream) {
+        return false;
+    }
+
+    HashesHeader header;
+    if (!stream.read((char *)&header, sizeof header) ||
+        header.magic != hashesMagic ||
+        header.version != hashesVersion ||
+        header.size != expected.size ||
+        header.mtime != expected.mtime) {
+        return false;
+    }
+
+    trace.frames.resize(header.frameCount);
+    for (auto & frame : trace.frames) {
+        uint64_t chunk;
+        uint32_t offsetInChunk;
+        uint32_t nextCallNo;
+        uint32_t skipFrames;
+        uint64_t callCount;
+        stream.read((char *)&chunk, sizeof chunk);
+        stream.read((char *)&offsetInChunk, sizeof offsetInChunk);
+        stream.read((char *)&nextCallNo, sizeof nextCallNo);
+        stream.read((char *)&skipFrames, sizeof skipFrames);
+        stream.read((char *)&callCount, sizeof callCount);
+        if (!stream) {
+            trace.frames.clear();
+            return false;
+        }
+        frame.bookmark.offset = trace::File::Offset(chunk, offsetInChunk);
+        frame.bookmark.next_call_no = nextCallNo;
+        frame.skipFrames = skipFrames;
+        frame.callNos.resize(callCount);
+        frame.callHashes.resize(callCount);
+        stream.read((char *)frame.callNos.data(), callCount * sizeof frame.callNos[0]);
+        stream.read((char *)frame.callHashes.data(), callCount * sizeof frame.callHashes[0]);
+        if (!stream) {
+            trace.frames.clear();
+            return false;
+        }
+        frame.finish();
+    }
+
+    return true;
+}
+
+
+void
+writeHashes(const TraceHashes &trace)
+{
+    HashesHeader header;
+    if (!getFileStamp(trace.filename, header.size, header.mtime)) {
+        return;
+    }
+    header.magic = hashesMagic;
+    header.version = hashesVersion;
+    header.frameCount = trace.frames.size();
+
+    std::string hashesFilename = getHashesFilename(trace.filename);
+    std::ofstream stream(hashesFilename, std::ofstream::binary);
+    if (!stream) {
+        std::cerr << "warning: could not write " << hashesFilename << "\n";
+        return;
+    }
+
+    stream.write((const char *)&header, sizeof header);
+    for (auto & frame : trace.frames) {
+        uint64_t chunk = frame.bookmark.offset.chunk;
+        uint32_t offsetInChunk = frame.bookmark.offset.offsetInChunk;
+        uint32_t nextCallNo = frame.bookmark.next_call_no;
+        uint32_t skipFrames = frame.skipFrames;
+        uint64_t callCount = frame.callNos.size();
+        stream.write((const char *)&chunk, sizeof chunk);
+        stream.write((const char *)&offsetInChunk, sizeof offsetInChunk);
+        stream.write((const char *)&nextCallNo, sizeof nextCallNo);
+        stream.write((const char *)&skipFrames, sizeof skipFrames);
+        stream.write((const char *)&callCount, sizeof callCount);
+        stream.write((const char *)frame.callNos.data(), callCount * sizeof frame.callNos[0]);
+        stream.write((const char *)frame.callHashes.data(), callCount * sizeof frame.callHashes[0]);
+    }
+}
+
+
+bool
+hashTrace(TraceHashes &trace)
+{
+    if (!trace.parser.open(trace.filename)) {
+        return false;
+    }
+
+    CallFilter filter;
+
+    // Pointers are numbered afresh for every frame, so that an extra object
+    // in one trace doesn't make all later frames differ
+    trace::PointerOrdinals pointers;
+
+    // Last position without pending calls, and the number of frames that
+    // ended since
+    trace::ParseBookmark bookmark;
+    unsigned skipFrames = 0;
+    trace.parser.getBookmark(bookmark);
+
+    trace.frames.emplace_back();
+    trace.frames.back().bookmark = bookmark;
+
+    trace::Call *call;
+    while ((call = trace.parser.parse_call())) {
+        FrameHashes &frame = trace.frames.back();
+        if (!filter.ignored(call)) {
+            frame.callNos.push_back(call->no);
+            frame.callHashes.push_back(trace::hashCall(*call, &pointers));
+        }
+        bool endFrame = call->flags & trace::CALL_FLAG_END_FRAME;
+        delete call;
+
+        if (endFrame) {
+            frame.finish();
+            pointers.clear();
+            if (trace.parser.hasPendingCalls()) {
+                ++skipFrames;
+            } else {
+                trace.parser.getBookmark(bookmark);
+                skipFrames = 0;
+            }
+            trace.frames.emplace_back();
+            trace.frames.back().bookmark = bookmark;
+            trace.frames.back().skipFrames = skipFrames;
+        }
+    }
+
+    if (trace.frames.back().callNos.empty()) {
+        trace.frames.pop_back();
+    } else {
+        trace.frames.back().finish();
+    }
+
+    trace.primed = true;
+
+    return true;
+}
+
+
+bool
+loadFrames(TraceHashes &trace,
+           const std::vector<size_t> &frameIndices,
+           std::vector<CallVector> &frameCalls)
+{
+    frameCalls.clear();
+    frameCalls.resize(frameIndices.size());
+    if (frameIndices.empty()) {
+        return true;
+    }
+
+    CallFilter filter;
+
+    // Calls of the skipped frames are parsed lazily rather than scanned, as
+    // those still pending at a frame end only get returned in a later frame,
+    // and would then be missing their arguments.
+    auto keepCall = [&] (trace::Call *call, CallVector &calls) {
+        call->decode();
+        if (filter.ignored(call)) {
+            delete call;
+        } else {
+            calls.emplace_back(call);
+        }
+    };
+
+    if (trace.primed && trace.parser.supportsOffsets()) {
+        for (size_t i = 0; i < frameIndices.size(); ++i) {
+            const FrameHashes &frame = trace.frames[frameIndices[i]];
+            trace.parser.setBookmark(frame.bookmark);
+            trace::Call *call;
+            unsigned skipFrames = frame.skipFrames;
+            while ((call = trace.parser.lazy_call())) {
+                bool endFrame = call->flags & trace::CALL_FLAG_END_FRAME;
+                if (skipFrames) {
+                    delete call;
+                    if (endFrame) {
+                        --skipFrames;
+                    }
+                    continue;
+                }
+                keepCall(call, frameCalls[i]);
+                if (endFrame) {
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Sequentially parse through the frames we are not interested in.
+    trace.parser.close();
+    if (!trace.parser.open(trace.filename)) {
+        return false;
+    }
+
+    size_t frameNo = 0;
+    size_t i = 0;
+    while (i < frameIndices.size()) {
+        trace::Call *call = trace.parser.lazy_call();
+        if (!call) {
+            break;
+        }
+        bool endFrame = call->flags & trace::CALL_FLAG_END_FRAME;
+        bool wanted = frameNo == frameIndices[i];
+        if (wanted) {
+            keepCall(call, frameCalls[i]);
+        } else {
+            delete call;
+        }
+        if (endFrame) {
+            if (wanted) {
+                ++i;
+            }
+            ++frameNo;
+        }
+    }
+
+    trace.primed = true;
+
+    return true;
+}
@@ -0,0 +1,95 @@
+/*********************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *********************************************************************/
+
+/*
+ * Per-frame call hashes for the native diff engine.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "trace_parser.hpp"
+
+
+struct FrameHashes
+{
+    /*
+     * Where to seek to parse this frame.  The parser can only be seeked to
+     * positions where no calls from other threads are pending, so this may
+     * be the start of an earlier frame, in which case the first skipFrames
+     * frames after it must be skipped.
+     */
+    trace::ParseBookmark bookmark;
+    unsigned skipFrames = 0;
+
+    std::vector<unsigned> callNos;
+    std::vector<uint64_t> callHashes;
+    uint64_t hash = 0;
+
+    void
+    finish(void);
+};
+
+
+struct TraceHashes
+{
+    const char *filename = nullptr;
+    trace::Parser parser;
+    // Whether the parser has seen every signature, and can therefore seek.
+    bool primed = false;
+    std::vector<FrameHashes> frames;
+};
+
+
+typedef std::vector<std::unique_ptr<trace::Call>> CallVector;
+
+
+/*
+ * Cache of call hashes, stored next to the trace.
+ */
+
+bool
+readHashes(TraceHashes &trace);
+
+void
+writeHashes(const TraceHashes &trace);
+
+
+bool
+hashTrace(TraceHashes &trace);
+
+/*
+ * Parse the calls of the given frames, which must be sorted.
+ */
+bool
+loadFrames(TraceHashes &trace,
+           const std::vector<size_t> &frameIndices,
+           std::vector<CallVector> &frameCalls);
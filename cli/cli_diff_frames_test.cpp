@@ -0,0 +1,160 @@
+/*********************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *********************************************************************/
+#include <stdio.h>
+
+#include <vector>
+
+#include "cli_diff_frames.hpp"
+#include "trace_writer.hpp"
+
+#include "gtest/gtest.h"
+
+
+static const char *fooArgs[] = {"no"};
+static const trace::FunctionSig fooSig = {0, "glFoo", 1, fooArgs};
+static const trace::FunctionSig swapSig = {1, "glXSwapBuffers", 0, nullptr};
+
+
+/* Write calls from several threads, each left a few calls after it was
+ * entered, so that calls are pending at most of the frame ends. */
+static void
+writeThreadedTrace(const char *filename, unsigned count, unsigned frameLength)
+{
+    trace::Writer writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION, trace::Properties()));
+
+    std::vector<unsigned> pending;
+    unsigned seed = 1;
+    for (unsigned i = 0; i < count || !pending.empty(); ++i) {
+        if (i < count) {
+            unsigned no = writer.beginEnter(&fooSig, 1 + i % 3);
+            writer.beginArg(0);
+            writer.writeUInt(no);
+            writer.endArg();
+            writer.endEnter();
+            pending.push_back(no);
+        }
+
+        seed = seed * 1103515245 + 12345;
+        unsigned pick = (seed >> 16) % 4;
+        if (!pending.empty() &&
+            (pick == 0 || pending.size() >= 3 || i >= count)) {
+            pick %= pending.size();
+            writer.beginLeave(pending[pick]);
+            writer.endLeave();
+            pending.erase(pending.begin() + pick);
+        }
+
+        if (i % frameLength == frameLength - 1) {
+            unsigned no = writer.beginEnter(&swapSig, 0);
+            writer.endEnter();
+            writer.beginLeave(no);
+            writer.endLeave();
+        }
+    }
+
+    writer.close();
+}
+
+
+static std::vector<std::vector<unsigned>>
+getCallNos(const std::vector<CallVector> &frameCalls)
+{
+    std::vector<std::vector<unsigned>> callNos;
+    for (auto & calls : frameCalls) {
+        callNos.emplace_back();
+        for (auto & call : calls) {
+            if (call->sig->id == fooSig.id) {
+                EXPECT_EQ(call->arg(0).toUInt(), call->no);
+            }
+            callNos.back().push_back(call->no);
+        }
+    }
+    return callNos;
+}
+
+
+TEST(cli_diff_frames, threads)
+{
+    const char *filename = "cli_diff_frames_test.trace";
+    const unsigned count = 20000;
+
+    writeThreadedTrace(filename, count, 50);
+
+    TraceHashes trace;
+    trace.filename = filename;
+    ASSERT_TRUE(hashTrace(trace));
+    ASSERT_GT(trace.frames.size(), 100u);
+
+    size_t callCount = 0;
+    bool skipped = false;
+    for (auto & frame : trace.frames) {
+        callCount += frame.callNos.size();
+        if (frame.skipFrames) {
+            skipped = true;
+        }
+    }
+    ASSERT_EQ(callCount, count + count / 50);
+    ASSERT_TRUE(skipped);
+
+    std::vector<size_t> frameIndices;
+    for (size_t i = 0; i < trace.frames.size(); ++i) {
+        if (i % 7 == 3 || (i >= 200 && i < 210)) {
+            frameIndices.push_back(i);
+        }
+    }
+
+    std::vector<std::vector<unsigned>> expected;
+    for (size_t i : frameIndices) {
+        expected.push_back(trace.frames[i].callNos);
+    }
+
+    // Seek to the bookmarks
+    ASSERT_TRUE(trace.parser.supportsOffsets());
+    std::vector<CallVector> frameCalls;
+    ASSERT_TRUE(loadFrames(trace, frameIndices, frameCalls));
+    EXPECT_EQ(getCallNos(frameCalls), expected);
+
+    // Scan from the start
+    TraceHashes scanned;
+    scanned.filename = filename;
+    scanned.frames = trace.frames;
+    ASSERT_TRUE(loadFrames(scanned, frameIndices, frameCalls));
+    EXPECT_EQ(getCallNos(frameCalls), expected);
+
+    trace.parser.close();
+    scanned.parser.close();
+    remove(filename);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
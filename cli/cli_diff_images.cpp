@@ -26,13 +26,29 @@
  *********************************************************************/
 
 #include <string.h>
+#include <stdlib.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "cli.hpp"
 #include "os_string.hpp"
 #include "os_process.hpp"
 #include "cli_resources.hpp"
 
+#include "image.hpp"
+
 static const char *synopsis = "Identify differences between two image dumps.";
 
 static os::String
@@ -41,9 +57,322 @@ find_command(void)
     return findScript("snapdiff.py");
 }
 
+/*
+ * Native comparison engine.
+ *
+ * Image pairs are decoded and compared on all cores, and the results are
+ * written as an HTML or JSON report, with difference images for the
+ * mismatches only.
+ */
+
+static const unsigned thumbSize = 320;
+
+enum ReportFormat {
+    REPORT_HTML,
+    REPORT_JSON,
+};
+
+enum Result {
+    RESULT_MATCH,
+    RESULT_MISMATCH,
+    RESULT_MISSING,
+};
+
+static const char *
+resultNames[] = {
+    "MATCH",
+    "MISMATCH",
+    "MISSING",
+};
+
+struct ImagePair
+{
+    std::string name;
+    std::string refChecksum;
+    std::string srcChecksum;
+
+    Result result = RESULT_MISSING;
+    bool compared = false;
+    image::Comparison comparison;
+
+    // Difference image, when one was written
+    std::string diffImage;
+
+    // Table cells of the HTML report
+    std::string cells;
+};
+
+struct Options
+{
+    std::string refPrefix;
+    std::string srcPrefix;
+    double fuzz = 0.05;
+    bool alpha = false;
+    bool overwrite = false;
+    bool showAll = false;
+    ReportFormat format = REPORT_HTML;
+};
+
+
+static bool
+fileExists(const std::string &path, time_t *mtime = nullptr)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    if (mtime) {
+        *mtime = st.st_mtime;
+    }
+    return true;
+}
+
+
+/*
+ * Whether target needs to be (re)generated from the given sources.
+ */
+static bool
+isStale(const std::string &target, const std::string &source)
+{
+    time_t targetTime;
+    time_t sourceTime;
+    return !fileExists(target, &targetTime) ||
+           (fileExists(source, &sourceTime) && targetTime < sourceTime);
+}
+
+
+static bool
+isImage(const std::string &path)
+{
+    std::filesystem::path name = std::filesystem::path(path).filename();
+    std::string ext1 = name.extension().string();
+    std::string ext2 = name.stem().extension().string();
+    return ext1 == ".png" && ext2 != ".diff" && ext2 != ".thumb";
+}
+
+
+static void
+findImages(const std::string &prefix, std::vector<std::string> &images)
+{
+    namespace fs = std::filesystem;
+
+    // Exceptions are disabled, so use the overloads which report errors
+    std::error_code ec;
+
+    std::string dir;
+    if (fs::is_directory(prefix, ec)) {
+        dir = prefix;
+    } else {
+        dir = fs::path(prefix).parent_path().string();
+    }
+
+    fs::recursive_directory_iterator it(dir.empty() ? "." : dir,
+                                        fs::directory_options::follow_directory_symlink, ec);
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file(ec)) {
+            continue;
+        }
+        std::string path = it->path().generic_string();
+        if (dir.empty() && path.compare(0, 2, "./") == 0) {
+            path = path.substr(2);
+        }
+        if (path.compare(0, prefix.size(), prefix) == 0 && isImage(path)) {
+            images.push_back(path.substr(prefix.size()));
+        }
+    }
+}
+
+
+/*
+ * Read the checksums written by `apitrace replay --snapshot-prefix=PREFIX`.
+ */
+static void
+readManifest(const std::string &prefix, std::map<std::string, std::string> &checksums)
+{
+    std::ifstream stream(prefix + "checksums.txt");
+    std::string line;
+    while (std::getline(stream, line)) {
+        size_t sep = line.find("  ");
+        if (sep != std::string::npos) {
+            checksums[line.substr(sep + 2)] = line.substr(0, sep);
+        }
+    }
+}
+
+
+/*
+ * HTML table cell for an image, writing a thumbnail for large ones.
+ */
+static std::string
+surface(const std::string &path, const image::Image *decoded)
+{
+    std::string thumb = path;
+    if (fileExists(path)) {
+        std::unique_ptr<image::Image> owned;
+        std::string name = path.substr(0, path.rfind('.'));
+        std::string thumbPath = name + ".thumb.png";
+        if (isStale(thumbPath, path)) {
+            if (!decoded) {
+                owned.reset(image::readPNG(path.c_str()));
+                decoded = owned.get();
+            }
+            if (decoded &&
+                (decoded->width > thumbSize || decoded->height > thumbSize)) {
+                std::unique_ptr<image::Image> small(image::downscale(*decoded, thumbSize));
+                if (small->writePNG(thumbPath.c_str())) {
+                    thumb = thumbPath;
+                }
+            }
+        } else {
+            thumb = thumbPath;
+        }
+    }
+    return "        <td><a href=\"" + path + "\"><img src=\"" + thumb + "\"/></a></td>\n";
+}
+
+
+static void
+comparePair(const Options &options, ImagePair &pair)
+{
+    std::string refImage = options.refPrefix + pair.name;
+    std::string srcImage = options.srcPrefix + pair.name;
+    std::string diffImage = srcImage.substr(0, srcImage.rfind('.')) + ".diff.png";
+
+    std::unique_ptr<image::Image> ref;
+    std::unique_ptr<image::Image> src;
+    std::unique_ptr<image::Image> diff;
+
+    if (!pair.refChecksum.empty() && pair.refChecksum == pair.srcChecksum) {
+        // Identical pixels -- no need to decode anything
+        pair.result = RESULT_MATCH;
+    } else if (fileExists(refImage) && fileExists(srcImage)) {
+        ref.reset(image::readPNG(refImage.c_str()));
+        src.reset(image::readPNG(srcImage.c_str()));
+        if (!ref || !src) {
+            std::cerr << "warning: failed to read " << (ref ? srcImage : refImage) << "\n";
+            pair.result = RESULT_MISSING;
+        } else if (image::compare(*ref, *src, pair.comparison, options.fuzz, options.alpha)) {
+            pair.compared = true;
+            pair.result = pair.comparison.mismatches ? RESULT_MISMATCH : RESULT_MATCH;
+        } else {
+            // Sizes differ
+            pair.result = RESULT_MISMATCH;
+        }
+    } else if (!pair.refChecksum.empty() && !pair.srcChecksum.empty()) {
+        pair.result = RESULT_MISMATCH;
+    } else {
+        pair.result = RESULT_MISSING;
+    }
+
+    if (pair.result == RESULT_MISMATCH && pair.compared) {
+        if (options.overwrite ||
+            (isStale(diffImage, refImage) && isStale(diffImage, srcImage))) {
+            diff.reset(image::diff(*ref, *src, options.fuzz, options.alpha));
+            if (!diff->writePNG(diffImage.c_str())) {
+                std::cerr << "warning: failed to write " << diffImage << "\n";
+            }
+        }
+        pair.diffImage = diffImage;
+    }
+
+    if (options.format == REPORT_HTML &&
+        (pair.result != RESULT_MATCH || options.showAll)) {
+        pair.cells = surface(refImage, ref.get());
+        pair.cells += surface(srcImage, src.get());
+        pair.cells += surface(diffImage, diff.get());
+    }
+}
+
+
+static void
+writeHTML(std::ostream &os, const Options &options, const std::vector<ImagePair> &pairs)
+{
+    os << "<html>\n"
+          "  <body>\n"
+          "    <table border=\"1\">\n"
+          "      <tr><th>File</th><th>" << options.refPrefix << "</th><th>" << options.srcPrefix << "</th><th>&Delta;</th></tr>\n";
+    for (auto & pair : pairs) {
+        const char *bgcolor = pair.result == RESULT_MATCH ? "#20ff20" : "#ff2020";
+        os << "      <tr>\n"
+              "        <td bgcolor=\"" << bgcolor << "\"><a href=\"" << options.refPrefix << pair.name << "\">" << pair.name << "<a/></td>\n"
+           << pair.cells
+           << "      </tr>\n";
+    }
+    os << "    </table>\n"
+          "  </body>\n"
+          "</html>\n";
+}
+
+
+static void
+writeJSONString(std::ostream &os, const std::string &s)
+{
+    static const char hex[] = "0123456789abcdef";
+    os << '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if (c < 0x20) {
+            os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+
+static void
+writeJSON(std::ostream &os, const Options &options, const std::vector<ImagePair> &pairs)
+{
+    os << "{\n  \"ref\": ";
+    writeJSONString(os, options.refPrefix);
+    os << ",\n  \"src\": ";
+    writeJSONString(os, options.srcPrefix);
+    os << ",\n  \"images\": [";
+    const char *sep = "\n";
+    for (auto & pair : pairs) {
+        os << sep << "    {\"name\": ";
+        writeJSONString(os, pair.name);
+        os << ", \"result\": \"" << resultNames[pair.result] << "\"";
+        if (pair.compared) {
+            const image::Comparison &c = pair.comparison;
+            os << ", \"max_error\": " << c.maxError
+               << ", \"mean_error\": " << c.meanError
+               << ", \"precision\": " << c.precision
+               << ", \"mismatches\": " << c.mismatches;
+        }
+        if (!pair.diffImage.empty()) {
+            os << ", \"diff\": ";
+            writeJSONString(os, pair.diffImage);
+        }
+        os << "}";
+        sep = ",\n";
+    }
+    os << "\n  ]\n}\n";
+}
+
+
 static void
 usage(void)
 {
+    std::cout
+        << "usage: apitrace diff-images --native [OPTIONS] REF_PREFIX SRC_PREFIX\n"
+        << "Compare PNG images on all cores, writing difference images for the\n"
+           "mismatches only.\n"
+           "\n"
+           "    -h, --help           show this help message and exit\n"
+           "    -v, --verbose        verbose output\n"
+           "    -o, --output=FILE    output filename [default: index.html]\n"
+           "    --format=FORMAT      report format, html or json [default: html]\n"
+           "    -f, --fuzz=RATIO     fuzz ratio [default: 0.05]\n"
+           "    -a, --alpha          take alpha channel in consideration\n"
+           "    --overwrite          overwrite images\n"
+           "    --show-all           show all images, including similar ones\n"
+           "    -j, --jobs=N         number of threads for comparing images\n"
+           "\n"
+        << std::flush;
+
     os::String command = find_command();
 
     char *args[4];
@@ -55,11 +384,178 @@ usage(void)
     os::execute(args);
 }
 
+enum {
+    NATIVE_OPT = CHAR_MAX + 1,
+    FORMAT_OPT,
+    OVERWRITE_OPT,
+    SHOW_ALL_OPT,
+};
+
+const static char *
+shortOptions = "hvo:f:aj:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"verbose", no_argument, 0, 'v'},
+    {"native", no_argument, 0, NATIVE_OPT},
+    {"output", required_argument, 0, 'o'},
+    {"format", required_argument, 0, FORMAT_OPT},
+    {"fuzz", required_argument, 0, 'f'},
+    {"alpha", no_argument, 0, 'a'},
+    {"overwrite", no_argument, 0, OVERWRITE_OPT},
+    {"show-all", no_argument, 0, SHOW_ALL_OPT},
+    {"jobs", required_argument, 0, 'j'},
+    {0, 0, 0, 0}
+};
+
+static int
+native_command(int argc, char *argv[])
+{
+    Options options;
+    bool verbose = false;
+    const char *output = nullptr;
+    unsigned numThreads = std::thread::hardware_concurrency();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'v':
+            verbose = true;
+            break;
+        case NATIVE_OPT:
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case FORMAT_OPT:
+            if (strcmp(optarg, "html") == 0) {
+                options.format = REPORT_HTML;
+            } else if (strcmp(optarg, "json") == 0) {
+                options.format = REPORT_JSON;
+            } else {
+                std::cerr << "error: unknown report format " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case 'f':
+            options.fuzz = atof(optarg);
+            break;
+        case 'a':
+            options.alpha = true;
+            break;
+        case OVERWRITE_OPT:
+            options.overwrite = true;
+            break;
+        case SHOW_ALL_OPT:
+            options.showAll = true;
+            break;
+        case 'j':
+            numThreads = atoi(optarg);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: expected two image prefixes\n";
+        usage();
+        return 1;
+    }
+
+    options.refPrefix = argv[optind];
+    options.srcPrefix = argv[optind + 1];
+
+    std::map<std::string, std::string> refChecksums;
+    std::map<std::string, std::string> srcChecksums;
+    readManifest(options.refPrefix, refChecksums);
+    readManifest(options.srcPrefix, srcChecksums);
+
+    std::vector<std::string> names;
+    findImages(options.refPrefix, names);
+    findImages(options.srcPrefix, names);
+    for (auto & entry : refChecksums) {
+        names.push_back(entry.first);
+    }
+    for (auto & entry : srcChecksums) {
+        names.push_back(entry.first);
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::vector<ImagePair> pairs(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        ImagePair &pair = pairs[i];
+        pair.name = names[i];
+        auto ref = refChecksums.find(pair.name);
+        if (ref != refChecksums.end()) {
+            pair.refChecksum = ref->second;
+        }
+        auto src = srcChecksums.find(pair.name);
+        if (src != srcChecksums.end()) {
+            pair.srcChecksum = src->second;
+        }
+    }
+
+    numThreads = std::max(1U, std::min<unsigned>(numThreads, pairs.size()));
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&] () {
+            size_t i;
+            while ((i = next++) < pairs.size()) {
+                comparePair(options, pairs[i]);
+            }
+        });
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    unsigned failures = 0;
+    for (auto & pair : pairs) {
+        if (pair.result != RESULT_MATCH) {
+            ++failures;
+        }
+        if (verbose) {
+            std::cout << "Comparing " << options.refPrefix << pair.name
+                      << " and " << options.srcPrefix << pair.name
+                      << " ... " << resultNames[pair.result] << "\n";
+        }
+    }
+
+    std::string outputFilename = output ? output : (options.format == REPORT_JSON ? "index.json" : "index.html");
+    std::ofstream stream(outputFilename);
+    if (!stream) {
+        std::cerr << "error: failed to open " << outputFilename << "\n";
+        return 1;
+    }
+    if (options.format == REPORT_JSON) {
+        writeJSON(stream, options, pairs);
+    } else {
+        writeHTML(stream, options, pairs);
+    }
+
+    return failures ? 1 : 0;
+}
+
 static int
 command(int argc, char *argv[])
 {
     int i;
 
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--native") == 0) {
+            return native_command(argc, argv);
+        }
+    }
+
     os::String command = find_command();
 
     std::vector<const char *> args;
@@ -34,6 +34,7 @@
 #endif
 
 #include <memory>
+#include <vector>
 #include <fstream>
 #include <string>
 #include <regex>
@@ -61,6 +62,9 @@ static bool verbose = false;
 
 static trace::CallSet calls(trace::FREQUENCY_ALL);
 
+// Number of calls between the seek points recorded in signature caches
+static const unsigned cacheInterval = 10000;
+
 static const char *synopsis = "Dump given trace(s) to standard output.";
 
 static void
@@ -82,6 +86,8 @@ usage(void)
         "    --arg-names[=BOOL]   dump argument names [default: yes]\n"
         "    --blobs              dump blobs into files\n"
         "    --multiline[=BOOL]   dump newline in strings literally [default: yes]\n"
+        "    --sig-cache[=FILE]   keep signatures and seek points in FILE [default: TRACE.sigcache],\n"
+        "                         so later dumps of --calls can skip the calls before\n"
         "\n"
     ;
 }
@@ -95,6 +101,7 @@ enum {
     ARG_NAMES_OPT,
     BLOBS_OPT,
     MULTILINE_OPT,
+    SIG_CACHE_OPT,
 };
 
 const static char *
@@ -113,6 +120,7 @@ longOptions[] = {
     {"arg-names", optional_argument, 0, ARG_NAMES_OPT},
     {"blobs", no_argument, 0, BLOBS_OPT},
     {"multiline", optional_argument, 0, MULTILINE_OPT},
+    {"sig-cache", optional_argument, 0, SIG_CACHE_OPT},
     {0, 0, 0, 0}
 };
 
@@ -164,6 +172,8 @@ command(int argc, char *argv[])
     bool blobs = false;
     bool grep = false;
     std::regex grepRegex;
+    bool sigCache = false;
+    const char *sigCacheFilename = nullptr;
 
     int opt;
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
@@ -225,6 +235,10 @@ command(int argc, char *argv[])
         case BLOBS_OPT:
             blobs = true;
             break;
+        case SIG_CACHE_OPT:
+            sigCache = true;
+            sigCacheFilename = optarg;
+            break;
         default:
             std::cerr << "error: unexpected option `" << (char)opt << "`\n";
             usage();
@@ -232,6 +246,11 @@ command(int argc, char *argv[])
         }
     }
 
+    if (sigCacheFilename && argc - optind > 1) {
+        std::cerr << "error: --sig-cache=FILE only supports a single trace\n";
+        return 1;
+    }
+
     if (color == COLOR_OPTION_AUTO) {
 #ifdef _WIN32
         color = COLOR_OPTION_ALWAYS;
@@ -269,8 +288,44 @@ command(int argc, char *argv[])
             }
         }
 
+        std::string cacheFilename;
+        std::vector<trace::ParseBookmark> checkpoints;
+        bool checkpointsChanged = false;
+        if (sigCache && p.supportsOffsets()) {
+            cacheFilename = sigCacheFilename ? sigCacheFilename : std::string(argv[i]) + ".sigcache";
+            if (p.loadSignatureCache(cacheFilename.c_str(), checkpoints)) {
+                // Resume from the last seek point before the first call
+                for (size_t c = checkpoints.size(); c-- > 0; ) {
+                    if (checkpoints[c].next_call_no <= calls.getFirst()) {
+                        p.setBookmark(checkpoints[c]);
+                        break;
+                    }
+                }
+            } else {
+                checkpoints.clear();
+                checkpointsChanged = true;
+            }
+        }
+
         trace::Call *call;
-        while ((call = p.parse_call())) {
+        while (true) {
+            // Seeking drops the calls of other threads that are pending, so
+            // only checkpoint where there are none
+            if (!cacheFilename.empty() && !p.hasPendingCalls()) {
+                trace::ParseBookmark bookmark;
+                p.getBookmark(bookmark);
+                if (checkpoints.empty() ||
+                    bookmark.next_call_no >= checkpoints.back().next_call_no + cacheInterval) {
+                    checkpoints.push_back(bookmark);
+                    checkpointsChanged = true;
+                }
+            }
+
+            call = p.parse_call();
+            if (!call) {
+                break;
+            }
+
             // Give a few calls of tolerance before bailing out to allow pending
             // multi-threaded calls out of order to dump
             const unsigned long long call_no_tol = 100;
@@ -295,6 +350,11 @@ command(int argc, char *argv[])
             }
             delete call;
         }
+
+        if (checkpointsChanged &&
+            !p.saveSignatureCache(cacheFilename.c_str(), checkpoints)) {
+            std::cerr << "warning: failed to write " << cacheFilename << "\n";
+        }
     }
 
     return 0;
@@ -55,12 +55,18 @@ usage(void)
         "    -m, --mrt              dump all MRTs and depth/stencil\n"
         "    -o, --output=PREFIX    prefix to use in naming output files\n"
         "                           (default is trace filename without extension)\n"
+        "        --checksums        also write a PREFIXchecksums.txt manifest\n"
+        "                           with the CRC-32C of each image\n"
+        "        --checksums-only   only write the PREFIXchecksums.txt manifest,\n"
+        "                           without encoding any image\n"
         "\n";
 }
 
 enum {
     CALLS_OPT = CHAR_MAX + 1,
     CALL_NOS_OPT,
+    CHECKSUMS_OPT,
+    CHECKSUMS_ONLY_OPT,
 };
 
 const static char *
@@ -73,6 +79,8 @@ longOptions[] = {
     {"call-nos", optional_argument, 0, CALL_NOS_OPT},
     {"mrt", no_argument, 0, 'm'},
     {"output", required_argument, 0, 'o'},
+    {"checksums", no_argument, 0, CHECKSUMS_OPT},
+    {"checksums-only", no_argument, 0, CHECKSUMS_ONLY_OPT},
     {0, 0, 0, 0}
 };
 
@@ -85,6 +93,8 @@ command(int argc, char *argv[])
     const char *output = NULL;
     std::string call_nos;
     bool mrt = false;
+    bool checksums = false;
+    bool checksumsOnly = false;
 
     int opt;
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
@@ -105,6 +115,12 @@ command(int argc, char *argv[])
         case 'o':
             output = optarg;
             break;
+        case CHECKSUMS_OPT:
+            checksums = true;
+            break;
+        case CHECKSUMS_ONLY_OPT:
+            checksumsOnly = true;
+            break;
         default:
             std::cerr << "error: unexpected option `" << (char)opt << "`\n";
             usage();
@@ -148,6 +164,10 @@ command(int argc, char *argv[])
     }
     if (mrt)
         opts.push_back("-m");
+    if (checksumsOnly)
+        opts.push_back("--snapshot-format=CRC32C");
+    else if (checksums)
+        opts.push_back("--snapshot-checksums");
 
     return executeRetrace(opts, traceName);
 }
@@ -124,7 +124,8 @@ command(int argc, char *argv[])
         size_t firstCallId = 0;
         size_t frameBytesOffset = 0;
         bool endFrame = true;
-        while ((call = p.parse_call())) {
+        // Only call numbers and flags are needed, so skip over the values
+        while ((call = p.scan_call())) {
             if (flagDumpFrames) {
                 ++callsInFrame;
                 if (endFrame) {
@@ -99,7 +99,8 @@ traceProgram(trace::API api,
              int verbose,
              bool debug,
              bool mhook,
-             bool timestamp)
+             bool timestamp,
+             const char *compression)
 {
     const char *wrapperFilename;
     std::vector<const char *> args;
@@ -273,6 +274,9 @@ traceProgram(trace::API api,
         if (timestamp) {
             os::setEnvironment("TRACE_TIMESTAMP", "1");
         }
+        if (compression) {
+            os::setEnvironment("TRACE_COMPRESSION", compression);
+        }
 
         for (char * const * arg = argv; *arg; ++arg) {
             args.push_back(*arg);
@@ -319,6 +323,9 @@ exit:
     if (output) {
         os::unsetEnvironment("TRACE_FILE");
     }
+    if (compression) {
+        os::unsetEnvironment("TRACE_COMPRESSION");
+    }
     
     return status;
 
@@ -350,6 +357,8 @@ usage(void)
         "    -o, --output=TRACE  specify output trace file;\n"
         "                        default is `PROGRAM.trace`\n"
         "    -t, --timestamp     append timestamp to output trace filename\n"
+        "    -z, --compression=SPEC  output container: `snappy` (default), or\n"
+        "                        `zstd[:LEVEL[:THREADS]]` for seekable Zstandard\n"
 #ifdef TRACE_VARIABLE
         "    -d,  --debug        run inside debugger (gdb/lldb)\n"
 #endif
@@ -360,7 +369,7 @@ usage(void)
 }
 
 const static char *
-shortOptions = "+hva:o:dmt";
+shortOptions = "+hva:o:dmtz:";
 
 const static struct option
 longOptions[] = {
@@ -371,6 +380,7 @@ longOptions[] = {
     { "debug", no_argument, 0, 'd' },
     { "mhook", no_argument, 0, 'm' },
     { "timestamp", no_argument, 0, 't' },
+    { "compression", required_argument, 0, 'z' },
     { 0, 0, 0, 0 }
 };
 
@@ -389,6 +399,7 @@ command(int argc, char *argv[])
     bool debug = false;
     bool mhook = false;
     bool timestamp = false;
+    const char *compression = NULL;
 
     int opt;
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
@@ -439,6 +450,9 @@ command(int argc, char *argv[])
         case 't':
             timestamp = true;
             break;
+        case 'z':
+            compression = optarg;
+            break;
         default:
             std::cerr << "error: unexpected option `" << (char)opt << "`\n";
             usage();
@@ -453,7 +467,7 @@ command(int argc, char *argv[])
     }
 
     assert(argv[argc] == 0);
-    return traceProgram(api, argv + optind, output, verbose, debug, mhook, timestamp);
+    return traceProgram(api, argv + optind, output, verbose, debug, mhook, timestamp, compression);
 }
 
 const Command trace_command = {
@@ -122,7 +122,8 @@ trim_trace(const char *filename, struct trim_options *options)
 
     frame = 0;
     trace::Call *call;
-    while ((call = p.parse_call())) {
+    // Only the calls that get written need their values decoded
+    while ((call = p.lazy_call())) {
 
         /* There's no use doing any work past the last call and frame
          * requested by the user. */
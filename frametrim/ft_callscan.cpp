@@ -0,0 +1,109 @@
+/*********************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *********************************************************************/
+
+#include "ft_callscan.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace frametrim {
+
+void
+add_bookmark(trace::Parser& p, std::vector<trace::ParseBookmark>& bookmarks)
+{
+    if (!p.supportsOffsets() || p.hasPendingCalls())
+        return;
+
+    trace::ParseBookmark bookmark;
+    p.getBookmark(bookmark);
+    bookmarks.push_back(bookmark);
+}
+
+void
+for_each_call(trace::Parser& p, const char *filename,
+              const std::vector<trace::ParseBookmark>& bookmarks,
+              const std::vector<unsigned>& call_nos,
+              std::function<void (trace::Call& call)> func)
+{
+    if (!bookmarks.empty()) {
+        p.setBookmark(bookmarks.front());
+    } else {
+        p.close();
+        p.open(filename);
+    }
+
+    /* Calls of other threads are returned out of order, so keep track of
+     * which ones are done, and of the lowest one that isn't */
+    std::vector<bool> done(call_nos.size());
+    size_t remaining = call_nos.size();
+    size_t first_due = 0;
+    unsigned max_call_no = 0;
+
+    std::unique_ptr<trace::Call> call;
+    while (remaining) {
+        /* Seek over the calls before the lowest one still due, when all
+         * those before the bookmark are known to be done with */
+        auto bookmark = std::upper_bound(bookmarks.begin(), bookmarks.end(),
+                                         call_nos[first_due],
+                                         [](unsigned no, const trace::ParseBookmark& b) {
+                                             return no < b.next_call_no;
+                                         });
+        if (bookmark != bookmarks.begin() &&
+            (--bookmark)->next_call_no > max_call_no + 1 &&
+            !p.hasPendingCalls()) {
+            trace::ParseBookmark current;
+            p.getBookmark(current);
+            if (bookmark->next_call_no > current.next_call_no) {
+                p.setBookmark(*bookmark);
+                max_call_no = bookmark->next_call_no - 1;
+            }
+        }
+
+        call.reset(p.lazy_call());
+        if (!call)
+            break;
+
+        max_call_no = std::max(max_call_no, call->no);
+
+        auto it = std::lower_bound(call_nos.begin(), call_nos.end(), call->no);
+        if (it == call_nos.end() || *it != call->no)
+            continue;
+
+        size_t index = it - call_nos.begin();
+        if (done[index])
+            continue;
+        done[index] = true;
+        --remaining;
+        while (first_due < call_nos.size() && done[first_due])
+            ++first_due;
+
+        /* func may renumber the call */
+        func(*call);
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+/*********************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *********************************************************************/
+
+#pragma once
+
+#include "trace_parser.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace frametrim {
+
+/* Bookmark the current parser position, unless calls from other threads
+ * are pending there.  Seeking to such a position would drop them, since
+ * the parser only returns calls once they are left. */
+void
+add_bookmark(trace::Parser& p, std::vector<trace::ParseBookmark>& bookmarks);
+
+/* Invoke func on the calls with the given (sorted) numbers, in the order
+ * the parser returns them.  All other calls are left undecoded, and ranges
+ * of calls that contain none of the given ones are seeked over, using the
+ * bookmarks taken with add_bookmark in increasing order.  Seeking relies on
+ * the parser having seen all signatures up to the last call already, so it
+ * must not be reopened in between.  Without bookmarks, the trace is
+ * reopened and scanned from the start. */
+void
+for_each_call(trace::Parser& p, const char *filename,
+              const std::vector<trace::ParseBookmark>& bookmarks,
+              const std::vector<unsigned>& call_nos,
+              std::function<void (trace::Call& call)> func);
+
+}
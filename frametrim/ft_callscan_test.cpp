@@ -0,0 +1,147 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "ft_callscan.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace frametrim;
+
+
+static const char *args[] = {"no"};
+static const trace::FunctionSig sig = {0, "glFoo", 1, args};
+
+
+/* Write calls from several threads, each left a few calls after it was
+ * entered, so that they come back out of order. */
+static void
+writeThreadedTrace(const char *filename, unsigned count)
+{
+    trace::Writer writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION, trace::Properties()));
+
+    std::vector<unsigned> pending;
+    unsigned seed = 1;
+    for (unsigned i = 0; i < count || !pending.empty(); ++i) {
+        if (i < count) {
+            unsigned no = writer.beginEnter(&sig, i % 4);
+            writer.beginArg(0);
+            writer.writeUInt(no);
+            writer.endArg();
+            writer.endEnter();
+            pending.push_back(no);
+        }
+
+        // Leave a pseudo-random pending call, or none while few are
+        seed = seed * 1103515245 + 12345;
+        unsigned pick = (seed >> 16) % 4;
+        if (!pending.empty() &&
+            (pick == 0 || pending.size() >= 3 || i >= count)) {
+            pick %= pending.size();
+            writer.beginLeave(pending[pick]);
+            writer.endLeave();
+            pending.erase(pending.begin() + pick);
+        }
+    }
+
+    writer.close();
+}
+
+
+TEST(ft_callscan, threads)
+{
+    const char *filename = "ft_callscan_test.trace";
+    const unsigned count = 20000;
+
+    writeThreadedTrace(filename, count);
+
+    trace::Parser p;
+    ASSERT_TRUE(p.open(filename));
+
+    // Bookmark after every call, as the parser returns them
+    std::vector<trace::ParseBookmark> bookmarks;
+    std::vector<unsigned> order;
+    add_bookmark(p, bookmarks);
+    bool outOfOrder = false;
+    trace::Call *call;
+    while ((call = p.parse_call())) {
+        if (!order.empty() && call->no < order.back())
+            outOfOrder = true;
+        order.push_back(call->no);
+        delete call;
+        add_bookmark(p, bookmarks);
+    }
+    ASSERT_EQ(order.size(), count);
+    ASSERT_TRUE(outOfOrder);
+
+    // Bookmarks with pending calls must have been left out
+    ASSERT_GT(bookmarks.size(), 1u);
+    ASSERT_LT(bookmarks.size(), count);
+
+    // Sparse calls, so that most bookmarks are seeked to, plus a dense run
+    std::vector<unsigned> call_nos;
+    for (unsigned no = 0; no < count; ++no) {
+        if (no % 997 == 5 || (no >= 10000 && no < 10100))
+            call_nos.push_back(no);
+    }
+
+    std::vector<unsigned> expected;
+    for (auto no : order) {
+        if (std::binary_search(call_nos.begin(), call_nos.end(), no))
+            expected.push_back(no);
+    }
+
+    for (int seek = 1; seek >= 0; --seek) {
+        std::vector<unsigned> actual;
+        for_each_call(p, filename,
+                      seek ? bookmarks : std::vector<trace::ParseBookmark>(),
+                      call_nos,
+                      [&](trace::Call& call) {
+            EXPECT_EQ(call.arg(0).toUInt(), call.no);
+            actual.push_back(call.no);
+        });
+        EXPECT_EQ(actual, expected) << (seek ? "seeking" : "scanning");
+    }
+
+    p.close();
+    remove(filename);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -25,6 +25,7 @@
  *
  *********************************************************************/
 
+#include "ft_callscan.hpp"
 #include "ft_frametrimmer.hpp"
 
 #include "os_time.hpp"
@@ -38,8 +39,10 @@
 
 #include <limits.h> // for CHAR_MAX
 #include <getopt.h>
+#include <algorithm>
 #include <memory>
 #include <queue>
+#include <vector>
 
 using namespace frametrim;
 
@@ -135,24 +138,31 @@ static int trim_to_frame(const char *filename,
 
     frame = 0;
     uint64_t callid = 0;
-    std::unique_ptr<trace::Call> call(p.parse_call());
     std::priority_queue<std::pair<unsigned, unsigned>> calls_in_frame;
 
-    /* Determine whether the trace API is supported */
-    while (call && p.api == trace::API_UNKNOWN)
-        call.reset(p.parse_call());
+    /* Bookmarks of the frame starts, to seek over frames when writing */
+    std::vector<trace::ParseBookmark> frame_bookmarks;
+    add_bookmark(p, frame_bookmarks);
+
+    /* Determine whether the trace API is supported, keeping the calls read
+     * meanwhile for the trimmer */
+    std::vector<std::unique_ptr<trace::Call>> api_calls;
+    do {
+        api_calls.emplace_back(p.parse_call());
+    } while (api_calls.back() && p.api == trace::API_UNKNOWN);
     if (!FrameTrimmer::isSupported(p.api)) {
         std::cerr << "error: unsupported API" << std::endl;
         return 1;
     }
-    p.close();
-    p.open(filename);
-    call.reset(p.parse_call());
+    std::reverse(api_calls.begin(), api_calls.end());
+    std::unique_ptr<trace::Call> call = std::move(api_calls.back());
+    api_calls.pop_back();
 
     auto trimmer = FrameTrimmer::create(p.api, options.keep_all_states, options.swap_to_finish);
 
     unsigned calls_in_this_frame = 0;
     uint32_t last_frame_start = 0;
+    bool frame_start = false;
 
     while (call) {
         /* There's no use doing any work past the last call and frame
@@ -174,7 +184,8 @@ static int trim_to_frame(const char *filename,
 
         trimmer->call(*call, ft);
 
-        if (call->flags & trace::CALL_FLAG_END_FRAME) {
+        frame_start = call->flags & trace::CALL_FLAG_END_FRAME;
+        if (frame_start) {
             if (options.top_frame_call_counts > 0) {
                 calls_in_frame.push(std::make_pair(calls_in_this_frame, frame));
             }
@@ -188,7 +199,14 @@ static int trim_to_frame(const char *filename,
                       << " type:" << ft
                       << " call:" << call->no;
 
-        call.reset(p.parse_call());
+        if (!api_calls.empty()) {
+            call = std::move(api_calls.back());
+            api_calls.pop_back();
+        } else {
+            if (frame_start)
+                add_bookmark(p, frame_bookmarks);
+            call.reset(p.parse_call());
+        }
         ++calls_in_this_frame;
     }
 
@@ -207,59 +225,45 @@ static int trim_to_frame(const char *filename,
     auto call_ids = trimmer->getUniqueCallIds();
     std::cerr << "Write output file\n";
 
-    p.close();
-    p.open(filename);
-    call.reset(p.parse_call());
+    /* Setup calls, including those of the last frame, come first */
+    std::vector<unsigned> setup_call_nos;
+    std::vector<unsigned> last_frame_call_nos;
+    for (auto no : call_ids) {
+        if (no < last_frame_start ||
+            skip_loop_calls.find(no) != skip_loop_calls.end())
+            setup_call_nos.push_back(no);
+        else
+            last_frame_call_nos.push_back(no);
+    }
+    std::sort(setup_call_nos.begin(), setup_call_nos.end());
+    std::sort(last_frame_call_nos.begin(), last_frame_call_nos.end());
 
     std::cerr << "Copying " << call_ids.size() << " calls\n";
     std::cerr << "Write calls before " << last_frame_start << " and setup calls from last frame\n";
 
-    int call_id = 0;
+    unsigned call_id = 0;
     const trace::FunctionSig glFinishSig = {0, "glFinish", 0, NULL};
 
-    while (1) {
-        while (call && call_ids.find(call->no) == call_ids.end())
-            call.reset(p.parse_call());
-
-        if (!call)
-            break;
-
-        // Write setup calls in last frame  before last frame starts
-        if (call->no < last_frame_start ||
-                skip_loop_calls.find(call->no) != skip_loop_calls.end()) {
-
-            if (options.swap_to_finish &&
-                    swap_calls.find(call->no) != swap_calls.end()) {
-                call.reset(new trace::Call(&glFinishSig, 0, call->thread_id));
-            }
-
-            call->no = call_id++;
-            writer.writeCall(call.get());
+    for_each_call(p, filename, frame_bookmarks, setup_call_nos,
+                  [&](trace::Call& call) {
+        if (options.swap_to_finish &&
+                swap_calls.find(call.no) != swap_calls.end()) {
+            trace::Call finish(&glFinishSig, 0, call.thread_id);
+            finish.no = call_id++;
+            writer.writeCall(&finish);
+            return;
         }
-        call.reset(p.parse_call());
-    }
+        call.no = call_id++;
+        writer.writeCall(&call);
+    });
 
     // Now write the last frame without the setup calls
-    p.close();
-    p.open(filename);
-    call.reset(p.parse_call());
-
     std::cerr << "Write calls after " << last_frame_start << " without setup calls\n";
-    while (1) {
-        while (call &&
-               (call->no < last_frame_start ||
-                call_ids.find(call->no) == call_ids.end()))
-            call.reset(p.parse_call());
-
-        if (!call)
-            break;
-
-        if (skip_loop_calls.find(call->no) == skip_loop_calls.end()) {
-            call->no = call_id++;
-            writer.writeCall(call.get());
-        }
-        call.reset(p.parse_call());
-    }
+    for_each_call(p, filename, frame_bookmarks, last_frame_call_nos,
+                  [&](trace::Call& call) {
+        call.no = call_id++;
+        writer.writeCall(&call);
+    });
 
     if (options.top_frame_call_counts) {
         unsigned count = options.top_frame_call_counts;
@@ -30,7 +30,6 @@
 #include <unordered_set>
 #include <algorithm>
 #include <functional>
-#include <sstream>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -79,7 +78,7 @@ void OpenGLImpl::emitState()
 {
     m_matrix_states.emitStateTo(m_required_calls);
 
-    for (auto&& [name, call] : m_state_calls)
+    for (auto&& [key, call] : m_state_calls)
         m_required_calls.insert(call);
 
     for (auto&& [id, call]: m_enables)
@@ -938,13 +937,8 @@ PTraceCall
 OpenGLImpl::recordStateCall(const trace::Call& call,
                                    unsigned no_param_sel)
 {
-    std::stringstream s;
-    s << call.name();
-    for (unsigned i = 0; i < no_param_sel; ++i)
-        s << "_" << call.arg(i).toUInt();
-
-    auto c = std::make_shared<TraceCall>(call, s.str());
-    m_state_calls[s.str()] = c;
+    auto c = trace2call(call);
+    m_state_calls[StateCallKey(call, no_param_sel)] = c;
 
     if (m_active_display_list)
         m_active_display_list->addCall(c);
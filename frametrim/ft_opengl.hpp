@@ -173,7 +173,7 @@ private:
     std::shared_ptr<PerContextObjects> m_current_context;
     QueryObjectMap m_queries;
 
-    std::map<std::string, PTraceCall> m_state_calls;
+    StateCallMap m_state_calls;
     std::map<unsigned, PTraceCall> m_enables;
 
     std::unordered_map<unsigned, std::shared_ptr<PerContextObjects>> m_thread_active_context;
@@ -27,82 +27,65 @@
 
 #include "ft_tracecall.hpp"
 
-#include <sstream>
-#include <iostream>
+#include <assert.h>
+#include <string.h>
+#include <vector>
 
 
-namespace trace {
-
-class StreamVisitor : public Visitor
-{
-public:
-    StreamVisitor(std::stringstream& ss): s(ss) {}
-    void visit(Null *) override { s << "(null)";}
-    void visit(Bool *v) override { s << v->value;}
-    void visit(SInt *v) override { s << v->value;}
-    void visit(UInt *v) override { s << v->value;}
-    void visit(Float *v) override { s << v->value;}
-    void visit(Double *v) override { s << v->value;}
-    void visit(String *v) override { s << v->value;}
-    void visit(WString *v) override { s << v->value;}
-    void visit(Enum *v) override { s << v->value;}
-    void visit(Bitmask *v) override { s << v->value;}
-    void visit(Struct *v) override { s << v;}
-    void visit(Array *v) override { s << v;}
-    void visit(Blob *v) override { s << v;}
-    void visit(Pointer *v) override { s << v->value;}
-    void visit(Repr *v) override { s << v;}
-protected:
-    inline void _visit(Value *value) {
-        if (value) {
-            value->visit(*this);
-        }
-    }
-    std::stringstream& s;
-};
-
-}
-
 namespace frametrim {
 
-TraceCall::TraceCall(const trace::Call& call, const std::string& name):
+/* Signature names by signature id, shared by all calls of a signature */
+static std::vector<std::string> sig_names;
+
+TraceCall::TraceCall(const trace::Call& call):
     m_trace_call_no(call.no),
-    m_name(name)
+    m_sig_id(call.sig->id)
 {
-    std::stringstream s;
-    s << call.name();
-
-    trace::StreamVisitor sv(s);
-    for(auto&& a: call.args) {
-        s << "_";  a.value->visit(sv);
-    }
-
-    m_name_with_params = s.str();
+    if (m_sig_id >= sig_names.size())
+        sig_names.resize(m_sig_id + 1);
+    if (sig_names[m_sig_id].empty())
+        sig_names[m_sig_id] = call.name();
 }
 
-TraceCall::TraceCall(const trace::Call& call, unsigned nsel):
-    TraceCall(call, nameWithParamsel(call, nsel))
+const std::string&
+TraceCall::name() const
 {
-
+    return sig_names[m_sig_id];
 }
 
-TraceCall::TraceCall(const trace::Call& call):
-    TraceCall(call, call.name())
-{
-}
+/* Bit pattern of a scalar parameter, so that negative integers and
+ * fractional values make distinct keys rather than being truncated */
+class ParamBits : public trace::Visitor {
+public:
+    unsigned long long bits = 0;
+
+    void visit(trace::Null *) override { bits = 0; }
+    void visit(trace::Bool *node) override { bits = node->value; }
+    void visit(trace::SInt *node) override { bits = node->value; }
+    void visit(trace::UInt *node) override { bits = node->value; }
+    void visit(trace::Enum *node) override { bits = node->value; }
+    void visit(trace::Pointer *node) override { bits = node->value; }
+    void visit(trace::Float *node) override { fromDouble(node->value); }
+    void visit(trace::Double *node) override { fromDouble(node->value); }
+
+private:
+    void fromDouble(double value) {
+        static_assert(sizeof value == sizeof bits, "unexpected double size");
+        memcpy(&bits, &value, sizeof bits);
+    }
+};
 
-std::string
-TraceCall::nameWithParamsel(const trace::Call &call, unsigned nsel)
+StateCallKey::StateCallKey(const trace::Call& call, unsigned nparam_sel):
+    sig_id(call.sig->id),
+    params{0, 0}
 {
-    std::stringstream s;
-    s << call.name();
-
-    trace::StreamVisitor sv(s);
-    for(unsigned i = 0; i < nsel; ++i ) {
-        s << "_";
-        call.args[i].value->visit(sv);
+    assert(nparam_sel <= max_param_sel);
+    for (unsigned i = 0; i < nparam_sel; ++i) {
+        ParamBits param;
+        // Visitor interface is not const-correct, but this only reads
+        const_cast<trace::Value&>(call.arg(i)).visit(param);
+        params[i] = param.bits;
     }
-    return s.str();
 }
 
 void CallSet::insert(PTraceCall call)
@@ -46,30 +46,51 @@ enum ECallFlags {
 
 class CallSet;
 
+/* A call recorded for the trimmed output.  This is created for nearly
+ * every call of the trace, so it only holds the call number and the id of
+ * its signature, whose name is interned once per trace. */
 class TraceCall {
 public:
     using Pointer = std::shared_ptr<TraceCall>;
 
-    TraceCall(const trace::Call& call, const std::string& name);
-
-    TraceCall(const trace::Call& call, unsigned nparam_sel);
-
     TraceCall(const trace::Call& call);
 
     unsigned callNo() const { return m_trace_call_no;};
-    const std::string& name() const { return m_name;}
-    const std::string& nameWithParams() const { return m_name_with_params;}
+    unsigned sigId() const { return m_sig_id;}
+    const std::string& name() const;
 private:
-
-    static std::string nameWithParamsel(const trace::Call& call, unsigned nsel);
-
     unsigned m_trace_call_no;
-    std::string m_name;
-    std::string m_name_with_params;
+    unsigned m_sig_id;
 };
 using PTraceCall = TraceCall::Pointer;
 
-using StateCallMap=std::unordered_map<std::string, PTraceCall>;
+/* Identifies the piece of state a state call sets by its signature and
+ * the values of its first nparam_sel parameters. */
+struct StateCallKey {
+    static const unsigned max_param_sel = 2;
+
+    StateCallKey(const trace::Call& call, unsigned nparam_sel);
+
+    bool operator == (const StateCallKey& rhs) const {
+        return sig_id == rhs.sig_id &&
+                params[0] == rhs.params[0] &&
+                params[1] == rhs.params[1];
+    }
+
+    unsigned sig_id;
+    unsigned long long params[max_param_sel];
+};
+
+struct StateCallKeyHash {
+    std::size_t operator () (const StateCallKey& key) const {
+        std::size_t h = std::hash<unsigned>{}(key.sig_id);
+        for (auto p : key.params)
+            h = h * 31 + std::hash<unsigned long long>{}(p);
+        return h;
+    }
+};
+
+using StateCallMap=std::unordered_map<StateCallKey, PTraceCall, StateCallKeyHash>;
 
 inline PTraceCall trace2call(const trace::Call& call) {
     return std::make_shared<TraceCall>(call);
@@ -6,6 +6,7 @@
 #include "guids.hpp"
 
 #include <QDebug>
+#include <QFile>
 #include <QLocale>
 #include <QObject>
 #define QT_USE_FAST_OPERATOR_PLUS
@@ -155,6 +156,75 @@ apiVariantToString(const QVariant &variant, bool multiLine)
 }
 
 
+ApiStringCache::~ApiStringCache()
+{
+    clear();
+}
+
+QString ApiStringCache::string(const trace::String *node)
+{
+    trace::SharedString *shared = node->shared;
+    if (!shared) {
+        return QString::fromLatin1(node->value);
+    }
+
+    QHash<trace::SharedString *, QString>::const_iterator it =
+        m_strings.constFind(shared);
+    if (it != m_strings.constEnd()) {
+        return it.value();
+    }
+
+    QString str = QString::fromLatin1(node->value);
+
+    // Only cache strings that repeat.  A recycled pointer at worst caches
+    // a string seen just once.
+    if (!m_seen.contains(shared)) {
+        if (m_seen.size() >= m_pruneCount) {
+            m_seen.clear();
+        }
+        m_seen.insert(shared);
+        return str;
+    }
+    m_seen.remove(shared);
+
+    // Hold a reference so the key can't be recycled for other contents
+    shared->addRef();
+    m_strings.insert(shared, str);
+
+    if (m_strings.size() >= m_pruneCount) {
+        prune();
+    }
+
+    return str;
+}
+
+void ApiStringCache::prune()
+{
+    QHash<trace::SharedString *, QString>::iterator it = m_strings.begin();
+    while (it != m_strings.end()) {
+        // Not shared with any call's arguments anymore
+        if (it.value().isDetached()) {
+            it.key()->release();
+            it = m_strings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_pruneCount = qMax(4096, m_strings.size() * 2);
+}
+
+void ApiStringCache::clear()
+{
+    for (QHash<trace::SharedString *, QString>::const_iterator it = m_strings.constBegin();
+         it != m_strings.constEnd(); ++it) {
+        it.key()->release();
+    }
+    m_strings.clear();
+    m_seen.clear();
+    m_pruneCount = 4096;
+}
+
+
 void VariantVisitor::visit(trace::Null *)
 {
     m_variant = QVariant::fromValue(ApiPointer(0));
@@ -187,7 +257,11 @@ void VariantVisitor::visit(trace::Double *node)
 
 void VariantVisitor::visit(trace::String *node)
 {
-    m_variant = QVariant(QString::fromLatin1(node->value));
+    if (m_strings) {
+        m_variant = QVariant(m_strings->string(node));
+    } else {
+        m_variant = QVariant(QString::fromLatin1(node->value));
+    }
 }
 
 void VariantVisitor::visit(trace::WString *node)
@@ -207,12 +281,12 @@ void VariantVisitor::visit(trace::Bitmask *bitmask)
 
 void VariantVisitor::visit(trace::Struct *str)
 {
-    m_variant = QVariant::fromValue(ApiStruct(str));
+    m_variant = QVariant::fromValue(ApiStruct(str, m_strings));
 }
 
 void VariantVisitor::visit(trace::Array *array)
 {
-    m_variant = QVariant::fromValue(ApiArray(array));
+    m_variant = QVariant::fromValue(ApiArray(array, m_strings));
 }
 
 void VariantVisitor::visit(trace::Blob *blob)
@@ -352,9 +426,9 @@ QString ApiBitmask::toString() const
     return str;
 }
 
-ApiStruct::ApiStruct(const trace::Struct *s)
+ApiStruct::ApiStruct(const trace::Struct *s, ApiStringCache *strings)
 {
-    init(s);
+    init(s, strings);
 }
 
 QString ApiStruct::toString(bool multiLine) const
@@ -392,14 +466,14 @@ QString ApiStruct::toString(bool multiLine) const
     return str;
 }
 
-void ApiStruct::init(const trace::Struct *s)
+void ApiStruct::init(const trace::Struct *s, ApiStringCache *strings)
 {
     if (!s)
         return;
 
     m_sig.name = QString::fromLatin1(s->sig->name);
     for (unsigned i = 0; i < s->sig->num_members; ++i) {
-        VariantVisitor vis;
+        VariantVisitor vis(strings);
         m_sig.memberNames.append(
             QString::fromLatin1(s->sig->member_names[i]));
         s->members[i]->visit(vis);
@@ -407,9 +481,9 @@ void ApiStruct::init(const trace::Struct *s)
     }
 }
 
-ApiArray::ApiArray(const trace::Array *arr)
+ApiArray::ApiArray(const trace::Array *arr, ApiStringCache *strings)
 {
-    init(arr);
+    init(arr, strings);
 }
 
 ApiArray::ApiArray(const QVector<QVariant> &vals)
@@ -437,14 +511,14 @@ QString ApiArray::toString(bool multiLine) const
     return str;
 }
 
-void ApiArray::init(const trace::Array *arr)
+void ApiArray::init(const trace::Array *arr, ApiStringCache *strings)
 {
     if (!arr)
         return;
 
     m_array.reserve(arr->values.size());
     for (auto & value : arr->values) {
-        VariantVisitor vis;
+        VariantVisitor vis(strings);
         value->visit(vis);
 
         m_array.append(vis.variant());
@@ -456,6 +530,25 @@ ApiTraceState::ApiTraceState()
 {
 }
 
+/*
+ * Images are either embedded in the state, or, when glretrace was invoked with
+ * --dump-images, written to raw sidecar files which are referenced by name.
+ */
+static QByteArray getImageDataFrom(QVariantMap const &image)
+{
+    QString fileName = image[QLatin1String("__file__")].toString();
+    if (fileName.isEmpty()) {
+        return image[QLatin1String("__data__")].toByteArray();
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "failed to open" << fileName;
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
 static ApiTexture getTextureFrom(QVariantMap const &image, QString label)
 {
     QSize size(image[QLatin1String("__width__")].toInt(),
@@ -466,8 +559,7 @@ static ApiTexture getTextureFrom(QVariantMap const &image, QString label)
     QString formatName =
         image[QLatin1String("__format__")].toString();
 
-    QByteArray dataArray =
-        image[QLatin1String("__data__")].toByteArray();
+    QByteArray dataArray = getImageDataFrom(image);
 
     QString userLabel =
         image[QLatin1String("__label__")].toString();
@@ -524,8 +616,7 @@ ApiTraceState::ApiTraceState(const QVariantMap &parsedJson)
         int depth = buffer[QLatin1String("__depth__")].toInt();
         QString formatName = buffer[QLatin1String("__format__")].toString();
 
-        QByteArray dataArray =
-            buffer[QLatin1String("__data__")].toByteArray();
+        QByteArray dataArray = getImageDataFrom(buffer);
 
         QString label = itr.key();
         QString userLabel =
@@ -724,14 +815,14 @@ ApiTraceCall::loadData(TraceLoader *loader,
         loader->addSignature(call->sig->id, m_signature);
     }
     if (call->ret) {
-        VariantVisitor retVisitor;
+        VariantVisitor retVisitor(loader->strings());
         call->ret->visit(retVisitor);
         m_returnValue = retVisitor.variant();
     }
     m_argValues.reserve(call->args.size());
     for (int i = 0; i < call->args.size(); ++i) {
         if (call->args[i].value) {
-            VariantVisitor argVisitor;
+            VariantVisitor argVisitor(loader->strings());
             call->args[i].value->visit(argVisitor);
             m_argValues.append(argVisitor.variant());
             if (m_argValues[i].type() == QVariant::ByteArray) {
@@ -2,6 +2,8 @@
 
 #include "apisurface.h"
 
+#include <QHash>
+#include <QSet>
 #include <QStaticText>
 #include <QStringList>
 #include <QUrl>
@@ -13,9 +15,41 @@
 class ApiTrace;
 class TraceLoader;
 
+/*
+ * Converts each string the parser interned to a QString once it repeats, so
+ * that all the calls repeating it share the same implicitly shared QString.
+ *
+ * Entries no call uses anymore are pruned as the cache grows, letting the
+ * parser free the contents in turn.
+ */
+class ApiStringCache
+{
+public:
+    ApiStringCache() {}
+    ~ApiStringCache();
+
+    QString string(const trace::String *node);
+    void clear();
+
+private:
+    Q_DISABLE_COPY(ApiStringCache)
+
+    void prune();
+
+    QHash<trace::SharedString *, QString> m_strings;
+    int m_pruneCount = 4096;
+
+    // Strings seen once, not referenced, so possibly stale
+    QSet<trace::SharedString *> m_seen;
+};
+
 class VariantVisitor : public trace::Visitor
 {
 public:
+    VariantVisitor(ApiStringCache *strings = 0)
+        : m_strings(strings)
+    {}
+
     virtual void visit(trace::Null *) override;
     virtual void visit(trace::Bool *node) override;
     virtual void visit(trace::SInt *node) override;
@@ -37,6 +71,7 @@ public:
         return m_variant;
     }
 private:
+    ApiStringCache *m_strings;
     QVariant m_variant;
 };
 
@@ -104,14 +139,14 @@ public:
         QStringList memberNames;
     };
 
-    ApiStruct(const trace::Struct *s = 0);
+    ApiStruct(const trace::Struct *s = 0, ApiStringCache *strings = 0);
 
     QString toString(bool multiLine = false) const;
     Signature signature() const;
     QList<QVariant> values() const;
 
 private:
-    void init(const trace::Struct *bitmask);
+    void init(const trace::Struct *bitmask, ApiStringCache *strings);
 private:
     Signature m_sig;
     QList<QVariant> m_members;
@@ -121,14 +156,14 @@ Q_DECLARE_METATYPE(ApiStruct);
 class ApiArray
 {
 public:
-    ApiArray(const trace::Array *arr = 0);
+    ApiArray(const trace::Array *arr = 0, ApiStringCache *strings = 0);
     ApiArray(const QVector<QVariant> &vals);
 
     QString toString(bool multiLine = false) const;
 
     QVector<QVariant> values() const;
 private:
-    void init(const trace::Array *arr);
+    void init(const trace::Array *arr, ApiStringCache *strings);
 private:
     QVector<QVariant> m_array;
 };
@@ -4,6 +4,7 @@
 #include "thumbnail.h"
 
 #include "image.hpp"
+#include "image_ring.hpp"
 
 #include "trace_profiler.hpp"
 
@@ -12,6 +13,12 @@
 #include <QList>
 #include <QImage>
 #include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QVector>
+
+#include <new>
+#include <stdio.h>
 
 #include "qubjson.h"
 
@@ -338,6 +345,116 @@ QString Retracer::thumbnailCallSet()
     return callSet;
 }
 
+// Room for a few hundred thumbnails in flight
+#define THUMBNAIL_RING_SIZE (4 * 1024 * 1024)
+
+/**
+ * Create the shared memory ring through which glretrace hands thumbnails
+ * over (see image_ring.hpp), backed by the given temporary file.
+ */
+static image::RingHeader *
+createThumbnailRing(QTemporaryFile &file)
+{
+    const qint64 size = image::RING_HEADER_SIZE + THUMBNAIL_RING_SIZE;
+    if (!file.open() || !file.resize(size)) {
+        return nullptr;
+    }
+
+    uchar *mapping = file.map(0, size);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    image::RingHeader *header = new (mapping) image::RingHeader;
+    memcpy(header->magic, RING_MAGIC, sizeof header->magic);
+    header->capacity = THUMBNAIL_RING_SIZE;
+    header->tail.store(0, std::memory_order_release);
+    header->detached.store(0, std::memory_order_release);
+    return header;
+}
+
+/**
+ * Read a PNM snapshot from the retracer output, whose first header line has
+ * already been read into line.
+ */
+static bool
+readPNMSnapshot(QIODevice &io, const char *line, qint64 lineLength,
+                QImage &snapshot, int &commentNumber)
+{
+    image::PNMInfo info;
+
+    char header[512];
+    if (lineLength <= 0 || lineLength >= qint64(sizeof header)) {
+        return false;
+    }
+    memcpy(header, line, lineLength);
+    qint64 headerSize = lineLength;
+    int headerLines = 3; // assume no optional comment line
+
+    for (int headerLine = 1; headerLine < headerLines; ++headerLine) {
+        qint64 headerRead = io.readLine(&header[headerSize], sizeof(header) - headerSize);
+        if (headerRead <= 0) {
+            return false;
+        }
+
+        // if header actually contains optional comment line, ...
+        if (headerLine == 1 && header[headerSize] == '#') {
+            ++headerLines;
+        }
+
+        headerSize += headerRead;
+    }
+
+    const char *headerEnd = image::readPNMHeader(header, headerSize, info);
+
+    // if invalid PNM header was encountered, ...
+    if (headerEnd == NULL) {
+        return false;
+    }
+
+    unsigned channels = info.channels;
+    unsigned width = info.width;
+    unsigned height = info.height;
+
+    // qDebug() << "channels: " << channels << ", width: " << width << ", height: " << height";
+
+    if (info.channelType == image::TYPE_UNORM8) {
+        snapshot = QImage(width, height, channels == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+
+        int rowBytes = channels * width;
+        for (unsigned y = 0; y < height; ++y) {
+            unsigned char *scanLine = snapshot.scanLine(y);
+            if (io.read((char *) scanLine, rowBytes) != rowBytes) {
+                return false;
+            }
+        }
+    } else {
+        // Floating point snapshots are clamped to 8 bits
+        snapshot = QImage(width, height, QImage::Format_RGB888);
+
+        QVector<float> row(channels * width);
+        qint64 rowBytes = row.size() * sizeof(float);
+        for (unsigned y = 0; y < height; ++y) {
+            if (io.read((char *) row.data(), rowBytes) != rowBytes) {
+                return false;
+            }
+            unsigned char *dst = snapshot.scanLine(y);
+            const float *src = row.constData();
+            for (unsigned x = 0; x < width; ++x) {
+                for (unsigned c = 0; c < 3; ++c) {
+                    float value = src[channels >= 3 ? c : 0];
+                    dst[c] = (uchar)(qBound(0.0f, value, 1.0f) * 255.0f + 0.5f);
+                }
+                src += channels;
+                dst += 3;
+            }
+        }
+    }
+
+    commentNumber = info.commentNumber;
+    return true;
+}
+
 /**
  * Starting point for the retracing thread.
  *
@@ -390,11 +507,29 @@ void Retracer::run()
         arguments << QLatin1String("--msaa-no-resolve");
     }
 
+    /*
+     * Have images written to raw files rather than piping them PNG encoded
+     * through the state dump.  They are read back when building the
+     * ApiTraceState below, so the directory must outlive it.
+     */
+    QTemporaryDir stateImagesDir;
+
+    /*
+     * Thumbnails are scaled down by the retracer, and when it runs locally,
+     * handed over through shared memory rather than piped.
+     */
+    QTemporaryFile thumbnailRingFile;
+    image::RingHeader *thumbnailRing = nullptr;
+
     if (m_captureState) {
         arguments << QLatin1String("-D");
         arguments << QString::number(m_captureCall);
         arguments << QLatin1String("--dump-format");
         arguments << QLatin1String("ubjson");
+        if (m_remoteTarget.isEmpty() && stateImagesDir.isValid()) {
+            arguments << QLatin1String("--dump-images");
+            arguments << stateImagesDir.path();
+        }
     } else if (m_captureThumbnails) {
         if (!m_thumbnailsToCapture.isEmpty()) {
             arguments << QLatin1String("-S");
@@ -402,6 +537,18 @@ void Retracer::run()
         }
         arguments << QLatin1String("-s"); // emit snapshots
         arguments << QLatin1String("-"); // emit to stdout
+        // A remote retracer may predate these options
+        if (m_remoteTarget.isEmpty()) {
+            arguments << QLatin1String("--snapshot-size");
+            arguments << QString::number(THUMBNAIL_SIZE);
+            if (prog != QLatin1String("wine")) {
+                thumbnailRing = createThumbnailRing(thumbnailRingFile);
+                if (thumbnailRing) {
+                    arguments << QLatin1String("--snapshot-ring");
+                    arguments << thumbnailRingFile.fileName();
+                }
+            }
+        }
     } else if (isProfiling()) {
         if (m_profileGpu) {
             arguments << QLatin1String("--pgpu");
@@ -497,56 +644,79 @@ void Retracer::run()
         if (m_captureState) {
             parsedJson = decodeUBJSONObject(&io).toMap();
             process.waitForFinished(-1);
-        } else if (m_captureThumbnails) {
+        } else if (m_captureThumbnails && thumbnailRing) {
             /*
-             * Parse concatenated PNM images from output.
+             * Copy thumbnails out of the ring as they are announced, and read
+             * those which didn't go through the ring as PNM images.
              */
 
-            while (!io.atEnd()) {
-                image::PNMInfo info;
-
-                char header[512];
-                qint64 headerSize = 0;
-                int headerLines = 3; // assume no optional comment line
+            const uchar *ringData = reinterpret_cast<const uchar *>(thumbnailRing) + image::RING_HEADER_SIZE;
+            const quint64 capacity = thumbnailRing->capacity;
 
-                for (int headerLine = 0; headerLine < headerLines; ++headerLine) {
-                    qint64 headerRead = io.readLine(&header[headerSize], sizeof(header) - headerSize);
+            while (!io.atEnd()) {
+                char line[256];
+                qint64 lineLength = io.readLine(line, sizeof line);
+                if (lineLength <= 0) {
+                    break;
+                }
 
-                    // if header actually contains optional comment line, ...
-                    if (headerLine == 1 && header[headerSize] == '#') {
-                        ++headerLines;
+                if (line[0] == 'P') {
+                    QImage snapshot;
+                    int commentNumber;
+                    if (!readPNMSnapshot(io, line, lineLength, snapshot, commentNumber)) {
+                        qDebug() << "error: invalid snapshot stream encountered";
+                        break;
                     }
-
-                    headerSize += headerRead;
+                    thumbnails.insert(commentNumber, thumbnail(snapshot));
+                    continue;
                 }
 
-                const char *headerEnd = image::readPNMHeader(header, headerSize, info);
+                unsigned callNo, width, height;
+                unsigned long long position;
+                if (sscanf(line, "snapshot %u %u %u %llu", &callNo, &width, &height, &position) != 4) {
+                    qDebug() << "error: invalid snapshot stream encountered";
+                    break;
+                }
 
-                // if invalid PNM header was encountered, ...
-                if (headerEnd == NULL ||
-                    info.channelType != image::TYPE_UNORM8) {
+                quint64 size = quint64(width) * height * 3;
+                quint64 offset = position % capacity;
+                if (offset + size > capacity) {
                     qDebug() << "error: invalid snapshot stream encountered";
                     break;
                 }
 
-                unsigned channels = info.channels;
-                unsigned width = info.width;
-                unsigned height = info.height;
+                QImage thumb(width, height, QImage::Format_RGB888);
+                const uchar *src = ringData + offset;
+                for (unsigned y = 0; y < height; ++y) {
+                    memcpy(thumb.scanLine(y), src, width * 3);
+                    src += width * 3;
+                }
+
+                thumbnailRing->tail.store(position + size, std::memory_order_release);
+
+                thumbnails.insert(callNo, thumb);
+            }
 
-                // qDebug() << "channels: " << channels << ", width: " << width << ", height: " << height";
+            // Don't leave the retracer waiting for ring space
+            thumbnailRing->detached.store(1, std::memory_order_release);
+        } else if (m_captureThumbnails) {
+            /*
+             * Parse concatenated PNM images from output.
+             */
 
-                QImage snapshot = QImage(width, height, channels == 1 ? QImage::Format_Mono : QImage::Format_RGB888);
+            while (!io.atEnd()) {
+                char line[256];
+                qint64 lineLength = io.readLine(line, sizeof line);
 
-                int rowBytes = channels * width;
-                for (int y = 0; y < height; ++y) {
-                    unsigned char *scanLine = snapshot.scanLine(y);
-                    qint64 readBytes = io.read((char *) scanLine, rowBytes);
-                    Q_ASSERT(readBytes == rowBytes);
-                    (void)readBytes;
+                QImage snapshot;
+                int commentNumber;
+                if (!readPNMSnapshot(io, line, lineLength, snapshot, commentNumber)) {
+                    qDebug() << "error: invalid snapshot stream encountered";
+                    break;
                 }
 
                 QImage thumb = thumbnail(snapshot);
-                thumbnails.insert(info.commentNumber, thumb);
+                thumbnails.insert(commentNumber, thumb);
             }
 
             Q_ASSERT(process.state() != QProcess::Running);
@@ -47,6 +47,7 @@ void TraceLoader::loadTrace(const QString &filename)
         m_signatures.clear();
         m_frameBookmarks.clear();
         m_createdFrames.clear();
+        m_strings.clear();
         m_parser.close();
     }
 
@@ -23,6 +23,8 @@ public:
 
     trace::EnumSig *enumSignature(unsigned id);
 
+    ApiStringCache *strings() { return &m_strings; }
+
 private:
     class FrameContents
     {
@@ -117,4 +119,6 @@ private:
     QHash<QString, QUrl> m_helpHash;
 
     QVector<ApiTraceCallSignature*> m_signatures;
+
+    ApiStringCache m_strings;
 };
@@ -30,6 +30,7 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 #include <iostream>
@@ -128,6 +129,13 @@ public:
     void
     writeMD5(std::ostream &os) const;
 
+    /*
+     * CRC-32C of the image dimensions and pixels, for fast equality checks.
+     * With strip_alpha, RGBA images are hashed as RGB, like writePNG() does.
+     */
+    uint32_t
+    checksum(bool strip_alpha = false) const;
+
     bool
     writePNG(std::ostream &os, bool strip_alpha = false) const;
 
@@ -142,6 +150,50 @@ public:
 };
 
 
+/*
+ * Shrink the image with a box filter so that it fits in a maxSize x maxSize
+ * square, preserving the aspect ratio.  Images that already fit are copied.
+ */
+Image *
+downscale(const Image &image, unsigned maxSize);
+
+
+/*
+ * Differences between two images of the same size, in 8-bit units.
+ */
+struct Comparison
+{
+    // Largest absolute difference of any channel
+    unsigned maxError;
+
+    // Mean absolute difference over all compared channels
+    double meanError;
+
+    // Bits of precision left after the mean squared error of the color
+    // channels, as computed by snapdiff.py
+    double precision;
+
+    // Pixels where any channel differs by more than 255 * fuzz
+    unsigned long long mismatches;
+};
+
+/*
+ * Compare two images as 8-bit RGB, or RGBA when alpha is true.  Returns
+ * false when their sizes differ.
+ */
+bool
+compare(const Image &ref, const Image &src, Comparison &result,
+        double fuzz = 0.05, bool alpha = false);
+
+/*
+ * Make an image showing a faded copy of src, where pixels differing by more
+ * than 255 * fuzz are highlighted in red, like ImageMagick's compare.
+ * Returns NULL when the sizes differ.
+ */
+Image *
+diff(const Image &ref, const Image &src, double fuzz = 0.05, bool alpha = false);
+
+
 Image *
 readPNG(std::istream &is);
 
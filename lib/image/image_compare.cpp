@@ -0,0 +1,360 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#else
+#define HAVE_SSE2 0
+#endif
+
+#include "image.hpp"
+
+
+namespace image {
+
+
+static inline unsigned char
+channelUnorm8(const unsigned char *pixel, ChannelType type, unsigned channel)
+{
+    if (type == TYPE_UNORM8) {
+        return pixel[channel];
+    }
+    float value = reinterpret_cast<const float *>(pixel)[channel];
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+
+/*
+ * Convert to 8-bit RGB or RGBA, expanding luminance, and adding opaque
+ * alpha or dropping it as needed.
+ */
+static Image *
+convert(const Image &image, unsigned channels)
+{
+    assert(channels == 3 || channels == 4);
+
+    Image *result = new Image(image.width, image.height, channels);
+
+    const unsigned char *srcRow = image.start();
+    unsigned char *dst = result->pixels;
+    for (unsigned y = 0; y < image.height; ++y) {
+        const unsigned char *src = srcRow;
+        for (unsigned x = 0; x < image.width; ++x) {
+            unsigned char rgba[4];
+            if (image.channels >= 3) {
+                for (unsigned c = 0; c < 3; ++c) {
+                    rgba[c] = channelUnorm8(src, image.channelType, c);
+                }
+            } else {
+                rgba[0] = rgba[1] = rgba[2] = channelUnorm8(src, image.channelType, 0);
+            }
+            if (image.channels == 2 || image.channels == 4) {
+                rgba[3] = channelUnorm8(src, image.channelType, image.channels - 1);
+            } else {
+                rgba[3] = 255;
+            }
+            memcpy(dst, rgba, channels);
+            src += image.bytesPerPixel;
+            dst += channels;
+        }
+        srcRow += image.stride();
+    }
+
+    return result;
+}
+
+
+/*
+ * Get both images in the same 8-bit RGB or RGBA layout, converting them only
+ * when necessary.  RGBA images are compared as they are even when alpha is to
+ * be ignored, masking it instead.
+ */
+static void
+prepare(const Image &ref, const Image &src, bool alpha,
+        const Image *&a, const Image *&b,
+        std::unique_ptr<Image> &aConverted, std::unique_ptr<Image> &bConverted)
+{
+    unsigned channels = alpha ? 4 : 3;
+
+    a = &ref;
+    b = &src;
+
+    if (ref.channelType == TYPE_UNORM8 &&
+        src.channelType == TYPE_UNORM8 &&
+        ref.channels == src.channels &&
+        (ref.channels == 3 || ref.channels == 4)) {
+        return;
+    }
+
+    if (ref.channelType != TYPE_UNORM8 || ref.channels != channels) {
+        aConverted.reset(convert(ref, channels));
+        a = aConverted.get();
+    }
+    if (src.channelType != TYPE_UNORM8 || src.channels != channels) {
+        bConverted.reset(convert(src, channels));
+        b = bConverted.get();
+    }
+}
+
+
+struct RowStats
+{
+    uint64_t sum = 0;
+    uint64_t sumSquares = 0;
+    unsigned max = 0;
+};
+
+
+/*
+ * Accumulate the absolute differences of a row of bytes.  The mask, when
+ * given, has a period of 16 bytes and zeroes the differences to ignore.
+ */
+static void
+compareRow(const unsigned char *a, const unsigned char *b, size_t size,
+           const unsigned char *mask, RowStats &stats)
+{
+    size_t i = 0;
+
+#if HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vmask = mask
+        ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask))
+        : _mm_set1_epi8(-1);
+    __m128i vmax = zero;
+    __m128i vsum = zero;
+    __m128i vsumSquares = zero;
+
+    const size_t vectorSize = size & ~size_t(15);
+    while (i < vectorSize) {
+        // Squares are summed in 32-bit lanes, which gain at most 4 * 255^2
+        // per iteration, so widen them before they can overflow
+        const size_t blockEnd = std::min(vectorSize, i + 16 * 4096);
+        __m128i vblockSquares = zero;
+        for (; i < blockEnd; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            d = _mm_and_si128(d, vmask);
+            vmax = _mm_max_epu8(vmax, d);
+            vsum = _mm_add_epi64(vsum, _mm_sad_epu8(d, zero));
+            __m128i lo = _mm_unpacklo_epi8(d, zero);
+            __m128i hi = _mm_unpackhi_epi8(d, zero);
+            vblockSquares = _mm_add_epi32(vblockSquares, _mm_madd_epi16(lo, lo));
+            vblockSquares = _mm_add_epi32(vblockSquares, _mm_madd_epi16(hi, hi));
+        }
+        vsumSquares = _mm_add_epi64(vsumSquares, _mm_unpacklo_epi32(vblockSquares, zero));
+        vsumSquares = _mm_add_epi64(vsumSquares, _mm_unpackhi_epi32(vblockSquares, zero));
+    }
+
+    alignas(16) unsigned char maxBytes[16];
+    alignas(16) uint64_t sums[2];
+    alignas(16) uint64_t sumsSquares[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(maxBytes), vmax);
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums), vsum);
+    _mm_store_si128(reinterpret_cast<__m128i *>(sumsSquares), vsumSquares);
+    for (unsigned j = 0; j < 16; ++j) {
+        stats.max = std::max<unsigned>(stats.max, maxBytes[j]);
+    }
+    stats.sum += sums[0] + sums[1];
+    stats.sumSquares += sumsSquares[0] + sumsSquares[1];
+#endif
+
+    for (; i < size; ++i) {
+        unsigned d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        if (mask) {
+            d &= mask[i % 16];
+        }
+        stats.max = std::max(stats.max, d);
+        stats.sum += d;
+        stats.sumSquares += d * d;
+    }
+}
+
+
+bool
+compare(const Image &ref, const Image &src, Comparison &result,
+        double fuzz, bool alpha)
+{
+    if (ref.width != src.width || ref.height != src.height) {
+        return false;
+    }
+
+    const Image *a;
+    const Image *b;
+    std::unique_ptr<Image> aConverted;
+    std::unique_ptr<Image> bConverted;
+    prepare(ref, src, alpha, a, b, aConverted, bConverted);
+
+    const unsigned channels = a->channels;
+    assert(b->channels == channels);
+
+    // Mask out alpha from RGBA pixels when it is to be ignored
+    static const unsigned char alphaMask[16] = {
+        0xff, 0xff, 0xff, 0, 0xff, 0xff, 0xff, 0,
+        0xff, 0xff, 0xff, 0, 0xff, 0xff, 0xff, 0,
+    };
+    static const unsigned char alphaOnlyMask[16] = {
+        0, 0, 0, 0xff, 0, 0, 0, 0xff,
+        0, 0, 0, 0xff, 0, 0, 0, 0xff,
+    };
+    const unsigned char *mask = nullptr;
+    unsigned comparedChannels = channels;
+    if (channels == 4) {
+        mask = alphaMask;
+        if (!alpha) {
+            comparedChannels = 3;
+        }
+    }
+
+    const unsigned threshold = unsigned(255 * fuzz);
+
+    uint64_t sum = 0;
+    uint64_t sumSquares = 0;
+    unsigned maxError = 0;
+    unsigned long long mismatches = 0;
+
+    const unsigned char *aRow = a->start();
+    const unsigned char *bRow = b->start();
+    for (unsigned y = 0; y < a->height; ++y) {
+        RowStats stats;
+        compareRow(aRow, bRow, size_t(a->width) * channels, mask, stats);
+        sum += stats.sum;
+        sumSquares += stats.sumSquares;
+        if (comparedChannels == 4) {
+            // Alpha counts towards the errors but, like in snapdiff.py, not
+            // towards the precision
+            RowStats alphaStats;
+            compareRow(aRow, bRow, size_t(a->width) * channels, alphaOnlyMask, alphaStats);
+            sum += alphaStats.sum;
+            stats.max = std::max(stats.max, alphaStats.max);
+        }
+        maxError = std::max(maxError, stats.max);
+
+        // Only look at individual pixels in rows with large differences
+        if (stats.max > threshold) {
+            for (unsigned x = 0; x < a->width; ++x) {
+                const unsigned char *aPixel = aRow + x * channels;
+                const unsigned char *bPixel = bRow + x * channels;
+                for (unsigned c = 0; c < comparedChannels; ++c) {
+                    unsigned d = aPixel[c] > bPixel[c] ? aPixel[c] - bPixel[c] : bPixel[c] - aPixel[c];
+                    if (d > threshold) {
+                        ++mismatches;
+                        break;
+                    }
+                }
+            }
+        }
+
+        aRow += a->stride();
+        bRow += b->stride();
+    }
+
+    double count = double(a->width) * a->height * comparedChannels;
+
+    result.maxError = maxError;
+    result.meanError = count ? sum / count : 0.0;
+    if (count) {
+        double colorCount = double(a->width) * a->height * 3;
+        double relError = (sumSquares * 2.0 + 1.0) / (colorCount * 255.0 * 255.0 * 2.0);
+        result.precision = -log2(relError);
+    } else {
+        result.precision = 0.0;
+    }
+    result.mismatches = mismatches;
+
+    return true;
+}
+
+
+Image *
+diff(const Image &ref, const Image &src, double fuzz, bool alpha)
+{
+    if (ref.width != src.width || ref.height != src.height) {
+        return nullptr;
+    }
+
+    const Image *a;
+    const Image *b;
+    std::unique_ptr<Image> aConverted;
+    std::unique_ptr<Image> bConverted;
+    prepare(ref, src, alpha, a, b, aConverted, bConverted);
+
+    const unsigned channels = a->channels;
+    const unsigned comparedChannels = alpha ? channels : 3;
+
+    static const unsigned char lowlight[3] = {0xff, 0xff, 0xff};
+    static const unsigned char highlight[3] = {0xf1, 0x00, 0x1e};
+    const unsigned opacity = 0xcc;
+
+    Image *result = new Image(a->width, a->height, 3);
+
+    const unsigned char *aRow = a->start();
+    const unsigned char *bRow = b->start();
+    unsigned char *dst = result->pixels;
+    for (unsigned y = 0; y < a->height; ++y) {
+        for (unsigned x = 0; x < a->width; ++x) {
+            const unsigned char *aPixel = aRow + x * channels;
+            const unsigned char *bPixel = bRow + x * channels;
+            unsigned maxDiff = 0;
+            for (unsigned c = 0; c < comparedChannels; ++c) {
+                unsigned d = aPixel[c] > bPixel[c] ? aPixel[c] - bPixel[c] : bPixel[c] - aPixel[c];
+                maxDiff = std::max(maxDiff, d);
+            }
+
+            // Differences at or above 255 * fuzz are fully highlighted
+            unsigned weight;
+            if (fuzz > 0) {
+                weight = unsigned(std::min(maxDiff / fuzz, 255.0));
+            } else {
+                weight = maxDiff ? 255 : 0;
+            }
+
+            for (unsigned c = 0; c < 3; ++c) {
+                unsigned marked = (highlight[c] * weight + lowlight[c] * (255 - weight) + 127) / 255;
+                dst[c] = (unsigned char)((bPixel[c] * (255 - opacity) + marked * opacity + 127) / 255);
+            }
+            dst += 3;
+        }
+        aRow += a->stride();
+        bRow += b->stride();
+    }
+
+    result->label = src.label;
+
+    return result;
+}
+
+
+} /* namespace image */
@@ -0,0 +1,249 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "image.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace image;
+
+
+static unsigned char *
+pixel(Image &image, unsigned x, unsigned y)
+{
+    return image.start() + ptrdiff_t(y) * image.stride() + x * image.bytesPerPixel;
+}
+
+
+static const unsigned char *
+pixel(const Image &image, unsigned x, unsigned y)
+{
+    return image.start() + ptrdiff_t(y) * image.stride() + x * image.bytesPerPixel;
+}
+
+
+static void
+fill(Image &image, uint32_t seed)
+{
+    for (unsigned y = 0; y < image.height; ++y) {
+        for (unsigned x = 0; x < image.width; ++x) {
+            unsigned char *p = pixel(image, x, y);
+            for (unsigned c = 0; c < image.channels; ++c) {
+                seed = seed * 1664525 + 1013904223;
+                p[c] = (unsigned char)(seed >> 24);
+            }
+        }
+    }
+}
+
+
+static void
+copy(Image &dst, const Image &src)
+{
+    for (unsigned y = 0; y < src.height; ++y) {
+        for (unsigned x = 0; x < src.width; ++x) {
+            memcpy(pixel(dst, x, y), pixel(src, x, y), src.bytesPerPixel);
+        }
+    }
+}
+
+
+/*
+ * Straightforward per-pixel statistics, with the precision as snapdiff.py
+ * computes it: over the color channels only, alpha being either dropped or
+ * left out of its histogram.
+ */
+static Comparison
+reference(const Image &a, const Image &b, bool alpha)
+{
+    unsigned channels = alpha ? a.channels : 3;
+    unsigned max = 0;
+    uint64_t sum = 0;
+    uint64_t squareError = 0;
+    for (unsigned y = 0; y < a.height; ++y) {
+        for (unsigned x = 0; x < a.width; ++x) {
+            const unsigned char *pa = pixel(a, x, y);
+            const unsigned char *pb = pixel(b, x, y);
+            for (unsigned c = 0; c < channels; ++c) {
+                unsigned d = abs(int(pa[c]) - int(pb[c]));
+                max = std::max(max, d);
+                sum += d;
+                if (c < 3) {
+                    squareError += d * d;
+                }
+            }
+        }
+    }
+
+    Comparison result;
+    result.maxError = max;
+    result.meanError = double(sum) / (double(a.width) * a.height * channels);
+    double relError = double(squareError * 2 + 1) /
+                      double(uint64_t(a.width) * a.height * 3 * 255 * 255 * 2);
+    result.precision = -log(relError) / log(2.0);
+    result.mismatches = 0;
+    return result;
+}
+
+
+static void
+expectEqual(const Comparison &expected, const Comparison &actual)
+{
+    EXPECT_EQ(expected.maxError, actual.maxError);
+    EXPECT_DOUBLE_EQ(expected.meanError, actual.meanError);
+    EXPECT_NEAR(expected.precision, actual.precision, 1e-9);
+}
+
+
+TEST(image_compare, known_values)
+{
+    Image a(2, 1, 3);
+    Image b(2, 1, 3);
+    memset(a.pixels, 100, 6);
+    memset(b.pixels, 100, 6);
+    b.pixels[4] = 110;
+
+    Comparison result;
+    ASSERT_TRUE(compare(a, b, result, 0.05));
+    EXPECT_EQ(10u, result.maxError);
+    EXPECT_DOUBLE_EQ(10.0 / 6.0, result.meanError);
+    // (10*10*2 + 1) / (2*1*3*255*255*2)
+    EXPECT_NEAR(11.9226, result.precision, 1e-4);
+    EXPECT_EQ(0u, result.mismatches);
+
+    ASSERT_TRUE(compare(a, b, result, 0.0));
+    EXPECT_EQ(1u, result.mismatches);
+
+    // identical images still leave a finite precision
+    ASSERT_TRUE(compare(a, a, result));
+    EXPECT_EQ(0u, result.maxError);
+    EXPECT_EQ(0.0, result.meanError);
+    EXPECT_NEAR(-log2(1.0 / (6 * 255.0 * 255.0 * 2)), result.precision, 1e-9);
+}
+
+
+TEST(image_compare, odd_widths)
+{
+    // cover rows shorter than, equal to, and straddling 16 byte vectors
+    static const unsigned widths[] = {1, 3, 4, 5, 7, 13, 16, 17, 31, 33, 100};
+    for (unsigned channels = 3; channels <= 4; ++channels) {
+        for (unsigned width : widths) {
+            SCOPED_TRACE(testing::Message() << width << "x" << channels);
+            Image a(width, 3, channels);
+            Image b(width, 3, channels);
+            fill(a, width);
+            fill(b, width + 1);
+
+            for (bool alpha : {false, true}) {
+                Comparison result;
+                ASSERT_TRUE(compare(a, b, result, 0.05, alpha));
+                expectEqual(reference(a, b, alpha), result);
+            }
+        }
+    }
+}
+
+
+TEST(image_compare, alpha)
+{
+    Image a(17, 2, 4);
+    Image b(17, 2, 4);
+    fill(a, 1);
+    copy(b, a);
+    // only alpha differs, in the vector part and in the tail
+    pixel(b, 2, 0)[3] ^= 0x80;
+    pixel(b, 16, 1)[3] ^= 0x40;
+
+    Comparison result;
+    ASSERT_TRUE(compare(a, b, result, 0.05, false));
+    EXPECT_EQ(0u, result.maxError);
+    EXPECT_EQ(0.0, result.meanError);
+    EXPECT_EQ(0u, result.mismatches);
+
+    ASSERT_TRUE(compare(a, b, result, 0.05, true));
+    EXPECT_EQ(128u, result.maxError);
+    EXPECT_DOUBLE_EQ((128.0 + 64.0) / (17 * 2 * 4), result.meanError);
+    expectEqual(reference(a, b, true), result);
+
+    Comparison identical;
+    ASSERT_TRUE(compare(a, a, identical, 0.05, true));
+    EXPECT_DOUBLE_EQ(identical.precision, result.precision);
+}
+
+
+TEST(image_compare, flipped)
+{
+    Image a(21, 5, 4);
+    Image b(21, 5, 4, true);
+    Image c(21, 5, 4, true);
+    ASSERT_LT(b.stride(), 0);
+    fill(a, 7);
+    copy(b, a);
+    fill(c, 8);
+
+    Comparison result;
+    ASSERT_TRUE(compare(a, b, result));
+    EXPECT_EQ(0u, result.maxError);
+    EXPECT_EQ(0u, result.mismatches);
+
+    for (bool alpha : {false, true}) {
+        ASSERT_TRUE(compare(a, c, result, 0.05, alpha));
+        expectEqual(reference(a, c, alpha), result);
+        ASSERT_TRUE(compare(c, b, result, 0.05, alpha));
+        expectEqual(reference(c, b, alpha), result);
+    }
+}
+
+
+TEST(image_compare, wide)
+{
+    // rows long enough for the vector squares to be widened mid-row
+    Image a(20000, 2, 4);
+    Image b(20000, 2, 4);
+    memset(a.pixels, 0, a.sizeInBytes());
+    memset(b.pixels, 255, b.sizeInBytes());
+    pixel(b, 19999, 1)[0] = 0;
+
+    Comparison result;
+    ASSERT_TRUE(compare(a, b, result, 0.05, true));
+    expectEqual(reference(a, b, true), result);
+    EXPECT_EQ(255u, result.maxError);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
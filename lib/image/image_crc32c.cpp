@@ -0,0 +1,125 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+#include "image.hpp"
+
+#include "crc32c.hpp"
+
+
+namespace image {
+
+
+#ifdef HAVE_CRC32C_SSE42
+
+// Use the SSE4.2 CRC32 instruction, which implements CRC-32C.  It is
+// compiled for SSE4.2 regardless of the build flags, and only called when
+// the CPU supports it.
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32cUpdateSSE42(uint32_t crc, const unsigned char *data, size_t length)
+{
+    uint64_t crc64 = ~crc;
+    while (length >= 8) {
+        uint64_t value;
+        memcpy(&value, data, sizeof value);
+        crc64 = _mm_crc32_u64(crc64, value);
+        data += 8;
+        length -= 8;
+    }
+    uint32_t crc32 = (uint32_t)crc64;
+    while (length--) {
+        crc32 = _mm_crc32_u8(crc32, *data++);
+    }
+    return ~crc32;
+}
+
+static const bool haveSSE42 = __builtin_cpu_supports("sse4.2");
+
+#endif /* HAVE_CRC32C_SSE42 */
+
+
+static inline uint32_t
+crc32cUpdate(uint32_t crc, const unsigned char *data, size_t length)
+{
+#ifdef HAVE_CRC32C_SSE42
+    if (haveSSE42) {
+        return crc32cUpdateSSE42(crc, data, length);
+    }
+#endif
+    return crc32c_8bytes(data, length, crc);
+}
+
+
+uint32_t
+Image::checksum(bool strip_alpha) const {
+    // Hash the pixels as writePNG() would write them
+    strip_alpha = strip_alpha && channels == 4;
+    unsigned outChannels = strip_alpha ? 3 : channels;
+
+    uint32_t header[4] = {width, height, outChannels, (uint32_t)channelType};
+    uint32_t crc = crc32cUpdate(0, (const unsigned char *)header, sizeof header);
+
+    unsigned len = width*bytesPerPixel;
+    if (strip_alpha) {
+        unsigned bytesPerChannel = bytesPerPixel / channels;
+        unsigned colorBytes = bytesPerChannel * 3;
+        std::vector<unsigned char> color((size_t)width * colorBytes);
+        for (const unsigned char *row = start(); row != end(); row += stride()) {
+            const unsigned char *src = row;
+            unsigned char *dst = color.data();
+            for (unsigned x = 0; x < width; ++x) {
+                memcpy(dst, src, colorBytes);
+                src += bytesPerPixel;
+                dst += colorBytes;
+            }
+            crc = crc32cUpdate(crc, color.data(), color.size());
+        }
+        return crc;
+    }
+
+    if (!flipped) {
+        // Rows are contiguous
+        return crc32cUpdate(crc, start(), (size_t)len * height);
+    }
+
+    for (const unsigned char *row = start(); row != end(); row += stride()) {
+        crc = crc32cUpdate(crc, row, len);
+    }
+    return crc;
+}
+
+
+} /* namespace image */
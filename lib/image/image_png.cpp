@@ -196,6 +196,7 @@ readPNG(std::istream &is)
     png_infop info_ptr;
     png_infop end_info;
     unsigned channels;
+    int passes;
     Image *image;
 
     png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -240,6 +241,8 @@ readPNG(std::istream &is)
         png_set_tRNS_to_alpha(png_ptr);
     if (bit_depth == 16)
         png_set_strip_16(png_ptr);
+    passes = png_set_interlace_handling(png_ptr);
+    png_read_update_info(png_ptr, info_ptr);
 
     channels = png_get_channels(png_ptr, info_ptr);
     image = new Image(width, height, channels);
@@ -247,9 +250,11 @@ readPNG(std::istream &is)
         goto no_image;
 
     assert(png_get_rowbytes(png_ptr, info_ptr) == width*channels);
-    for (unsigned y = 0; y < height; ++y) {
-        png_bytep row = (png_bytep)(image->pixels + y*width*channels);
-        png_read_row(png_ptr, row, NULL);
+    for (int pass = 0; pass < passes; ++pass) {
+        for (unsigned y = 0; y < height; ++y) {
+            png_bytep row = (png_bytep)(image->pixels + y*width*channels);
+            png_read_row(png_ptr, row, NULL);
+        }
     }
 
     png_read_end(png_ptr, info_ptr);
@@ -270,7 +275,7 @@ readPNG(const char *filename)
     if (!is) {
         return NULL;
     }
-    return readPNG(filename);
+    return readPNG(is);
 }
 
 
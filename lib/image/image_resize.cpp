@@ -0,0 +1,130 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "image.hpp"
+
+
+namespace image {
+
+
+template< class Channel, class Sum >
+static void
+boxFilter(const Image &src, Image &dst)
+{
+    const unsigned channels = src.channels;
+    std::vector<Sum> sums(dst.width * channels);
+
+    unsigned char *dstRow = dst.start();
+    for (unsigned y = 0; y < dst.height; ++y) {
+        // Source rows [y0, y1) collapse onto destination row y
+        unsigned y0 = y * src.height / dst.height;
+        unsigned y1 = std::max((y + 1) * src.height / dst.height, y0 + 1);
+
+        std::fill(sums.begin(), sums.end(), Sum(0));
+
+        for (unsigned sy = y0; sy < y1; ++sy) {
+            const Channel *srcRow = (const Channel *)(src.start() + (signed)sy * src.stride());
+            for (unsigned x = 0; x < dst.width; ++x) {
+                unsigned x0 = x * src.width / dst.width;
+                unsigned x1 = std::max((x + 1) * src.width / dst.width, x0 + 1);
+                Sum *sum = &sums[x * channels];
+                for (unsigned sx = x0; sx < x1; ++sx) {
+                    const Channel *pixel = &srcRow[sx * channels];
+                    for (unsigned c = 0; c < channels; ++c) {
+                        sum[c] += pixel[c];
+                    }
+                }
+            }
+        }
+
+        Channel *out = (Channel *)dstRow;
+        for (unsigned x = 0; x < dst.width; ++x) {
+            unsigned x0 = x * src.width / dst.width;
+            unsigned x1 = std::max((x + 1) * src.width / dst.width, x0 + 1);
+            Sum count = Sum((x1 - x0) * (y1 - y0));
+            const Sum *sum = &sums[x * channels];
+            for (unsigned c = 0; c < channels; ++c) {
+                if (std::is_integral<Sum>::value) {
+                    out[x * channels + c] = Channel((sum[c] + count / 2) / count);
+                } else {
+                    out[x * channels + c] = Channel(sum[c] / count);
+                }
+            }
+        }
+
+        dstRow += dst.stride();
+    }
+}
+
+
+Image *
+downscale(const Image &image, unsigned maxSize)
+{
+    assert(maxSize > 0);
+
+    unsigned width = image.width;
+    unsigned height = image.height;
+    if (width > maxSize || height > maxSize) {
+        // Preserve the aspect ratio, rounding to the nearest pixel
+        if (width >= height) {
+            height = std::max((height * maxSize + width / 2) / width, 1U);
+            width = maxSize;
+        } else {
+            width = std::max((width * maxSize + height / 2) / height, 1U);
+            height = maxSize;
+        }
+    }
+
+    Image *result = new Image(width, height, image.channels, false, image.channelType);
+
+    if (width == image.width && height == image.height) {
+        const unsigned char *srcRow = image.start();
+        unsigned char *dstRow = result->start();
+        for (unsigned y = 0; y < height; ++y) {
+            memcpy(dstRow, srcRow, image._stride());
+            srcRow += image.stride();
+            dstRow += result->stride();
+        }
+    } else if (image.channelType == TYPE_UNORM8) {
+        boxFilter<unsigned char, unsigned>(image, *result);
+    } else {
+        boxFilter<float, float>(image, *result);
+    }
+
+    result->label = image.label;
+
+    return result;
+}
+
+
+} /* namespace image */
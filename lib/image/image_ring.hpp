@@ -0,0 +1,91 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Shared memory ring through which glretrace hands snapshots over to
+ * qapitrace, instead of piping them as PNM images.
+ *
+ * The consumer creates a file of RING_HEADER_SIZE + capacity bytes, fills in
+ * the header, and passes its path to glretrace with --snapshot-ring.  For
+ * every snapshot glretrace copies RGB888 pixels into the ring, and then
+ * writes a line
+ *
+ *     snapshot CALL_NO WIDTH HEIGHT POSITION
+ *
+ * to stdout.  POSITION counts bytes since the start of the stream; the pixels
+ * are at POSITION % capacity and never wrap around the end of the ring.  Once
+ * done with them the consumer sets tail to POSITION + WIDTH*HEIGHT*3, which
+ * lets glretrace reuse that space.
+ *
+ * Snapshots the ring can't carry (not 8 bits per channel, or larger than the
+ * ring) are written to stdout as PNM images instead, in between those lines.
+ * So are all snapshots once the consumer sets detached, when it stops reading,
+ * or when it fails to release space for too long.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+
+namespace image {
+
+
+#define RING_MAGIC "APISNAP1"
+
+struct RingHeader {
+    char magic[8];
+    uint64_t capacity;
+
+    // Bytes released by the consumer
+    std::atomic<uint64_t> tail;
+
+    // Set by the consumer once it no longer reads the ring
+    std::atomic<uint32_t> detached;
+};
+
+static const unsigned RING_HEADER_SIZE = 64;
+
+static_assert(sizeof(RingHeader) <= RING_HEADER_SIZE, "ring header too large");
+
+
+/*
+ * Position where a record of the given size is written after head, skipping
+ * to the start of the ring when it would not fit before the end.
+ */
+inline uint64_t
+ringRecordPosition(uint64_t head, uint64_t size, uint64_t capacity)
+{
+    uint64_t offset = head % capacity;
+    if (offset + size > capacity) {
+        head += capacity - offset;
+    }
+    return head;
+}
+
+
+} /* namespace image */
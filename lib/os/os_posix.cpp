@@ -38,6 +38,10 @@
 #include <pwd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <thread>
 
 #if defined(__linux__)
 #include <linux/limits.h> // PATH_MAX
@@ -67,6 +71,7 @@
 #include "os.hpp"
 #include "os_string.hpp"
 #include "os_backtrace.hpp"
+#include "os_thread.hpp"
 
 
 namespace os {
@@ -442,6 +447,21 @@ resetExceptionCallback(void)
 }
 
 
+bool
+pinCurrentThread(unsigned cpu)
+{
+#if defined(__linux__)
+    unsigned numCpus = std::thread::hardware_concurrency();
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(numCpus ? cpu % numCpus : 0, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof cpus, &cpus) == 0;
+#else
+    return false;
+#endif
+}
+
+
 } /* namespace os */
 
 #endif // !defined(_WIN32)
@@ -36,6 +36,10 @@
 #include <mutex>
 #include <condition_variable>
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 
 /**
  * Compiler TLS.
@@ -54,3 +58,32 @@
 #else
 #  error Unsupported C++ compiler
 #endif
+
+
+namespace os {
+
+
+/**
+ * Tell the CPU we are busy-waiting, so it can save power and let the
+ * sibling hyper-thread run.
+ */
+inline void
+cpuRelax(void)
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+
+/**
+ * Restrict the calling thread to run on a single CPU, numbered modulo the
+ * number of CPUs.  Returns false when not supported.
+ */
+bool
+pinCurrentThread(unsigned cpu);
+
+
+} /* namespace os */
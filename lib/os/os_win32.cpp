@@ -33,9 +33,11 @@
 #include <stdio.h>
 
 #include <string>
+#include <thread>
 
 #include "os.hpp"
 #include "os_string.hpp"
+#include "os_thread.hpp"
 
 
 namespace os {
@@ -394,6 +396,18 @@ resetExceptionCallback(void)
 }
 
 
+bool
+pinCurrentThread(unsigned cpu)
+{
+    unsigned numCpus = std::thread::hardware_concurrency();
+    if (numCpus > sizeof(DWORD_PTR) * 8) {
+        numCpus = sizeof(DWORD_PTR) * 8;
+    }
+    DWORD_PTR mask = DWORD_PTR(1) << (numCpus ? cpu % numCpus : 0);
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+
 } /* namespace os */
 
 #endif  // defined(_WIN32)
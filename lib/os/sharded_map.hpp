@@ -0,0 +1,102 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include "os_thread.hpp"
+
+
+/**
+ * Hash map split in independently locked shards, so that threads looking up
+ * different keys rarely contend for the same mutex.
+ */
+template< class Key, class Value, unsigned ShardCount = 16 >
+class ShardedMap {
+public:
+    typedef std::unordered_map<Key, Value> Map;
+
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Map map;
+    };
+
+    Shard shards[ShardCount];
+
+    Shard &
+    shard(const Key &key) {
+        // Keys are often pointers, so mix the low bits in
+        uint64_t h = std::hash<Key>()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return shards[h % ShardCount];
+    }
+
+public:
+    /**
+     * Copy the value for the key into value, returning whether it was found.
+     */
+    bool
+    find(const Key &key, Value &value) {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.map.find(key);
+        if (it == s.map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    /**
+     * Insert the value unless the key is already present, returning whether
+     * it was inserted.
+     */
+    bool
+    insert(const Key &key, const Value &value) {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.map.emplace(key, value).second;
+    }
+
+    /**
+     * Call f with the map holding the key, with its shard locked.
+     */
+    template< class F >
+    auto
+    withShard(const Key &key, F f) -> decltype(f(std::declval<Map &>())) {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return f(s.map);
+    }
+};
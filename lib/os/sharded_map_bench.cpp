@@ -0,0 +1,129 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures lookups of a few dozen keys from many threads at once, which is
+ * what the GL tracer does on every make-current, comparing ShardedMap with a
+ * single mutex guarded std::map.  Takes the maximum thread count as optional
+ * argument.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "sharded_map.hpp"
+
+
+struct Value {
+    unsigned count = 0;
+};
+
+typedef std::shared_ptr<Value> ValuePtr;
+
+
+class LockedMap {
+    std::recursive_mutex mutex;
+    std::map<uintptr_t, ValuePtr> map;
+
+public:
+    void
+    insert(uintptr_t key, const ValuePtr &value) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        map[key] = value;
+    }
+
+    bool
+    find(uintptr_t key, ValuePtr &value) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+};
+
+
+static const unsigned numKeys = 32;
+static const unsigned numLookups = 1000000;
+
+
+template< class Map >
+static double
+run(unsigned numThreads)
+{
+    Map map;
+    for (unsigned key = 0; key < numKeys; ++key) {
+        map.insert(0x10000 + key * 64, std::make_shared<Value>());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&map, t, numThreads] () {
+            ValuePtr value;
+            for (unsigned i = 0; i < numLookups; ++i) {
+                // Each thread cycles through its own contexts
+                uintptr_t key = 0x10000 + ((t + i * numThreads) % numKeys) * 64;
+                map.find(key, value);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / numLookups;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    if (argc > 1) {
+        maxThreads = std::max(atoi(argv[1]), 1);
+    }
+
+    printf("%8s %16s %16s\n", "threads", "locked (ns)", "sharded (ns)");
+    for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        double locked = run<LockedMap>(numThreads);
+        double sharded = run<ShardedMap<uintptr_t, ValuePtr>>(numThreads);
+        printf("%8u %16.1f %16.1f\n", numThreads, locked, sharded);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "sharded_map.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+
+TEST(sharded_map, basic)
+{
+    ShardedMap<uintptr_t, int> map;
+    int value = 0;
+
+    EXPECT_FALSE(map.find(1, value));
+    EXPECT_TRUE(map.insert(1, 10));
+    EXPECT_FALSE(map.insert(1, 20));
+    EXPECT_TRUE(map.find(1, value));
+    EXPECT_EQ(value, 10);
+
+    bool erased = map.withShard(1, [] (ShardedMap<uintptr_t, int>::Map &m) {
+        return m.erase(1) == 1;
+    });
+    EXPECT_TRUE(erased);
+    EXPECT_FALSE(map.find(1, value));
+}
+
+
+TEST(sharded_map, concurrent)
+{
+    typedef ShardedMap<uintptr_t, std::shared_ptr<unsigned>> Map;
+    Map map;
+
+    const unsigned numKeys = 64;
+    const unsigned numThreads = 8;
+    const unsigned numIterations = 10000;
+
+    for (unsigned key = 0; key < numKeys; ++key) {
+        // Pointer-like keys, with their low bits clear
+        map.insert(key * 16, std::make_shared<unsigned>(0));
+    }
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&map, t] () {
+            for (unsigned i = 0; i < numIterations; ++i) {
+                uintptr_t key = ((i + t) % numKeys) * 16;
+                map.withShard(key, [key] (Map::Map &m) {
+                    ++*m[key];
+                });
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    unsigned total = 0;
+    for (unsigned key = 0; key < numKeys; ++key) {
+        std::shared_ptr<unsigned> count;
+        ASSERT_TRUE(map.find(key * 16, count));
+        total += *count;
+    }
+    EXPECT_EQ(total, numThreads * numIterations);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -215,6 +215,8 @@ void Dumper::visit(Backtrace & backtrace) {
 
 void Dumper::visit(Call *call)
 {
+    call->decode();
+
     CallFlags callFlags = call->flags;
 
     if (!(dumpFlags & DUMP_FLAG_NO_CALL_NO)) {
@@ -28,6 +28,8 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 
 using namespace trace;
 
@@ -36,10 +38,15 @@ File::File(void)
 {
 }
 
+// Size of the window used when implementations don't provide their own
+#define REFILL_BUFFER_SIZE (64 * 1024)
+
+
 File::~File()
 {
     // We can't invoke any overriden virtual method here anymore
     assert(!m_isOpened);
+    delete [] m_refillBuffer;
 }
 
 
@@ -58,16 +65,115 @@ void File::setCurrentOffset(const File::Offset &offset)
     assert(0);
 }
 
-int File::rawGetc()
+bool File::refill(void)
+{
+    assert(m_windowPtr == m_windowEnd);
+    if (!m_isOpened) {
+        return false;
+    }
+    if (m_capture) {
+        flushCapture();
+        bool ret = rawRefill();
+        m_captureStart = m_windowPtr;
+        return ret;
+    }
+    return rawRefill();
+}
+
+bool File::rawRefill(void)
+{
+    if (!m_refillBuffer) {
+        m_refillBuffer = new unsigned char[REFILL_BUFFER_SIZE];
+    }
+    size_t length = rawRead(m_refillBuffer, REFILL_BUFFER_SIZE);
+    setWindow(m_refillBuffer, m_refillBuffer + length);
+    return length > 0;
+}
+
+size_t File::readSlow(void *buffer, size_t length)
+{
+    if (!m_isOpened) {
+        return 0;
+    }
+    size_t available = windowAvailable();
+    if (available) {
+        memcpy(buffer, m_windowPtr, available);
+        m_windowPtr = m_windowEnd;
+    }
+    char *rest = static_cast<char *>(buffer) + available;
+    if (m_capture) {
+        // The window may be lent from a cache that rawRead() overwrites
+        flushCapture();
+    }
+    size_t restLength = rawRead(rest, length - available);
+    if (m_capture) {
+        m_capture->insert(m_capture->end(), rest, rest + restLength);
+    }
+    return available + restLength;
+}
+
+int File::getcSlow(void)
 {
-    unsigned char c;
-    if (rawRead(&c, 1) != 1) {
+    if (!refill()) {
         return -1;
     }
-    return c;
+    return *m_windowPtr++;
 }
 
-bool File::rawSkip(size_t)
+bool File::skipSlow(size_t length)
 {
-    return false;
+    if (!m_isOpened) {
+        return false;
+    }
+    if (m_capture) {
+        // Go through the window so that the skipped bytes get captured
+        while (length) {
+            if (!windowAvailable() && !refill()) {
+                return false;
+            }
+            size_t available = std::min(length, windowAvailable());
+            m_windowPtr += available;
+            length -= available;
+        }
+        return true;
+    }
+    length -= windowAvailable();
+    m_windowPtr = m_windowEnd;
+    return rawSkip(length);
+}
+
+void File::beginCapture(std::vector<unsigned char> &buffer)
+{
+    assert(!m_capture);
+    m_capture = &buffer;
+    m_captureStart = m_windowPtr;
+}
+
+void File::endCapture(void)
+{
+    assert(m_capture);
+    flushCapture();
+    m_capture = nullptr;
+    m_captureStart = nullptr;
+}
+
+void File::flushCapture(void)
+{
+    if (m_captureStart < m_windowPtr) {
+        m_capture->insert(m_capture->end(), m_captureStart, m_windowPtr);
+    }
+    m_captureStart = m_windowPtr;
+}
+
+bool File::rawSkip(size_t length)
+{
+    while (length) {
+        if (!rawRefill()) {
+            return false;
+        }
+        size_t available = std::min(length, windowAvailable());
+        m_windowPtr += available;
+        length -= available;
+    }
+    return true;
 }
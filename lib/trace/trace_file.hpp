@@ -26,8 +26,12 @@
 
 #pragma once
 
-#include <fstream>
+#include <assert.h>
 #include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <vector>
 
 
 namespace trace {
@@ -63,6 +67,28 @@ public:
     bool skip(size_t length);
     int percentRead(void) const;
 
+    /*
+     * Window of decompressed bytes which can be consumed directly, without
+     * going through any virtual method.  Consumers may read up to
+     * windowEnd() and then advance past what they used; refill() replaces an
+     * exhausted window with the next bytes, and returns false at the end.
+     */
+    inline const unsigned char *windowBegin(void) const { return m_windowPtr; }
+    inline const unsigned char *windowEnd(void) const { return m_windowEnd; }
+    inline size_t windowAvailable(void) const { return m_windowEnd - m_windowPtr; }
+    inline void windowAdvance(const unsigned char *ptr) {
+        assert(ptr >= m_windowPtr && ptr <= m_windowEnd);
+        m_windowPtr = ptr;
+    }
+    bool refill(void);
+
+    /*
+     * Append every byte consumed from now on to the given buffer, until
+     * endCapture().  Only one capture may be active at a time.
+     */
+    void beginCapture(std::vector<unsigned char> &buffer);
+    void endCapture(void);
+
     // returns the size of (compressed/serialized) data in the container in bytes
     virtual size_t containerSizeInBytes(void) const = 0;
     // returns the amount of bytes read from the container
@@ -76,14 +102,42 @@ public:
     virtual File::Offset currentOffset(void) const;
     virtual void setCurrentOffset(const File::Offset &offset);
 protected:
+    /*
+     * The raw methods below are only invoked once the window is exhausted.
+     *
+     * rawRefill() should point the window at the implementation's own
+     * decompression cache when there is one, and account the bytes in it as
+     * consumed; the default implementation copies through rawRead().
+     */
     virtual bool rawOpen(const char *filename) = 0;
     virtual size_t rawRead(void *buffer, size_t length) = 0;
-    virtual int rawGetc(void);
+    virtual bool rawRefill(void);
     virtual void rawClose(void) = 0;
     virtual bool rawSkip(size_t length);
 
+    inline void setWindow(const void *begin, const void *end) {
+        m_windowPtr = static_cast<const unsigned char *>(begin);
+        m_windowEnd = static_cast<const unsigned char *>(end);
+    }
+    inline void discardWindow(void) {
+        m_windowPtr = m_windowEnd = nullptr;
+    }
+
+private:
+    size_t readSlow(void *buffer, size_t length);
+    int getcSlow(void);
+    bool skipSlow(size_t length);
+    void flushCapture(void);
+
 protected:
     bool m_isOpened = false;
+
+private:
+    const unsigned char *m_windowPtr = nullptr;
+    const unsigned char *m_windowEnd = nullptr;
+    unsigned char *m_refillBuffer = nullptr;
+    std::vector<unsigned char> *m_capture = nullptr;
+    const unsigned char *m_captureStart = nullptr;
 };
 
 inline bool File::isOpened(void) const
@@ -96,6 +150,7 @@ inline bool File::open(const char *filename)
     if (m_isOpened) {
         close();
     }
+    discardWindow();
     m_isOpened = rawOpen(filename);
 
     return m_isOpened;
@@ -103,10 +158,12 @@ inline bool File::open(const char *filename)
 
 inline size_t File::read(void *buffer, size_t length)
 {
-    if (!m_isOpened) {
-        return 0;
+    if (length <= windowAvailable()) {
+        memcpy(buffer, m_windowPtr, length);
+        m_windowPtr += length;
+        return length;
     }
-    return rawRead(buffer, length);
+    return readSlow(buffer, length);
 }
 
 inline int File::percentRead(void) const
@@ -122,6 +179,7 @@ inline int File::percentRead(void) const
 inline void File::close(void)
 {
     if (m_isOpened) {
+        discardWindow();
         rawClose();
         m_isOpened = false;
     }
@@ -129,18 +187,19 @@ inline void File::close(void)
 
 inline int File::getc(void)
 {
-    if (!m_isOpened) {
-        return -1;
+    if (m_windowPtr < m_windowEnd) {
+        return *m_windowPtr++;
     }
-    return rawGetc();
+    return getcSlow();
 }
 
 inline bool File::skip(size_t length)
 {
-    if (!m_isOpened) {
-        return false;
+    if (length <= windowAvailable()) {
+        m_windowPtr += length;
+        return true;
     }
-    return rawSkip(length);
+    return skipSlow(length);
 }
 
 inline bool
@@ -148,7 +148,7 @@ size_t BrotliFile::containerBytesRead(void) const {
 }
 
 size_t BrotliFile::dataBytesRead(void) const {
-    return m_dataBytesRead;
+    return m_dataBytesRead - windowAvailable();
 }
 
 const char *BrotliFile::containerType(void) const {
@@ -82,6 +82,7 @@ public:
 protected:
     virtual bool rawOpen(const char *filename) override;
     virtual size_t rawRead(void *buffer, size_t length) override;
+    virtual bool rawRefill(void) override;
     virtual void rawClose(void) override;
     virtual bool rawSkip(size_t length) override;
 
@@ -204,6 +205,26 @@ size_t SnappyFile::rawRead(void *buffer, size_t length)
     return length;
 }
 
+bool SnappyFile::rawRefill(void)
+{
+    if (endOfData()) {
+        return false;
+    }
+
+    if (!freeCacheSize()) {
+        flushReadCache();
+        if (!freeCacheSize()) {
+            return false;
+        }
+    }
+
+    // Lend the rest of the chunk
+    setWindow(m_cachePtr, m_cache + m_cacheSize);
+    m_dataBytesRead += freeCacheSize();
+    m_cachePtr = m_cache + m_cacheSize;
+    return true;
+}
+
 void SnappyFile::rawClose(void)
 {
     m_stream.close();
@@ -298,12 +319,13 @@ File::Offset SnappyFile::currentOffset(void) const
 {
     File::Offset offset;
     offset.chunk = m_currentChunkOffset;
-    offset.offsetInChunk = m_cachePtr - m_cache;
+    offset.offsetInChunk = usedCacheSize() - windowAvailable();
     return offset;
 }
 
 void SnappyFile::setCurrentOffset(const File::Offset &offset)
 {
+    discardWindow();
     // to remove eof bit
     m_stream.clear();
     // seek to the start of a chunk
@@ -353,7 +375,7 @@ size_t SnappyFile::containerBytesRead(void) const {
 }
 
 size_t SnappyFile::dataBytesRead(void) const {
-    return static_cast<size_t>(m_dataBytesRead);
+    return static_cast<size_t>(m_dataBytesRead) - windowAvailable();
 }
 
 const char *SnappyFile::containerType(void) const {
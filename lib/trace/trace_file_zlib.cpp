@@ -56,7 +56,6 @@ public:
 protected:
     virtual bool rawOpen(const char *filename) override;
     virtual size_t rawRead(void *buffer, size_t length) override;
-    virtual int rawGetc(void) override;
     virtual void rawClose(void) override;
 
     size_t containerSizeInBytes(void) const override;
@@ -123,11 +122,6 @@ size_t ZLibFile::rawRead(void *buffer, size_t length)
     return ret < 0 ? 0 : ret;
 }
 
-int ZLibFile::rawGetc()
-{
-    return gzgetc(m_gzFile);
-}
-
 void ZLibFile::rawClose()
 {
     if (m_gzFile) {
@@ -145,7 +139,7 @@ size_t ZLibFile::containerBytesRead(void) const {
 }
 
 size_t ZLibFile::dataBytesRead(void) const {
-    return m_dataBytesRead;
+    return m_dataBytesRead - windowAvailable();
 }
 
 const char *ZLibFile::containerType(void) const {
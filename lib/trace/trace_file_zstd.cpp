@@ -56,6 +56,7 @@ public:
 protected:
     virtual bool rawOpen(const char *filename) override;
     virtual size_t rawRead(void *buffer, size_t length) override;
+    virtual bool rawRefill(void) override;
     virtual void rawClose(void) override;
 
     size_t containerSizeInBytes(void) const override;
@@ -185,6 +186,22 @@ size_t ZstdFile::rawRead(void *buffer, size_t length)
     return totalRead;
 }
 
+bool ZstdFile::rawRefill(void)
+{
+    if (!cacheRemaining()) {
+        reloadCache();
+        if (!cacheRemaining()) {
+            return false;
+        }
+    }
+
+    // Lend the rest of the cache
+    setWindow(m_cache + m_cachePos, m_cache + m_cacheSize);
+    m_dataBytesRead += cacheRemaining();
+    m_cachePos = m_cacheSize;
+    return true;
+}
+
 void ZstdFile::rawClose(void)
 {
     if (m_dstream) {
@@ -259,7 +276,7 @@ size_t ZstdFile::containerBytesRead(void) const
 
 size_t ZstdFile::dataBytesRead(void) const
 {
-    return m_dataBytesRead;
+    return m_dataBytesRead - windowAvailable();
 }
 
 const char* ZstdFile::containerType() const
@@ -69,6 +69,7 @@ public:
 protected:
     virtual bool rawOpen(const char *filename) override;
     virtual size_t rawRead(void *buffer, size_t length) override;
+    virtual bool rawRefill(void) override;
     virtual void rawClose(void) override;
     virtual bool rawSkip(size_t length) override;
 
@@ -200,6 +201,26 @@ size_t ZstdSeekableFile::rawRead(void *buffer, size_t length)
     return totalRead;
 }
 
+bool ZstdSeekableFile::rawRefill(void)
+{
+    if (endOfData()) {
+        return false;
+    }
+
+    if (!cacheRemaining()) {
+        reloadCache();
+        if (!cacheRemaining()) {
+            return false;
+        }
+    }
+
+    // Lend the rest of the cache
+    setWindow(m_cache + m_cachePos, m_cache + m_cacheSize);
+    m_currentOffset += cacheRemaining();
+    m_cachePos = m_cacheSize;
+    return true;
+}
+
 void ZstdSeekableFile::rawClose(void)
 {
     if (m_seekable) {
@@ -240,13 +261,14 @@ bool ZstdSeekableFile::supportsOffsets(void) const
 File::Offset ZstdSeekableFile::currentOffset(void) const
 {
     File::Offset offset;
-    offset.chunk = m_currentOffset;
+    offset.chunk = m_currentOffset - windowAvailable();
     offset.offsetInChunk = 0;
     return offset;
 }
 
 void ZstdSeekableFile::setCurrentOffset(const File::Offset &offset)
 {
+    discardWindow();
     m_currentOffset = offset.chunk;
     // Invalidate cache, force refill on next read
     m_cacheSize = 0;
@@ -292,7 +314,7 @@ size_t ZstdSeekableFile::containerBytesRead(void) const
 
 size_t ZstdSeekableFile::dataBytesRead(void) const
 {
-    return m_currentOffset;
+    return m_currentOffset - windowAvailable();
 }
 
 const char* ZstdSeekableFile::containerType() const
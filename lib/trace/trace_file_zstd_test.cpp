@@ -0,0 +1,154 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "trace_ostream.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+
+
+static const char *args[] = {"value", "data"};
+static const FunctionSig sig = {0, "glFoo", 2, args};
+
+static const size_t blobSize = 1024;
+
+
+static void
+fillBlob(unsigned char *data, unsigned i)
+{
+    unsigned seed = i;
+    for (size_t j = 0; j < blobSize; ++j) {
+        seed = seed * 1103515245 + 12345;
+        data[j] = seed >> 16;
+    }
+}
+
+
+static void
+checkCall(Call *call, unsigned i)
+{
+    ASSERT_TRUE(call);
+    ASSERT_EQ(call->no, i);
+    ASSERT_EQ(call->arg(0).toUInt(), i);
+
+    const Blob *blob = call->arg(1).toBlob();
+    ASSERT_TRUE(blob);
+    ASSERT_EQ(blob->size, blobSize);
+    unsigned char expected[blobSize];
+    fillBlob(expected, i);
+    ASSERT_EQ(memcmp(blob->buf, expected, blobSize), 0);
+}
+
+
+/*
+ * Write a trace several times the zstd frame size, compressed by worker
+ * threads, and read it back, seeking across frames.
+ */
+TEST(trace_file_zstd, seekable)
+{
+    const char *filename = "trace_file_zstd_test.trace";
+
+    // 1KB per call, so about 5 frames of 2MB
+    const unsigned count = 10000;
+    const unsigned interval = 1000;
+
+    {
+        OutStream *stream = createZstdStream(filename, 1, 2);
+        ASSERT_TRUE(stream);
+
+        Writer writer;
+        ASSERT_TRUE(writer.open(stream, TRACE_VERSION, Properties()));
+        unsigned char data[blobSize];
+        for (unsigned i = 0; i < count; ++i) {
+            unsigned call = writer.beginEnter(&sig, 0);
+            writer.beginArg(0);
+            writer.writeUInt(i);
+            writer.endArg();
+            writer.beginArg(1);
+            fillBlob(data, i);
+            writer.writeBlob(data, blobSize);
+            writer.endArg();
+            writer.endEnter();
+            writer.beginLeave(call);
+            writer.endLeave();
+        }
+        writer.close();
+    }
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    EXPECT_STREQ(parser.containerType(), "Zstandard (seekable)");
+    ASSERT_TRUE(parser.supportsOffsets());
+
+    std::vector<ParseBookmark> bookmarks;
+    for (unsigned i = 0; i < count; ++i) {
+        if (i % interval == 0) {
+            bookmarks.emplace_back();
+            parser.getBookmark(bookmarks.back());
+        }
+        std::unique_ptr<Call> call(parser.parse_call());
+        checkCall(call.get(), i);
+    }
+    EXPECT_EQ(parser.parse_call(), nullptr);
+
+    // Offsets are uncompressed positions, and frames are capped at 2MB of
+    // trace data, so the bookmarks must span several frames
+    ASSERT_GT(bookmarks.back().offset.chunk, 2u * 2 * 1024 * 1024);
+
+    // Seek backwards, parsing on past the next bookmark each time, so that
+    // frame boundaries are crossed after seeking too
+    for (size_t b = bookmarks.size(); b-- > 0; ) {
+        parser.setBookmark(bookmarks[b]);
+        unsigned end = std::min<unsigned>(b * interval + interval * 3 / 2, count);
+        for (unsigned i = b * interval; i < end; ++i) {
+            std::unique_ptr<Call> call(parser.parse_call());
+            checkCall(call.get(), i);
+        }
+    }
+
+    parser.close();
+    remove(filename);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
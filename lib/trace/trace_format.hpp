@@ -34,7 +34,7 @@
 namespace trace {
 
 
-#define TRACE_VERSION 6
+#define TRACE_VERSION 7
 
 
 enum Event {
@@ -68,6 +68,25 @@ enum Type {
     TYPE_OPAQUE,
     TYPE_REPR,
     TYPE_WSTRING,
+    TYPE_PACKED_ARRAY,
+};
+
+/*
+ * Element types of packed arrays.  Elements are stored with their natural
+ * size, in the host byte order.
+ */
+enum PackedType {
+    PACKED_SINT8 = 0,
+    PACKED_UINT8,
+    PACKED_SINT16,
+    PACKED_UINT16,
+    PACKED_SINT32,
+    PACKED_UINT32,
+    PACKED_SINT64,
+    PACKED_UINT64,
+    PACKED_FLOAT,
+    PACKED_DOUBLE,
+    PACKED_TYPE_COUNT,
 };
 
 enum BacktraceDetail {
@@ -0,0 +1,211 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+
+#include "trace_hash.hpp"
+#include "trace_format.hpp"
+
+
+namespace trace {
+
+
+void
+Hasher::update(const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+    update(static_cast<uint64_t>(size));
+
+    while (size >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof word);
+        update(word);
+        bytes += sizeof word;
+        size -= sizeof word;
+    }
+
+    if (size) {
+        uint64_t word = 0;
+        memcpy(&word, bytes, size);
+        update(word);
+    }
+}
+
+
+uint64_t
+PointerOrdinals::get(unsigned long long pointer) {
+    if (!pointer) {
+        return 0;
+    }
+    auto result = ordinals.emplace(pointer, ordinals.size() + 1);
+    return result.first->second;
+}
+
+
+class HashVisitor : public Visitor
+{
+private:
+    Hasher &hasher;
+    PointerOrdinals *pointers;
+
+    inline void
+    _hash(Value *value) {
+        if (value) {
+            value->visit(*this);
+        } else {
+            hasher.update(UINT64_C(~0));
+        }
+    }
+
+public:
+    HashVisitor(Hasher &_hasher, PointerOrdinals *_pointers) :
+        hasher(_hasher),
+        pointers(_pointers)
+    {}
+
+    void visit(Null *) override {
+        hasher.update(TYPE_NULL);
+    }
+
+    void visit(Bool *node) override {
+        hasher.update(node->value ? TYPE_TRUE : TYPE_FALSE);
+    }
+
+    void visit(SInt *node) override {
+        // Non-negative signed integers are only distinguishable from unsigned
+        // ones in packed arrays
+        hasher.update(node->value < 0 ? TYPE_SINT : TYPE_UINT);
+        hasher.update(static_cast<uint64_t>(node->value));
+    }
+
+    void visit(UInt *node) override {
+        hasher.update(TYPE_UINT);
+        hasher.update(node->value);
+    }
+
+    void visit(Float *node) override {
+        uint32_t bits;
+        memcpy(&bits, &node->value, sizeof bits);
+        hasher.update(TYPE_FLOAT);
+        hasher.update(bits);
+    }
+
+    void visit(Double *node) override {
+        uint64_t bits;
+        memcpy(&bits, &node->value, sizeof bits);
+        hasher.update(TYPE_DOUBLE);
+        hasher.update(bits);
+    }
+
+    void visit(String *node) override {
+        hasher.update(TYPE_STRING);
+        hasher.update(node->value);
+    }
+
+    void visit(WString *node) override {
+        hasher.update(TYPE_WSTRING);
+        size_t len = 0;
+        while (node->value[len]) {
+            ++len;
+        }
+        hasher.update(node->value, len * sizeof node->value[0]);
+    }
+
+    void visit(Enum *node) override {
+        hasher.update(TYPE_ENUM);
+        hasher.update(static_cast<uint64_t>(node->value));
+    }
+
+    void visit(Bitmask *node) override {
+        hasher.update(TYPE_BITMASK);
+        hasher.update(node->value);
+    }
+
+    void visit(Struct *node) override {
+        hasher.update(TYPE_STRUCT);
+        hasher.update(node->sig->name);
+        for (auto member : node->members) {
+            _hash(member);
+        }
+    }
+
+    void visit(Array *node) override {
+        hasher.update(TYPE_ARRAY);
+        hasher.update(static_cast<uint64_t>(node->values.size()));
+        for (auto value : node->values) {
+            _hash(value);
+        }
+    }
+
+    void visit(Blob *node) override {
+        hasher.update(TYPE_BLOB);
+        hasher.update(node->buf, node->size);
+    }
+
+    void visit(Pointer *node) override {
+        hasher.update(TYPE_OPAQUE);
+        if (pointers) {
+            hasher.update(pointers->get(node->value));
+        } else {
+            hasher.update(static_cast<uint64_t>(node->value != 0));
+        }
+    }
+
+    void visit(Repr *node) override {
+        hasher.update(TYPE_REPR);
+        _hash(node->machineValue);
+    }
+};
+
+
+void
+hash(Hasher &hasher, const Value *value, PointerOrdinals *pointers) {
+    HashVisitor visitor(hasher, pointers);
+    // Visitor interface is not const-correct, but hashing doesn't modify
+    // anything.
+    Value *node = const_cast<Value *>(value);
+    if (node) {
+        node->visit(visitor);
+    } else {
+        hasher.update(UINT64_C(~0));
+    }
+}
+
+
+uint64_t
+hashCall(const Call &call, PointerOrdinals *pointers) {
+    Hasher hasher;
+    hasher.update(call.name());
+    hasher.update(static_cast<uint64_t>(call.args.size()));
+    for (auto & arg : call.args) {
+        hash(hasher, arg.value, pointers);
+    }
+    hash(hasher, call.ret, pointers);
+    return hasher.digest();
+}
+
+
+} /* namespace trace */
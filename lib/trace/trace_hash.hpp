@@ -0,0 +1,130 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Hashing of parsed calls, for quickly comparing traces.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+
+#include "trace_model.hpp"
+
+
+namespace trace {
+
+
+/**
+ * Incremental, non-cryptographic, 64 bits hash.
+ */
+class Hasher
+{
+private:
+    uint64_t state = 0xcbf29ce484222325ULL;
+
+    static inline uint64_t
+    mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+public:
+    inline void
+    update(uint64_t value) {
+        state = (state ^ mix(value)) * 0x100000001b3ULL;
+        state ^= state >> 29;
+    }
+
+    void
+    update(const void *data, size_t size);
+
+    inline void
+    update(const char *str);
+
+    inline uint64_t
+    digest(void) const {
+        return mix(state);
+    }
+};
+
+
+inline void
+Hasher::update(const char *str) {
+    if (!str) {
+        update(UINT64_C(0));
+        return;
+    }
+    size_t len = 0;
+    while (str[len]) {
+        ++len;
+    }
+    update(str, len);
+}
+
+
+/**
+ * Numbers distinct non-null pointers in the order they are first hashed.
+ *
+ * Addresses differ from run to run, so pointers are hashed by ordinal rather
+ * than by value, or merely as null or non-null when no ordinals are given.
+ */
+class PointerOrdinals
+{
+private:
+    std::unordered_map<unsigned long long, uint64_t> ordinals;
+
+public:
+    uint64_t
+    get(unsigned long long pointer);
+
+    inline void
+    clear(void) {
+        ordinals.clear();
+    }
+};
+
+
+void
+hash(Hasher &hasher, const Value *value, PointerOrdinals *pointers = nullptr);
+
+
+/**
+ * Hash the function name, arguments and return value of a call.
+ *
+ * Call number, thread and flags are deliberately left out, so that the same
+ * call made in two different traces yields the same hash.
+ */
+uint64_t
+hashCall(const Call &call, PointerOrdinals *pointers = nullptr);
+
+
+} /* namespace trace */
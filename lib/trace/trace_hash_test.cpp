@@ -0,0 +1,141 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+
+#include <memory>
+
+#include "trace_hash.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+
+
+static const char *args[] = {"x", "y"};
+static const FunctionSig sigA = {0, "glFoo", 2, args};
+static const FunctionSig sigB = {1, "glBar", 2, args};
+
+
+static Call *
+makeCall(const FunctionSig *sig, unsigned no, signed long long x, float y)
+{
+    Call *call = new Call(sig, 0, 0);
+    call->no = no;
+    call->args[0].value = new SInt(x);
+    call->args[1].value = new Float(y);
+    return call;
+}
+
+
+TEST(trace_hash, call)
+{
+    std::unique_ptr<Call> a(makeCall(&sigA, 0, 1, 2.0f));
+    std::unique_ptr<Call> b(makeCall(&sigA, 10, 1, 2.0f));
+    std::unique_ptr<Call> c(makeCall(&sigA, 0, 1, 3.0f));
+    std::unique_ptr<Call> d(makeCall(&sigB, 0, 1, 2.0f));
+
+    // Call numbers don't matter
+    EXPECT_EQ(hashCall(*a), hashCall(*b));
+
+    // Arguments and names do
+    EXPECT_NE(hashCall(*a), hashCall(*c));
+    EXPECT_NE(hashCall(*a), hashCall(*d));
+}
+
+
+TEST(trace_hash, value)
+{
+    Blob blob1(13);
+    Blob blob2(13);
+    memset(blob1.buf, 0xaa, blob1.size);
+    memset(blob2.buf, 0xaa, blob2.size);
+
+    Hasher h1, h2;
+    hash(h1, &blob1);
+    hash(h2, &blob2);
+    EXPECT_EQ(h1.digest(), h2.digest());
+
+    blob2.buf[12] = 0;
+    Hasher h3;
+    hash(h3, &blob2);
+    EXPECT_NE(h1.digest(), h3.digest());
+
+    // Same bits, different types
+    SInt s(-1);
+    UInt u(~0ULL);
+    Hasher h4, h5;
+    hash(h4, &s);
+    hash(h5, &u);
+    EXPECT_NE(h4.digest(), h5.digest());
+
+    // Non-negative integers from packed arrays match unpacked ones
+    SInt s0(0);
+    UInt u0(0);
+    Hasher h6, h7;
+    hash(h6, &s0);
+    hash(h7, &u0);
+    EXPECT_EQ(h6.digest(), h7.digest());
+}
+
+
+TEST(trace_hash, pointer)
+{
+    // Same calls on different addresses, as happens under ASLR
+    std::unique_ptr<Call> a1(makeCall(&sigA, 0, 1, 2.0f));
+    std::unique_ptr<Call> a2(makeCall(&sigA, 1, 1, 2.0f));
+    std::unique_ptr<Call> b1(makeCall(&sigA, 0, 1, 2.0f));
+    std::unique_ptr<Call> b2(makeCall(&sigA, 1, 1, 2.0f));
+    std::unique_ptr<Call> c2(makeCall(&sigA, 1, 1, 2.0f));
+    a1->ret = new Pointer(0x7f0000001000);
+    a2->ret = new Pointer(0x7f0000001000);
+    b1->ret = new Pointer(0x5500000a0000);
+    b2->ret = new Pointer(0x5500000a0000);
+    c2->ret = new Pointer(0x5500000b0000);
+
+    EXPECT_EQ(hashCall(*a1), hashCall(*b1));
+
+    PointerOrdinals pointersA;
+    PointerOrdinals pointersB;
+    EXPECT_EQ(hashCall(*a1, &pointersA), hashCall(*b1, &pointersB));
+    EXPECT_EQ(hashCall(*a2, &pointersA), hashCall(*b2, &pointersB));
+
+    // A pointer not seen before is told apart from a repeated one
+    EXPECT_NE(hashCall(*a2, &pointersA), hashCall(*c2, &pointersB));
+
+    // Null pointers are always told apart
+    std::unique_ptr<Call> n(makeCall(&sigA, 0, 1, 2.0f));
+    n->ret = new Pointer(0);
+    EXPECT_NE(hashCall(*a1), hashCall(*n));
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
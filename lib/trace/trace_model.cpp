@@ -24,8 +24,11 @@
  **************************************************************************/
 
 
+#include <stdint.h>
 #include <string.h>
+
 #include <deque>
+#include <new>
 
 #include "trace_model.hpp"
 
@@ -44,6 +47,14 @@ Call::~Call() {
     delete ret;
 }
 
+void
+Call::decodeEncoded(void) {
+    CallDecoder *callDecoder = decoder;
+    decoder = nullptr;
+    callDecoder->decodeCall(this, encoded.data(), encoded.size());
+    std::vector<unsigned char>().swap(encoded);
+}
+
 Value &
 Call::argByName(const char *argName) {
     for (unsigned i = 0; i < sig->num_args; ++i) {
@@ -55,8 +66,43 @@ Call::argByName(const char *argName) {
 }
 
 
+SharedString *
+SharedString::create(const char *str, size_t length) {
+    void *storage = ::operator new(sizeof(SharedString) + length + 1);
+    SharedString *shared = new (storage) SharedString(length);
+    char *data = reinterpret_cast<char *>(shared + 1);
+    memcpy(data, str, length);
+    data[length] = 0;
+    return shared;
+}
+
+
+void
+SharedString::release(void) {
+    if (refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->~SharedString();
+        ::operator delete(this);
+    }
+}
+
+
 String::~String() {
-    delete [] value;
+    if (shared) {
+        shared->release();
+    } else {
+        delete [] value;
+    }
+}
+
+
+void String::reset(const char * _value) {
+    if (shared) {
+        shared->release();
+        shared = nullptr;
+    } else {
+        delete [] value;
+    }
+    value = _value;
 }
 
 
@@ -79,6 +125,111 @@ Array::~Array() {
 }
 
 
+PackedArray::PackedArray(PackedType _type, size_t len) :
+    Array(len),
+    type(_type),
+    elements(nullptr)
+{
+    bufSize = len * elementSize(type);
+    buf = new char[bufSize];
+}
+
+
+PackedArray::~PackedArray() {
+    if (elements) {
+        for (auto & value : values) {
+            value->~Value();
+        }
+        ::operator delete(elements);
+    }
+    // Prevent Array::~Array from deleting the elements
+    values.clear();
+    delete [] buf;
+}
+
+
+size_t
+PackedArray::elementSize(PackedType type) {
+    switch (type) {
+    case PACKED_SINT8:
+    case PACKED_UINT8:
+        return 1;
+    case PACKED_SINT16:
+    case PACKED_UINT16:
+        return 2;
+    case PACKED_SINT32:
+    case PACKED_UINT32:
+    case PACKED_FLOAT:
+        return 4;
+    case PACKED_SINT64:
+    case PACKED_UINT64:
+    case PACKED_DOUBLE:
+        return 8;
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+
+template< class T, typename E >
+static Value *
+unpackElements(std::vector<Value *> &values, const char *buf)
+{
+    size_t len = values.size();
+    T *elements = static_cast<T *>(::operator new(len * sizeof(T)));
+    for (size_t i = 0; i < len; ++i) {
+        E element;
+        memcpy(&element, buf + i * sizeof element, sizeof element);
+        values[i] = new (&elements[i]) T(element);
+    }
+    return elements;
+}
+
+
+void
+PackedArray::unpack(void) {
+    assert(!elements);
+    if (values.empty()) {
+        return;
+    }
+    switch (type) {
+    case PACKED_SINT8:
+        elements = unpackElements<SInt, int8_t>(values, buf);
+        break;
+    case PACKED_UINT8:
+        elements = unpackElements<UInt, uint8_t>(values, buf);
+        break;
+    case PACKED_SINT16:
+        elements = unpackElements<SInt, int16_t>(values, buf);
+        break;
+    case PACKED_UINT16:
+        elements = unpackElements<UInt, uint16_t>(values, buf);
+        break;
+    case PACKED_SINT32:
+        elements = unpackElements<SInt, int32_t>(values, buf);
+        break;
+    case PACKED_UINT32:
+        elements = unpackElements<UInt, uint32_t>(values, buf);
+        break;
+    case PACKED_SINT64:
+        elements = unpackElements<SInt, int64_t>(values, buf);
+        break;
+    case PACKED_UINT64:
+        elements = unpackElements<UInt, uint64_t>(values, buf);
+        break;
+    case PACKED_FLOAT:
+        elements = unpackElements<Float, float>(values, buf);
+        break;
+    case PACKED_DOUBLE:
+        elements = unpackElements<Double, double>(values, buf);
+        break;
+    default:
+        assert(0);
+    }
+}
+
+
 #define BLOB_MAX_BOUND_SIZE (1*1024*1024*1024)
 
 class BoundBlob {
@@ -258,6 +409,7 @@ void Enum   ::visit(Visitor &visitor) { visitor.visit(this); }
 void Bitmask::visit(Visitor &visitor) { visitor.visit(this); }
 void Struct ::visit(Visitor &visitor) { visitor.visit(this); }
 void Array  ::visit(Visitor &visitor) { visitor.visit(this); }
+void PackedArray::visit(Visitor &visitor) { visitor.visit(this); }
 void Blob   ::visit(Visitor &visitor) { visitor.visit(this); }
 void Pointer::visit(Visitor &visitor) { visitor.visit(this); }
 void Repr   ::visit(Visitor &visitor) { visitor.visit(this); }
@@ -275,6 +427,7 @@ void Visitor::visit(Enum *node) { assert(0); }
 void Visitor::visit(Bitmask *node) { visit(static_cast<UInt *>(node)); }
 void Visitor::visit(Struct *) { assert(0); }
 void Visitor::visit(Array *) { assert(0); }
+void Visitor::visit(PackedArray *node) { visit(static_cast<Array *>(node)); }
 void Visitor::visit(Blob *) { assert(0); }
 void Visitor::visit(Pointer *) { assert(0); }
 void Visitor::visit(Repr *node) { node->machineValue->visit(*this); }
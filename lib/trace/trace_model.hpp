@@ -33,10 +33,13 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <atomic>
 #include <map>
 #include <vector>
 #include <ostream>
 
+#include "trace_format.hpp"
+
 
 namespace trace {
 
@@ -94,6 +97,7 @@ class Visitor;
 class Null;
 class Struct;
 class Array;
+class PackedArray;
 class Blob;
 
 
@@ -229,17 +233,63 @@ public:
 };
 
 
+/**
+ * Immutable, reference counted string contents, which the parser shares
+ * among all the String values decoded from identical bytes.
+ */
+class SharedString
+{
+    std::atomic<unsigned> refCount;
+
+    SharedString(size_t _length) : refCount(1), length(_length) {}
+    ~SharedString() {}
+
+public:
+    const size_t length;
+
+    /** Create with a single reference. */
+    static SharedString *
+    create(const char *str, size_t length);
+
+    inline const char *
+    data(void) const {
+        return reinterpret_cast<const char *>(this + 1);
+    }
+
+    inline void
+    addRef(void) {
+        refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    release(void);
+
+    /** Whether the caller holds the only reference. */
+    inline bool
+    isUnique(void) const {
+        return refCount.load(std::memory_order_acquire) == 1;
+    }
+};
+
+
 class String : public Value
 {
 public:
+    /** Take ownership of a new[] allocated string. */
     String(const char * _value) : value(_value) {}
+    /** Take over a reference to shared contents. */
+    String(SharedString *_shared) : value(_shared->data()), shared(_shared) {}
     ~String();
 
     bool toBool(void) const override;
     const char *toString(void) const override;
     void visit(Visitor &visitor) override;
 
+    /** Replace the value with a new[] allocated string. */
+    void reset(const char * _value);
+
     const char * value;
+    SharedString *shared = nullptr;
 };
 
 
@@ -327,6 +377,37 @@ public:
 };
 
 
+/*
+ * Array of integer or floating point numbers, as stored contiguously in the
+ * trace file.
+ *
+ * The elements are still available through Array::values, but they are
+ * allocated in bulk and owned by the packed array, so they must not be
+ * replaced.
+ */
+class PackedArray : public Array
+{
+public:
+    PackedArray(PackedType _type, size_t len);
+    ~PackedArray();
+
+    void visit(Visitor &visitor) override;
+
+    // Create the element values from the raw data in buf.
+    void unpack(void);
+
+    static size_t
+    elementSize(PackedType type);
+
+    PackedType type;
+    char *buf;
+    size_t bufSize;
+
+private:
+    Value *elements;
+};
+
+
 class Blob : public Value
 {
 public:
@@ -449,6 +530,7 @@ public:
     virtual void visit(Bitmask *);
     virtual void visit(Struct *);
     virtual void visit(Array *);
+    virtual void visit(PackedArray *);
     virtual void visit(Blob *);
     virtual void visit(Pointer *);
     virtual void visit(Repr *);
@@ -550,6 +632,29 @@ struct Arg
 };
 
 
+class Call;
+class Writer;
+
+
+/**
+ * Decodes the values of calls whose arguments were left encoded.
+ */
+class CallDecoder
+{
+public:
+    virtual ~CallDecoder() {}
+
+    virtual void decodeCall(Call *call, const unsigned char *data, size_t size) = 0;
+
+    /**
+     * Write the encoded argument values, or the return value if ret is
+     * true, straight to the writer without decoding them.  Returns false,
+     * having written nothing, if the call must be decoded instead.
+     */
+    virtual bool writeEncoded(const Call *call, Writer &writer, bool ret) = 0;
+};
+
+
 class Call
 {
 public:
@@ -563,6 +668,13 @@ public:
     Backtrace *backtrace = nullptr;
     bool reuse_call = false;
 
+    // Encoded argument and return values of a lazily parsed call, which are
+    // only decoded on first access through arg() or decode().  The decoder is
+    // the parser that read the call, so lazy calls must be decoded or deleted
+    // before that parser is closed.
+    CallDecoder *decoder = nullptr;
+    std::vector<unsigned char> encoded;
+
     Call(const FunctionSig *_sig, const CallFlags &_flags, unsigned _thread_id) :
         thread_id(_thread_id), 
         sig(_sig), 
@@ -577,20 +689,33 @@ public:
         return sig->name;
     }
 
+    inline void
+    decode(void) {
+        if (decoder) {
+            decodeEncoded();
+        }
+    }
+
     inline Value &
     arg(unsigned index) {
+        decode();
         assert(index < args.size());
         return *(args[index].value);
     }
 
     inline const Value &
     arg(unsigned index) const {
+        assert(!decoder);
         assert(index < args.size());
         return *(args[index].value);
     }
 
     Value &
     argByName(const char *argName);
+
+private:
+    void
+    decodeEncoded(void);
 };
 
 
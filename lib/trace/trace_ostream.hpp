@@ -48,8 +48,12 @@ createSnappyStream(const char *filename);
 OutStream *
 createZLibStream(const char *filename);
 
+/**
+ * Seekable Zstandard stream.  When workers is non-zero, each frame is
+ * compressed by that many libzstd worker threads.
+ */
 OutStream *
-createZstdStream(const char *filename, int compressionLevel);
+createZstdStream(const char *filename, int compressionLevel, unsigned workers = 0);
 
 
 } /* namespace trace */
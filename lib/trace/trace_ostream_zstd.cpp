@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
 
 #include <assert.h>
 #include <string.h>
@@ -46,10 +47,20 @@
 using namespace trace;
 
 
+/*
+ * Writes the Zstandard seekable format: a sequence of independent frames of
+ * at most maxFrameSize decompressed bytes each, followed by a seek table.
+ *
+ * Frames are compressed with a regular ZSTD_CCtx (rather than the helper
+ * library's ZSTD_seekable_CStream, which does not expose compression
+ * parameters) so that libzstd's worker threads can be used, while the seek
+ * table is still produced by the helper library's frame log.
+ */
 class ZstdOutStream : public OutStream {
 public:
     ZstdOutStream(const char *filename,
                   int compressionLevel = ZSTD_COMPRESSION_LEVEL,
+                  unsigned workers = 0,
                   unsigned maxFrameSize = ZSTD_FRAME_SIZE);
     ~ZstdOutStream();
 
@@ -61,50 +72,78 @@ public:
 
 private:
     void close(void);
-    bool flushOutput(void);
+    bool compress(ZSTD_inBuffer *input, ZSTD_EndDirective directive);
+    bool endFrame(void);
+    bool writeOutput(const ZSTD_outBuffer &output);
 
 private:
     FILE* m_fp;
-    ZSTD_seekable_CStream* m_cstream;
+    ZSTD_CCtx* m_cctx;
+    ZSTD_frameLog* m_frameLog;
     char* m_outputBuffer;
     size_t m_outputBufferSize;
+
+    unsigned m_maxFrameSize;
+    // Decompressed and compressed sizes of the frame being written
+    unsigned m_frameSize;
+    size_t m_frameCompressedSize;
 };
 
 ZstdOutStream::ZstdOutStream(const char *filename,
                              int compressionLevel,
+                             unsigned workers,
                              unsigned maxFrameSize)
     : m_fp(nullptr),
-      m_cstream(nullptr),
+      m_cctx(nullptr),
+      m_frameLog(nullptr),
       m_outputBuffer(nullptr),
-      m_outputBufferSize(0)
+      m_outputBufferSize(0),
+      m_maxFrameSize(maxFrameSize),
+      m_frameSize(0),
+      m_frameCompressedSize(0)
 {
     m_fp = fopen(filename, "wb");
     if (!m_fp) {
         return;
     }
 
-    m_cstream = ZSTD_seekable_createCStream();
-    if (!m_cstream) {
+    m_cctx = ZSTD_createCCtx();
+    m_frameLog = ZSTD_seekable_createFrameLog(0);
+    if (!m_cctx || !m_frameLog) {
+        ZSTD_freeCCtx(m_cctx);
+        m_cctx = nullptr;
+        ZSTD_seekable_freeFrameLog(m_frameLog);
+        m_frameLog = nullptr;
         fclose(m_fp);
         m_fp = nullptr;
         return;
     }
 
-    // Initialize seekable compression stream
-    // Parameters: compression level, add checksums, max frame size
-    size_t result = ZSTD_seekable_initCStream(m_cstream,
-                                              compressionLevel,
-                                              0, // Add checksums for data integrity
-                                              maxFrameSize);
+    size_t result = ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, compressionLevel);
     if (ZSTD_isError(result)) {
         os::log("error: failed to initialize zstd compression: %s\n", ZSTD_getErrorName(result));
-        ZSTD_seekable_freeCStream(m_cstream);
-        m_cstream = nullptr;
+        ZSTD_freeCCtx(m_cctx);
+        m_cctx = nullptr;
+        ZSTD_seekable_freeFrameLog(m_frameLog);
+        m_frameLog = nullptr;
         fclose(m_fp);
         m_fp = nullptr;
         return;
     }
 
+    if (workers) {
+        // Worker threads only help if each frame is split into several jobs,
+        // so size the jobs so that every worker gets a share of a frame.
+        // libzstd clamps the job size to its own minimum.
+        result = ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_nbWorkers, workers);
+        if (ZSTD_isError(result)) {
+            os::log("warning: zstd worker threads unavailable (%s), compressing on the calling thread\n",
+                    ZSTD_getErrorName(result));
+        } else {
+            ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_jobSize, maxFrameSize / workers);
+        }
+    }
+
     // Allocate output buffer
     m_outputBufferSize = ZSTD_CStreamOutSize();
     m_outputBuffer = new char[m_outputBufferSize];
@@ -116,30 +155,90 @@ ZstdOutStream::~ZstdOutStream()
     delete [] m_outputBuffer;
 }
 
-bool ZstdOutStream::write(const void *buffer, size_t length)
+bool ZstdOutStream::writeOutput(const ZSTD_outBuffer &output)
 {
-    if (!m_fp || !m_cstream) {
+    if (output.pos > 0) {
+        size_t written = fwrite(output.dst, 1, output.pos, m_fp);
+        if (written != output.pos) {
+            os::log("error: failed to write compressed data\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Feeds the input to the compressor, writing out whatever it produces.  With
+// ZSTD_e_end, also waits for the frame to be complete.
+bool ZstdOutStream::compress(ZSTD_inBuffer *input, ZSTD_EndDirective directive)
+{
+    size_t remaining;
+    do {
+        ZSTD_outBuffer output = { m_outputBuffer, m_outputBufferSize, 0 };
+
+        remaining = ZSTD_compressStream2(m_cctx, &output, input, directive);
+        if (ZSTD_isError(remaining)) {
+            os::log("error: zstd compression failed: %s\n", ZSTD_getErrorName(remaining));
+            return false;
+        }
+
+        m_frameCompressedSize += output.pos;
+        if (!writeOutput(output)) {
+            return false;
+        }
+    } while (directive == ZSTD_e_end ? remaining > 0 : input->pos < input->size);
+
+    return true;
+}
+
+bool ZstdOutStream::endFrame(void)
+{
+    if (m_frameSize == 0) {
+        return true;
+    }
+
+    ZSTD_inBuffer input = { nullptr, 0, 0 };
+    if (!compress(&input, ZSTD_e_end)) {
         return false;
     }
 
-    ZSTD_inBuffer input = { buffer, length, 0 };
+    size_t result = ZSTD_seekable_logFrame(m_frameLog,
+                                           unsigned(m_frameCompressedSize),
+                                           m_frameSize,
+                                           0);
+    m_frameSize = 0;
+    m_frameCompressedSize = 0;
+    if (ZSTD_isError(result)) {
+        os::log("error: failed to log zstd frame: %s\n", ZSTD_getErrorName(result));
+        return false;
+    }
 
-    while (input.pos < input.size) {
-        ZSTD_outBuffer output = { m_outputBuffer, m_outputBufferSize, 0 };
+    return true;
+}
 
-        size_t result = ZSTD_seekable_compressStream(m_cstream, &output, &input);
+bool ZstdOutStream::write(const void *buffer, size_t length)
+{
+    if (!m_fp || !m_cctx) {
+        return false;
+    }
 
-        if (ZSTD_isError(result)) {
-            os::log("error: zstd compression failed: %s\n", ZSTD_getErrorName(result));
+    const char *data = static_cast<const char *>(buffer);
+    while (length) {
+        // Never let a frame grow past maxFrameSize, so that seeking never
+        // needs to decompress more than that.
+        size_t chunk = std::min<size_t>(length, m_maxFrameSize - m_frameSize);
+
+        ZSTD_inBuffer input = { data, chunk, 0 };
+        if (!compress(&input, ZSTD_e_continue)) {
             return false;
         }
 
-        if (output.pos > 0) {
-            size_t written = fwrite(m_outputBuffer, 1, output.pos, m_fp);
-            if (written != output.pos) {
-                os::log("error: failed to write compressed data\n");
-                return false;
-            }
+        m_frameSize += unsigned(chunk);
+        data += chunk;
+        length -= chunk;
+
+        if (m_frameSize == m_maxFrameSize &&
+            !endFrame()) {
+            return false;
         }
     }
 
@@ -148,30 +247,32 @@ bool ZstdOutStream::write(const void *buffer, size_t length)
 
 void ZstdOutStream::close(void)
 {
-    if (m_cstream && m_fp) {
+    if (m_cctx && m_fp) {
         // Flush remaining data and write seek table
-        size_t remaining;
-
-        do {
-            ZSTD_outBuffer output = { m_outputBuffer, m_outputBufferSize, 0 };
-            remaining = ZSTD_seekable_endStream(m_cstream, &output);
-
-            if (ZSTD_isError(remaining)) {
-                os::log("error: zstd stream finalization failed: %s\n", ZSTD_getErrorName(remaining));
-            }
-
-            if (output.pos > 0) {
-                size_t written = fwrite(m_outputBuffer, 1, output.pos, m_fp);
-                if (written != output.pos) {
-                    os::log("error: failed to write final compressed data\n");
+        if (endFrame()) {
+            size_t remaining;
+            do {
+                ZSTD_outBuffer output = { m_outputBuffer, m_outputBufferSize, 0 };
+                remaining = ZSTD_seekable_writeSeekTable(m_frameLog, &output);
+                if (ZSTD_isError(remaining)) {
+                    os::log("error: zstd stream finalization failed: %s\n", ZSTD_getErrorName(remaining));
+                    break;
+                }
+                if (!writeOutput(output)) {
+                    break;
                 }
-            }
-        } while (remaining > 0);
+            } while (remaining > 0);
+        }
+    }
+
+    if (m_cctx) {
+        ZSTD_freeCCtx(m_cctx);
+        m_cctx = nullptr;
     }
 
-    if (m_cstream) {
-        ZSTD_seekable_freeCStream(m_cstream);
-        m_cstream = nullptr;
+    if (m_frameLog) {
+        ZSTD_seekable_freeFrameLog(m_frameLog);
+        m_frameLog = nullptr;
     }
 
     if (m_fp) {
@@ -187,7 +288,7 @@ void ZstdOutStream::close(void)
 // handlers (which may also be called more than once!)
 void ZstdOutStream::flush(void)
 {
-    if (!m_fp || !m_cstream) {
+    if (!m_fp || !m_cctx) {
         return;
     }
 
@@ -196,30 +297,22 @@ void ZstdOutStream::flush(void)
     // being able to write the seek table at this point, then buffer output
     // until we finish a frame, then seek back to the end of the last frame and
     // overwrite the seek table with the new frame and a new seek table after
-    // that, but that's complicated and would require API changes from the Zstd
-    // helper library.
+    // that, but that's complicated.
     //
     // If the trace isn't close()d properly, it won't be reopenable by
     // trace_file_zstd_seekable.cpp, but we will fall back to
     // trace_file_zstd.cpp, which parses it but just doesn't allow seeking.  You
     // can repack to get a seekable file.
-    ZSTD_outBuffer output = { m_outputBuffer, m_outputBufferSize, 0 };
-    ZSTD_seekable_endFrame(m_cstream, nullptr);
-    if (output.pos > 0) {
-        size_t written = fwrite(m_outputBuffer, 1, output.pos, m_fp);
-        if (written != output.pos) {
-            os::log("error: failed to write final compressed data\n");
-        }
-    }
+    endFrame();
 
     fflush(m_fp);
 }
 
 
 OutStream *
-trace::createZstdStream(const char *filename, int compressionLevel)
+trace::createZstdStream(const char *filename, int compressionLevel, unsigned workers)
 {
-    ZstdOutStream *outStream = new ZstdOutStream(filename, compressionLevel);
+    ZstdOutStream *outStream = new ZstdOutStream(filename, compressionLevel, workers);
     if (!outStream->isOpen()) {
         os::log("error: could not open %s for writing\n", filename);
         delete outStream;
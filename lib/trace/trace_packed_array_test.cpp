@@ -0,0 +1,133 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+
+
+static const char *args[] = {"ints", "floats", "doubles", "bytes", "nothing"};
+static const FunctionSig sig = {0, "glFoo", 5, args};
+
+
+TEST(trace_packed_array, type)
+{
+    EXPECT_EQ(packedType<float>(), PACKED_FLOAT);
+    EXPECT_EQ(packedType<double>(), PACKED_DOUBLE);
+    EXPECT_EQ(packedType<int8_t>(), PACKED_SINT8);
+    EXPECT_EQ(packedType<uint16_t>(), PACKED_UINT16);
+    EXPECT_EQ(packedType<int32_t>(), PACKED_SINT32);
+    EXPECT_EQ(packedType<uint64_t>(), PACKED_UINT64);
+}
+
+
+TEST(trace_packed_array, roundtrip)
+{
+    const char *filename = "trace_packed_array_test.trace";
+
+    const int32_t ints[] = {0, -1, 0x7fffffff, -0x7fffffff - 1};
+    const float floats[] = {1.0f, -0.5f, 3.25f};
+    const double doubles[] = {1.0 / 3.0};
+    const uint8_t bytes[] = {0};
+
+    {
+        Writer writer;
+        ASSERT_TRUE(writer.open(filename, TRACE_VERSION, Properties()));
+        writer.beginEnter(&sig, 0);
+        writer.beginArg(0);
+        writer.writePackedArray(ints, 4);
+        writer.endArg();
+        writer.beginArg(1);
+        writer.writePackedArray(floats, 3);
+        writer.endArg();
+        writer.beginArg(2);
+        writer.writePackedArray(doubles, 1);
+        writer.endArg();
+        writer.beginArg(3);
+        writer.writePackedArray(bytes, 0);
+        writer.endArg();
+        writer.beginArg(4);
+        writer.writePackedArray(static_cast<const float *>(nullptr), 2);
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(0);
+        writer.endLeave();
+        writer.close();
+    }
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    std::unique_ptr<Call> call(parser.parse_call());
+    ASSERT_TRUE(call);
+    parser.close();
+    remove(filename);
+
+    // Consumers see plain arrays
+    const Array *array = call->arg(0).toArray();
+    ASSERT_TRUE(array);
+    ASSERT_EQ(array->size(), 4u);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(array->values[i]->toSInt(), ints[i]);
+    }
+
+    array = call->arg(1).toArray();
+    ASSERT_TRUE(array);
+    ASSERT_EQ(array->size(), 3u);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(array->values[i]->toFloat(), floats[i]);
+    }
+
+    EXPECT_EQ(call->arg(2)[0].toDouble(), doubles[0]);
+
+    array = call->arg(3).toArray();
+    ASSERT_TRUE(array);
+    EXPECT_EQ(array->size(), 0u);
+
+    EXPECT_TRUE(call->arg(4).toNull());
+
+    // The raw data is available too
+    const PackedArray *packed = static_cast<const PackedArray *>(call->arg(1).toArray());
+    EXPECT_EQ(packed->type, PACKED_FLOAT);
+    ASSERT_EQ(packed->bufSize, sizeof floats);
+    EXPECT_EQ(memcmp(packed->buf, floats, sizeof floats), 0);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
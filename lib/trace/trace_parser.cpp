@@ -25,15 +25,22 @@
 
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <climits>
 #include <memory>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "trace_file.hpp"
 #include "trace_dump.hpp"
 #include "trace_parser.hpp"
+#include "trace_writer.hpp"
 
 
 #define TRACE_VERBOSE 0
@@ -57,6 +64,7 @@ bool Parser::open(const char *filename) {
     if (!file) {
         return false;
     }
+    this->filename = filename;
 
     version = read_uint();
     if (version > TRACE_VERSION) {
@@ -105,11 +113,27 @@ void Parser::close(void) {
         delete file;
         file = NULL;
     }
+    filename.clear();
 
     properties.clear();
 
     deleteAll(calls);
 
+    for (auto & entry : strings) {
+        entry.second->release();
+    }
+    strings.clear();
+    stringsBytes = 0;
+    pruneStringsCount = 0;
+    pruneStringsBytes = 0;
+
+    deleteSignatures();
+
+    next_call_no = 0;
+}
+
+
+void Parser::deleteSignatures(void) {
     // Delete all signature data.  Signatures are mere structures which don't
     // own their own memory, so we need to destroy all data we created here.
 
@@ -159,7 +183,7 @@ void Parser::close(void) {
     }
     bitmasks.clear();
 
-    next_call_no = 0;
+    glGetErrorSig = nullptr;
 }
 
 
@@ -314,6 +338,29 @@ Parser::parse_function_sig(void) {
 }
 
 
+/**
+ * Whether the definition of an already known signature follows its id.
+ */
+template< class T >
+bool Parser::definition_follows(SigState<T> *sig) {
+    if (decoding) {
+        // Encoded values only carry the definition where the call that
+        // defined the signature first used it.
+        if (sig->callNo != details_call_no) {
+            return false;
+        }
+        for (auto decoded : decodedSigs) {
+            if (decoded == sig) {
+                return false;
+            }
+        }
+        decodedSigs.push_back(sig);
+        return true;
+    }
+    return file->currentOffset() < sig->fileOffset;
+}
+
+
 StructSig *Parser::parse_struct_sig() {
     size_t id = read_uint();
 
@@ -331,8 +378,9 @@ StructSig *Parser::parse_struct_sig() {
         }
         sig->member_names = member_names;
         sig->fileOffset = file->currentOffset();
+        sig->callNo = details_call_no;
         structs[id] = sig;
-    } else if (file->currentOffset() < sig->fileOffset) {
+    } else if (definition_follows(sig)) {
         /* skip over the signature */
         skip_string(); /* name */
         unsigned num_members = read_uint();
@@ -367,8 +415,9 @@ EnumSig *Parser::parse_old_enum_sig() {
         values->value = read_sint();
         sig->values = values;
         sig->fileOffset = file->currentOffset();
+        sig->callNo = details_call_no;
         enums[id] = sig;
-    } else if (file->currentOffset() < sig->fileOffset) {
+    } else if (definition_follows(sig)) {
         /* skip over the signature */
         skip_string(); /*name*/
         scan_value();
@@ -396,8 +445,9 @@ EnumSig *Parser::parse_enum_sig() {
         }
         sig->values = values;
         sig->fileOffset = file->currentOffset();
+        sig->callNo = details_call_no;
         enums[id] = sig;
-    } else if (file->currentOffset() < sig->fileOffset) {
+    } else if (definition_follows(sig)) {
         /* skip over the signature */
         int num_values = read_uint();
         for (int i = 0; i < num_values; ++i) {
@@ -431,8 +481,9 @@ BitmaskSig *Parser::parse_bitmask_sig() {
         }
         sig->flags = flags;
         sig->fileOffset = file->currentOffset();
+        sig->callNo = details_call_no;
         bitmasks[id] = sig;
-    } else if (file->currentOffset() < sig->fileOffset) {
+    } else if (definition_follows(sig)) {
         /* skip over the signature */
         int num_flags = read_uint();
         for (int i = 0; i < num_flags; ++i) {
@@ -486,6 +537,7 @@ Call *Parser::parse_leave(Mode mode) {
          */
         const FunctionSig sig = {0, NULL, 0, NULL};
         call = new Call(&sig, 0, 0);
+        call->no = call_no;
         parse_call_details(call, SCAN);
         delete call;
         return NULL;
@@ -501,6 +553,7 @@ Call *Parser::parse_leave(Mode mode) {
 
 
 bool Parser::parse_call_details(Call *call, Mode mode) {
+    details_call_no = call->no;
     do {
         int c = read_byte();
         switch (c) {
@@ -513,13 +566,21 @@ bool Parser::parse_call_details(Call *call, Mode mode) {
             if (TRACE_VERBOSE) {
                 std::cerr << "\tCALL_ARG\n";
             }
-            parse_arg(call, mode);
+            if (mode == LAZY) {
+                capture_value(call, c);
+            } else {
+                parse_arg(call, mode);
+            }
             break;
         case trace::CALL_RET:
             if (TRACE_VERBOSE) {
                 std::cerr << "\tCALL_RET\n";
             }
-            call->ret = parse_value(mode);
+            if (mode == LAZY) {
+                capture_value(call, c);
+            } else {
+                call->ret = parse_value(mode);
+            }
             break;
         case trace::CALL_BACKTRACE:
             if (TRACE_VERBOSE) {
@@ -634,6 +695,9 @@ StackFrame * Parser::parse_backtrace_frame(Mode mode) {
  */
 void Parser::adjust_call_flags(Call *call) {
     // Mark glGetError() = GL_NO_ERROR as verbose
+    if (call->sig == glGetErrorSig) {
+        call->decode();
+    }
     if (call->sig == glGetErrorSig &&
         call->ret &&
         call->ret->toSInt() == 0) {
@@ -653,6 +717,203 @@ void Parser::parse_arg(Call *call, Mode mode) {
 }
 
 
+/**
+ * Append an argument or return value to the call's encoded values, as is,
+ * while still going through any signature definitions it carries.
+ */
+void Parser::capture_value(Call *call, int detail) {
+    if (call->encoded.empty()) {
+        // Callers may renumber the call before it gets decoded
+        const unsigned char *no = reinterpret_cast<const unsigned char *>(&call->no);
+        call->encoded.insert(call->encoded.end(), no, no + sizeof call->no);
+    }
+    call->encoded.push_back(detail);
+    file->beginCapture(call->encoded);
+    if (detail == trace::CALL_ARG) {
+        skip_uint(); /* index */
+    }
+    scan_value();
+    file->endCapture();
+    call->decoder = this;
+}
+
+
+namespace {
+
+/**
+ * Read-only view of a call's encoded values, so they can be decoded by the
+ * same code which parses them from the trace.  The values are preceded by
+ * the number the call had when it was parsed.
+ */
+class EncodedValuesFile : public File {
+public:
+    EncodedValuesFile(const unsigned char *data, size_t size)
+    {
+        assert(size >= sizeof m_callNo);
+        memcpy(&m_callNo, data, sizeof m_callNo);
+        m_size = size - sizeof m_callNo;
+        setWindow(data + sizeof m_callNo, data + size);
+        m_isOpened = true;
+    }
+
+    ~EncodedValuesFile() {
+        close();
+    }
+
+    size_t containerSizeInBytes(void) const override { return m_size; }
+    size_t containerBytesRead(void) const override { return m_size - windowAvailable(); }
+    size_t dataBytesRead(void) const override { return m_size - windowAvailable(); }
+    const char *containerType() const override { return "Memory"; }
+
+    unsigned callNo(void) const { return m_callNo; }
+
+protected:
+    bool rawOpen(const char *filename) override { return false; }
+    size_t rawRead(void *buffer, size_t length) override { return 0; }
+    bool rawRefill(void) override { return false; }
+    void rawClose(void) override {}
+
+private:
+    unsigned m_callNo;
+    size_t m_size;
+};
+
+} /* anonymous namespace */
+
+
+void Parser::decodeCall(Call *call, const unsigned char *data, size_t size) {
+    assert(!decoding);
+    EncodedValuesFile values(data, size);
+    File *traceFile = file;
+    file = &values;
+    decoding = true;
+    details_call_no = values.callNo();
+    decodedSigs.clear();
+
+    int c;
+    while ((c = read_byte()) != -1) {
+        switch (c) {
+        case trace::CALL_ARG:
+            parse_arg(call, FULL);
+            break;
+        case trace::CALL_RET:
+            call->ret = parse_value();
+            break;
+        default:
+            std::cerr << "error: ("<<call->name()<< ") unknown encoded detail "
+                      << c << "\n";
+            exit(1);
+        }
+    }
+
+    decoding = false;
+    file = traceFile;
+}
+
+
+bool Parser::writeEncoded(const Call *call, Writer &writer, bool ret) {
+    if (version < 3) {
+        // Old enum signatures can't be rewritten in the current format
+        // without decoding their values
+        return false;
+    }
+
+    assert(!decoding);
+    EncodedValuesFile values(call->encoded.data(), call->encoded.size());
+    File *traceFile = file;
+    file = &values;
+    decoding = true;
+    details_call_no = values.callNo();
+    decodedSigs.clear();
+
+    // Bytes are copied verbatim, in as large runs as possible, except for
+    // values of the other kind, which are only scanned
+    const unsigned char *copied = file->windowBegin();
+    int c;
+    while ((c = read_byte()) != -1) {
+        if ((c == trace::CALL_RET) == ret) {
+            if (c == trace::CALL_ARG) {
+                skip_uint(); /* index */
+            }
+            copy_value(writer, copied);
+        } else {
+            writer.writeEncoded(copied, file->windowBegin() - 1 - copied);
+            if (c == trace::CALL_ARG) {
+                skip_uint(); /* index */
+            }
+            scan_value();
+            copied = file->windowBegin();
+        }
+    }
+    writer.writeEncoded(copied, file->windowBegin() - copied);
+
+    decoding = false;
+    file = traceFile;
+    return true;
+}
+
+
+/**
+ * Copy an encoded value to the writer, starting at copied, up to which the
+ * bytes were written already.  Signatures are written through the writer
+ * instead, which emits their definitions if the output lacks them.
+ */
+void Parser::copy_value(Writer &writer, const unsigned char *&copied) {
+    const unsigned char *begin = file->windowBegin();
+    assert(begin < file->windowEnd());
+    switch (*begin) {
+    case trace::TYPE_ENUM:
+        {
+            writer.writeEncoded(copied, begin - copied);
+            skip_byte();
+            EnumSig *sig = parse_enum_sig();
+            writer.writeEnum(sig, read_sint());
+            copied = file->windowBegin();
+        }
+        break;
+    case trace::TYPE_BITMASK:
+        {
+            writer.writeEncoded(copied, begin - copied);
+            skip_byte();
+            BitmaskSig *sig = parse_bitmask_sig();
+            writer.writeBitmask(sig, read_uint());
+            copied = file->windowBegin();
+        }
+        break;
+    case trace::TYPE_STRUCT:
+        {
+            writer.writeEncoded(copied, begin - copied);
+            skip_byte();
+            StructSig *sig = parse_struct_sig();
+            writer.beginStruct(sig);
+            copied = file->windowBegin();
+            for (size_t i = 0; i < sig->num_members; ++i) {
+                copy_value(writer, copied);
+            }
+            writer.endStruct();
+        }
+        break;
+    case trace::TYPE_ARRAY:
+        {
+            skip_byte();
+            size_t len = read_uint();
+            for (size_t i = 0; i < len; ++i) {
+                copy_value(writer, copied);
+            }
+        }
+        break;
+    case trace::TYPE_REPR:
+        skip_byte();
+        copy_value(writer, copied);
+        copy_value(writer, copied);
+        break;
+    default:
+        scan_value();
+        break;
+    }
+}
+
+
 Value *Parser::parse_value(void) {
     int c;
     Value *value;
@@ -706,6 +967,9 @@ Value *Parser::parse_value(void) {
     case trace::TYPE_WSTRING:
         value = parse_wstring();
         break;
+    case trace::TYPE_PACKED_ARRAY:
+        value = parse_packed_array();
+        break;
     default:
         std::cerr << "error: unknown type " << c << "\n";
         exit(1);
@@ -770,6 +1034,9 @@ void Parser::scan_value(void) {
     case trace::TYPE_WSTRING:
         scan_wstring();
         break;
+    case trace::TYPE_PACKED_ARRAY:
+        scan_packed_array();
+        break;
     default:
         std::cerr << "error: unknown type " << c << "\n";
         exit(1);
@@ -824,7 +1091,7 @@ void Parser::scan_double() {
 
 
 Value *Parser::parse_string() {
-    return new String(read_string());
+    return new String(read_shared_string());
 }
 
 
@@ -891,6 +1158,35 @@ void Parser::scan_array(void) {
 }
 
 
+PackedType Parser::read_packed_type(void) {
+    unsigned long long type = read_uint();
+    if (type >= PACKED_TYPE_COUNT) {
+        std::cerr << "error: unknown packed array type " << type << "\n";
+        exit(1);
+    }
+    return static_cast<PackedType>(type);
+}
+
+
+Value *Parser::parse_packed_array(void) {
+    PackedType type = read_packed_type();
+    size_t len = read_uint();
+    PackedArray *array = new PackedArray(type, len);
+    if (array->bufSize) {
+        file->read(array->buf, array->bufSize);
+    }
+    array->unpack();
+    return array;
+}
+
+
+void Parser::scan_packed_array(void) {
+    PackedType type = read_packed_type();
+    size_t len = read_uint();
+    file->skip(len * PackedArray::elementSize(type));
+}
+
+
 Value *Parser::parse_blob(void) {
     size_t size = read_uint();
     Blob *blob = new Blob(size);
@@ -990,6 +1286,66 @@ char * Parser::read_string(void) {
 }
 
 
+static const size_t minPruneStringsCount = 4096;
+static const size_t minPruneStringsBytes = 64 * 1024 * 1024;
+
+
+/*
+ * Shader sources, uniform names, and the like are repeated throughout a
+ * trace, so look the bytes up in the table straight from the file window,
+ * and only copy them out when they're new.
+ */
+SharedString * Parser::read_shared_string(void) {
+    size_t len = read_uint();
+    const char *bytes;
+    if (len <= file->windowAvailable()) {
+        const unsigned char *p = file->windowBegin();
+        file->windowAdvance(p + len);
+        bytes = reinterpret_cast<const char *>(p);
+    } else {
+        stringScratch.resize(len);
+        file->read(stringScratch.data(), len);
+        bytes = stringScratch.data();
+    }
+
+    SharedString *shared;
+    auto it = strings.find(std::string_view(bytes, len));
+    if (it != strings.end()) {
+        shared = it->second;
+    } else {
+        if (strings.size() >= pruneStringsCount ||
+            stringsBytes >= pruneStringsBytes) {
+            prune_strings();
+        }
+        shared = SharedString::create(bytes, len);
+        strings.emplace(std::string_view(shared->data(), len), shared);
+        stringsBytes += len;
+    }
+    shared->addRef();
+
+    if (TRACE_VERBOSE) {
+        std::cerr << "\tSTRING \"" << shared->data() << "\"\n";
+    }
+    return shared;
+}
+
+
+void Parser::prune_strings(void) {
+    for (auto it = strings.begin(); it != strings.end(); ) {
+        SharedString *shared = it->second;
+        if (shared->isUnique()) {
+            stringsBytes -= shared->length;
+            shared->release();
+            it = strings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    pruneStringsCount = std::max(minPruneStringsCount, strings.size() * 2);
+    pruneStringsBytes = std::max(minPruneStringsBytes, stringsBytes * 2);
+}
+
+
 void Parser::skip_string(void) {
     size_t len = read_uint();
     file->skip(len);
@@ -1023,18 +1379,88 @@ Parser::skip_sint(void) {
     skip_uint();
 }
 
-unsigned long long Parser::read_uint(void) {
-    unsigned long long value = 0;
-    int c;
-    unsigned shift = 0;
-    do {
-        c = file->getc();
-        if (c == -1) {
-            break;
+#if (defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || \
+    (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64)))
+
+/*
+ * Decode a variable length integer of up to 8 bytes from an 8 byte little
+ * endian load, without branching on every byte.  Returns the number of bytes
+ * used, or zero if the integer is longer than that.
+ */
+static inline unsigned
+decode_uint8(const unsigned char *p, unsigned long long &value) {
+    uint64_t word;
+    memcpy(&word, p, sizeof word);
+
+    // Bytes without the continuation bit
+    uint64_t stops = ~word & UINT64_C(0x8080808080808080);
+    if (!stops) {
+        return 0;
+    }
+
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, stops);
+    unsigned length = (index >> 3) + 1;
+#else
+    unsigned length = (__builtin_ctzll(stops) >> 3) + 1;
+#endif
+
+    // Drop the following bytes, then the continuation bits, by packing
+    // successively larger groups of bits together
+    word &= stops ^ (stops - 1);
+    word = ((word & UINT64_C(0x7f007f007f007f00)) >> 1) | (word & UINT64_C(0x007f007f007f007f));
+    word = ((word & UINT64_C(0x3fff00003fff0000)) >> 2) | (word & UINT64_C(0x00003fff00003fff));
+    word = ((word & UINT64_C(0x0fffffff00000000)) >> 4) | (word & UINT64_C(0x000000000fffffff));
+
+    value = word;
+    return length;
+}
+
+#else
+
+static inline unsigned
+decode_uint8(const unsigned char *p, unsigned long long &value) {
+    unsigned long long result = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        result |= (unsigned long long)(p[i] & 0x7f) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            value = result;
+            return i + 1;
         }
-        value |= (unsigned long long)(c & 0x7f) << shift;
-        shift += 7;
-    } while(c & 0x80);
+    }
+    return 0;
+}
+
+#endif
+
+
+inline unsigned long long Parser::read_uint(void) {
+    unsigned long long value = 0;
+
+    const unsigned char *p = file->windowBegin();
+    size_t available = file->windowAvailable();
+    if (available && !(p[0] & 0x80)) {
+        // Most integers fit in a single byte
+        value = p[0];
+        file->windowAdvance(p + 1);
+    } else if (available >= 8 && (available = decode_uint8(p, value)) != 0) {
+        file->windowAdvance(p + available);
+    } else {
+        // Near the end of the window, or more than 56 bits
+        value = 0;
+        int c;
+        unsigned shift = 0;
+        do {
+            c = file->getc();
+            if (c == -1) {
+                break;
+            }
+            value |= (unsigned long long)(c & 0x7f) << shift;
+            shift += 7;
+        } while(c & 0x80);
+    }
+
     if (TRACE_VERBOSE) {
         std::cerr << "\tUINT " << value << "\n";
     }
@@ -1042,7 +1468,18 @@ unsigned long long Parser::read_uint(void) {
 }
 
 
-void Parser::skip_uint(void) {
+inline void Parser::skip_uint(void) {
+    const unsigned char *p = file->windowBegin();
+    const unsigned char *end = file->windowEnd();
+    while (p < end) {
+        if (!(*p++ & 0x80)) {
+            file->windowAdvance(p);
+            return;
+        }
+    }
+    file->windowAdvance(p);
+
+    // Integer straddles the end of the window
     int c;
     do {
         c = file->getc();
@@ -28,6 +28,10 @@
 
 #include <iostream>
 #include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "trace_file.hpp"
 #include "trace_format.hpp"
@@ -62,15 +66,19 @@ public:
 };
 
 
-class Parser: public AbstractParser
+class Parser: public AbstractParser, public CallDecoder
 {
 protected:
     File *file = nullptr;
 
+    // Name of the open trace, which the signature cache is keyed on
+    std::string filename;
+
     enum Mode {
         FULL = 0,
         SCAN,
-        SKIP
+        SKIP,
+        LAZY  // like SCAN, but keep the encoded values for decodeCall()
     };
 
     Properties properties;
@@ -90,6 +98,10 @@ protected:
         // reparsing to determine whether the signature definition is to be
         // expected next or not.
         File::Offset fileOffset;
+
+        // Call whose values carried the signature definition.  It is used
+        // likewise when decoding the encoded values of a lazy call.
+        unsigned callNo = 0;
     };
 
     typedef SigState<FunctionSigFlags> FunctionSigState;
@@ -113,9 +125,26 @@ protected:
 
     FunctionSig *glGetErrorSig = nullptr;
 
+    // Interned string values, keyed by their contents.  The table holds a
+    // reference to each, and drops the ones no call refers to anymore
+    // whenever it grows past pruneStringsCount entries or pruneStringsBytes.
+    typedef std::unordered_map<std::string_view, SharedString *> StringTable;
+    StringTable strings;
+    size_t stringsBytes = 0;
+    size_t pruneStringsCount = 0;
+    size_t pruneStringsBytes = 0;
+    std::vector<char> stringScratch;
+
     int next_event_type = -1;
     unsigned next_call_no = 0;
 
+    // Number of the call whose details are being parsed or decoded
+    unsigned details_call_no = 0;
+
+    // Whether decodeCall() is in progress, and the signatures it has seen
+    bool decoding = false;
+    std::vector<const void *> decodedSigs;
+
     unsigned long long version = 0;
     unsigned long long semanticVersion = 0;
 
@@ -143,6 +172,14 @@ public:
 
     void setBookmark(const ParseBookmark &bookmark) override;
 
+    /**
+     * Whether calls were entered but not left yet, which setBookmark() would
+     * drop, so a bookmark taken now can't be seeked to without losing them.
+     */
+    bool hasPendingCalls(void) const {
+        return !calls.empty();
+    }
+
     unsigned long long getVersion(void) const override {
         return semanticVersion;
     }
@@ -176,6 +213,36 @@ public:
         return parse_call(SCAN);
     }
 
+    /**
+     * Parse the next call, leaving its argument and return values encoded
+     * until they are first accessed.  This is cheaper than parse_call() when
+     * only some calls' values end up being looked at.
+     */
+    Call *lazy_call() {
+        return parse_call(LAZY);
+    }
+
+    /**
+     * Save the signatures parsed so far to a sidecar file, along with
+     * bookmarks no further than the current position.  A parser which loads
+     * them right after opening the same trace can then seek to any of those
+     * bookmarks straight away, instead of first scanning all the calls
+     * before it.  Bookmarks should be taken where hasPendingCalls() is false,
+     * as seeking drops pending calls.
+     */
+    bool saveSignatureCache(const char *filename, const std::vector<ParseBookmark> &bookmarks) const;
+
+    /**
+     * Restore signatures and bookmarks saved by saveSignatureCache().  Fails,
+     * leaving the parser untouched, when the cache is missing, was saved for
+     * a different trace, or signatures were parsed already.
+     */
+    bool loadSignatureCache(const char *filename, std::vector<ParseBookmark> &bookmarks);
+
+    void decodeCall(Call *call, const unsigned char *data, size_t size) override;
+
+    bool writeEncoded(const Call *call, Writer &writer, bool ret) override;
+
 protected:
     Call *parse_call(Mode mode);
 
@@ -184,6 +251,9 @@ protected:
     EnumSig *parse_old_enum_sig();
     EnumSig *parse_enum_sig();
     BitmaskSig *parse_bitmask_sig();
+
+    template< class T >
+    bool definition_follows(SigState<T> *sig);
     
 public:
     static CallFlags
@@ -192,6 +262,8 @@ public:
 protected:
     void parseProperties(void);
 
+    void deleteSignatures(void);
+
     Call *parse_Call(Mode mode);
 
     void parse_enter(Mode mode);
@@ -207,6 +279,9 @@ protected:
 
     void parse_arg(Call *call, Mode mode);
 
+    void capture_value(Call *call, int detail);
+    void copy_value(Writer &writer, const unsigned char *&copied);
+
     Value *parse_value(void);
     void scan_value(void);
     inline Value *parse_value(Mode mode) {
@@ -242,6 +317,10 @@ protected:
     Value *parse_array(void);
     void scan_array(void);
 
+    Value *parse_packed_array(void);
+    void scan_packed_array(void);
+    PackedType read_packed_type(void);
+
     Value *parse_blob(void);
     void scan_blob(void);
 
@@ -258,13 +337,15 @@ protected:
     void scan_wstring();
 
     char * read_string(void);
+    SharedString * read_shared_string(void);
     void skip_string(void);
+    void prune_strings(void);
 
     signed long long read_sint(void);
     void skip_sint(void);
 
-    unsigned long long read_uint(void);
-    void skip_uint(void);
+    inline unsigned long long read_uint(void);
+    inline void skip_uint(void);
 
     inline int read_byte(void);
     inline void skip_byte(void);
@@ -0,0 +1,574 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Signature cache sidecar files.
+ *
+ * The cache holds the signature tables of a trace, together with where in
+ * the trace each signature was defined, so that a fresh parser can tell
+ * whether a definition follows a signature id wherever it starts parsing.
+ * Everything is encoded as variable length unsigned integers, like in the
+ * trace itself:
+ *
+ *   cache = MAGIC version trace_version container_size mtime head_hash api
+ *           count bookmark*
+ *           count function* count struct* count enum* count bitmask*
+ *           count frame*
+ *
+ *   bookmark = offset call_no
+ *   offset = chunk offset_in_chunk
+ *
+ *   function = id offset call_no name count arg_name*
+ *   struct = id offset call_no name count member_name*
+ *   enum = id offset call_no count (name value)*
+ *   bitmask = id offset call_no count (name value)*
+ *   frame = id offset module function filename linenumber offset
+ *
+ *   string = length byte*
+ *   nullable_string = 0 | (length + 1) byte*
+ *
+ * Besides the container size, the cache is keyed on the modification time of
+ * the trace and a hash of its first bytes, as traces rewritten in place, e.g.
+ * when recapturing, often end up with the same size.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "trace_parser.hpp"
+#include "trace_hash.hpp"
+
+
+namespace trace {
+
+
+static const char cacheMagic[] = "apitrace-sigcache";
+
+static const unsigned long long cacheVersion = 2;
+
+// Sanity limit on signature ids, to not allocate absurd tables from a
+// corrupted cache
+static const unsigned long long maxCacheId = 1 << 24;
+
+
+namespace {
+
+
+class CacheWriter
+{
+public:
+    std::string buf;
+
+    void writeUInt(unsigned long long value) {
+        while (value >= 0x80) {
+            buf.push_back(char(0x80 | (value & 0x7f)));
+            value >>= 7;
+        }
+        buf.push_back(char(value));
+    }
+
+    void writeString(const char *str) {
+        size_t len = strlen(str);
+        writeUInt(len);
+        buf.append(str, len);
+    }
+
+    void writeNullableString(const char *str) {
+        if (!str) {
+            writeUInt(0);
+            return;
+        }
+        size_t len = strlen(str);
+        writeUInt(len + 1);
+        buf.append(str, len);
+    }
+
+    void writeOffset(const File::Offset &offset) {
+        writeUInt(offset.chunk);
+        writeUInt(offset.offsetInChunk);
+    }
+};
+
+
+class CacheReader
+{
+    const char *ptr;
+    const char *end;
+
+public:
+    bool ok = true;
+
+    CacheReader(const std::vector<char> &data) :
+        ptr(data.data()),
+        end(data.data() + data.size())
+    {}
+
+    bool atEnd(void) const {
+        return ptr == end;
+    }
+
+    bool readMagic(void) {
+        if (size_t(end - ptr) < sizeof cacheMagic ||
+            memcmp(ptr, cacheMagic, sizeof cacheMagic) != 0) {
+            ok = false;
+            return false;
+        }
+        ptr += sizeof cacheMagic;
+        return true;
+    }
+
+    unsigned long long readUInt(void) {
+        unsigned long long value = 0;
+        unsigned shift = 0;
+        while (ptr != end && shift < 64) {
+            unsigned char c = *ptr++;
+            value |= (unsigned long long)(c & 0x7f) << shift;
+            if (!(c & 0x80)) {
+                return value;
+            }
+            shift += 7;
+        }
+        ok = false;
+        return 0;
+    }
+
+    unsigned long long readId(void) {
+        unsigned long long id = readUInt();
+        if (id >= maxCacheId) {
+            ok = false;
+            return 0;
+        }
+        return id;
+    }
+
+    char *readChars(unsigned long long len) {
+        if (!ok || len > (unsigned long long)(end - ptr)) {
+            ok = false;
+            return nullptr;
+        }
+        char *str = new char[len + 1];
+        memcpy(str, ptr, len);
+        str[len] = '\0';
+        ptr += len;
+        return str;
+    }
+
+    char *readString(void) {
+        char *str = readChars(readUInt());
+        if (!str) {
+            // Callers own whatever is returned, so don't leave them dangling
+            str = new char[1];
+            str[0] = '\0';
+        }
+        return str;
+    }
+
+    char *readNullableString(void) {
+        unsigned long long len = readUInt();
+        if (len == 0) {
+            return nullptr;
+        }
+        return readChars(len - 1);
+    }
+
+    File::Offset readOffset(void) {
+        File::Offset offset;
+        offset.chunk = readUInt();
+        offset.offsetInChunk = readUInt();
+        return offset;
+    }
+
+    // Number of items which follow, each taking at least one byte
+    size_t readCount(void) {
+        unsigned long long count = readUInt();
+        if (count > (unsigned long long)(end - ptr)) {
+            ok = false;
+            return 0;
+        }
+        return count;
+    }
+};
+
+
+template<class T>
+size_t
+countSigs(const std::vector<T *> &map)
+{
+    size_t count = 0;
+    for (auto sig : map) {
+        if (sig) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+
+template<class T>
+bool
+insertSig(std::vector<T *> &map, size_t id, T *sig)
+{
+    if (id >= map.size()) {
+        map.resize(id + 1);
+    }
+    if (map[id]) {
+        return false;
+    }
+    map[id] = sig;
+    return true;
+}
+
+
+/*
+ * Identify the trace file beyond its size.
+ */
+bool
+getTraceStamp(const std::string &filename,
+              unsigned long long &mtime,
+              unsigned long long &headHash)
+{
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(filename, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = (unsigned long long)time.time_since_epoch().count();
+
+    std::ifstream stream(filename, std::ifstream::binary);
+    if (!stream) {
+        return false;
+    }
+    std::vector<char> head(64 * 1024);
+    stream.read(head.data(), head.size());
+    Hasher hasher;
+    hasher.update(head.data(), size_t(stream.gcount()));
+    headHash = hasher.digest();
+    return true;
+}
+
+
+} /* anonymous namespace */
+
+
+bool
+Parser::saveSignatureCache(const char *filename, const std::vector<ParseBookmark> &bookmarks) const
+{
+    unsigned long long mtime;
+    unsigned long long headHash;
+    if (!file || !getTraceStamp(this->filename, mtime, headHash)) {
+        return false;
+    }
+
+    CacheWriter w;
+
+    w.buf.append(cacheMagic, sizeof cacheMagic);
+    w.writeUInt(cacheVersion);
+    w.writeUInt(version);
+    w.writeUInt(file->containerSizeInBytes());
+    w.writeUInt(mtime);
+    w.writeUInt(headHash);
+    w.writeUInt(api);
+
+    w.writeUInt(bookmarks.size());
+    for (auto & bookmark : bookmarks) {
+        w.writeOffset(bookmark.offset);
+        w.writeUInt(bookmark.next_call_no);
+    }
+
+    w.writeUInt(countSigs(functions));
+    for (auto sig : functions) {
+        if (sig) {
+            w.writeUInt(sig->id);
+            w.writeOffset(sig->fileOffset);
+            w.writeUInt(sig->callNo);
+            w.writeString(sig->name);
+            w.writeUInt(sig->num_args);
+            for (unsigned i = 0; i < sig->num_args; ++i) {
+                w.writeString(sig->arg_names[i]);
+            }
+        }
+    }
+
+    w.writeUInt(countSigs(structs));
+    for (auto sig : structs) {
+        if (sig) {
+            w.writeUInt(sig->id);
+            w.writeOffset(sig->fileOffset);
+            w.writeUInt(sig->callNo);
+            w.writeString(sig->name);
+            w.writeUInt(sig->num_members);
+            for (unsigned i = 0; i < sig->num_members; ++i) {
+                w.writeString(sig->member_names[i]);
+            }
+        }
+    }
+
+    w.writeUInt(countSigs(enums));
+    for (auto sig : enums) {
+        if (sig) {
+            w.writeUInt(sig->id);
+            w.writeOffset(sig->fileOffset);
+            w.writeUInt(sig->callNo);
+            w.writeUInt(sig->num_values);
+            for (unsigned i = 0; i < sig->num_values; ++i) {
+                w.writeString(sig->values[i].name);
+                w.writeUInt(sig->values[i].value);
+            }
+        }
+    }
+
+    w.writeUInt(countSigs(bitmasks));
+    for (auto sig : bitmasks) {
+        if (sig) {
+            w.writeUInt(sig->id);
+            w.writeOffset(sig->fileOffset);
+            w.writeUInt(sig->callNo);
+            w.writeUInt(sig->num_flags);
+            for (unsigned i = 0; i < sig->num_flags; ++i) {
+                w.writeString(sig->flags[i].name);
+                w.writeUInt(sig->flags[i].value);
+            }
+        }
+    }
+
+    w.writeUInt(countSigs(frames));
+    for (auto frame : frames) {
+        if (frame) {
+            w.writeUInt(frame->id);
+            w.writeOffset(frame->fileOffset);
+            w.writeNullableString(frame->module);
+            w.writeNullableString(frame->function);
+            w.writeNullableString(frame->filename);
+            w.writeUInt(frame->linenumber);
+            w.writeUInt(frame->offset);
+        }
+    }
+
+    // Write to a temporary file first, so that concurrent readers never see
+    // a partial cache
+    std::string tmpFilename = std::string(filename) + ".tmp";
+    {
+        std::ofstream stream(tmpFilename, std::ofstream::binary);
+        stream.write(w.buf.data(), w.buf.size());
+        stream.close();
+        if (stream.fail()) {
+            remove(tmpFilename.c_str());
+            return false;
+        }
+    }
+    remove(filename);
+    if (rename(tmpFilename.c_str(), filename) != 0) {
+        remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool
+Parser::loadSignatureCache(const char *filename, std::vector<ParseBookmark> &bookmarks)
+{
+    if (!file ||
+        !functions.empty() || !structs.empty() || !enums.empty() ||
+        !bitmasks.empty() || !frames.empty()) {
+        return false;
+    }
+
+    unsigned long long mtime;
+    unsigned long long headHash;
+    if (!getTraceStamp(this->filename, mtime, headHash)) {
+        return false;
+    }
+
+    std::vector<char> data;
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream) {
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(stream),
+                    std::istreambuf_iterator<char>());
+    }
+
+    CacheReader r(data);
+
+    if (!r.readMagic() ||
+        r.readUInt() != cacheVersion ||
+        r.readUInt() != version ||
+        r.readUInt() != file->containerSizeInBytes() ||
+        r.readUInt() != mtime ||
+        r.readUInt() != headHash) {
+        return false;
+    }
+    API cachedApi = API(r.readUInt());
+
+    std::vector<ParseBookmark> cachedBookmarks(r.readCount());
+    for (auto & bookmark : cachedBookmarks) {
+        bookmark.offset = r.readOffset();
+        bookmark.next_call_no = r.readUInt();
+    }
+
+    for (size_t count = r.readCount(); r.ok && count; --count) {
+        FunctionSigState *sig = new FunctionSigState;
+        sig->id = r.readId();
+        sig->fileOffset = r.readOffset();
+        sig->callNo = r.readUInt();
+        sig->name = r.readString();
+        sig->num_args = r.readCount();
+        const char **arg_names = new const char *[sig->num_args];
+        for (unsigned i = 0; i < sig->num_args; ++i) {
+            arg_names[i] = r.readString();
+        }
+        sig->arg_names = arg_names;
+        sig->flags = lookupCallFlags(sig->name);
+        if (!insertSig(functions, sig->id, sig)) {
+            r.ok = false;
+            delete [] sig->name;
+            for (unsigned i = 0; i < sig->num_args; ++i) {
+                delete [] sig->arg_names[i];
+            }
+            delete [] sig->arg_names;
+            delete sig;
+            break;
+        }
+        if (sig->num_args == 0 &&
+            strcmp(sig->name, "glGetError") == 0) {
+            glGetErrorSig = sig;
+        }
+    }
+
+    for (size_t count = r.readCount(); r.ok && count; --count) {
+        StructSigState *sig = new StructSigState;
+        sig->id = r.readId();
+        sig->fileOffset = r.readOffset();
+        sig->callNo = r.readUInt();
+        sig->name = r.readString();
+        sig->num_members = r.readCount();
+        const char **member_names = new const char *[sig->num_members];
+        for (unsigned i = 0; i < sig->num_members; ++i) {
+            member_names[i] = r.readString();
+        }
+        sig->member_names = member_names;
+        if (!insertSig(structs, sig->id, sig)) {
+            r.ok = false;
+            delete [] sig->name;
+            for (unsigned i = 0; i < sig->num_members; ++i) {
+                delete [] sig->member_names[i];
+            }
+            delete [] sig->member_names;
+            delete sig;
+            break;
+        }
+    }
+
+    for (size_t count = r.readCount(); r.ok && count; --count) {
+        EnumSigState *sig = new EnumSigState;
+        sig->id = r.readId();
+        sig->fileOffset = r.readOffset();
+        sig->callNo = r.readUInt();
+        sig->num_values = r.readCount();
+        EnumValue *values = new EnumValue[sig->num_values];
+        for (EnumValue *it = values; it != values + sig->num_values; ++it) {
+            it->name = r.readString();
+            it->value = r.readUInt();
+        }
+        sig->values = values;
+        if (!insertSig(enums, sig->id, sig)) {
+            r.ok = false;
+            for (unsigned i = 0; i < sig->num_values; ++i) {
+                delete [] sig->values[i].name;
+            }
+            delete [] sig->values;
+            delete sig;
+            break;
+        }
+    }
+
+    for (size_t count = r.readCount(); r.ok && count; --count) {
+        BitmaskSigState *sig = new BitmaskSigState;
+        sig->id = r.readId();
+        sig->fileOffset = r.readOffset();
+        sig->callNo = r.readUInt();
+        sig->num_flags = r.readCount();
+        BitmaskFlag *flags = new BitmaskFlag[sig->num_flags];
+        for (BitmaskFlag *it = flags; it != flags + sig->num_flags; ++it) {
+            it->name = r.readString();
+            it->value = r.readUInt();
+        }
+        sig->flags = flags;
+        if (!insertSig(bitmasks, sig->id, sig)) {
+            r.ok = false;
+            for (unsigned i = 0; i < sig->num_flags; ++i) {
+                delete [] sig->flags[i].name;
+            }
+            delete [] sig->flags;
+            delete sig;
+            break;
+        }
+    }
+
+    for (size_t count = r.readCount(); r.ok && count; --count) {
+        StackFrameState *frame = new StackFrameState;
+        frame->id = r.readId();
+        frame->fileOffset = r.readOffset();
+        frame->module = r.readNullableString();
+        frame->function = r.readNullableString();
+        frame->filename = r.readNullableString();
+        frame->linenumber = r.readUInt();
+        frame->offset = r.readUInt();
+        if (!insertSig(frames, frame->id, frame)) {
+            r.ok = false;
+            delete frame;
+            break;
+        }
+    }
+
+    if (!r.ok || !r.atEnd()) {
+        deleteSignatures();
+        // No call can refer to these frames yet
+        for (auto frame : frames) {
+            delete frame;
+        }
+        frames.clear();
+        return false;
+    }
+
+    if (api == API_UNKNOWN) {
+        api = cachedApi;
+    }
+    bookmarks = std::move(cachedBookmarks);
+    return true;
+}
+
+
+} /* namespace trace */
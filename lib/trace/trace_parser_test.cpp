@@ -0,0 +1,703 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdio.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "trace_dump.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+
+
+static const char *args[] = {"value", "name"};
+static const FunctionSig sig = {0, "glFoo", 2, args};
+
+
+/**
+ * Tell the type of a value, as dynamic_cast is not available with -fno-rtti.
+ */
+class TypeVisitor : public Visitor
+{
+public:
+    enum Type {
+        OTHER,
+        STRING,
+        ENUM,
+    };
+
+    Type type = OTHER;
+
+    void visit(Null *) override {}
+    void visit(Bool *) override {}
+    void visit(SInt *) override {}
+    void visit(UInt *) override {}
+    void visit(Float *) override {}
+    void visit(Double *) override {}
+    void visit(String *) override { type = STRING; }
+    void visit(WString *) override {}
+    void visit(Enum *) override { type = ENUM; }
+    void visit(Bitmask *) override {}
+    void visit(Struct *) override {}
+    void visit(Array *) override {}
+    void visit(PackedArray *) override {}
+    void visit(Blob *) override {}
+    void visit(Pointer *) override {}
+    void visit(Repr *) override {}
+};
+
+
+static TypeVisitor::Type
+valueType(Value *value)
+{
+    TypeVisitor visitor;
+    if (value) {
+        value->visit(visitor);
+    }
+    return visitor.type;
+}
+
+
+static unsigned long long
+testValue(unsigned i)
+{
+    // Cover every encoded length, from 1 to 10 bytes
+    unsigned bits = i % 65;
+    unsigned long long value = bits ? ~0ULL >> (64 - bits) : 0;
+    return value ^ (i / 65);
+}
+
+
+TEST(trace_parser, uint)
+{
+    const char *filename = "trace_parser_test.trace";
+
+    // Enough calls to span several compression chunks, so that integers
+    // straddle the parser's window
+    const unsigned count = 200000;
+
+    {
+        Writer writer;
+        ASSERT_TRUE(writer.open(filename, TRACE_VERSION, Properties()));
+        for (unsigned i = 0; i < count; ++i) {
+            unsigned call = writer.beginEnter(&sig, 0);
+            writer.beginArg(0);
+            writer.writeUInt(testValue(i));
+            writer.endArg();
+            writer.beginArg(1);
+            writer.writeString("abc");
+            writer.endArg();
+            writer.endEnter();
+            writer.beginLeave(call);
+            writer.endLeave();
+        }
+        writer.close();
+    }
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+
+    std::vector<ParseBookmark> bookmarks;
+    for (unsigned i = 0; i < count; ++i) {
+        if (i % 10000 == 0) {
+            bookmarks.emplace_back();
+            parser.getBookmark(bookmarks.back());
+        }
+        std::unique_ptr<Call> call(parser.parse_call());
+        ASSERT_TRUE(call);
+        ASSERT_EQ(call->no, i);
+        ASSERT_EQ(call->arg(0).toUInt(), testValue(i));
+        ASSERT_STREQ(call->arg(1).toString(), "abc");
+    }
+    EXPECT_EQ(parser.parse_call(), nullptr);
+
+    // Resume from the bookmarks
+    if (parser.supportsOffsets()) {
+        for (size_t b = bookmarks.size(); b-- > 0; ) {
+            parser.setBookmark(bookmarks[b]);
+            unsigned i = b * 10000;
+            std::unique_ptr<Call> call(parser.parse_call());
+            ASSERT_TRUE(call);
+            ASSERT_EQ(call->no, i);
+            ASSERT_EQ(call->arg(0).toUInt(), testValue(i));
+        }
+    }
+
+    parser.close();
+    remove(filename);
+}
+
+
+TEST(trace_parser, strings)
+{
+    const char *filename = "trace_parser_strings_test.trace";
+
+    // A long repeated source, straddling the parser's window, amid enough
+    // unique names to make the parser prune its string table
+    const std::string source(300000, 's');
+    const unsigned count = 20000;
+
+    {
+        Writer writer;
+        ASSERT_TRUE(writer.open(filename, TRACE_VERSION, Properties()));
+        for (unsigned i = 0; i < count; ++i) {
+            std::string name = "u" + std::to_string(i);
+            unsigned call = writer.beginEnter(&sig, 0);
+            writer.beginArg(0);
+            writer.writeString(i % 1000 == 0 ? source.c_str() : "main");
+            writer.endArg();
+            writer.beginArg(1);
+            writer.writeString(name.c_str());
+            writer.endArg();
+            writer.endEnter();
+            writer.beginLeave(call);
+            writer.endLeave();
+        }
+        writer.close();
+    }
+
+    std::vector<std::unique_ptr<Call>> calls;
+
+    {
+        Parser parser;
+        ASSERT_TRUE(parser.open(filename));
+        for (unsigned i = 0; i < count; ++i) {
+            std::unique_ptr<Call> call(parser.parse_call());
+            ASSERT_TRUE(call);
+            std::string name = "u" + std::to_string(i);
+            ASSERT_STREQ(call->arg(1).toString(), name.c_str());
+            if (i % 1000 == 0) {
+                ASSERT_EQ(call->arg(0).toString(), source);
+            } else {
+                ASSERT_STREQ(call->arg(0).toString(), "main");
+            }
+            if (i % 500 == 0) {
+                calls.push_back(std::move(call));
+            }
+        }
+        parser.close();
+    }
+
+    // Repeated strings share their contents, which outlive the parser
+    ASSERT_EQ(valueType(calls[0]->args[0].value), TypeVisitor::STRING);
+    ASSERT_EQ(valueType(calls[2]->args[0].value), TypeVisitor::STRING);
+    const String *first = static_cast<const String *>(calls[0]->args[0].value);
+    const String *second = static_cast<const String *>(calls[2]->args[0].value);
+    EXPECT_TRUE(first->shared);
+    EXPECT_EQ(first->shared, second->shared);
+    EXPECT_EQ(first->value, source);
+    EXPECT_STREQ(calls[1]->arg(0).toString(), "main");
+    EXPECT_STREQ(calls.back()->arg(1).toString(), "u19500");
+
+    remove(filename);
+}
+
+
+static std::string
+dumpCall(Call &call)
+{
+    std::ostringstream os;
+    dump(call, os, DUMP_FLAG_NO_COLOR);
+    return os.str();
+}
+
+
+static void
+writeSigsTrace(const char *filename, unsigned count)
+{
+    static const EnumValue enumValues[] = {{"GL_ZERO", 0}, {"GL_ONE", 1}};
+    static const BitmaskFlag bitmaskFlags[] = {{"GL_A", 1}, {"GL_B", 2}};
+    static const char *memberNames[] = {"x", "y"};
+    static const char *fooArgs[] = {"e", "s", "data"};
+    static const FunctionSig fooSig = {1, "glFoo", 3, fooArgs};
+
+    // Signatures first used at different calls, some of them twice within
+    // the same call, and blobs large enough to straddle the parser's window
+    const unsigned numSigs = 8;
+    std::vector<EnumSig> enums(numSigs);
+    std::vector<BitmaskSig> bitmasks(numSigs);
+    std::vector<StructSig> structs(numSigs);
+    for (unsigned i = 0; i < numSigs; ++i) {
+        enums[i] = {i, 2, enumValues};
+        bitmasks[i] = {i, 2, bitmaskFlags};
+        structs[i] = {i, "S", 2, memberNames};
+    }
+    const std::vector<char> blob(100000, 'b');
+
+    Writer writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION, Properties()));
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned id = (i * 7 / 5) % numSigs;
+        unsigned call = writer.beginEnter(&fooSig, 0);
+        writer.beginArg(0);
+        writer.writeEnum(&enums[id], i & 1);
+        writer.endArg();
+        writer.beginArg(1);
+        writer.beginArray(2);
+        writer.writeUInt(i);
+        writer.beginStruct(&structs[id]);
+        writer.writeEnum(&enums[(id + 1) % numSigs], 1);
+        writer.writeBitmask(&bitmasks[id], i & 3);
+        writer.endStruct();
+        writer.endArray();
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(call);
+        writer.beginArg(2);
+        if (i % 100 == 0) {
+            writer.writeBlob(blob.data(), blob.size());
+        } else {
+            writer.writeEnum(&enums[(id + 1) % numSigs], 0);
+        }
+        writer.endArg();
+        writer.beginReturn();
+        writer.writeBitmask(&bitmasks[(id + 3) % numSigs], 3);
+        writer.endReturn();
+        writer.endLeave();
+    }
+    writer.close();
+}
+
+
+static void
+dumpTrace(const char *filename, std::vector<std::string> &dumps)
+{
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    Call *call;
+    while ((call = parser.parse_call())) {
+        dumps.push_back(dumpCall(*call));
+        delete call;
+    }
+    parser.close();
+}
+
+
+TEST(trace_parser, lazy)
+{
+    const char *filename = "trace_parser_lazy_test.trace";
+    const unsigned count = 2000;
+
+    writeSigsTrace(filename, count);
+
+    std::vector<std::string> expected;
+    dumpTrace(filename, expected);
+    ASSERT_EQ(expected.size(), count);
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    std::vector<std::unique_ptr<Call>> calls;
+    Call *call;
+    while ((call = parser.lazy_call())) {
+        EXPECT_TRUE(call->decoder);
+        calls.emplace_back(call);
+        // Decode some calls right away, interleaved with parsing
+        if (call->no % 3 == 0) {
+            EXPECT_EQ(call->arg(0).toSInt(), call->no & 1);
+        }
+    }
+    ASSERT_EQ(calls.size(), count);
+
+    // Decode the rest in reverse, away from where they were parsed, and
+    // renumbered as trimming does
+    for (size_t i = count; i-- > 0; ) {
+        calls[i]->no = 0;
+        std::string decoded = dumpCall(*calls[i]);
+        ASSERT_EQ(decoded.substr(decoded.find(' ')),
+                  expected[i].substr(expected[i].find(' '))) << "call " << i;
+        EXPECT_FALSE(calls[i]->decoder);
+    }
+
+    calls.clear();
+    parser.close();
+    remove(filename);
+}
+
+
+/* Write calls that each define a new enum signature, with names long enough
+ * for some definitions to straddle the compression chunks. */
+static void
+writeLongSigsTrace(const char *filename, unsigned count,
+                   std::vector<std::string> &names)
+{
+    static const char *fooArgs[] = {"e"};
+    static const FunctionSig fooSig = {1, "glFoo", 1, fooArgs};
+
+    names.resize(count);
+    std::vector<EnumValue> values(count);
+    std::vector<EnumSig> enums(count);
+    for (unsigned i = 0; i < count; ++i) {
+        names[i] = "GL_" + std::to_string(i) + std::string(1500, 'E');
+        values[i] = {names[i].c_str(), i};
+        enums[i] = {i, 1, &values[i]};
+    }
+
+    Writer writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION, Properties()));
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned call = writer.beginEnter(&fooSig, 0);
+        writer.beginArg(0);
+        writer.writeEnum(&enums[i], i);
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(call);
+        writer.endLeave();
+    }
+    writer.close();
+}
+
+
+TEST(trace_parser, lazy_chunks)
+{
+    const char *filename = "trace_parser_lazy_chunks_test.trace";
+    const unsigned count = 3000;
+
+    std::vector<std::string> names;
+    writeLongSigsTrace(filename, count, names);
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    for (unsigned i = 0; i < count; ++i) {
+        std::unique_ptr<Call> call(parser.lazy_call());
+        ASSERT_TRUE(call);
+        ASSERT_EQ(call->no, i);
+        ASSERT_EQ(valueType(&call->arg(0)), TypeVisitor::ENUM) << "call " << i;
+        Enum *e = static_cast<Enum *>(&call->arg(0));
+        ASSERT_EQ(e->toSInt(), (signed long long)i);
+        const EnumValue *value = e->lookup();
+        ASSERT_TRUE(value) << "call " << i;
+        ASSERT_EQ(value->name, names[i]) << "call " << i;
+    }
+    EXPECT_EQ(parser.lazy_call(), nullptr);
+    parser.close();
+
+    remove(filename);
+}
+
+
+TEST(trace_parser, copy)
+{
+    const char *filename = "trace_parser_copy_test.trace";
+    const char *outFilename = "trace_parser_copy_test.out.trace";
+    const unsigned count = 2000;
+
+    writeSigsTrace(filename, count);
+
+    std::vector<std::string> expected;
+    dumpTrace(filename, expected);
+    ASSERT_EQ(expected.size(), count);
+
+    // Copy every third call without decoding, so that signatures defined by
+    // the dropped calls must be defined anew, and those defined by the
+    // copied calls may already be known
+    std::vector<unsigned> copied;
+    {
+        Parser parser;
+        ASSERT_TRUE(parser.open(filename));
+        Writer writer;
+        ASSERT_TRUE(writer.open(outFilename, parser.getVersion(), parser.getProperties()));
+        Call *call;
+        while ((call = parser.lazy_call())) {
+            if (call->no % 3 == 1) {
+                copied.push_back(call->no);
+                writer.writeCall(call);
+                EXPECT_TRUE(call->decoder);
+            }
+            delete call;
+        }
+        writer.close();
+        parser.close();
+    }
+
+    std::vector<std::string> output;
+    dumpTrace(outFilename, output);
+    ASSERT_EQ(output.size(), copied.size());
+    for (size_t i = 0; i < copied.size(); ++i) {
+        const std::string &original = expected[copied[i]];
+        ASSERT_EQ(output[i].substr(output[i].find(' ')),
+                  original.substr(original.find(' '))) << "call " << copied[i];
+    }
+
+    remove(filename);
+    remove(outFilename);
+}
+
+
+TEST(trace_parser, copy_chunks)
+{
+    const char *filename = "trace_parser_copy_chunks_test.trace";
+    const char *outFilename = "trace_parser_copy_chunks_test.out.trace";
+    const unsigned count = 3000;
+
+    std::vector<std::string> names;
+    writeLongSigsTrace(filename, count, names);
+
+    std::vector<std::string> expected;
+    dumpTrace(filename, expected);
+    ASSERT_EQ(expected.size(), count);
+
+    // Copy every call without decoding, signature definitions included
+    {
+        Parser parser;
+        ASSERT_TRUE(parser.open(filename));
+        Writer writer;
+        ASSERT_TRUE(writer.open(outFilename, parser.getVersion(), parser.getProperties()));
+        Call *call;
+        while ((call = parser.lazy_call())) {
+            writer.writeCall(call);
+            EXPECT_TRUE(call->decoder);
+            delete call;
+        }
+        writer.close();
+        parser.close();
+    }
+
+    std::vector<std::string> output;
+    dumpTrace(outFilename, output);
+    ASSERT_EQ(output.size(), count);
+    for (unsigned i = 0; i < count; ++i) {
+        ASSERT_EQ(output[i], expected[i]) << "call " << i;
+    }
+
+    remove(filename);
+    remove(outFilename);
+}
+
+
+TEST(trace_parser, signature_cache)
+{
+    const char *filename = "trace_parser_cache_test.trace";
+    const char *cacheFilename = "trace_parser_cache_test.trace.sigcache";
+    const unsigned count = 2000;
+    const unsigned interval = 97;
+
+    writeSigsTrace(filename, count);
+
+    std::vector<std::string> expected;
+    dumpTrace(filename, expected);
+    ASSERT_EQ(expected.size(), count);
+
+    // Only scan part of the trace, so that later signatures are missing
+    // from the cache
+    std::vector<ParseBookmark> bookmarks;
+    {
+        Parser parser;
+        ASSERT_TRUE(parser.open(filename));
+        if (!parser.supportsOffsets()) {
+            parser.close();
+            remove(filename);
+            GTEST_SKIP();
+        }
+        for (unsigned i = 0; i < count / 2; ++i) {
+            if (i % interval == 0) {
+                bookmarks.emplace_back();
+                parser.getBookmark(bookmarks.back());
+            }
+            delete parser.parse_call();
+        }
+        ASSERT_TRUE(parser.saveSignatureCache(cacheFilename, bookmarks));
+
+        // Signatures were parsed already
+        std::vector<ParseBookmark> loaded;
+        EXPECT_FALSE(parser.loadSignatureCache(cacheFilename, loaded));
+        parser.close();
+    }
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    std::vector<ParseBookmark> loaded;
+    ASSERT_TRUE(parser.loadSignatureCache(cacheFilename, loaded));
+    ASSERT_EQ(loaded.size(), bookmarks.size());
+
+    // Seek straight to each bookmark, and parse on past the cached
+    // signatures from the last one
+    for (size_t b = loaded.size(); b-- > 0; ) {
+        parser.setBookmark(loaded[b]);
+        unsigned end = b + 1 == loaded.size() ? count : b * interval + 3;
+        for (unsigned i = b * interval; i < end; ++i) {
+            std::unique_ptr<Call> call(parser.parse_call());
+            ASSERT_TRUE(call);
+            ASSERT_EQ(dumpCall(*call), expected[i]) << "call " << i;
+        }
+        if (end == count) {
+            EXPECT_EQ(parser.parse_call(), nullptr);
+        }
+    }
+    parser.close();
+
+    // Nor once the trace was modified, even if it kept its size
+    auto mtime = std::filesystem::last_write_time(filename);
+    std::filesystem::last_write_time(filename, mtime + std::chrono::seconds(2));
+    ASSERT_TRUE(parser.open(filename));
+    EXPECT_FALSE(parser.loadSignatureCache(cacheFilename, loaded));
+    parser.close();
+    std::filesystem::last_write_time(filename, mtime);
+    ASSERT_TRUE(parser.open(filename));
+    EXPECT_TRUE(parser.loadSignatureCache(cacheFilename, loaded));
+    parser.close();
+
+    // The cache doesn't apply to other traces
+    writeSigsTrace(filename, count / 2);
+    ASSERT_TRUE(parser.open(filename));
+    EXPECT_FALSE(parser.loadSignatureCache(cacheFilename, loaded));
+    parser.close();
+
+    remove(filename);
+    remove(cacheFilename);
+}
+
+
+/* Write calls from several threads, each left a few calls after it was
+ * entered, so that they come back out of order. */
+static void
+writeThreadedTrace(const char *filename, unsigned count)
+{
+    Writer writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION, Properties()));
+
+    std::vector<unsigned> pending;
+    unsigned seed = 1;
+    for (unsigned i = 0; i < count || !pending.empty(); ++i) {
+        if (i < count) {
+            unsigned no = writer.beginEnter(&sig, i % 4);
+            writer.beginArg(0);
+            writer.writeUInt(no);
+            writer.endArg();
+            writer.endEnter();
+            pending.push_back(no);
+        }
+
+        // Leave a pseudo-random pending call, or none while few are
+        seed = seed * 1103515245 + 12345;
+        unsigned pick = (seed >> 16) % 4;
+        if (!pending.empty() &&
+            (pick == 0 || pending.size() >= 3 || i >= count)) {
+            pick %= pending.size();
+            writer.beginLeave(pending[pick]);
+            writer.beginArg(1);
+            writer.writeString("out");
+            writer.endArg();
+            writer.beginReturn();
+            writer.writeUInt(pending[pick]);
+            writer.endReturn();
+            writer.endLeave();
+            pending.erase(pending.begin() + pick);
+        }
+    }
+
+    writer.close();
+}
+
+
+TEST(trace_parser, signature_cache_threads)
+{
+    const char *filename = "trace_parser_cache_threads_test.trace";
+    const char *cacheFilename = "trace_parser_cache_threads_test.trace.sigcache";
+    const unsigned count = 5000;
+
+    writeThreadedTrace(filename, count);
+
+    // Checkpoint as `apitrace dump --sig-cache` does, only where no calls
+    // are pending
+    std::vector<ParseBookmark> bookmarks;
+    std::vector<unsigned> order;
+    {
+        Parser parser;
+        ASSERT_TRUE(parser.open(filename));
+        if (!parser.supportsOffsets()) {
+            parser.close();
+            remove(filename);
+            GTEST_SKIP();
+        }
+        bool outOfOrder = false;
+        while (true) {
+            if (!parser.hasPendingCalls()) {
+                bookmarks.emplace_back();
+                parser.getBookmark(bookmarks.back());
+            }
+            std::unique_ptr<Call> call(parser.parse_call());
+            if (!call) {
+                break;
+            }
+            outOfOrder = outOfOrder || (!order.empty() && call->no < order.back());
+            order.push_back(call->no);
+        }
+        ASSERT_EQ(order.size(), count);
+        ASSERT_TRUE(outOfOrder);
+        ASSERT_GT(bookmarks.size(), 1u);
+        ASSERT_LT(bookmarks.size(), count);
+        ASSERT_TRUE(parser.saveSignatureCache(cacheFilename, bookmarks));
+        parser.close();
+    }
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+    std::vector<ParseBookmark> loaded;
+    ASSERT_TRUE(parser.loadSignatureCache(cacheFilename, loaded));
+    ASSERT_EQ(loaded.size(), bookmarks.size());
+
+    // Seeking to a checkpoint returns the same calls from it on, in the same
+    // order, as parsing from the start
+    for (size_t b = 0; b < loaded.size(); b += 7) {
+        const unsigned first = loaded[b].next_call_no;
+        std::vector<unsigned> expected;
+        for (auto no : order) {
+            if (no >= first) {
+                expected.push_back(no);
+            }
+        }
+
+        parser.setBookmark(loaded[b]);
+        std::vector<unsigned> actual;
+        Call *call;
+        while ((call = parser.parse_call())) {
+            EXPECT_EQ(call->arg(0).toUInt(), call->no);
+            actual.push_back(call->no);
+            delete call;
+        }
+        ASSERT_EQ(actual, expected) << "checkpoint " << b;
+    }
+    parser.close();
+
+    remove(filename);
+    remove(cacheFilename);
+}
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
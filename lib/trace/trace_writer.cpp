@@ -61,10 +61,18 @@ bool
 Writer::open(const char *filename,
              unsigned semanticVersion,
              const Properties &properties)
+{
+    return open(createSnappyStream(filename), semanticVersion, properties);
+}
+
+bool
+Writer::open(OutStream *stream,
+             unsigned semanticVersion,
+             const Properties &properties)
 {
     close();
 
-    m_file = createSnappyStream(filename);
+    m_file = stream;
     if (!m_file) {
         return false;
     }
@@ -347,6 +355,36 @@ void Writer::writeBlob(const void *data, size_t size) {
     }
 }
 
+void Writer::beginBlob(size_t size) {
+    _writeByte(trace::TYPE_BLOB);
+    _writeUInt(size);
+}
+
+void Writer::writeBlobData(const void *data, size_t size) {
+    if (size) {
+        _write(data, size);
+    }
+}
+
+void Writer::writeEncoded(const void *data, size_t size) {
+    if (size) {
+        _write(data, size);
+    }
+}
+
+void Writer::writePackedArray(PackedType type, const void *data, size_t count) {
+    if (!data) {
+        Writer::writeNull();
+        return;
+    }
+    _writeByte(trace::TYPE_PACKED_ARRAY);
+    _writeUInt(type);
+    _writeUInt(count);
+    if (count) {
+        _write(data, count * PackedArray::elementSize(type));
+    }
+}
+
 void Writer::writeEnum(const EnumSig *sig, signed long long value) {
     _writeByte(trace::TYPE_ENUM);
     _writeUInt(sig->id);
@@ -32,6 +32,7 @@
 
 #include <stddef.h>
 
+#include <type_traits>
 #include <vector>
 
 #include "trace_model.hpp"
@@ -39,6 +40,21 @@
 namespace trace {
     class OutStream;
 
+    // Packed array element type matching a C type.
+    template< typename T >
+    constexpr PackedType
+    packedType(void) {
+        static_assert(std::is_arithmetic<T>::value, "not a number");
+        static_assert(sizeof(T) <= 8, "number too large");
+        return std::is_floating_point<T>::value
+               ? (sizeof(T) == sizeof(float) ? PACKED_FLOAT : PACKED_DOUBLE)
+               : PackedType((sizeof(T) == 1 ? PACKED_SINT8 :
+                             sizeof(T) == 2 ? PACKED_SINT16 :
+                             sizeof(T) == 4 ? PACKED_SINT32 :
+                                              PACKED_SINT64) +
+                            (std::is_signed<T>::value ? 0 : 1));
+    }
+
     class Writer {
     protected:
         OutStream *m_file;
@@ -57,6 +73,12 @@ namespace trace {
         bool open(const char *filename,
                   unsigned semanticVersion,
                   const Properties &properties);
+        /**
+         * Start writing to the given stream, taking ownership of it.
+         */
+        bool open(OutStream *stream,
+                  unsigned semanticVersion,
+                  const Properties &properties);
         void close(void);
 
         unsigned beginEnter(const FunctionSig *sig, unsigned thread_id);
@@ -99,6 +121,18 @@ namespace trace {
         void writeWString(const wchar_t *str);
         void writeWString(const wchar_t *str, size_t size);
         void writeBlob(const void *data, size_t size);
+        /**
+         * Write a blob piecewise: beginBlob() must be followed by
+         * writeBlobData() calls adding up to exactly size bytes.
+         */
+        void beginBlob(size_t size);
+        void writeBlobData(const void *data, size_t size);
+        inline void endBlob(void) {}
+        void writePackedArray(PackedType type, const void *data, size_t count);
+        template< typename T >
+        inline void writePackedArray(const T *values, size_t count) {
+            writePackedArray(packedType<T>(), values, count);
+        }
         void writeEnum(const EnumSig *sig, signed long long value);
         void writeBitmask(const BitmaskSig *sig, unsigned long long value);
         void writeNull(void);
@@ -106,6 +140,12 @@ namespace trace {
 
         void writeCall(Call *call);
 
+        /**
+         * Write bytes which are already in the trace format, and don't
+         * refer to any signatures.
+         */
+        void writeEncoded(const void *data, size_t size);
+
     private:
         inline void beginProperties(void) {}
         void writeProperty(const char *name, const char *value);
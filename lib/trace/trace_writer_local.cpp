@@ -30,6 +30,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "os.hpp"
 #include "os_thread.hpp"
 #include "os_string.hpp"
@@ -74,6 +76,8 @@ LocalWriter::LocalWriter() :
     os::String process = os::getProcessName();
     os::log("apitrace: loaded into %s\n", process.str());
 
+    overheadEnabled = boolOption(getenv("TRACE_OVERHEAD"), false);
+
     // Install the signal handlers as early as possible, to prevent
     // interfering with the application's signal handling.
     os::setExceptionCallback(exceptionCallback);
@@ -99,10 +103,60 @@ LocalWriter::~LocalWriter()
     os::resetExceptionCallback();
     checkProcessId();
 
+    if (overheadEnabled) {
+        dumpOverhead();
+    }
+
     os::String process = os::getProcessName();
     os::log("apitrace: unloaded from %s\n", process.str());
 }
 
+/**
+ * Create the output stream for the container chosen by TRACE_COMPRESSION:
+ *
+ *   snappy                   (default)
+ *   zstd[:LEVEL[:THREADS]]   seekable Zstandard
+ */
+static OutStream *
+createOutStream(const char *filename)
+{
+    const char *compression = getenv("TRACE_COMPRESSION");
+    if (!compression || !*compression || strcmp(compression, "snappy") == 0) {
+        return createSnappyStream(filename);
+    }
+
+    if (strncmp(compression, "zstd", 4) == 0 &&
+        (compression[4] == 0 || compression[4] == ':')) {
+        int level = 3;
+        int threads = 0;
+        const char *p = compression + 4;
+        if (*p == ':') {
+            char *end;
+            level = strtol(p + 1, &end, 10);
+            if (end == p + 1 || level < 1 || level > 22) {
+                goto invalid;
+            }
+            p = end;
+            if (*p == ':') {
+                threads = strtol(p + 1, &end, 10);
+                if (end == p + 1 || threads < 0) {
+                    goto invalid;
+                }
+                p = end;
+            }
+            if (*p) {
+                goto invalid;
+            }
+        }
+        return createZstdStream(filename, level, threads);
+    }
+
+invalid:
+    os::log("apitrace: error: invalid TRACE_COMPRESSION: %s\n", compression);
+    os::abort();
+    return nullptr;
+}
+
 void
 LocalWriter::open(void) {
     os::String szFileName;
@@ -172,7 +226,7 @@ LocalWriter::open(void) {
     os::String processCommandLine = os::getProcessCommandLine();
     properties["process.commandLine"] = processCommandLine;
 
-    if (!Writer::open(lpFileName, TRACE_VERSION, properties)) {
+    if (!Writer::open(createOutStream(lpFileName), TRACE_VERSION, properties)) {
         os::log("apitrace: error: failed to open %s\n", lpFileName);
         os::abort();
     }
@@ -199,6 +253,28 @@ static uintptr_t next_thread_num = 1;
 
 static OS_THREAD_LOCAL uintptr_t thread_num;
 
+static OS_THREAD_LOCAL long long thread_shadow_overhead;
+
+// Total time the current thread spent in the writer, so that shadowing
+// overhead can exclude the calls it writes itself
+static OS_THREAD_LOCAL long long thread_writer_time;
+
+// Likewise for shadowing, so that wrapper overhead can exclude it
+static OS_THREAD_LOCAL long long thread_shadow_time;
+
+/*
+ * Signature ids of the calls entered but not yet left by the current thread,
+ * innermost last.  Calls nest only so deep, and deeper ones are not
+ * accounted.
+ */
+#define MAX_PENDING_CALLS 8
+struct PendingCall {
+    unsigned call_no;
+    unsigned sig_id;
+};
+static OS_THREAD_LOCAL PendingCall thread_pending_calls[MAX_PENDING_CALLS];
+static OS_THREAD_LOCAL unsigned thread_num_pending_calls;
+
 void LocalWriter::checkProcessId(void) {
     if (m_file &&
         os::getCurrentProcessId() != pid) {
@@ -214,9 +290,13 @@ void LocalWriter::checkProcessId(void) {
 }
 
 unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
+    long long lockStart = overheadEnabled ? os::getTime() : 0;
+
     mutex.lock();
     ++acquired;
 
+    long long writeStart = overheadEnabled ? os::getTime() : 0;
+
     checkProcessId();
     if (!m_file) {
         open();
@@ -241,27 +321,155 @@ unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
         }
         endBacktrace();
     }
+
+    if (overheadEnabled) {
+        OverheadCounters &counters = getOverheadCounters(sig->id, sig->name);
+        counters.calls += 1;
+        counters.time[OVERHEAD_LOCK] += writeStart - lockStart;
+        counters.time[OVERHEAD_SHADOW] += thread_shadow_overhead;
+        thread_shadow_overhead = 0;
+        if (thread_num_pending_calls < MAX_PENDING_CALLS) {
+            PendingCall &pending = thread_pending_calls[thread_num_pending_calls];
+            pending.call_no = call_no;
+            pending.sig_id = sig->id;
+        }
+        ++thread_num_pending_calls;
+        overheadSigId = sig->id;
+        overheadLockStart = lockStart;
+        overheadWriteStart = writeStart;
+    }
+
     return call_no;
 }
 
 void LocalWriter::endEnter(void) {
     Writer::endEnter();
+    if (overheadEnabled) {
+        long long writeEnd = os::getTime();
+        overheadCounters[overheadSigId].time[OVERHEAD_WRITE] += writeEnd - overheadWriteStart;
+        thread_writer_time += writeEnd - overheadLockStart;
+    }
     --acquired;
     mutex.unlock();
 }
 
 void LocalWriter::beginLeave(unsigned call) {
+    long long lockStart = overheadEnabled ? os::getTime() : 0;
+
     mutex.lock();
     ++acquired;
+
+    if (overheadEnabled) {
+        long long writeStart = os::getTime();
+        overheadWriteStart = 0;
+        // Calls are normally left innermost first
+        for (unsigned i = std::min(thread_num_pending_calls, unsigned(MAX_PENDING_CALLS)); i-- > 0; ) {
+            if (thread_pending_calls[i].call_no == call) {
+                overheadSigId = thread_pending_calls[i].sig_id;
+                overheadCounters[overheadSigId].time[OVERHEAD_LOCK] += writeStart - lockStart;
+                overheadLockStart = lockStart;
+                overheadWriteStart = writeStart;
+                thread_num_pending_calls = i;
+                break;
+            }
+        }
+        if (!overheadWriteStart && thread_num_pending_calls > MAX_PENDING_CALLS) {
+            // Nested too deep to be accounted
+            --thread_num_pending_calls;
+        }
+    }
+
     Writer::beginLeave(call);
 }
 
 void LocalWriter::endLeave(void) {
     Writer::endLeave();
+    if (overheadEnabled && overheadWriteStart) {
+        long long writeEnd = os::getTime();
+        overheadCounters[overheadSigId].time[OVERHEAD_WRITE] += writeEnd - overheadWriteStart;
+        thread_writer_time += writeEnd - overheadLockStart;
+    }
     --acquired;
     mutex.unlock();
 }
 
+void LocalWriter::addShadowOverhead(long long time) {
+    thread_shadow_overhead += time;
+    thread_shadow_time += time;
+}
+
+void LocalWriter::addWrapperOverhead(const FunctionSig *sig, long long time) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    getOverheadCounters(sig->id, sig->name).time[OVERHEAD_WRAPPER] += time;
+}
+
+long long LocalWriter::getThreadWriterTime(void) const {
+    return thread_writer_time;
+}
+
+long long LocalWriter::getThreadShadowTime(void) const {
+    return thread_shadow_time;
+}
+
+LocalWriter::OverheadCounters &
+LocalWriter::getOverheadCounters(unsigned id, const char *name) {
+    if (id >= overheadCounters.size()) {
+        overheadCounters.resize(id + 1);
+    }
+    OverheadCounters &counters = overheadCounters[id];
+    if (!counters.name) {
+        counters.name = name;
+    }
+    return counters;
+}
+
+void LocalWriter::dumpOverhead(void) {
+    std::vector<const OverheadCounters *> sorted;
+    long long totals[OVERHEAD_PHASE_COUNT] = {};
+    unsigned long long totalCalls = 0;
+    for (auto & counters : overheadCounters) {
+        if (counters.calls) {
+            sorted.push_back(&counters);
+            totalCalls += counters.calls;
+            for (unsigned phase = 0; phase < OVERHEAD_PHASE_COUNT; ++phase) {
+                totals[phase] += counters.time[phase];
+            }
+        }
+    }
+
+    auto total = [] (const OverheadCounters *counters) {
+        long long sum = 0;
+        for (unsigned phase = 0; phase < OVERHEAD_PHASE_COUNT; ++phase) {
+            sum += counters->time[phase];
+        }
+        return sum;
+    };
+    std::sort(sorted.begin(), sorted.end(),
+              [&] (const OverheadCounters *a, const OverheadCounters *b) {
+                  return total(a) > total(b);
+              });
+
+    const double msecs = 1000.0 / os::timeFrequency;
+    os::log("apitrace: overhead: %llu calls, %.3f ms lock, %.3f ms write, %.3f ms shadow, %.3f ms wrapper\n",
+            totalCalls,
+            totals[OVERHEAD_LOCK] * msecs,
+            totals[OVERHEAD_WRITE] * msecs,
+            totals[OVERHEAD_SHADOW] * msecs,
+            totals[OVERHEAD_WRAPPER] * msecs);
+    os::log("apitrace: overhead: %-40s %10s %12s %12s %12s %12s %10s\n",
+            "function", "calls", "lock (ms)", "write (ms)", "shadow (ms)", "wrapper (ms)", "us/call");
+    for (auto counters : sorted) {
+        os::log("apitrace: overhead: %-40s %10llu %12.3f %12.3f %12.3f %12.3f %10.3f\n",
+                counters->name ? counters->name : "?",
+                counters->calls,
+                counters->time[OVERHEAD_LOCK] * msecs,
+                counters->time[OVERHEAD_WRITE] * msecs,
+                counters->time[OVERHEAD_SHADOW] * msecs,
+                counters->time[OVERHEAD_WRAPPER] * msecs,
+                total(counters) * msecs * 1000.0 / counters->calls);
+    }
+}
+
 void LocalWriter::flush(void) {
     /*
      * Do nothing if the mutex is already acquired (e.g., if a segfault happen
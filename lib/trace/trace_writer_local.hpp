@@ -32,9 +32,11 @@
 
 #include <stdint.h>
 #include <memory>
+#include <vector>
 
 #include "os_thread.hpp"
 #include "os_process.hpp"
+#include "os_time.hpp"
 #include "trace_writer.hpp"
 
 
@@ -81,6 +83,39 @@ namespace trace {
 
         void checkProcessId();
 
+    public:
+        /**
+         * Phases of the tracer's own per-call overhead.
+         */
+        enum OverheadPhase {
+            OVERHEAD_LOCK = 0, /**< waiting for the writer mutex */
+            OVERHEAD_WRITE,    /**< serializing the call */
+            OVERHEAD_SHADOW,   /**< shadowing mapped memory before the call */
+            OVERHEAD_WRAPPER,  /**< the rest of the generated wrapper code */
+            OVERHEAD_PHASE_COUNT
+        };
+
+    protected:
+        /**
+         * Overhead accounting, enabled with TRACE_OVERHEAD=1, and logged when
+         * the wrapper is unloaded.  Counters are indexed by function
+         * signature id, and are only updated with the mutex held.
+         */
+        struct OverheadCounters {
+            const char *name = nullptr;
+            unsigned long long calls = 0;
+            long long time[OVERHEAD_PHASE_COUNT] = {};
+        };
+
+        bool overheadEnabled;
+        std::vector<OverheadCounters> overheadCounters;
+        unsigned overheadSigId = 0;
+        long long overheadLockStart = 0;
+        long long overheadWriteStart = 0;
+
+        OverheadCounters &getOverheadCounters(unsigned id, const char *name);
+        void dumpOverhead(void);
+
     public:
         /**
          * Should never called directly -- use localWriter singleton below
@@ -112,6 +147,33 @@ namespace trace {
         void endLeave(void);
 
         void flush(void);
+
+        inline bool isOverheadEnabled(void) const {
+            return overheadEnabled;
+        }
+
+        /**
+         * Account time spent shadowing memory, attributing it to the next
+         * call entered by the current thread.
+         */
+        void addShadowOverhead(long long time);
+
+        /**
+         * Account time spent in the wrapper of the given function, other
+         * than in the function itself, writing calls, or shadowing memory.
+         */
+        void addWrapperOverhead(const FunctionSig *sig, long long time);
+
+        /**
+         * Total time the current thread spent writing calls, including
+         * waiting for the mutex.
+         */
+        long long getThreadWriterTime(void) const;
+
+        /**
+         * Total time the current thread spent shadowing memory.
+         */
+        long long getThreadShadowTime(void) const;
     };
 
     /**
@@ -121,5 +183,73 @@ namespace trace {
 
     void fakeMemcpy(const void *ptr, size_t size);
 
+    /**
+     * Account the time spent in the enclosing scope as memory shadowing
+     * overhead, except for the calls written meanwhile (e.g., fakeMemcpy),
+     * which are accounted on their own.
+     */
+    class ShadowOverheadScope {
+    private:
+        long long start;
+        long long writerTime;
+
+    public:
+        inline ShadowOverheadScope() :
+            start(localWriter.isOverheadEnabled() ? os::getTime() : 0),
+            writerTime(start ? localWriter.getThreadWriterTime() : 0)
+        {}
+
+        inline ~ShadowOverheadScope() {
+            if (start) {
+                long long nested = localWriter.getThreadWriterTime() - writerTime;
+                localWriter.addShadowOverhead(os::getTime() - start - nested);
+            }
+        }
+    };
+
+    /**
+     * Account the time spent in the enclosing generated wrapper as wrapper
+     * overhead, except for the time spent in the wrapped function, between
+     * beginInvoke() and endInvoke(), and the time already accounted to
+     * writing calls or shadowing memory.
+     */
+    class WrapperOverheadScope {
+    private:
+        const FunctionSig *sig;
+        long long start;
+        long long writerTime;
+        long long shadowTime;
+        long long invokeStart = 0;
+        long long invokeTime = 0;
+
+    public:
+        inline WrapperOverheadScope(const FunctionSig *_sig) :
+            sig(_sig),
+            start(localWriter.isOverheadEnabled() ? os::getTime() : 0),
+            writerTime(start ? localWriter.getThreadWriterTime() : 0),
+            shadowTime(start ? localWriter.getThreadShadowTime() : 0)
+        {}
+
+        inline void beginInvoke(void) {
+            if (start) {
+                invokeStart = os::getTime();
+            }
+        }
+
+        inline void endInvoke(void) {
+            if (start) {
+                invokeTime += os::getTime() - invokeStart;
+            }
+        }
+
+        inline ~WrapperOverheadScope() {
+            if (start) {
+                long long nested = localWriter.getThreadWriterTime() - writerTime +
+                                   localWriter.getThreadShadowTime() - shadowTime;
+                localWriter.addWrapperOverhead(sig, os::getTime() - start - invokeTime - nested);
+            }
+        }
+    };
+
 } /* namespace trace */
 
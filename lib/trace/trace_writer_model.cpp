@@ -97,6 +97,10 @@ public:
         writer.endArray();
     }
 
+    void visit(PackedArray *node) override {
+        writer.writePackedArray(node->type, node->buf, node->size());
+    }
+
     void visit(Blob *node) override {
         writer.writeBlob(node->buf, node->size);
     }
@@ -113,6 +117,8 @@ public:
     }
 
     void visit(Call *call) {
+        // Lazily parsed calls get their values copied without decoding
+        bool encoded = call->decoder != nullptr;
         unsigned call_no = writer.beginEnter(call->sig, call->thread_id);
         if (call->flags & CALL_FLAG_FAKE) {
             writer.writeFlags(FLAG_FAKE);
@@ -124,16 +130,24 @@ public:
             }
             writer.endBacktrace();
         }
-        for (unsigned i = 0; i < call->args.size(); ++i) {
-            if (call->args[i].value) {
-                writer.beginArg(i);
-                _visit(call->args[i].value);
-                writer.endArg();
+        if (encoded && !call->decoder->writeEncoded(call, writer, false)) {
+            call->decode();
+            encoded = false;
+        }
+        if (!encoded) {
+            for (unsigned i = 0; i < call->args.size(); ++i) {
+                if (call->args[i].value) {
+                    writer.beginArg(i);
+                    _visit(call->args[i].value);
+                    writer.endArg();
+                }
             }
         }
         writer.endEnter();
         writer.beginLeave(call_no);
-        if (call->ret) {
+        if (encoded) {
+            call->decoder->writeEncoded(call, writer, true);
+        } else if (call->ret) {
             writer.beginReturn();
             _visit(call->ret);
             writer.endReturn();
@@ -566,6 +566,9 @@ frame_complete(trace::Call &call) {
                         profilingBoundariesIndex[QUERY_BOUNDARY_FRAME]++);
             }
         }
+        if (isLastPass() && curMetricBackend) {
+            profiler().writeAvailable(curMetricBackend);
+        }
     }
     else if (retrace::profiling) {
         /* Complete any remaining queries */
@@ -646,6 +649,11 @@ afterContextSwitch()
                 std::cout << retrace::numPasses << std::endl;
                 exit(0);
             }
+            if (retrace::profilingMetricsOutput && retrace::numPasses > 1) {
+                // results of earlier passes are merged inside the backends
+                std::cerr << "warning: metrics need " << retrace::numPasses
+                          << " passes; only those of the last one are freed as they are written\n";
+            }
             metricBackendsSetup = true;
         }
 
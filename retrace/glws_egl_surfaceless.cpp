@@ -0,0 +1,505 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * EGL window system backend which needs no display server: drawables are
+ * pbuffers on the EGL_MESA_platform_surfaceless or EGL_EXT_platform_device
+ * displays, so they can be read back like windows would.
+ *
+ * Without X11 this is the only backend.  Otherwise it is built into the
+ * glws::surfaceless namespace, and glws_egl_xlib.cpp forwards to it.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include <dlfcn.h>
+
+#include "glproc.hpp"
+#include "glws.hpp"
+#ifdef HAVE_X11
+#include "glws_egl_surfaceless.hpp"
+#endif
+
+#include <EGL/eglext.h>
+
+
+namespace glws {
+
+#ifdef HAVE_X11
+namespace surfaceless {
+#endif
+
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static char const *eglExtensions = NULL;
+static bool has_EGL_KHR_create_context = false;
+
+
+static EGLenum
+translateAPI(glfeatures::Profile profile)
+{
+    switch (profile.api) {
+    case glfeatures::API_GL:
+        return EGL_OPENGL_API;
+    case glfeatures::API_GLES:
+        return EGL_OPENGL_ES_API;
+    default:
+        assert(0);
+        return EGL_NONE;
+    }
+}
+
+
+/* Must be called before
+ *
+ * - eglCreateContext
+ * - eglGetCurrentContext
+ * - eglGetCurrentDisplay
+ * - eglGetCurrentSurface
+ * - eglMakeCurrent (when its ctx parameter is EGL_NO_CONTEXT ),
+ * - eglWaitClient
+ * - eglWaitNative
+ */
+static void
+bindAPI(EGLenum api)
+{
+    if (eglBindAPI(api) != EGL_TRUE) {
+        std::cerr << "error: eglBindAPI failed\n";
+        exit(1);
+    }
+}
+
+
+class EglVisual : public Visual
+{
+public:
+    EGLConfig config;
+
+    EglVisual(Profile prof) :
+        Visual(prof),
+        config(0)
+    {}
+};
+
+
+class EglDrawable : public Drawable
+{
+public:
+    EGLSurface surface;
+    EGLenum api;
+
+    EglDrawable(const Visual *vis, int w, int h,
+                const glws::pbuffer_info *pbInfo) :
+        Drawable(vis, w, h, pbInfo),
+        api(EGL_OPENGL_ES_API)
+    {
+        surface = createSurface();
+    }
+
+    ~EglDrawable() {
+        eglDestroySurface(eglDisplay, surface);
+    }
+
+    EGLSurface
+    createSurface(void) {
+        Attributes<EGLint> attribs;
+        attribs.add(EGL_WIDTH, width);
+        attribs.add(EGL_HEIGHT, height);
+        attribs.end(EGL_NONE);
+
+        EGLConfig config = static_cast<const EglVisual *>(visual)->config;
+        EGLSurface surface = eglCreatePbufferSurface(eglDisplay, config, attribs);
+        if (surface == EGL_NO_SURFACE) {
+            std::cerr << "error: failed to create " << width << "x" << height << " EGL pbuffer\n";
+            exit(1);
+        }
+        return surface;
+    }
+
+    void
+    resize(int w, int h) override {
+        if (w == width && h == height) {
+            return;
+        }
+
+        Drawable::resize(w, h);
+
+        // Pbuffers have a fixed size, so replace the surface, contents and all
+        EGLContext currentContext = eglGetCurrentContext();
+        EGLSurface currentDrawSurface = eglGetCurrentSurface(EGL_DRAW);
+        EGLSurface currentReadSurface = eglGetCurrentSurface(EGL_READ);
+        bool rebindDrawSurface = currentDrawSurface == surface;
+        bool rebindReadSurface = currentReadSurface == surface;
+
+        if (rebindDrawSurface || rebindReadSurface) {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+
+        eglDestroySurface(eglDisplay, surface);
+        surface = createSurface();
+
+        if (rebindDrawSurface || rebindReadSurface) {
+            eglMakeCurrent(eglDisplay,
+                           rebindDrawSurface ? surface : currentDrawSurface,
+                           rebindReadSurface ? surface : currentReadSurface,
+                           currentContext);
+        }
+    }
+
+    void swapBuffers(void) override {
+        // Pbuffers have no front buffer, but make sure rendering completes
+        // at the same pace as it would on screen
+        bindAPI(api);
+        eglSwapBuffers(eglDisplay, surface);
+    }
+
+    void swapBuffersWithDamage(int *rects, int nrects) override {
+        swapBuffers();
+    }
+};
+
+
+class EglContext : public Context
+{
+public:
+    EGLContext context;
+
+    EglContext(const Visual *vis, EGLContext ctx) :
+        Context(vis),
+        context(ctx)
+    {}
+
+    ~EglContext() {
+        eglDestroyContext(eglDisplay, context);
+    }
+};
+
+/**
+ * Load the symbols from the specified shared object into global namespace, so
+ * that they can be later found by dlsym(RTLD_NEXT, ...);
+ */
+static void
+load(const char *filename)
+{
+    if (!dlopen(filename, RTLD_GLOBAL | RTLD_LAZY)) {
+        std::cerr << "error: unable to open " << filename << "\n";
+        exit(1);
+    }
+}
+
+static EGLDisplay
+getDeviceDisplay(void)
+{
+    EGLint numDevices = 0;
+    if (!eglQueryDevicesEXT(0, NULL, &numDevices) || numDevices <= 0) {
+        return EGL_NO_DISPLAY;
+    }
+
+    std::vector<EGLDeviceEXT> devices(numDevices);
+    if (!eglQueryDevicesEXT(numDevices, &devices[0], &numDevices)) {
+        return EGL_NO_DISPLAY;
+    }
+
+    // Take the first device which works, usually the hardware one
+    for (EGLint i = 0; i < numDevices; ++i) {
+        EGLDisplay display = eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, devices[i], NULL);
+        if (display != EGL_NO_DISPLAY) {
+            return display;
+        }
+    }
+    return EGL_NO_DISPLAY;
+}
+
+void
+init(void) {
+    load("libEGL.so.1");
+
+    eglExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (eglExtensions &&
+        checkExtension("EGL_MESA_platform_surfaceless", eglExtensions)) {
+        eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY &&
+        eglExtensions &&
+        checkExtension("EGL_EXT_platform_device", eglExtensions) &&
+        checkExtension("EGL_EXT_device_enumeration", eglExtensions)) {
+        eglDisplay = getDeviceDisplay();
+    }
+
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        std::cerr << "error: unable to get surfaceless or device EGL display\n";
+        exit(1);
+    }
+
+    EGLint major, minor;
+    if (!eglInitialize(eglDisplay, &major, &minor)) {
+        std::cerr << "error: unable to initialize EGL display\n";
+        exit(1);
+    }
+
+    eglExtensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    has_EGL_KHR_create_context = checkExtension("EGL_KHR_create_context", eglExtensions);
+}
+
+void
+cleanup(void) {
+    if (eglDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglTerminate(eglDisplay);
+    }
+}
+
+
+Visual *
+createVisual(bool doubleBuffer, unsigned samples, Profile profile) {
+    EGLint api_bits;
+    if (profile.api == glfeatures::API_GL) {
+        api_bits = EGL_OPENGL_BIT;
+        if (profile.core && !has_EGL_KHR_create_context) {
+            return NULL;
+        }
+    } else if (profile.api == glfeatures::API_GLES) {
+        switch (profile.major) {
+        case 1:
+            api_bits = EGL_OPENGL_ES_BIT;
+            break;
+        case 3:
+            if (has_EGL_KHR_create_context) {
+                api_bits = EGL_OPENGL_ES3_BIT;
+                break;
+            }
+            /* fall-through */
+        case 2:
+            api_bits = EGL_OPENGL_ES2_BIT;
+            break;
+        default:
+            return NULL;
+        }
+    } else {
+        assert(0);
+        return NULL;
+    }
+
+    Attributes<EGLint> attribs;
+    attribs.add(EGL_SURFACE_TYPE, EGL_PBUFFER_BIT);
+    attribs.add(EGL_RED_SIZE, 8);
+    attribs.add(EGL_GREEN_SIZE, 8);
+    attribs.add(EGL_BLUE_SIZE, 8);
+    attribs.add(EGL_ALPHA_SIZE, 8);
+    attribs.add(EGL_DEPTH_SIZE, 24);
+    attribs.add(EGL_STENCIL_SIZE, 8);
+    attribs.add(EGL_RENDERABLE_TYPE, api_bits);
+    attribs.end(EGL_NONE);
+
+    EGLint num_configs = 0;
+    if (!eglGetConfigs(eglDisplay, NULL, 0, &num_configs) ||
+        num_configs <= 0) {
+        return NULL;
+    }
+
+    std::vector<EGLConfig> configs(num_configs);
+    if (!eglChooseConfig(eglDisplay, attribs, &configs[0], num_configs,  &num_configs) ||
+        num_configs <= 0) {
+        return NULL;
+    }
+
+    // We can't tell what other APIs the trace will use afterwards, therefore
+    // try to pick a config which supports the widest set of APIs.
+    int bestScore = -1;
+    EGLConfig config = configs[0];
+    for (EGLint i = 0; i < num_configs; ++i) {
+        EGLint renderable_type = EGL_NONE;
+        eglGetConfigAttrib(eglDisplay, configs[i], EGL_RENDERABLE_TYPE, &renderable_type);
+        int score = 0;
+        assert(renderable_type & api_bits);
+        renderable_type &= ~api_bits;
+        if (renderable_type & EGL_OPENGL_ES2_BIT) {
+            score += 1 << 4;
+        }
+        if (renderable_type & EGL_OPENGL_ES3_BIT) {
+            score += 1 << 3;
+        }
+        if (renderable_type & EGL_OPENGL_ES_BIT) {
+            score += 1 << 2;
+        }
+        if (renderable_type & EGL_OPENGL_BIT) {
+            score += 1 << 1;
+        }
+        if (score > bestScore) {
+            config = configs[i];
+            bestScore = score;
+        }
+    }
+    assert(bestScore >= 0);
+
+    EglVisual *visual = new EglVisual(profile);
+    visual->config = config;
+
+    return visual;
+}
+
+Drawable *
+createDrawable(const Visual *visual, int width, int height,
+               const glws::pbuffer_info *pbInfo)
+{
+    return new EglDrawable(visual, width, height, pbInfo);
+}
+
+
+Context *
+createContext(const Visual *_visual, Context *shareContext, bool debug)
+{
+    Profile profile = _visual->profile;
+    const EglVisual *visual = static_cast<const EglVisual *>(_visual);
+    EGLContext share_context = EGL_NO_CONTEXT;
+    EGLContext context;
+    Attributes<EGLint> attribs;
+
+    if (shareContext) {
+        share_context = static_cast<EglContext*>(shareContext)->context;
+    }
+
+    int contextFlags = 0;
+    if (profile.api == glfeatures::API_GL) {
+        load("libGL.so.1");
+
+        if (has_EGL_KHR_create_context) {
+            attribs.add(EGL_CONTEXT_MAJOR_VERSION_KHR, profile.major);
+            attribs.add(EGL_CONTEXT_MINOR_VERSION_KHR, profile.minor);
+            int profileMask = profile.core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR;
+            attribs.add(EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, profileMask);
+            if (profile.forwardCompatible) {
+                contextFlags |= EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE_BIT_KHR;
+            }
+        } else if (profile.versionGreaterOrEqual(3, 2)) {
+            std::cerr << "error: EGL_KHR_create_context not supported\n";
+            return NULL;
+        }
+    } else if (profile.api == glfeatures::API_GLES) {
+        if (profile.major >= 2) {
+            load("libGLESv2.so.2");
+        } else {
+            load("libGLESv1_CM.so.1");
+        }
+
+        if (has_EGL_KHR_create_context) {
+            attribs.add(EGL_CONTEXT_MAJOR_VERSION_KHR, profile.major);
+            attribs.add(EGL_CONTEXT_MINOR_VERSION_KHR, profile.minor);
+        } else {
+            attribs.add(EGL_CONTEXT_CLIENT_VERSION, profile.major);
+        }
+    } else {
+        assert(0);
+        return NULL;
+    }
+
+    if (debug) {
+        contextFlags |= EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+    }
+    if (contextFlags && has_EGL_KHR_create_context) {
+        attribs.add(EGL_CONTEXT_FLAGS_KHR, contextFlags);
+    }
+    attribs.end(EGL_NONE);
+
+    EGLenum api = translateAPI(profile);
+    bindAPI(api);
+
+    context = eglCreateContext(eglDisplay, visual->config, share_context, attribs);
+    if (!context) {
+        if (debug) {
+            // XXX: Mesa has problems with EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR
+            // with OpenGL ES contexts, so retry without it
+            // (parenthesized so that ADL doesn't also find glws::createContext)
+            return (createContext)(_visual, shareContext, false);
+        }
+        return NULL;
+    }
+
+    return new EglContext(visual, context);
+}
+
+bool
+makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context)
+{
+    if (!drawable || !context) {
+        return eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    } else {
+        EglDrawable *eglDrawable = static_cast<EglDrawable *>(drawable);
+        EglDrawable *eglReadable = static_cast<EglDrawable *>(readable);
+        EglContext *eglContext = static_cast<EglContext *>(context);
+        EGLBoolean ok;
+
+        EGLenum api = translateAPI(eglContext->profile);
+        bindAPI(api);
+
+        ok = eglMakeCurrent(eglDisplay, eglDrawable->surface,
+                            eglReadable->surface, eglContext->context);
+
+        if (ok) {
+            eglDrawable->api = api;
+            eglReadable->api = api;
+        }
+
+        return ok;
+    }
+}
+
+
+bool
+processEvents(void) {
+    return true;
+}
+
+
+bool
+bindTexImage(Drawable *pBuffer, int iBuffer) {
+    std::cerr << "error: EGL/surfaceless::wglBindTexImageARB not implemented.\n";
+    assert(pBuffer->pbuffer);
+    return true;
+}
+
+bool
+releaseTexImage(Drawable *pBuffer, int iBuffer) {
+    std::cerr << "error: EGL/surfaceless::wglReleaseTexImageARB not implemented.\n";
+    assert(pBuffer->pbuffer);
+    return true;
+}
+
+bool
+setPbufferAttrib(Drawable *pBuffer, const int *attribList) {
+    // nothing to do here.
+    assert(pBuffer->pbuffer);
+    return true;
+}
+
+
+#ifdef HAVE_X11
+} /* namespace surfaceless */
+#endif
+
+} /* namespace glws */
@@ -0,0 +1,76 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Surfaceless EGL backend, which X11 builds of eglretrace select at runtime
+ * when there is no display to connect to.
+ */
+
+#pragma once
+
+
+#include "glws.hpp"
+
+
+namespace glws {
+
+namespace surfaceless {
+
+
+void
+init(void);
+
+void
+cleanup(void);
+
+Visual *
+createVisual(bool doubleBuffer, unsigned samples, Profile profile);
+
+Drawable *
+createDrawable(const Visual *visual, int width, int height,
+               const glws::pbuffer_info *pbInfo);
+
+Context *
+createContext(const Visual *visual, Context *shareContext, bool debug);
+
+bool
+makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context);
+
+bool
+processEvents(void);
+
+bool
+bindTexImage(Drawable *pBuffer, int iBuffer);
+
+bool
+releaseTexImage(Drawable *pBuffer, int iBuffer);
+
+bool
+setPbufferAttrib(Drawable *pBuffer, const int *attribList);
+
+
+} /* namespace surfaceless */
+
+} /* namespace glws */
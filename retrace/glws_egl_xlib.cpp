@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <iostream>
 
@@ -34,6 +35,7 @@
 #include "glproc.hpp"
 #include "glws.hpp"
 #include "glws_xlib.hpp"
+#include "glws_egl_surfaceless.hpp"
 
 #include <EGL/eglext.h>
 
@@ -45,6 +47,23 @@ static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
 static char const *eglExtensions = NULL;
 static bool has_EGL_KHR_create_context = false;
 
+// Whether to replay through pbuffers on a surfaceless or device display
+// instead, so that no X server is needed
+static bool useSurfaceless = false;
+
+
+static bool
+wantSurfaceless(void)
+{
+    const char *platform = getenv("EGL_PLATFORM");
+    if (platform) {
+        return strcmp(platform, "surfaceless") == 0 ||
+               strcmp(platform, "device") == 0;
+    }
+    const char *displayName = getenv("DISPLAY");
+    return !displayName || !displayName[0];
+}
+
 
 static EGLenum
 translateAPI(glfeatures::Profile profile)
@@ -270,6 +289,12 @@ load(const char *filename)
 
 void
 init(void) {
+    useSurfaceless = wantSurfaceless();
+    if (useSurfaceless) {
+        surfaceless::init();
+        return;
+    }
+
     load("libEGL.so.1");
 
     initX();
@@ -306,6 +331,11 @@ init(void) {
 
 void
 cleanup(void) {
+    if (useSurfaceless) {
+        surfaceless::cleanup();
+        return;
+    }
+
     if (eglDisplay != EGL_NO_DISPLAY) {
         eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         eglTerminate(eglDisplay);
@@ -317,6 +347,10 @@ cleanup(void) {
 
 Visual *
 createVisual(bool doubleBuffer, unsigned samples, Profile profile) {
+    if (useSurfaceless) {
+        return surfaceless::createVisual(doubleBuffer, samples, profile);
+    }
+
     EGLint api_bits;
     if (profile.api == glfeatures::API_GL) {
         api_bits = EGL_OPENGL_BIT;
@@ -431,6 +465,10 @@ Drawable *
 createDrawable(const Visual *visual, int width, int height,
                const glws::pbuffer_info *pbInfo)
 {
+    if (useSurfaceless) {
+        return surfaceless::createDrawable(visual, width, height, pbInfo);
+    }
+
     return new EglDrawable(visual, width, height, pbInfo);
 }
 
@@ -438,6 +476,10 @@ createDrawable(const Visual *visual, int width, int height,
 Context *
 createContext(const Visual *_visual, Context *shareContext, bool debug)
 {
+    if (useSurfaceless) {
+        return surfaceless::createContext(_visual, shareContext, debug);
+    }
+
     Profile profile = _visual->profile;
     const EglVisual *visual = static_cast<const EglVisual *>(_visual);
     EGLContext share_context = EGL_NO_CONTEXT;
@@ -509,6 +551,10 @@ createContext(const Visual *_visual, Context *shareContext, bool debug)
 bool
 makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context)
 {
+    if (useSurfaceless) {
+        return surfaceless::makeCurrentInternal(drawable, readable, context);
+    }
+
     if (!drawable || !context) {
         return eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     } else {
@@ -535,6 +581,9 @@ makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context)
 
 bool
 bindTexImage(Drawable *pBuffer, int iBuffer) {
+    if (useSurfaceless) {
+        return surfaceless::bindTexImage(pBuffer, iBuffer);
+    }
     std::cerr << "error: EGL/XLIB::wglBindTexImageARB not implemented.\n";
     assert(pBuffer->pbuffer);
     return true;
@@ -542,6 +591,9 @@ bindTexImage(Drawable *pBuffer, int iBuffer) {
 
 bool
 releaseTexImage(Drawable *pBuffer, int iBuffer) {
+    if (useSurfaceless) {
+        return surfaceless::releaseTexImage(pBuffer, iBuffer);
+    }
     std::cerr << "error: EGL/XLIB::wglReleaseTexImageARB not implemented.\n";
     assert(pBuffer->pbuffer);
     return true;
@@ -549,6 +601,9 @@ releaseTexImage(Drawable *pBuffer, int iBuffer) {
 
 bool
 setPbufferAttrib(Drawable *pBuffer, const int *attribList) {
+    if (useSurfaceless) {
+        return surfaceless::setPbufferAttrib(pBuffer, attribList);
+    }
     // nothing to do here.
     assert(pBuffer->pbuffer);
     return true;
@@ -170,6 +170,11 @@ cleanupX(void)
 bool
 processEvents(void)
 {
+    // EGL may be replaying without X, see glws_egl_xlib.cpp
+    if (!display) {
+        return true;
+    }
+
     while (XPending(display) > 0) {
         XEvent event;
         XNextEvent(display, &event);
@@ -90,17 +90,40 @@ escapeAsciiString(std::ostream &os, const char *str) {
     os << "\"";
 }
 
+static inline bool
+isPassThroughAscii(unsigned char c) {
+    return c >= 0x20 && c <= 0x7e && c != '\"' && c != '\\';
+}
+
 static void
 escapeUnicodeString(std::ostream &os, const char *str) {
     os << "\"";
 
-    const char *locale = setlocale(LC_CTYPE, "");
+    const char *locale = NULL;
+    bool localeSet = false;
     const char *src = str;
     mbstate_t state;
 
     memset(&state, 0, sizeof state);
 
-    do {
+    while (*src) {
+        // Write runs of printable ASCII characters in one go, as that's by
+        // far the common case, and only go through the locale for the rest.
+        const char *end = src;
+        while (isPassThroughAscii(*end)) {
+            ++end;
+        }
+        if (end != src) {
+            os.write(src, end - src);
+            src = end;
+            continue;
+        }
+
+        if (!localeSet) {
+            locale = setlocale(LC_CTYPE, "");
+            localeSet = true;
+        }
+
         // Convert characters one at a time in order to recover from
         // conversion errors
         wchar_t c;
@@ -128,9 +151,11 @@ escapeUnicodeString(std::ostream &os, const char *str) {
             // unicode
             os << "\\u" << std::hex << std::setfill('0') << std::setw(4) << (unsigned)c << std::setfill(' ') << std::dec;
         }
-    } while (src);
+    }
 
-    setlocale(LC_CTYPE, locale);
+    if (localeSet) {
+        setlocale(LC_CTYPE, locale);
+    }
 
     os << "\"";
 }
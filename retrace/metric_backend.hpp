@@ -282,4 +282,20 @@ public:
      */
     virtual unsigned getNumPasses() = 0;
 
+    /**
+     * Returns the number of queries of given type of boundary, counting from
+     * query id 0, whose data enumDataQueryId(...) can already return during
+     * the last pass, or ~0U if none is still to be sampled.  Results of
+     * earlier passes stay with the backend until then, so this only bounds
+     * memory when profiling takes a single pass.  Backends that only have
+     * their data after endPass() need not override this.
+     */
+    virtual unsigned getNumQueriesReady(QueryBoundary boundary) { return 0; }
+
+    /**
+     * Tells that data of the queries with ids below numQueries will not be
+     * enumerated anymore, so that the backend may free it.
+     */
+    virtual void releaseData(QueryBoundary boundary, unsigned numQueries) {}
+
 };
@@ -97,25 +97,41 @@ MetricBackend_AMD_perfmon::DataCollector::newDataBuffer(unsigned event,
                                                         size_t size)
 {
     // in case there is no data for previous events fill with nullptr
-    data[curPass].resize(event, nullptr);
+    data[curPass].resize(event - released[curPass], nullptr);
     data[curPass].push_back(alloc.allocate(size));
-    return data[curPass][event];
+    return data[curPass].back();
 }
 
 void MetricBackend_AMD_perfmon::DataCollector::endPass() {
     curPass++;
     data.push_back(mmapdeque<unsigned*>(alloc));
+    released.push_back(0);
 }
 
 unsigned*
 MetricBackend_AMD_perfmon::DataCollector::getDataBuffer(unsigned pass,
                                                         unsigned event)
 {
-    if (event < data[pass].size()) {
-        return data[pass][event];
+    if (event >= released[pass] && event - released[pass] < data[pass].size()) {
+        return data[pass][event - released[pass]];
     } else return nullptr;
 }
 
+unsigned MetricBackend_AMD_perfmon::DataCollector::numEvents(unsigned pass) {
+    return released[pass] + data[pass].size();
+}
+
+void MetricBackend_AMD_perfmon::DataCollector::release(unsigned pass,
+                                                       unsigned numEvents)
+{
+    if (pass >= data.size()) return; // not sampled yet
+    while (released[pass] < numEvents && !data[pass].empty()) {
+        alloc.deallocate(data[pass].front(), 1);
+        data[pass].pop_front();
+        released[pass]++;
+    }
+}
+
 
 MetricBackend_AMD_perfmon::MetricBackend_AMD_perfmon(glretrace::Context* context,
                                                      MmapAllocator<char> &alloc)
@@ -438,6 +454,34 @@ unsigned MetricBackend_AMD_perfmon::getNumPasses() {
     return numPasses;
 }
 
+unsigned MetricBackend_AMD_perfmon::getNumQueriesReady(QueryBoundary boundary) {
+    /* A boundary is sampled by a range of passes, frames first, so only the
+     * last of them decides what is ready */
+    if (boundary == QUERY_BOUNDARY_CALL) return ~0U;
+    unsigned j = 0;
+    unsigned nPasses = numFramePasses;
+    if (boundary == QUERY_BOUNDARY_DRAWCALL) {
+        j = numFramePasses;
+        nPasses = numPasses;
+    }
+    if (j == nPasses || unsigned(curPass) >= nPasses) return ~0U;
+    if (unsigned(curPass) + 1 < nPasses) return 0;
+    return collector.numEvents(curPass);
+}
+
+void MetricBackend_AMD_perfmon::releaseData(QueryBoundary boundary, unsigned numQueries) {
+    if (boundary == QUERY_BOUNDARY_CALL) return;
+    unsigned j = 0;
+    unsigned nPasses = numFramePasses;
+    if (boundary == QUERY_BOUNDARY_DRAWCALL) {
+        j = numFramePasses;
+        nPasses = numPasses;
+    }
+    for (; j < nPasses; j++) {
+        collector.release(j, numQueries);
+    }
+}
+
 MetricBackend_AMD_perfmon&
 MetricBackend_AMD_perfmon::getInstance(glretrace::Context* context,
                                        MmapAllocator<char> &alloc) {
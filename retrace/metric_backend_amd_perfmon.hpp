@@ -82,12 +82,13 @@ private:
             using mmapdeque = std::deque<T, MmapAllocator<T>>;
             // data storage
             mmapdeque<mmapdeque<unsigned*>> data;
+            std::vector<unsigned> released; // events freed from the front of each pass
             unsigned curPass;
 
         public:
             DataCollector(MmapAllocator<char> &alloc)
                 : alloc(alloc), data(1, mmapdeque<unsigned*>(alloc), alloc),
-                  curPass(0) {}
+                  released(1, 0), curPass(0) {}
 
             ~DataCollector();
 
@@ -96,6 +97,10 @@ private:
             void endPass();
 
             unsigned* getDataBuffer(unsigned pass, unsigned event);
+
+            unsigned numEvents(unsigned pass);
+
+            void release(unsigned pass, unsigned numEvents);
     };
 
 private:
@@ -173,6 +178,10 @@ public:
 
     unsigned getNumPasses() override;
 
+    unsigned getNumQueriesReady(QueryBoundary boundary) override;
+
+    void releaseData(QueryBoundary boundary, unsigned numQueries) override;
+
     static MetricBackend_AMD_perfmon& getInstance(glretrace::Context* context,
                                                   MmapAllocator<char> &alloc);
 };
@@ -105,25 +105,41 @@ MetricBackend_INTEL_perfquery::DataCollector::newDataBuffer(unsigned event,
                                                             size_t size)
 {
     // in case there is no data for previous events fill with nullptr
-    data[curPass].resize(event, nullptr);
+    data[curPass].resize(event - released[curPass], nullptr);
     data[curPass].push_back(alloc.allocate(size));
-    return data[curPass][event];
+    return data[curPass].back();
 }
 
 void MetricBackend_INTEL_perfquery::DataCollector::endPass() {
     curPass++;
     data.push_back(mmapdeque<unsigned char*>(alloc));
+    released.push_back(0);
 }
 
 unsigned char*
 MetricBackend_INTEL_perfquery::DataCollector::getDataBuffer(unsigned pass,
                                                             unsigned event)
 {
-    if (event < data[pass].size()) {
-        return data[pass][event];
+    if (event >= released[pass] && event - released[pass] < data[pass].size()) {
+        return data[pass][event - released[pass]];
     } else return nullptr;
 }
 
+unsigned MetricBackend_INTEL_perfquery::DataCollector::numEvents(unsigned pass) {
+    return released[pass] + data[pass].size();
+}
+
+void MetricBackend_INTEL_perfquery::DataCollector::release(unsigned pass,
+                                                           unsigned numEvents)
+{
+    if (pass >= data.size()) return; // not sampled yet
+    while (released[pass] < numEvents && !data[pass].empty()) {
+        alloc.deallocate(data[pass].front(), 1);
+        data[pass].pop_front();
+        released[pass]++;
+    }
+}
+
 MetricBackend_INTEL_perfquery::MetricBackend_INTEL_perfquery(glretrace::Context* context,
                                                              MmapAllocator<char> &alloc)
     : numPasses(1), curPass(0), curEvent(0), collector(alloc) {
@@ -350,6 +366,34 @@ unsigned MetricBackend_INTEL_perfquery::getNumPasses() {
     return numPasses;
 }
 
+unsigned MetricBackend_INTEL_perfquery::getNumQueriesReady(QueryBoundary boundary) {
+    /* A boundary is sampled by a range of passes, frames first, so only the
+     * last of them decides what is ready */
+    if (boundary == QUERY_BOUNDARY_CALL) return ~0U;
+    unsigned j = 0;
+    unsigned nPasses = numFramePasses;
+    if (boundary == QUERY_BOUNDARY_DRAWCALL) {
+        j = numFramePasses;
+        nPasses = numPasses;
+    }
+    if (j == nPasses || unsigned(curPass) >= nPasses) return ~0U;
+    if (unsigned(curPass) + 1 < nPasses) return 0;
+    return collector.numEvents(curPass);
+}
+
+void MetricBackend_INTEL_perfquery::releaseData(QueryBoundary boundary, unsigned numQueries) {
+    if (boundary == QUERY_BOUNDARY_CALL) return;
+    unsigned j = 0;
+    unsigned nPasses = numFramePasses;
+    if (boundary == QUERY_BOUNDARY_DRAWCALL) {
+        j = numFramePasses;
+        nPasses = numPasses;
+    }
+    for (; j < nPasses; j++) {
+        collector.release(j, numQueries);
+    }
+}
+
 MetricBackend_INTEL_perfquery&
 MetricBackend_INTEL_perfquery::getInstance(glretrace::Context* context,
                                            MmapAllocator<char> &alloc) {
@@ -85,12 +85,13 @@ private:
             using mmapdeque = std::deque<T, MmapAllocator<T>>;
             // data storage
             mmapdeque<mmapdeque<unsigned char*>> data;
+            std::vector<unsigned> released; // events freed from the front of each pass
             unsigned curPass;
 
         public:
             DataCollector(MmapAllocator<char> &alloc)
                 : alloc(alloc), data(1, mmapdeque<unsigned char*>(alloc), alloc),
-                  curPass(0) {}
+                  released(1, 0), curPass(0) {}
 
             ~DataCollector();
 
@@ -99,6 +100,10 @@ private:
             void endPass();
 
             unsigned char* getDataBuffer(unsigned pass, unsigned event);
+
+            unsigned numEvents(unsigned pass);
+
+            void release(unsigned pass, unsigned numEvents);
     };
 
 private:
@@ -166,6 +171,10 @@ public:
 
     unsigned getNumPasses() override;
 
+    unsigned getNumQueriesReady(QueryBoundary boundary) override;
+
+    void releaseData(QueryBoundary boundary, unsigned numQueries) override;
+
     static MetricBackend_INTEL_perfquery& getInstance(glretrace::Context* context,
                                                       MmapAllocator<char> &alloc);
 };
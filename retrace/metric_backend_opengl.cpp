@@ -25,6 +25,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "metric_backend_opengl.hpp"
 #include "os_time.hpp"
 #include "os_memory.hpp"
@@ -37,7 +39,20 @@ MetricBackend_opengl::Storage::addData(QueryBoundary boundary, int64_t data) {
 int64_t* MetricBackend_opengl::Storage::getData(QueryBoundary boundary,
                                                  unsigned eventId)
 {
-    return &(data[boundary][eventId]);
+    return &(data[boundary][eventId - released[boundary]]);
+}
+
+unsigned MetricBackend_opengl::Storage::numEvents(QueryBoundary boundary) {
+    return released[boundary] + data[boundary].size();
+}
+
+void MetricBackend_opengl::Storage::release(QueryBoundary boundary,
+                                            unsigned numEvents)
+{
+    while (released[boundary] < numEvents && !data[boundary].empty()) {
+        data[boundary].pop_front();
+        released[boundary]++;
+    }
 }
 
 Metric_opengl::Metric_opengl(unsigned gId, unsigned id, const std::string &name,
@@ -532,6 +547,26 @@ unsigned MetricBackend_opengl::getNumPasses() {
     return twoPasses ? 2 : 1;
 }
 
+unsigned MetricBackend_opengl::getNumQueriesReady(QueryBoundary boundary) {
+    // metrics profiled in the first pass are complete already, and GPU
+    // queries are only read back at the end of frames
+    unsigned numReady = ~0U;
+    for (int i = 0; i < METRIC_LIST_END; i++) {
+        if (metrics[i].enabled[boundary]) {
+            numReady = std::min(numReady, data[i][boundary]->numEvents(boundary));
+        }
+    }
+    return numReady;
+}
+
+void MetricBackend_opengl::releaseData(QueryBoundary boundary, unsigned numQueries) {
+    for (int i = 0; i < METRIC_LIST_END; i++) {
+        if (metrics[i].enabled[boundary]) {
+            data[i][boundary]->release(boundary, numQueries);
+        }
+    }
+}
+
 MetricBackend_opengl&
 MetricBackend_opengl::getInstance(glretrace::Context* context, MmapAllocator<char> &alloc) {
     static MetricBackend_opengl backend(context, alloc);
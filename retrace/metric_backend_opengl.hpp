@@ -75,6 +75,7 @@ private:
     {
     private:
         std::deque<int64_t, MmapAllocator<int64_t>> data[QUERY_BOUNDARY_LIST_END];
+        unsigned released[QUERY_BOUNDARY_LIST_END] = {}; // events freed from the front
 
     public:
 #ifdef _WIN32
@@ -91,6 +92,8 @@ private:
 #endif
         void addData(QueryBoundary boundary, int64_t data);
         int64_t* getData(QueryBoundary boundary, unsigned eventId);
+        unsigned numEvents(QueryBoundary boundary);
+        void release(QueryBoundary boundary, unsigned numEvents);
     };
 
     // indexes into metrics vector
@@ -189,6 +192,10 @@ public:
 
     unsigned getNumPasses() override;
 
+    unsigned getNumQueriesReady(QueryBoundary boundary) override;
+
+    void releaseData(QueryBoundary boundary, unsigned numQueries) override;
+
     static MetricBackend_opengl& getInstance(glretrace::Context* context,
                                              MmapAllocator<char> &alloc);
 
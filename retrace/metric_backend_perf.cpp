@@ -0,0 +1,413 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "metric_backend_perf.hpp"
+
+
+Metric_perf::Metric_perf(unsigned gId, unsigned id, const std::string &name,
+                         const std::string &desc, MetricType t,
+                         uint32_t eventType, uint64_t eventConfig)
+    : m_gId(gId), m_id(id), m_name(name), m_desc(desc), m_type(t),
+      eventType(eventType), eventConfig(eventConfig), available(false)
+{
+    for (int i = 0; i < QUERY_BOUNDARY_LIST_END; i++) {
+        enabled[i] = false;
+    }
+}
+
+unsigned Metric_perf::id() {
+    return m_id;
+}
+
+unsigned Metric_perf::groupId() {
+    return m_gId;
+}
+
+std::string Metric_perf::name() {
+    return m_name;
+}
+
+std::string Metric_perf::description() {
+    return m_desc;
+}
+
+MetricNumType Metric_perf::numType() {
+    return CNT_NUM_INT64;
+}
+
+MetricType Metric_perf::type() {
+    return m_type;
+}
+
+
+/**
+ * Open a counter of the calling thread, on any CPU.  Kernel time is counted
+ * too where allowed, as that is where much of the driver work happens.
+ *
+ * The group is read with the times it was enabled and running for, so that
+ * counts can be scaled when the kernel multiplexes more hardware counters
+ * than the PMU has.
+ */
+static int
+openCounter(uint32_t type, uint64_t config, int groupFd)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_hv = 1;
+
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static void
+closeCounter(int fd)
+{
+#ifdef __linux__
+    close(fd);
+#endif
+}
+
+static bool
+readCounterGroup(int fd, uint64_t *values, size_t count)
+{
+#ifdef __linux__
+    size_t size = count * sizeof *values;
+    return read(fd, values, size) == static_cast<ssize_t>(size);
+#else
+    return false;
+#endif
+}
+
+
+MetricBackend_perf::MetricBackend_perf(MmapAllocator<char> &alloc)
+    : alloc(alloc), groupFd(-1)
+{
+#ifdef __linux__
+    // Add metrics below, in the order of the METRIC_* indexes
+    metrics.emplace_back(0, 0, "Cycles", "CPU cycles",
+                         CNT_TYPE_GENERIC, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    metrics.emplace_back(0, 1, "Instructions", "Retired instructions",
+                         CNT_TYPE_GENERIC, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    metrics.emplace_back(0, 2, "Cache Misses", "Last level cache misses",
+                         CNT_TYPE_GENERIC, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    metrics.emplace_back(1, 0, "Task Clock", "CPU time in nanoseconds",
+                         CNT_TYPE_DURATION, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+    metrics.emplace_back(1, 1, "Page Faults", "",
+                         CNT_TYPE_GENERIC, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    metrics.emplace_back(1, 2, "Context Switches", "",
+                         CNT_TYPE_GENERIC, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+#endif
+
+    // hardware counters are often missing in virtual machines, and all of
+    // them are subject to kernel.perf_event_paranoid
+    for (auto &m : metrics) {
+        int fd = openCounter(m.eventType, m.eventConfig, -1);
+        if (fd >= 0) {
+            m.available = true;
+            closeCounter(fd);
+        }
+    }
+
+    // populate lookups
+    for (auto &m : metrics) {
+        idLookup[std::make_pair(m.groupId(), m.id())] = &m;
+        nameLookup[m.name()] = &m;
+    }
+
+    for (int i = 0; i < QUERY_BOUNDARY_LIST_END; i++) {
+        profiled[i] = false;
+        queryInProgress[i] = false;
+        released[i] = 0;
+    }
+}
+
+MetricBackend_perf::~MetricBackend_perf() {
+    closeCounters();
+}
+
+
+bool MetricBackend_perf::isSupported() {
+    for (auto &m : metrics) {
+        if (m.available) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MetricBackend_perf::enumGroups(enumGroupsCallback callback, void* userData) {
+    callback(0, 0, userData); // hardware group
+    callback(1, 0, userData); // software group
+}
+
+std::string MetricBackend_perf::getGroupName(unsigned group) {
+    switch(group) {
+        case 0:
+            return "Hardware";
+        case 1:
+            return "Software";
+        default:
+            return "";
+    }
+}
+
+void MetricBackend_perf::enumMetrics(unsigned group, enumMetricsCallback callback, void* userData) {
+    for (auto &m : metrics) {
+        if (m.groupId() == group && m.available) {
+            callback(&m, 0, userData);
+        }
+    }
+}
+
+std::unique_ptr<Metric>
+MetricBackend_perf::getMetricById(unsigned groupId, unsigned metricId) {
+    auto entryToCopy = idLookup.find(std::make_pair(groupId, metricId));
+    if (entryToCopy != idLookup.end()) {
+        return std::unique_ptr<Metric>(new Metric_perf(*entryToCopy->second));
+    } else {
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Metric>
+MetricBackend_perf::getMetricByName(std::string metricName) {
+    auto entryToCopy = nameLookup.find(metricName);
+    if (entryToCopy != nameLookup.end()) {
+        return std::unique_ptr<Metric>(new Metric_perf(*entryToCopy->second));
+    } else {
+        return nullptr;
+    }
+}
+
+
+int MetricBackend_perf::enableMetric(Metric* metric, QueryBoundary pollingRule) {
+    // metric is not necessarily the same object as in metrics[]
+    auto entry = idLookup.find(std::make_pair(metric->groupId(), metric->id()));
+    if ((entry != idLookup.end()) && entry->second->available) {
+        entry->second->enabled[pollingRule] = true;
+        return 0;
+    }
+    return 1;
+}
+
+unsigned MetricBackend_perf::generatePasses() {
+    // draw calls profiling not needed if all calls are profiled
+    for (auto &m : metrics) {
+        if (m.enabled[QUERY_BOUNDARY_CALL]) {
+            m.enabled[QUERY_BOUNDARY_DRAWCALL] = false;
+        }
+    }
+    // setup storage for profiled metrics
+    for (unsigned i = 0; i < metrics.size(); i++) {
+        for (int j = 0; j < QUERY_BOUNDARY_LIST_END; j++) {
+            if (metrics[i].enabled[j]) {
+                data[i][j] = std::unique_ptr<Storage>(new Storage(alloc));
+                profiled[j] = true;
+            }
+        }
+    }
+    // all counters fit in a single pass
+    return 1;
+}
+
+void MetricBackend_perf::openCounters(void) {
+    metricCounters.assign(metrics.size(), -1);
+    for (unsigned i = 0; i < metrics.size(); i++) {
+        Metric_perf &m = metrics[i];
+        bool enabled = false;
+        for (int j = 0; j < QUERY_BOUNDARY_LIST_END; j++) {
+            enabled = enabled || m.enabled[j];
+        }
+        if (!enabled) {
+            continue;
+        }
+        int fd = openCounter(m.eventType, m.eventConfig, groupFd);
+        if (fd < 0) {
+            std::cerr << "Warning: Failed to open perf counter for " << m.name()
+                      << ", reporting zeros." << std::endl;
+            continue;
+        }
+        if (groupFd < 0) {
+            groupFd = fd;
+        }
+        metricCounters[i] = counterFds.size();
+        counterFds.push_back(fd);
+    }
+    // the group reads as the number of counters, the enabled and running
+    // times, and then the counter values
+    readBuffer.resize(3 + counterFds.size());
+    counterValues.assign(counterFds.size(), 0);
+    for (auto &start : counterStart) {
+        start.assign(counterFds.size(), 0);
+    }
+}
+
+void MetricBackend_perf::closeCounters(void) {
+    for (auto fd : counterFds) {
+        closeCounter(fd);
+    }
+    counterFds.clear();
+    groupFd = -1;
+}
+
+bool MetricBackend_perf::readCounters(void) {
+    if (groupFd < 0) {
+        return false;
+    }
+    if (!readCounterGroup(groupFd, readBuffer.data(), readBuffer.size())) {
+        return false;
+    }
+    // extrapolate the counts over the time the group was not scheduled
+    uint64_t timeEnabled = readBuffer[1];
+    uint64_t timeRunning = readBuffer[2];
+    for (unsigned i = 0; i < counterValues.size(); i++) {
+        uint64_t value = readBuffer[3 + i];
+        if (timeRunning && timeRunning < timeEnabled) {
+            value = uint64_t(double(value) * timeEnabled / timeRunning);
+        }
+        counterValues[i] = value;
+    }
+    return true;
+}
+
+void MetricBackend_perf::beginPass() {
+    openCounters();
+}
+
+void MetricBackend_perf::endPass() {
+    closeCounters();
+}
+
+void MetricBackend_perf::pausePass() {
+    // counters follow the thread, not the GL context
+}
+
+void MetricBackend_perf::continuePass() {
+}
+
+void MetricBackend_perf::beginQuery(QueryBoundary boundary) {
+    if (profiled[boundary]) {
+        if (readCounters()) {
+            counterStart[boundary] = counterValues;
+        }
+        queryInProgress[boundary] = true;
+    }
+    // DRAWCALL is a CALL
+    if (boundary == QUERY_BOUNDARY_DRAWCALL) beginQuery(QUERY_BOUNDARY_CALL);
+}
+
+void MetricBackend_perf::endQuery(QueryBoundary boundary) {
+    if (queryInProgress[boundary]) {
+        bool valid = readCounters();
+        for (unsigned i = 0; i < metrics.size(); i++) {
+            if (!metrics[i].enabled[boundary]) {
+                continue;
+            }
+            int64_t value = 0;
+            int counter = metricCounters[i];
+            if (valid && counter >= 0) {
+                value = counterValues[counter] - counterStart[boundary][counter];
+            }
+            data[i][boundary]->push_back(value);
+        }
+        queryInProgress[boundary] = false;
+    }
+    // DRAWCALL is a CALL
+    if (boundary == QUERY_BOUNDARY_DRAWCALL) endQuery(QUERY_BOUNDARY_CALL);
+}
+
+void MetricBackend_perf::enumDataQueryId(unsigned id, enumDataCallback callback,
+                                         QueryBoundary boundary, void* userData) {
+    for (unsigned i = 0; i < metrics.size(); i++) {
+        Metric_perf &metric = metrics[i];
+        if (metric.enabled[boundary]) {
+            callback(&metric, id, &(*data[i][boundary])[id - released[boundary]], 0,
+                     userData);
+        }
+    }
+}
+
+unsigned MetricBackend_perf::getNumPasses() {
+    return 1;
+}
+
+unsigned MetricBackend_perf::getNumQueriesReady(QueryBoundary boundary) {
+    // counters are read synchronously, so data is there as soon as the
+    // query ends
+    unsigned numReady = ~0U;
+    for (unsigned i = 0; i < metrics.size(); i++) {
+        if (metrics[i].enabled[boundary]) {
+            numReady = std::min(numReady,
+                                unsigned(released[boundary] + data[i][boundary]->size()));
+        }
+    }
+    return numReady;
+}
+
+void MetricBackend_perf::releaseData(QueryBoundary boundary, unsigned numQueries) {
+    if (numQueries <= released[boundary]) {
+        return;
+    }
+    unsigned count = std::min(numQueries, getNumQueriesReady(boundary)) - released[boundary];
+    for (unsigned i = 0; i < metrics.size(); i++) {
+        if (metrics[i].enabled[boundary]) {
+            Storage &storage = *data[i][boundary];
+            storage.erase(storage.begin(), storage.begin() + count);
+        }
+    }
+    released[boundary] += count;
+}
+
+MetricBackend_perf&
+MetricBackend_perf::getInstance(MmapAllocator<char> &alloc) {
+    static MetricBackend_perf backend(alloc);
+    return backend;
+}
@@ -0,0 +1,170 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metric_backend.hpp"
+#include "mmap_allocator.hpp"
+
+/**
+ * CPU counters of the replaying thread, as counted by Linux perf events.
+ */
+class Metric_perf : public Metric
+{
+private:
+    unsigned m_gId, m_id;
+    std::string m_name, m_desc;
+    MetricType m_type;
+
+public:
+    Metric_perf(unsigned gId, unsigned id, const std::string &name,
+                const std::string &desc, MetricType t,
+                uint32_t eventType, uint64_t eventConfig);
+
+    unsigned id() override;
+
+    unsigned groupId() override;
+
+    std::string name() override;
+
+    std::string description() override;
+
+    MetricNumType numType() override;
+
+    MetricType type() override;
+
+    // perf_event_attr type and config of the counter
+    uint32_t eventType;
+    uint64_t eventConfig;
+
+    // should be set by backend
+    bool available;
+    bool enabled[QUERY_BOUNDARY_LIST_END]; // enabled for profiling
+};
+
+class MetricBackend_perf : public MetricBackend
+{
+private:
+    MmapAllocator<char> alloc;
+
+    typedef std::deque<int64_t, MmapAllocator<int64_t>> Storage;
+
+    // indexes into metrics vector
+    enum {
+        METRIC_CYCLES = 0,
+        METRIC_INSTRUCTIONS,
+        METRIC_CACHE_MISSES,
+        METRIC_TASK_CLOCK,
+        METRIC_PAGE_FAULTS,
+        METRIC_CONTEXT_SWITCHES,
+        METRIC_LIST_END
+    };
+
+    // lookup tables
+    std::map<std::pair<unsigned,unsigned>, Metric_perf*> idLookup;
+    std::map<std::string, Metric_perf*> nameLookup;
+
+    std::vector<Metric_perf> metrics;
+    // storage for metrics
+    std::unique_ptr<Storage> data[METRIC_LIST_END][QUERY_BOUNDARY_LIST_END];
+    unsigned released[QUERY_BOUNDARY_LIST_END]; // events freed from the front
+
+    // Counters are opened as a single group, so that one read() returns
+    // them all.  metricCounters holds the index of each metric's counter in
+    // the values read, or -1 if it has none.
+    int groupFd;
+    std::vector<int> counterFds;
+    std::vector<int> metricCounters;
+    std::vector<uint64_t> readBuffer;
+    std::vector<uint64_t> counterValues; // scaled values of the last read
+
+    bool profiled[QUERY_BOUNDARY_LIST_END]; // any metric enabled
+    bool queryInProgress[QUERY_BOUNDARY_LIST_END];
+    std::vector<uint64_t> counterStart[QUERY_BOUNDARY_LIST_END];
+
+    MetricBackend_perf(MmapAllocator<char> &alloc);
+
+    MetricBackend_perf(MetricBackend_perf const&) = delete;
+
+    void operator=(MetricBackend_perf const&)     = delete;
+
+public:
+    ~MetricBackend_perf();
+
+    bool isSupported() override;
+
+    void enumGroups(enumGroupsCallback callback, void* userData = nullptr) override;
+
+    void enumMetrics(unsigned group, enumMetricsCallback callback, void* userData = nullptr) override;
+
+    std::unique_ptr<Metric> getMetricById(unsigned groupId, unsigned metricId) override;
+
+    std::unique_ptr<Metric> getMetricByName(std::string metricName) override;
+
+    std::string getGroupName(unsigned group) override;
+
+    int enableMetric(Metric* metric, QueryBoundary pollingRule = QUERY_BOUNDARY_DRAWCALL) override;
+
+    unsigned generatePasses() override;
+
+    void beginPass() override;
+
+    void endPass() override;
+
+    void pausePass() override;
+
+    void continuePass() override;
+
+    void beginQuery(QueryBoundary boundary = QUERY_BOUNDARY_DRAWCALL) override;
+
+    void endQuery(QueryBoundary boundary = QUERY_BOUNDARY_DRAWCALL) override;
+
+    void enumDataQueryId(unsigned id, enumDataCallback callback,
+                         QueryBoundary boundary, void* userData = nullptr) override;
+
+    unsigned getNumPasses() override;
+
+    unsigned getNumQueriesReady(QueryBoundary boundary) override;
+
+    void releaseData(QueryBoundary boundary, unsigned numQueries) override;
+
+    static MetricBackend_perf& getInstance(MmapAllocator<char> &alloc);
+
+
+private:
+    void openCounters(void);
+
+    void closeCounters(void);
+
+    bool readCounters(void);
+};
@@ -0,0 +1,112 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+
+#include "metric_backend_perf.hpp"
+
+#include "gtest/gtest.h"
+
+
+static void
+collect(Metric *metric, int event, void *data, int error, void *userData)
+{
+    auto &values = *static_cast<std::map<std::string, int64_t> *>(userData);
+    values[metric->name()] = *static_cast<int64_t *>(data);
+}
+
+
+// Software counters need no PMU, so this runs in virtual machines too
+TEST(metric_backend_perf, software)
+{
+    MmapAllocator<char> alloc;
+    MetricBackend_perf &backend = MetricBackend_perf::getInstance(alloc);
+
+    std::unique_ptr<Metric> taskClock = backend.getMetricByName("Task Clock");
+    std::unique_ptr<Metric> pageFaults = backend.getMetricByName("Page Faults");
+    ASSERT_TRUE(taskClock);
+    ASSERT_TRUE(pageFaults);
+    if (backend.enableMetric(taskClock.get(), QUERY_BOUNDARY_CALL) != 0 ||
+        backend.enableMetric(pageFaults.get(), QUERY_BOUNDARY_CALL) != 0) {
+        GTEST_SKIP() << "perf events are not permitted";
+    }
+
+    EXPECT_EQ(backend.generatePasses(), 1u);
+    backend.beginPass();
+
+    // an idle call
+    backend.beginQuery(QUERY_BOUNDARY_CALL);
+    backend.endQuery(QUERY_BOUNDARY_CALL);
+
+    // a call touching fresh memory, one fault per page unless transparent
+    // huge pages back it
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t size = 16 << 20;
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+#ifdef MADV_NOHUGEPAGE
+    madvise(mapping, size, MADV_NOHUGEPAGE);
+#endif
+    char *buffer = static_cast<char *>(mapping);
+    backend.beginQuery(QUERY_BOUNDARY_CALL);
+    for (size_t i = 0; i < size; i += pageSize) {
+        buffer[i] = char(i);
+    }
+    backend.endQuery(QUERY_BOUNDARY_CALL);
+    munmap(mapping, size);
+
+    backend.endPass();
+
+    ASSERT_EQ(backend.getNumQueriesReady(QUERY_BOUNDARY_CALL), 2u);
+
+    std::map<std::string, int64_t> idle;
+    backend.enumDataQueryId(0, &collect, QUERY_BOUNDARY_CALL, &idle);
+    std::map<std::string, int64_t> busy;
+    backend.enumDataQueryId(1, &collect, QUERY_BOUNDARY_CALL, &busy);
+    ASSERT_EQ(busy.size(), 2u);
+
+    EXPECT_GE(idle["Task Clock"], 0);
+    EXPECT_GT(busy["Task Clock"], 0);
+    EXPECT_GE(busy["Page Faults"], int64_t(size / pageSize / 2));
+
+    backend.releaseData(QUERY_BOUNDARY_CALL, 2);
+    EXPECT_EQ(backend.getNumQueriesReady(QUERY_BOUNDARY_CALL), 2u);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -23,48 +23,138 @@
  *
  **************************************************************************/
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "metric_writer.hpp"
 
+// binary row types
+enum {
+    ROW_FRAME = 0,
+    ROW_CALL,
+    ROW_FRAME_END,
+    ROW_HEADER,
+};
+
+template<typename T>
+static void
+writeBinary(std::ostream &os, T value) {
+    os.write(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+static void
+writeBinaryString(std::ostream &os, const std::string &str) {
+    writeBinary<uint16_t>(os, str.size());
+    os.write(str.data(), str.size());
+}
+
+static const char*
+separator(const MetricStream &stream) {
+    return stream.format == retrace::METRICS_FORMAT_CSV ? "," : "\t";
+}
+
+namespace {
+
+// metric names of a binary header, which start with their count
+struct BinaryHeader
+{
+    uint32_t numMetrics = 0;
+    std::ostringstream metrics;
+};
+
+}
+
 void ProfilerQuery::writeMetricHeaderCallback(Metric* metric, int event, void* data, int error,
                                       void* userData) {
-    std::cout << "\t" << metric->name();
+    MetricStream &stream = *reinterpret_cast<MetricStream*>(userData);
+    switch (stream.format) {
+        case retrace::METRICS_FORMAT_TEXT:
+            *stream.os << "\t" << metric->name();
+            break;
+        case retrace::METRICS_FORMAT_CSV:
+            *stream.os << ",\"" << metric->name() << "\"";
+            break;
+        case retrace::METRICS_FORMAT_BINARY:
+            break;
+    }
+}
+
+static void
+writeBinaryHeaderCallback(Metric* metric, int event, void* data, int error,
+                          void* userData) {
+    BinaryHeader &header = *reinterpret_cast<BinaryHeader*>(userData);
+    header.numMetrics++;
+    writeBinary<uint8_t>(header.metrics, metric->numType());
+    writeBinaryString(header.metrics, metric->name());
 }
 
 void ProfilerQuery::writeMetricEntryCallback(Metric* metric, int event, void* data, int error,
                                      void* userData) {
+    MetricStream &stream = *reinterpret_cast<MetricStream*>(userData);
+    std::ostream &os = *stream.os;
+    if (stream.format == retrace::METRICS_FORMAT_BINARY) {
+        if (error) {
+            data = nullptr;
+        }
+        switch(metric->numType()) {
+            case CNT_NUM_UINT: writeBinary<uint64_t>(os, data ? *(reinterpret_cast<unsigned*>(data)) : 0); break;
+            case CNT_NUM_FLOAT: writeBinary<double>(os, data ? *(reinterpret_cast<float*>(data)) : 0); break;
+            case CNT_NUM_DOUBLE: writeBinary<double>(os, data ? *(reinterpret_cast<double*>(data)) : 0); break;
+            case CNT_NUM_BOOL: writeBinary<uint64_t>(os, data ? *(reinterpret_cast<bool*>(data)) : 0); break;
+            case CNT_NUM_UINT64: writeBinary<uint64_t>(os, data ? *(reinterpret_cast<uint64_t*>(data)) : 0); break;
+            case CNT_NUM_INT64: writeBinary<int64_t>(os, data ? *(reinterpret_cast<int64_t*>(data)) : 0); break;
+        }
+        return;
+    }
+    os << separator(stream);
     if (error) {
-        std::cout << "\t" << "#ERR" << error;
+        os << "#ERR" << error;
         return;
     }
     if (!data) {
-        std::cout << "\t" << "-";
+        if (stream.format == retrace::METRICS_FORMAT_TEXT) {
+            os << "-";
+        }
         return;
     }
     switch(metric->numType()) {
-        case CNT_NUM_UINT: std::cout << "\t" << *(reinterpret_cast<unsigned*>(data)); break;
-        case CNT_NUM_FLOAT: std::cout << "\t" << *(reinterpret_cast<float*>(data)); break;
-        case CNT_NUM_DOUBLE: std::cout << "\t" << *(reinterpret_cast<double*>(data)); break;
-        case CNT_NUM_BOOL: std::cout << "\t" << *(reinterpret_cast<bool*>(data)); break;
-        case CNT_NUM_UINT64: std::cout << "\t" << *(reinterpret_cast<uint64_t*>(data)); break;
-        case CNT_NUM_INT64: std::cout << "\t" << *(reinterpret_cast<int64_t*>(data)); break;
+        case CNT_NUM_UINT: os << *(reinterpret_cast<unsigned*>(data)); break;
+        case CNT_NUM_FLOAT: os << *(reinterpret_cast<float*>(data)); break;
+        case CNT_NUM_DOUBLE: os << *(reinterpret_cast<double*>(data)); break;
+        case CNT_NUM_BOOL: os << *(reinterpret_cast<bool*>(data)); break;
+        case CNT_NUM_UINT64: os << *(reinterpret_cast<uint64_t*>(data)); break;
+        case CNT_NUM_INT64: os << *(reinterpret_cast<int64_t*>(data)); break;
     }
 }
 
-void ProfilerQuery::writeMetricHeader(QueryBoundary qb) const {
+void ProfilerQuery::writeMetricHeader(QueryBoundary qb, MetricStream &stream) const {
+    if (stream.format == retrace::METRICS_FORMAT_BINARY) {
+        BinaryHeader header;
+        for (auto &a : *metricBackends) {
+            a->enumDataQueryId(eventId, &writeBinaryHeaderCallback, qb, &header);
+        }
+        writeBinary<uint8_t>(*stream.os, ROW_HEADER);
+        writeBinary<uint8_t>(*stream.os, qb);
+        writeBinary<uint32_t>(*stream.os, header.numMetrics);
+        *stream.os << header.metrics.str();
+        return;
+    }
     for (auto &a : *metricBackends) {
-        a->enumDataQueryId(eventId, &writeMetricHeaderCallback, qb);
+        a->enumDataQueryId(eventId, &writeMetricHeaderCallback, qb, &stream);
     }
-    std::cout << std::endl;
+    *stream.os << "\n";
 }
 
-void ProfilerQuery::writeMetricEntry(QueryBoundary qb) const {
+void ProfilerQuery::writeMetricEntry(QueryBoundary qb, MetricStream &stream) const {
     for (auto &a : *metricBackends) {
-        a->enumDataQueryId(eventId, &writeMetricEntryCallback, qb);
+        a->enumDataQueryId(eventId, &writeMetricEntryCallback, qb, &stream);
+    }
+    if (stream.format != retrace::METRICS_FORMAT_BINARY) {
+        *stream.os << "\n";
     }
-    std::cout << std::endl;
 }
 
 template<typename T>
@@ -99,50 +189,85 @@ ProfilerCall::ProfilerCall(unsigned eventId, const data* queryData)
 }
 
 
-void ProfilerCall::writeHeader() const {
-    std::cout << "#\tcall no\tprogram\tname";
-    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_CALL);
+void ProfilerCall::writeHeader(QueryBoundary qb, MetricStream &stream) const {
+    switch (stream.format) {
+        case retrace::METRICS_FORMAT_TEXT:
+            *stream.os << "#\tcall no\tprogram\tname";
+            break;
+        case retrace::METRICS_FORMAT_CSV:
+            *stream.os << "type,call no,program,name";
+            break;
+        case retrace::METRICS_FORMAT_BINARY:
+            break;
+    }
+    ProfilerQuery::writeMetricHeader(qb, stream);
 }
 
-void ProfilerCall::writeEntry() const {
+void ProfilerCall::writeEntry(QueryBoundary qb, MetricStream &stream) const {
+    std::ostream &os = *stream.os;
+    if (stream.format == retrace::METRICS_FORMAT_BINARY) {
+        if (isFrameEnd) {
+            writeBinary<uint8_t>(os, ROW_FRAME_END);
+        } else {
+            writeBinary<uint8_t>(os, ROW_CALL);
+            writeBinary<uint32_t>(os, no);
+            writeBinary<uint32_t>(os, program);
+            writeBinaryString(os, nameTable.getString(nameTableEntry));
+            ProfilerQuery::writeMetricEntry(qb, stream);
+        }
+        return;
+    }
     if (isFrameEnd) {
-        std::cout << "frame_end" << std::endl;
+        os << "frame_end\n";
     } else {
-        std::cout << "call"
-            << "\t" << no
-            << "\t" << program
-            << "\t" << nameTable.getString(nameTableEntry);
-        ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_CALL);
+        const char *sep = separator(stream);
+        os << "call"
+            << sep << no
+            << sep << program
+            << sep << nameTable.getString(nameTableEntry);
+        ProfilerQuery::writeMetricEntry(qb, stream);
     }
 }
 
+void ProfilerCall::writeHeader(MetricStream &stream) const {
+    writeHeader(QUERY_BOUNDARY_CALL, stream);
+}
 
-void ProfilerDrawcall::writeHeader() const {
-    std::cout << "#\tcall no\tprogram\tname";
-    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_DRAWCALL);
+void ProfilerCall::writeEntry(MetricStream &stream) const {
+    writeEntry(QUERY_BOUNDARY_CALL, stream);
 }
 
-void ProfilerDrawcall::writeEntry() const {
-    if (isFrameEnd) {
-        std::cout << "frame_end" << std::endl;
-    } else {
-        std::cout << "call"
-            << "\t" << no
-            << "\t" << program
-            << "\t" << nameTable.getString(nameTableEntry);
-        ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_DRAWCALL);
-    }
+
+void ProfilerDrawcall::writeHeader(MetricStream &stream) const {
+    ProfilerCall::writeHeader(QUERY_BOUNDARY_DRAWCALL, stream);
+}
+
+void ProfilerDrawcall::writeEntry(MetricStream &stream) const {
+    ProfilerCall::writeEntry(QUERY_BOUNDARY_DRAWCALL, stream);
 }
 
 
-void ProfilerFrame::writeHeader() const {
-    std::cout << "#";
-    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_FRAME);
+void ProfilerFrame::writeHeader(MetricStream &stream) const {
+    switch (stream.format) {
+        case retrace::METRICS_FORMAT_TEXT:
+            *stream.os << "#";
+            break;
+        case retrace::METRICS_FORMAT_CSV:
+            *stream.os << "type";
+            break;
+        case retrace::METRICS_FORMAT_BINARY:
+            break;
+    }
+    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_FRAME, stream);
 }
 
-void ProfilerFrame::writeEntry() const {
-    std::cout << "frame";
-    ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_FRAME);
+void ProfilerFrame::writeEntry(MetricStream &stream) const {
+    if (stream.format == retrace::METRICS_FORMAT_BINARY) {
+        writeBinary<uint8_t>(*stream.os, ROW_FRAME);
+    } else {
+        *stream.os << "frame";
+    }
+    ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_FRAME, stream);
 }
 
 
@@ -155,6 +280,38 @@ MetricWriter::MetricWriter(std::vector<MetricBackend*> &metricBackends,
     ProfilerQuery::metricBackends = &metricBackends;
 }
 
+void MetricWriter::setOutput(const char *prefix, retrace::MetricsFormat format)
+{
+    outputPrefix = prefix ? prefix : "";
+    this->format = format;
+}
+
+MetricStream &MetricWriter::getStream(QueryBoundary boundary)
+{
+    MetricStream &stream = streams[boundary];
+    if (stream.os) {
+        return stream;
+    }
+    stream.format = format;
+    if (outputPrefix.empty()) {
+        stream.os = &std::cout;
+        return stream;
+    }
+
+    static const char *names[QUERY_BOUNDARY_LIST_END] = {
+        "drawcalls", "frames", "calls"
+    };
+    static const char *extensions[] = {".txt", ".csv", ".bin"};
+    std::string filename = outputPrefix + names[boundary] + extensions[format];
+    files[boundary].open(filename, std::ios::out | std::ios::binary);
+    if (!files[boundary]) {
+        std::cerr << "error: failed to open `" << filename << "`\n";
+        exit(1);
+    }
+    stream.os = &files[boundary];
+    return stream;
+}
+
 void MetricWriter::addQuery(QueryBoundary boundary, unsigned eventId,
                             const void* queryData)
 {
@@ -175,49 +332,64 @@ void MetricWriter::addQuery(QueryBoundary boundary, unsigned eventId,
     }
 }
 
-void MetricWriter::writeQuery(QueryBoundary boundary) {
-    switch (boundary) {
-        case QUERY_BOUNDARY_FRAME:
-            frameQueue.front().writeEntry();
-            frameQueue.pop_front();
-            break;
-        case QUERY_BOUNDARY_CALL:
-            callQueue.front().writeEntry();
-            callQueue.pop_front();
-            break;
-        case QUERY_BOUNDARY_DRAWCALL:
-            drawcallQueue.front().writeEntry();
-            drawcallQueue.pop_front();
-            break;
-        default:
-            break;
+template<typename Queue>
+void MetricWriter::writeQueue(Queue &queue, QueryBoundary boundary,
+                              unsigned numReady)
+{
+    if (queue.empty() || !queue.front().isReady(numReady)) {
+        return;
+    }
+    MetricStream &stream = getStream(boundary);
+    if (!stream.headerWritten) {
+        queue.front().writeHeader(stream);
+        stream.headerWritten = true;
+    }
+    while (!queue.empty() && queue.front().isReady(numReady)) {
+        auto &query = queue.front();
+        query.writeEntry(stream);
+        if (query.hasData()) {
+            stream.numWritten = std::max(stream.numWritten, query.getEventId() + 1);
+        }
+        queue.pop_front();
+    }
+    stream.os->flush();
+
+    // written rows are not enumerated again
+    for (auto &b : *ProfilerQuery::metricBackends) {
+        b->releaseData(boundary, stream.numWritten);
     }
 }
 
+void MetricWriter::writeAvailable(MetricBackend *backend) {
+    if (outputPrefix.empty()) {
+        return;
+    }
+    writeQueue(frameQueue, QUERY_BOUNDARY_FRAME,
+               backend->getNumQueriesReady(QUERY_BOUNDARY_FRAME));
+    writeQueue(callQueue, QUERY_BOUNDARY_CALL,
+               backend->getNumQueriesReady(QUERY_BOUNDARY_CALL));
+    writeQueue(drawcallQueue, QUERY_BOUNDARY_DRAWCALL,
+               backend->getNumQueriesReady(QUERY_BOUNDARY_DRAWCALL));
+}
+
 void MetricWriter::writeAll(QueryBoundary boundary) {
     switch (boundary) {
         case QUERY_BOUNDARY_FRAME:
-            frameQueue.front().writeHeader();
-            while (!frameQueue.empty()) {
-                writeQuery(boundary);
-            }
+            writeQueue(frameQueue, boundary, ~0U);
             break;
         case QUERY_BOUNDARY_CALL:
-            callQueue.front().writeHeader();
-            while (!callQueue.empty()) {
-                writeQuery(boundary);
-            }
+            writeQueue(callQueue, boundary, ~0U);
             break;
         case QUERY_BOUNDARY_DRAWCALL:
-            drawcallQueue.front().writeHeader();
-            while (!drawcallQueue.empty()) {
-                writeQuery(boundary);
-            }
+            writeQueue(drawcallQueue, boundary, ~0U);
             break;
         default:
             break;
     }
-    std::cout << std::endl;
+    // separate the sections written to stdout
+    if (outputPrefix.empty() && format != retrace::METRICS_FORMAT_BINARY) {
+        std::cout << std::endl;
+    }
 }
 
 std::vector<MetricBackend*>* ProfilerQuery::metricBackends = nullptr;
@@ -25,12 +25,36 @@
 
 #pragma once
 
+#include <fstream>
 #include <queue>
 #include <string>
 #include <unordered_map>
 
 #include "metric_backend.hpp"
 #include "mmap_allocator.hpp"
+#include "retrace.hpp"
+
+/**
+ * Destination of the rows of one type of boundary.
+ *
+ * Binary output is a sequence of rows in host byte order, each starting with
+ * a uint8 row type:
+ *  - header (3): uint8 QueryBoundary, uint32 number of metrics, then for each
+ *    metric its uint8 MetricNumType, uint16 name length and name;
+ *  - frame (0): one value per metric;
+ *  - call (1): uint32 call no, uint32 program, uint16 name length, name, then
+ *    one value per metric;
+ *  - frame end (2): nothing else.
+ * Values take 8 bytes, as int64 for CNT_NUM_INT64, double for CNT_NUM_FLOAT
+ * and CNT_NUM_DOUBLE, and uint64 otherwise; they are 0 if unavailable.
+ */
+struct MetricStream
+{
+    std::ostream *os = nullptr;
+    retrace::MetricsFormat format = retrace::METRICS_FORMAT_TEXT;
+    bool headerWritten = false;
+    unsigned numWritten = 0; // events written, counting from event id 0
+};
 
 class ProfilerQuery
 {
@@ -46,8 +70,11 @@ public:
 
     ProfilerQuery(QueryBoundary qb, unsigned eventId)
         : eventId(eventId) {};
-    void writeMetricHeader(QueryBoundary qb) const;
-    void writeMetricEntry(QueryBoundary qb) const;
+    unsigned getEventId() const { return eventId; }
+    bool hasData() const { return true; }
+    bool isReady(unsigned numReady) const { return eventId < numReady; }
+    void writeMetricHeader(QueryBoundary qb, MetricStream &stream) const;
+    void writeMetricEntry(QueryBoundary qb, MetricStream &stream) const;
 };
 
 class ProfilerCall : public ProfilerQuery
@@ -75,15 +102,23 @@ protected:
 
     static StringTable<int16_t> nameTable;
 
-    int16_t nameTableEntry;
-    bool isFrameEnd;
-    unsigned no;
-    unsigned program;
+    int16_t nameTableEntry = 0;
+    bool isFrameEnd = false;
+    unsigned no = 0;
+    unsigned program = 0;
+
+    void writeHeader(QueryBoundary qb, MetricStream &stream) const;
+    void writeEntry(QueryBoundary qb, MetricStream &stream) const;
 
 public:
     ProfilerCall(unsigned eventId, const data* queryData = nullptr);
-    void writeHeader() const;
-    void writeEntry() const;
+    // frame end markers carry no metrics, so are always ready
+    bool hasData() const { return !isFrameEnd; }
+    bool isReady(unsigned numReady) const {
+        return isFrameEnd || ProfilerQuery::isReady(numReady);
+    }
+    void writeHeader(MetricStream &stream) const;
+    void writeEntry(MetricStream &stream) const;
 };
 
 class ProfilerDrawcall : public ProfilerCall
@@ -91,8 +126,8 @@ class ProfilerDrawcall : public ProfilerCall
 public:
     ProfilerDrawcall(unsigned eventId, const data* queryData)
         : ProfilerCall( eventId, queryData) {};
-    void writeHeader() const;
-    void writeEntry() const;
+    void writeHeader(MetricStream &stream) const;
+    void writeEntry(MetricStream &stream) const;
 };
 
 class ProfilerFrame : public ProfilerQuery
@@ -100,8 +135,8 @@ class ProfilerFrame : public ProfilerQuery
 public:
     ProfilerFrame(unsigned eventId)
         : ProfilerQuery(QUERY_BOUNDARY_FRAME, eventId) {};
-    void writeHeader() const;
-    void writeEntry() const;
+    void writeHeader(MetricStream &stream) const;
+    void writeEntry(MetricStream &stream) const;
 };
 
 class MetricWriter
@@ -111,14 +146,37 @@ private:
     std::deque<ProfilerCall, MmapAllocator<ProfilerCall>> callQueue;
     std::deque<ProfilerDrawcall, MmapAllocator<ProfilerDrawcall>> drawcallQueue;
 
+    std::string outputPrefix; // empty when writing to stdout at the end
+    retrace::MetricsFormat format = retrace::METRICS_FORMAT_TEXT;
+    std::ofstream files[QUERY_BOUNDARY_LIST_END];
+    MetricStream streams[QUERY_BOUNDARY_LIST_END];
+
+    MetricStream &getStream(QueryBoundary boundary);
+
+    template<typename Queue>
+    void writeQueue(Queue &queue, QueryBoundary boundary, unsigned numReady);
+
 public:
     MetricWriter(std::vector<MetricBackend*> &metricBackends,
                  const MmapAllocator<char> &alloc);
 
+    /**
+     * Sets the format of the rows.  If prefix is not null, the rows of each
+     * boundary are streamed to a file named after it as soon as their data
+     * is available, rather than all written to stdout at the end.
+     */
+    void setOutput(const char *prefix, retrace::MetricsFormat format);
+
     void addQuery(QueryBoundary boundary, unsigned eventId,
                   const void* queryData = nullptr);
 
-    void writeQuery(QueryBoundary boundary);
+    /**
+     * When streaming, writes the queued rows whose data backend, the one
+     * profiling the last pass, has available, and lets backends free it.
+     * Rows are only queued in the last pass, so data of earlier passes is
+     * kept until then.
+     */
+    void writeAvailable(MetricBackend *backend);
 
     void writeAll(QueryBoundary boundary);
 };
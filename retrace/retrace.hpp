@@ -167,6 +167,20 @@ extern char* profilingDrawCallsMetricsString;
 extern bool profilingListMetrics;
 extern bool profilingNumPasses;
 
+enum MetricsFormat {
+    METRICS_FORMAT_TEXT,
+    METRICS_FORMAT_CSV,
+    METRICS_FORMAT_BINARY,
+};
+
+extern MetricsFormat profilingMetricsFormat;
+
+/**
+ * Prefix of the files metrics are streamed to, or null to write them all to
+ * stdout at the end.
+ */
+extern const char *profilingMetricsOutput;
+
 extern bool profiling;
 extern bool profilingFrameTimes;
 extern bool profilingCpuTimes;
@@ -0,0 +1,791 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Replay pipeline benchmark.
+ *
+ * Generates synthetic traces with trace::Writer, and measures how fast they
+ * are parsed, parsed and dispatched through a null retracer, and -- when
+ * given a retracer executable -- fully replayed, writing the results as JSON.
+ *
+ * Every stage runs in a child process, so that the peak RSS reported is that
+ * of the stage alone.
+ */
+
+
+#include <assert.h>
+#include <limits.h> // for CHAR_MAX
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "os_string.hpp"
+#include "os_time.hpp"
+#include "trace_format.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+#include "retrace.hpp"
+#include "json.hpp"
+#include "version.h"
+
+
+namespace retrace {
+    int verbosity = -2;
+    int debug = 0;
+}
+
+
+/*
+ * Synthetic trace generation.
+ */
+
+static const char *glXCreateContext_args[] = {"dpy", "vis", "shareList", "direct"};
+static const char *glXMakeCurrent_args[] = {"dpy", "drawable", "ctx"};
+static const char *glXSwapBuffers_args[] = {"dpy", "drawable"};
+static const char *glViewport_args[] = {"x", "y", "width", "height"};
+static const char *glClear_args[] = {"mask"};
+static const char *glColor4f_args[] = {"red", "green", "blue", "alpha"};
+static const char *glDrawArrays_args[] = {"mode", "first", "count"};
+static const char *glGenBuffers_args[] = {"n", "buffer"};
+static const char *glBindBuffer_args[] = {"target", "buffer"};
+static const char *glBufferData_args[] = {"target", "size", "data", "usage"};
+static const char *eglBindAPI_args[] = {"api"};
+static const char *eglCreateContext_args[] = {"dpy", "config", "share_context", "attrib_list"};
+static const char *eglCreateWindowSurface_args[] = {"dpy", "config", "win", "attrib_list"};
+static const char *eglMakeCurrent_args[] = {"dpy", "draw", "read", "ctx"};
+static const char *eglSwapBuffers_args[] = {"dpy", "surface"};
+
+static const trace::FunctionSig glXCreateContext_sig = {0, "glXCreateContext", 4, glXCreateContext_args};
+static const trace::FunctionSig glXMakeCurrent_sig = {1, "glXMakeCurrent", 3, glXMakeCurrent_args};
+static const trace::FunctionSig glXSwapBuffers_sig = {2, "glXSwapBuffers", 2, glXSwapBuffers_args};
+static const trace::FunctionSig glViewport_sig = {3, "glViewport", 4, glViewport_args};
+static const trace::FunctionSig glClear_sig = {4, "glClear", 1, glClear_args};
+static const trace::FunctionSig glColor4f_sig = {5, "glColor4f", 4, glColor4f_args};
+static const trace::FunctionSig glDrawArrays_sig = {6, "glDrawArrays", 3, glDrawArrays_args};
+static const trace::FunctionSig glGenBuffers_sig = {7, "glGenBuffers", 2, glGenBuffers_args};
+static const trace::FunctionSig glBindBuffer_sig = {8, "glBindBuffer", 2, glBindBuffer_args};
+static const trace::FunctionSig glBufferData_sig = {9, "glBufferData", 4, glBufferData_args};
+static const trace::FunctionSig eglBindAPI_sig = {10, "eglBindAPI", 1, eglBindAPI_args};
+static const trace::FunctionSig eglCreateContext_sig = {11, "eglCreateContext", 4, eglCreateContext_args};
+static const trace::FunctionSig eglCreateWindowSurface_sig = {12, "eglCreateWindowSurface", 4, eglCreateWindowSurface_args};
+static const trace::FunctionSig eglMakeCurrent_sig = {13, "eglMakeCurrent", 4, eglMakeCurrent_args};
+static const trace::FunctionSig eglSwapBuffers_sig = {14, "eglSwapBuffers", 2, eglSwapBuffers_args};
+
+static const unsigned long long display = 0x1000;
+static const unsigned long long config = 0x2000;
+
+enum {
+    GL_TRIANGLES = 0x0004,
+    GL_COLOR_BUFFER_BIT = 0x00004000,
+    GL_ARRAY_BUFFER = 0x8892,
+    GL_STATIC_DRAW = 0x88E4,
+    EGL_OPENGL_API = 0x30A2,
+};
+
+
+/**
+ * Writes GL calls, with either GLX or EGL calls to manage contexts and
+ * drawables, the latter of which can be replayed without a display.
+ */
+class TraceGenerator
+{
+private:
+    trace::Writer writer;
+    bool egl = false;
+
+    inline unsigned
+    begin(const trace::FunctionSig &sig, unsigned thread) {
+        return writer.beginEnter(&sig, thread);
+    }
+
+    inline void
+    end(unsigned callNo) {
+        writer.endEnter();
+        writer.beginLeave(callNo);
+        writer.endLeave();
+    }
+
+    inline void
+    uintArg(unsigned index, unsigned long long value) {
+        writer.beginArg(index);
+        writer.writeUInt(value);
+        writer.endArg();
+    }
+
+    inline void
+    pointerArg(unsigned index, unsigned long long value) {
+        writer.beginArg(index);
+        writer.writePointer(value);
+        writer.endArg();
+    }
+
+    inline void
+    nullArg(unsigned index) {
+        writer.beginArg(index);
+        writer.writeNull();
+        writer.endArg();
+    }
+
+    inline void
+    endReturningPointer(unsigned callNo, unsigned long long value) {
+        writer.endEnter();
+        writer.beginLeave(callNo);
+        writer.beginReturn();
+        writer.writePointer(value);
+        writer.endReturn();
+        writer.endLeave();
+    }
+
+    inline void
+    endReturningTrue(unsigned callNo) {
+        writer.endEnter();
+        writer.beginLeave(callNo);
+        writer.beginReturn();
+        writer.writeSInt(1);
+        writer.endReturn();
+        writer.endLeave();
+    }
+
+public:
+    bool
+    open(const char *filename, bool _egl) {
+        egl = _egl;
+        trace::Properties properties;
+        return writer.open(filename, TRACE_VERSION, properties);
+    }
+
+    void
+    close(void) {
+        writer.close();
+    }
+
+    /**
+     * Select desktop GL, since the draws use fixed function calls.  Only
+     * needed with EGL.
+     */
+    void
+    bindAPI(unsigned thread) {
+        if (egl) {
+            unsigned callNo = begin(eglBindAPI_sig, thread);
+            uintArg(0, EGL_OPENGL_API);
+            endReturningTrue(callNo);
+        }
+    }
+
+    void
+    createContext(unsigned thread, unsigned long long context) {
+        if (egl) {
+            unsigned callNo = begin(eglCreateContext_sig, thread);
+            pointerArg(0, display);
+            pointerArg(1, config);
+            pointerArg(2, 0);
+            nullArg(3);
+            endReturningPointer(callNo, context);
+            return;
+        }
+        unsigned callNo = begin(glXCreateContext_sig, thread);
+        pointerArg(0, display);
+        pointerArg(1, 0);
+        pointerArg(2, 0);
+        uintArg(3, 1);
+        endReturningPointer(callNo, context);
+    }
+
+    /**
+     * Create the drawable.  Only needed with EGL, as GLX windows are created
+     * on first use.
+     */
+    void
+    createDrawable(unsigned thread, unsigned long long drawable) {
+        if (egl) {
+            unsigned callNo = begin(eglCreateWindowSurface_sig, thread);
+            pointerArg(0, display);
+            pointerArg(1, config);
+            pointerArg(2, 0);
+            nullArg(3);
+            endReturningPointer(callNo, drawable);
+        }
+    }
+
+    void
+    makeCurrent(unsigned thread, unsigned long long drawable, unsigned long long context) {
+        if (egl) {
+            unsigned callNo = begin(eglMakeCurrent_sig, thread);
+            pointerArg(0, display);
+            pointerArg(1, drawable);
+            pointerArg(2, drawable);
+            pointerArg(3, context);
+            endReturningTrue(callNo);
+            return;
+        }
+        unsigned callNo = begin(glXMakeCurrent_sig, thread);
+        pointerArg(0, display);
+        uintArg(1, drawable);
+        pointerArg(2, context);
+        endReturningTrue(callNo);
+    }
+
+    void
+    swapBuffers(unsigned thread, unsigned long long drawable) {
+        if (egl) {
+            unsigned callNo = begin(eglSwapBuffers_sig, thread);
+            pointerArg(0, display);
+            pointerArg(1, drawable);
+            endReturningTrue(callNo);
+            return;
+        }
+        unsigned callNo = begin(glXSwapBuffers_sig, thread);
+        pointerArg(0, display);
+        uintArg(1, drawable);
+        end(callNo);
+    }
+
+    void
+    viewport(unsigned thread, unsigned width, unsigned height) {
+        unsigned callNo = begin(glViewport_sig, thread);
+        uintArg(0, 0);
+        uintArg(1, 0);
+        uintArg(2, width);
+        uintArg(3, height);
+        end(callNo);
+    }
+
+    void
+    clear(unsigned thread) {
+        unsigned callNo = begin(glClear_sig, thread);
+        uintArg(0, GL_COLOR_BUFFER_BIT);
+        end(callNo);
+    }
+
+    void
+    color(unsigned thread, float r, float g, float b, float a) {
+        unsigned callNo = begin(glColor4f_sig, thread);
+        float values[4] = {r, g, b, a};
+        for (unsigned i = 0; i < 4; ++i) {
+            writer.beginArg(i);
+            writer.writeFloat(values[i]);
+            writer.endArg();
+        }
+        end(callNo);
+    }
+
+    void
+    drawArrays(unsigned thread, unsigned first, unsigned count) {
+        unsigned callNo = begin(glDrawArrays_sig, thread);
+        uintArg(0, GL_TRIANGLES);
+        uintArg(1, first);
+        uintArg(2, count);
+        end(callNo);
+    }
+
+    void
+    genBuffer(unsigned thread, unsigned buffer) {
+        unsigned callNo = begin(glGenBuffers_sig, thread);
+        uintArg(0, 1);
+        writer.endEnter();
+        writer.beginLeave(callNo);
+        writer.beginArg(1);
+        writer.beginArray(1);
+        writer.beginElement();
+        writer.writeUInt(buffer);
+        writer.endElement();
+        writer.endArray();
+        writer.endArg();
+        writer.endLeave();
+    }
+
+    void
+    bindBuffer(unsigned thread, unsigned buffer) {
+        unsigned callNo = begin(glBindBuffer_sig, thread);
+        uintArg(0, GL_ARRAY_BUFFER);
+        uintArg(1, buffer);
+        end(callNo);
+    }
+
+    void
+    bufferData(unsigned thread, const void *data, size_t size) {
+        unsigned callNo = begin(glBufferData_sig, thread);
+        uintArg(0, GL_ARRAY_BUFFER);
+        uintArg(1, size);
+        writer.beginArg(2);
+        writer.writeBlob(data, size);
+        writer.endArg();
+        uintArg(3, GL_STATIC_DRAW);
+        end(callNo);
+    }
+};
+
+
+/*
+ * Each synthetic trace has NUM_THREADS threads, each rendering to its own
+ * drawable and cycling through CONTEXTS_PER_THREAD contexts.  EGL variants
+ * can be replayed headless, with eglretrace on the surfaceless platform.
+ */
+struct Scenario
+{
+    const char *name;
+    bool egl;
+    unsigned numThreads;
+    unsigned contextsPerThread;
+    unsigned frames;
+    unsigned drawsPerFrame;
+    size_t blobSize;
+    unsigned blobsPerFrame;
+};
+
+
+static const Scenario
+scenarios[] = {
+    {"small-draws",       false,  1,  1, 1000, 1000, 0, 0},
+    {"huge-blobs",        false,  1,  1,   50,   10, 16 << 20, 4},
+    {"many-threads",      false, 16,  1,  200,  250, 0, 0},
+    {"many-contexts",     false,  1, 64,  200, 1000, 0, 0},
+    {"small-draws-egl",   true,   1,  1, 1000, 1000, 0, 0},
+    {"huge-blobs-egl",    true,   1,  1,   50,   10, 16 << 20, 4},
+    {"many-threads-egl",  true,  16,  1,  200,  250, 0, 0},
+    {"many-contexts-egl", true,   1, 64,  200, 1000, 0, 0},
+};
+
+
+static bool
+generateTrace(const Scenario &scenario, const char *filename)
+{
+    TraceGenerator generator;
+    if (!generator.open(filename, scenario.egl)) {
+        std::cerr << "error: failed to create " << filename << "\n";
+        return false;
+    }
+
+    std::vector<unsigned char> blob(scenario.blobSize);
+    for (size_t i = 0; i < blob.size(); ++i) {
+        blob[i] = (unsigned char)(i * 2654435761U >> 24);
+    }
+
+    auto contextHandle = [&] (unsigned thread, unsigned i) {
+        return 0x10000ULL + thread * scenario.contextsPerThread + i;
+    };
+    auto drawableHandle = [] (unsigned thread) {
+        return 0x20000ULL + thread;
+    };
+
+    for (unsigned thread = 0; thread < scenario.numThreads; ++thread) {
+        generator.bindAPI(thread);
+        for (unsigned i = 0; i < scenario.contextsPerThread; ++i) {
+            generator.createContext(thread, contextHandle(thread, i));
+        }
+        generator.createDrawable(thread, drawableHandle(thread));
+        generator.makeCurrent(thread, drawableHandle(thread), contextHandle(thread, 0));
+        if (scenario.blobsPerFrame) {
+            generator.genBuffer(thread, 1);
+            generator.bindBuffer(thread, 1);
+        }
+    }
+
+    for (unsigned frame = 0; frame < scenario.frames; ++frame) {
+        for (unsigned thread = 0; thread < scenario.numThreads; ++thread) {
+            generator.viewport(thread, 256, 256);
+            generator.clear(thread);
+            for (unsigned i = 0; i < scenario.blobsPerFrame; ++i) {
+                generator.bufferData(thread, blob.data(), blob.size());
+            }
+            for (unsigned draw = 0; draw < scenario.drawsPerFrame; ++draw) {
+                if (scenario.contextsPerThread > 1 &&
+                    draw % (scenario.drawsPerFrame / scenario.contextsPerThread) == 0) {
+                    unsigned i = draw * scenario.contextsPerThread / scenario.drawsPerFrame;
+                    generator.makeCurrent(thread, drawableHandle(thread), contextHandle(thread, i));
+                }
+                generator.color(thread, (draw & 0xff) / 255.0f, 0.5f, 0.25f, 1.0f);
+                generator.drawArrays(thread, draw * 3, 3);
+            }
+            generator.swapBuffers(thread, drawableHandle(thread));
+        }
+    }
+
+    generator.close();
+
+    return true;
+}
+
+
+/*
+ * Measurements.
+ */
+
+struct StageResult
+{
+    bool ok;
+    unsigned long long calls;
+    unsigned long long bytes;
+    double seconds;
+    long peakRss; // KiB
+    trace::API api;
+};
+
+
+static double
+elapsedSeconds(long long startTime)
+{
+    return double(os::getTime() - startTime) / os::timeFrequency;
+}
+
+
+static bool
+parseStage(const char *filename, retrace::Retracer *retracer, StageResult &result)
+{
+    trace::Parser parser;
+    if (!parser.open(filename)) {
+        return false;
+    }
+
+    long long startTime = os::getTime();
+
+    trace::Call *call;
+    while ((call = parser.parse_call())) {
+        if (retracer) {
+            retracer->retrace(*call);
+        }
+        ++result.calls;
+        delete call;
+    }
+
+    result.seconds = elapsedSeconds(startTime);
+    result.bytes = parser.dataBytesRead();
+    result.api = parser.api;
+
+    return true;
+}
+
+
+/**
+ * Run a stage in a child process.
+ */
+static bool
+runForked(std::function<bool (StageResult &)> stage, StageResult &result)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        StageResult childResult = StageResult();
+        childResult.ok = stage(childResult);
+        ssize_t written = write(fds[1], &childResult, sizeof childResult);
+        _exit(written == sizeof childResult ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t size = read(fds[0], &result, sizeof result);
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+    result.peakRss = usage.ru_maxrss;
+
+    return size == sizeof result &&
+           WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+           result.ok;
+}
+
+
+/**
+ * Fully replay a trace with an external retracer, on a software driver.
+ */
+static bool
+replayStage(const char *retracePath, trace::API api, const char *filename, StageResult &result)
+{
+    long long startTime = os::getTime();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+        if (api == trace::API_EGL) {
+            // Make eglretrace render into pbuffers, whether it was built
+            // with X11 or waffle, so that no display is needed
+            setenv("EGL_PLATFORM", "surfaceless", 1);
+            setenv("WAFFLE_PLATFORM", "surfaceless_egl", 1);
+        }
+        int null = ::open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+        }
+        execl(retracePath, retracePath, "--headless", "-b", filename, (char *)NULL);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+
+    result.seconds = elapsedSeconds(startTime);
+    result.peakRss = usage.ru_maxrss;
+    result.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    return result.ok;
+}
+
+
+static void
+writeResult(JSONWriter &json,
+            const char *trace, const char *stage,
+            const StageResult &result)
+{
+    json.beginObject();
+    json.beginMember("trace");
+    json.writeString(trace);
+    json.endMember();
+    json.beginMember("stage");
+    json.writeString(stage);
+    json.endMember();
+    json.beginMember("calls");
+    json.writeInt(result.calls);
+    json.endMember();
+    json.beginMember("seconds");
+    json.writeFloat(result.seconds);
+    json.endMember();
+    json.beginMember("calls_per_sec");
+    json.writeFloat(result.seconds > 0 ? result.calls / result.seconds : 0.0);
+    json.endMember();
+    json.beginMember("mb_per_sec");
+    json.writeFloat(result.seconds > 0 ? result.bytes / (1024.0 * 1024.0) / result.seconds : 0.0);
+    json.endMember();
+    json.beginMember("peak_rss_kb");
+    json.writeInt(result.peakRss);
+    json.endMember();
+    json.endObject();
+}
+
+
+static void
+usage(const char *argv0)
+{
+    std::cout
+        << "usage: " << argv0 << " [OPTIONS]\n"
+        << "Benchmark parsing, dispatching, and replaying synthetic traces.\n"
+        "\n"
+        "    -h, --help             show this help message and exit\n"
+        "    -o, --output=FILE      write JSON results to FILE (default is stdout)\n"
+        "    -d, --directory=DIR    where to generate the traces (default is current directory)\n"
+        "    -g, --glretrace=PATH   also fully replay GLX/WGL/CGL traces with the given glretrace\n"
+        "    -e, --eglretrace=PATH  also fully replay EGL traces with the given eglretrace\n"
+        "    -k, --keep             keep the generated traces\n"
+        "\n";
+}
+
+
+const static char *
+shortOptions = "ho:d:g:e:k";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"output", required_argument, 0, 'o'},
+    {"directory", required_argument, 0, 'd'},
+    {"glretrace", required_argument, 0, 'g'},
+    {"eglretrace", required_argument, 0, 'e'},
+    {"keep", no_argument, 0, 'k'},
+    {0, 0, 0, 0}
+};
+
+
+int
+main(int argc, char **argv)
+{
+    const char *output = NULL;
+    const char *directory = ".";
+    const char *glretracePath = NULL;
+    const char *eglretracePath = NULL;
+    bool keep = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        case 'o':
+            output = optarg;
+            break;
+        case 'd':
+            directory = optarg;
+            break;
+        case 'g':
+            glretracePath = optarg;
+            break;
+        case 'e':
+            eglretracePath = optarg;
+            break;
+        case 'k':
+            keep = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::ofstream outputFile;
+    if (output) {
+        outputFile.open(output);
+        if (!outputFile) {
+            std::cerr << "error: failed to open " << output << "\n";
+            return 1;
+        }
+    }
+    std::ostream &os = output ? outputFile : std::cout;
+
+    // Every call is dispatched to a no-op callback.
+    static const retrace::Entry nullCallbacks[] = {
+        {glXCreateContext_sig.name, &retrace::ignore},
+        {glXMakeCurrent_sig.name, &retrace::ignore},
+        {glXSwapBuffers_sig.name, &retrace::ignore},
+        {glViewport_sig.name, &retrace::ignore},
+        {glClear_sig.name, &retrace::ignore},
+        {glColor4f_sig.name, &retrace::ignore},
+        {glDrawArrays_sig.name, &retrace::ignore},
+        {glGenBuffers_sig.name, &retrace::ignore},
+        {glBindBuffer_sig.name, &retrace::ignore},
+        {glBufferData_sig.name, &retrace::ignore},
+        {eglBindAPI_sig.name, &retrace::ignore},
+        {eglCreateContext_sig.name, &retrace::ignore},
+        {eglCreateWindowSurface_sig.name, &retrace::ignore},
+        {eglMakeCurrent_sig.name, &retrace::ignore},
+        {eglSwapBuffers_sig.name, &retrace::ignore},
+        {NULL, NULL}
+    };
+
+    int ret = 0;
+
+    {
+        JSONWriter json(os);
+
+        json.beginMember("version");
+        json.writeString(APITRACE_VERSION);
+        json.endMember();
+
+        json.beginMember("benchmarks");
+        json.beginArray();
+
+        for (const Scenario &scenario : scenarios) {
+            os::String filename = os::String::format("%s/bench-%s.trace", directory, scenario.name);
+
+            if (!generateTrace(scenario, filename)) {
+                ret = 1;
+                break;
+            }
+
+            StageResult parseResult = StageResult();
+            if (runForked([&] (StageResult &result) {
+                    return parseStage(filename, nullptr, result);
+                }, parseResult)) {
+                writeResult(json, scenario.name, "parse", parseResult);
+            } else {
+                std::cerr << "error: failed to parse " << filename << "\n";
+                ret = 1;
+            }
+
+            StageResult dispatchResult = StageResult();
+            if (runForked([&] (StageResult &result) {
+                    retrace::Retracer retracer;
+                    retracer.addCallbacks(nullCallbacks);
+                    return parseStage(filename, &retracer, result);
+                }, dispatchResult)) {
+                writeResult(json, scenario.name, "dispatch", dispatchResult);
+            } else {
+                std::cerr << "error: failed to dispatch " << filename << "\n";
+                ret = 1;
+            }
+
+            // Like `apitrace replay`, pick the retracer from the trace's API
+            const char *retracePath = NULL;
+            switch (parseResult.api) {
+            case trace::API_GL:
+                retracePath = glretracePath;
+                if (retracePath && !getenv("DISPLAY")) {
+                    std::cerr << "warning: no X display to replay " << filename << "\n";
+                    retracePath = NULL;
+                }
+                break;
+            case trace::API_EGL:
+                // Replayed on the surfaceless platform, see replayStage()
+                retracePath = eglretracePath;
+                break;
+            default:
+                break;
+            }
+
+            if (retracePath) {
+                StageResult replayResult = StageResult();
+                replayResult.calls = parseResult.calls;
+                replayResult.bytes = parseResult.bytes;
+                if (replayStage(retracePath, parseResult.api, filename, replayResult)) {
+                    writeResult(json, scenario.name, "replay", replayResult);
+                } else {
+                    std::cerr << "error: failed to replay " << filename << "\n";
+                    ret = 1;
+                }
+            }
+
+            if (!keep) {
+                unlink(filename);
+            }
+        }
+
+        json.endArray();
+        json.endMember();
+    }
+
+    os << std::flush;
+
+    return ret;
+}
@@ -0,0 +1,151 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "retrace_fastforward.hpp"
+
+#include <string.h>
+
+#include <regex>
+
+
+namespace retrace {
+
+
+// GL_PIXEL_PACK_BUFFER
+static const unsigned long long pixelPackBuffer = 0x88EB;
+
+// DXGI_PRESENT_TEST
+static const unsigned long long presentTest = 0x1;
+
+
+FastForward::Kind
+FastForward::getKind(const trace::Call &call)
+{
+    const char *name = call.name();
+
+    if (strcmp(name, "glNewList") == 0) {
+        return KIND_NEW_LIST;
+    }
+    if (strcmp(name, "glEndList") == 0) {
+        return KIND_END_LIST;
+    }
+    if (strcmp(name, "glBindBuffer") == 0 ||
+        strcmp(name, "glBindBufferARB") == 0) {
+        return KIND_BIND_BUFFER;
+    }
+
+    if (call.flags & trace::CALL_FLAG_END_FRAME) {
+        // Flagged so that snapshots are taken before it, but it copies a
+        // render target into a surface later calls may use, and normal
+        // replay doesn't count it as a frame
+        static const std::regex getRenderTargetData("^IDirect3DDevice9(Ex)?::GetRenderTargetData$");
+        if (std::regex_match(name, getRenderTargetData)) {
+            return KIND_OTHER;
+        }
+        static const std::regex dxgiPresent("^IDXGI(Decode)?SwapChain\\w*::Present\\w*$");
+        if (std::regex_match(name, dxgiPresent)) {
+            return KIND_DXGI_PRESENT;
+        }
+        return KIND_FRAME;
+    }
+
+    if (call.flags & trace::CALL_FLAG_RENDER) {
+        // glEnd must close its glBegin, display lists may change state, and
+        // blits write to framebuffers later calls may sample
+        static const std::regex kept("^gl(End|CallLists?|Blit(Named)?Framebuffer\\w*)$");
+        if (std::regex_match(name, kept)) {
+            return KIND_OTHER;
+        }
+        return KIND_RENDER;
+    }
+
+    static const std::regex dispatch("^glDispatchCompute(Indirect|GroupSizeARB)?$");
+    if (std::regex_match(name, dispatch)) {
+        return KIND_RENDER;
+    }
+
+    static const std::regex readback(
+        "^gl("
+            "Readn?Pixels(ARB|EXT|KHR)?|"
+            "Get(n|Compressed)*Tex(ture)?(Sub)?Image(ARB|EXT)?"
+        ")$"
+    );
+    if (std::regex_match(name, readback)) {
+        return KIND_READBACK;
+    }
+
+    return KIND_OTHER;
+}
+
+
+FastForward::Action
+FastForward::classify(trace::Call &call)
+{
+    trace::Id id = call.sig->id;
+    if (id >= kinds.size()) {
+        kinds.resize(id + 1, KIND_UNKNOWN);
+    }
+    if (kinds[id] == KIND_UNKNOWN) {
+        kinds[id] = getKind(call);
+    }
+
+    switch (kinds[id]) {
+    case KIND_NEW_LIST:
+        compilingList = true;
+        return REPLAY;
+    case KIND_END_LIST:
+        compilingList = false;
+        return REPLAY;
+    case KIND_BIND_BUFFER:
+        if (call.arg(0).toUInt() == pixelPackBuffer && call.arg(1).toUInt() != 0) {
+            packBufferBound = true;
+        }
+        return REPLAY;
+    default:
+        break;
+    }
+
+    // Both GL_COMPILE and GL_COMPILE_AND_EXECUTE compile draws into the list
+    if (compilingList) {
+        return REPLAY;
+    }
+
+    switch (kinds[id]) {
+    case KIND_FRAME:
+        return SKIP_FRAME;
+    case KIND_DXGI_PRESENT:
+        return call.arg(2).toUInt() & presentTest ? SKIP : SKIP_FRAME;
+    case KIND_RENDER:
+        return SKIP;
+    case KIND_READBACK:
+        return packBufferBound ? REPLAY : SKIP;
+    default:
+        return REPLAY;
+    }
+}
+
+
+} /* namespace retrace */
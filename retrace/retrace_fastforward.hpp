@@ -0,0 +1,85 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include "trace_model.hpp"
+
+
+namespace retrace {
+
+
+/**
+ * Decides which calls can be skipped when fast-forwarding to a target frame
+ * or call: those that only render, read back results or present, rather than
+ * creating resources or changing state that later calls depend on.
+ *
+ * Every call before the target must be classified, in order, since whether
+ * a call can be skipped depends on the calls before it.
+ */
+class FastForward
+{
+public:
+    enum Action {
+        REPLAY,     /**< the call must be replayed */
+        SKIP,       /**< the call can be skipped */
+        SKIP_FRAME, /**< the call can be skipped, and ends a frame */
+    };
+
+    Action
+    classify(trace::Call &call);
+
+private:
+    enum Kind : signed char {
+        KIND_UNKNOWN = -1,
+        KIND_OTHER,
+        KIND_RENDER,
+        KIND_READBACK,
+        KIND_FRAME,
+        KIND_DXGI_PRESENT,
+        KIND_NEW_LIST,
+        KIND_END_LIST,
+        KIND_BIND_BUFFER,
+    };
+
+    // Kinds cached per signature, like the parser does for flags
+    std::vector<Kind> kinds;
+
+    // Whether a display list is being compiled, in which case draws are
+    // compiled into it rather than executed
+    bool compilingList = false;
+
+    // Whether a pixel pack buffer was ever bound, in which case readbacks
+    // may write to it.  Bindings are per context, so don't track unbinding.
+    bool packBufferBound = false;
+
+    static Kind
+    getKind(const trace::Call &call);
+};
+
+
+} /* namespace retrace */
@@ -0,0 +1,136 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <memory>
+#include <vector>
+
+#include "retrace_fastforward.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace retrace;
+
+
+static const char *noArgs[] = {nullptr};
+static const char *twoArgs[] = {"a", "b"};
+static const char *threeArgs[] = {"this", "SyncInterval", "Flags"};
+
+static const trace::FunctionSig drawSig = {0, "glDrawArrays", 0, noArgs};
+static const trace::FunctionSig swapSig = {1, "glXSwapBuffers", 0, noArgs};
+static const trace::FunctionSig newListSig = {2, "glNewList", 2, twoArgs};
+static const trace::FunctionSig endListSig = {3, "glEndList", 0, noArgs};
+static const trace::FunctionSig readSig = {4, "glReadPixels", 0, noArgs};
+static const trace::FunctionSig bindSig = {5, "glBindBuffer", 2, twoArgs};
+static const trace::FunctionSig blitSig = {6, "glBlitFramebuffer", 0, noArgs};
+static const trace::FunctionSig dispatchSig = {7, "glDispatchCompute", 0, noArgs};
+static const trace::FunctionSig texImageSig = {8, "glTexImage2D", 0, noArgs};
+static const trace::FunctionSig getRTDataSig = {9, "IDirect3DDevice9::GetRenderTargetData", 0, noArgs};
+static const trace::FunctionSig presentSig = {10, "IDirect3DDevice9::Present", 0, noArgs};
+static const trace::FunctionSig dxgiPresentSig = {11, "IDXGISwapChain::Present", 3, threeArgs};
+static const trace::FunctionSig endSig = {12, "glEnd", 0, noArgs};
+static const trace::FunctionSig getTexImageSig = {13, "glGetTexImage", 0, noArgs};
+
+
+static std::unique_ptr<trace::Call>
+makeCall(const trace::FunctionSig &sig, trace::CallFlags flags,
+         const std::vector<unsigned long long> &args = {})
+{
+    std::unique_ptr<trace::Call> call(new trace::Call(&sig, flags, 0));
+    for (size_t i = 0; i < args.size(); ++i) {
+        call->args[i].value = new trace::UInt(args[i]);
+    }
+    return call;
+}
+
+
+TEST(retrace_fastforward, classify)
+{
+    FastForward ff;
+
+    EXPECT_EQ(ff.classify(*makeCall(drawSig, trace::CALL_FLAG_RENDER)), FastForward::SKIP);
+    EXPECT_EQ(ff.classify(*makeCall(endSig, trace::CALL_FLAG_RENDER)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(dispatchSig, 0)), FastForward::SKIP);
+    EXPECT_EQ(ff.classify(*makeCall(texImageSig, 0)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(swapSig, trace::CALL_FLAG_END_FRAME)), FastForward::SKIP_FRAME);
+
+    // Blits write to framebuffers later calls may use
+    EXPECT_EQ(ff.classify(*makeCall(blitSig, trace::CALL_FLAG_RENDER)), FastForward::REPLAY);
+
+    // D3D9 render target readbacks are flagged as frame ends, but aren't
+    EXPECT_EQ(ff.classify(*makeCall(getRTDataSig, trace::CALL_FLAG_END_FRAME)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(presentSig, trace::CALL_FLAG_END_FRAME)), FastForward::SKIP_FRAME);
+
+    // DXGI test presents don't present
+    EXPECT_EQ(ff.classify(*makeCall(dxgiPresentSig, trace::CALL_FLAG_END_FRAME, {0, 0, 0})), FastForward::SKIP_FRAME);
+    EXPECT_EQ(ff.classify(*makeCall(dxgiPresentSig, trace::CALL_FLAG_END_FRAME, {0, 0, 1})), FastForward::SKIP);
+}
+
+
+TEST(retrace_fastforward, display_lists)
+{
+    FastForward ff;
+
+    // GL_COMPILE
+    EXPECT_EQ(ff.classify(*makeCall(newListSig, 0, {1, 0x1300})), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(drawSig, trace::CALL_FLAG_RENDER)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(endListSig, 0)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(drawSig, trace::CALL_FLAG_RENDER)), FastForward::SKIP);
+
+    // GL_COMPILE_AND_EXECUTE
+    EXPECT_EQ(ff.classify(*makeCall(newListSig, 0, {2, 0x1301})), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(drawSig, trace::CALL_FLAG_RENDER)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(endListSig, 0)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(drawSig, trace::CALL_FLAG_RENDER)), FastForward::SKIP);
+}
+
+
+TEST(retrace_fastforward, pack_buffers)
+{
+    FastForward ff;
+
+    const unsigned long long packBuffer = 0x88EB;
+    const unsigned long long arrayBuffer = 0x8892;
+
+    EXPECT_EQ(ff.classify(*makeCall(readSig, 0)), FastForward::SKIP);
+    EXPECT_EQ(ff.classify(*makeCall(getTexImageSig, 0)), FastForward::SKIP);
+
+    EXPECT_EQ(ff.classify(*makeCall(bindSig, 0, {arrayBuffer, 1})), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(bindSig, 0, {packBuffer, 0})), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(readSig, 0)), FastForward::SKIP);
+
+    // Readbacks into pack buffers write GPU resources
+    EXPECT_EQ(ff.classify(*makeCall(bindSig, 0, {packBuffer, 2})), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(readSig, 0)), FastForward::REPLAY);
+    EXPECT_EQ(ff.classify(*makeCall(getTexImageSig, 0)), FastForward::REPLAY);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
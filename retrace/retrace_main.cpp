@@ -50,11 +50,13 @@
 #include "os_time.hpp"
 #include "os_thread.hpp"
 #include "image.hpp"
+#include "snapshot_ring.hpp"
 #include "threaded_snapshot.hpp"
 #include "trace_callset.hpp"
 #include "trace_dump.hpp"
 #include "trace_option.hpp"
 #include "retrace.hpp"
+#include "retrace_fastforward.hpp"
 #include "state_writer.hpp"
 #include "ws.hpp"
 #include "process_name.hpp"
@@ -67,13 +69,26 @@ static const char *snapshotPrefix = "";
 static enum {
     PNM_FMT,
     RAW_RGB,
-    RAW_MD5
+    RAW_MD5,
+    CRC32C_FMT
 } snapshotFormat = PNM_FMT;
+// Whether to also record snapshot checksums in PREFIXchecksums.txt
+static bool snapshotChecksums = false;
 
 static trace::CallSet snapshotFrequency;
+
+// Calls/frames before which only resource and state calls are replayed
+static unsigned fastForwardCallNo = 0;
+static unsigned fastForwardFrameNo = 0;
+// Whether to pin each replay thread to its own CPU
+static bool pinThreads = false;
 static unsigned snapshotInterval = 0;
+static unsigned snapshotSize = 0;
+static const char *snapshotRingFilename = NULL;
+static SnapshotRing *snapshotRing = NULL;
 
 static unsigned dumpStateCallNo = ~0;
+static const char *dumpImagesDirectory = NULL;
 
 retrace::Retracer retracer;
 
@@ -114,6 +129,8 @@ char* profilingFramesMetricsString;
 char* profilingDrawCallsMetricsString;
 bool profilingListMetrics = false;
 bool profilingNumPasses = false;
+MetricsFormat profilingMetricsFormat = METRICS_FORMAT_TEXT;
+const char *profilingMetricsOutput = nullptr;
 
 bool profiling = false;
 bool profilingFrameTimes = false;
@@ -322,7 +339,17 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no, bool backBuffer) {
     if ((snapshotInterval == 0 ||
         (snapshot_no % snapshotInterval) == 0)) {
 
+        if (snapshotSize) {
+            src.reset(image::downscale(*src, snapshotSize));
+        }
+
         if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
+            // Snapshots the ring can't carry are written as PNM below
+            if (snapshotRing && snapshotFormat == PNM_FMT &&
+                snapshotRing->write(*src, useCallNos ? call_no : snapshot_no, std::cout)) {
+                return;
+            }
+
             char comment[21];
             snprintf(comment, sizeof comment, "%u",
                      useCallNos ? call_no : snapshot_no);
@@ -336,6 +363,9 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no, bool backBuffer) {
             case RAW_MD5:
                 src->writeMD5(std::cout);
                 break;
+            case CRC32C_FMT:
+                std::cout << os::String::format("%08x\n", src->checksum(!retrace::snapshotAlpha));
+                break;
             default:
                 assert(0);
                 break;
@@ -359,7 +389,11 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no, bool backBuffer) {
 
             // Here we release our ownership on the Image, it is now the
             // responsibility of the snapshotter to delete it.
-            snapshotter->writePNG(filename, src.release());
+            if (snapshotFormat == CRC32C_FMT) {
+                snapshotter->writeChecksum(filename, src.release());
+            } else {
+                snapshotter->writePNG(filename, src.release());
+            }
         }
     }
 
@@ -404,6 +438,17 @@ retraceCall(trace::Call *call) {
         return;
     }
 
+    if (callNo < fastForwardCallNo || frameNo < fastForwardFrameNo) {
+        static FastForward fastForward;
+        FastForward::Action action = fastForward.classify(*call);
+        if (action != FastForward::REPLAY) {
+            if (action == FastForward::SKIP_FRAME) {
+                ++frameNo;
+            }
+            return;
+        }
+    }
+
     retracer.retrace(*call);
 
     if (snapshotFrequency.contains(*call)) {
@@ -417,6 +462,9 @@ retraceCall(trace::Call *call) {
     if (call->no == dumpStateCallNo || dumpStateCallNo == 0) {
         if (dumper->canDump()) {
             StateWriter *writer = stateWriterFactory(std::cout);
+            if (dumpImagesDirectory) {
+                writer->setImageDirectory(dumpImagesDirectory, std::thread::hardware_concurrency());
+            }
             dumper->dumpState(*writer);
             delete writer;
             exit(0);
@@ -444,6 +492,12 @@ private:
     std::vector<RelayRunner*> runners;
 
 public:
+    /**
+     * How many times a runner polls for the baton before going to sleep.
+     * Spinning only pays off when the passing thread runs on another CPU.
+     */
+    unsigned spinCount;
+
     RelayRace();
 
     ~RelayRace();
@@ -489,10 +543,17 @@ private:
     std::condition_variable wake_cond;
 
     /**
-     * There are protected by the mutex.
+     * These are set by other threads.  They are polled without the mutex
+     * while spinning, and rechecked with the mutex held before sleeping.
      */
-    bool finished;
-    trace::Call *baton;
+    std::atomic<bool> finished;
+    std::atomic<trace::Call *> baton;
+
+    /**
+     * Whether the runner is (about to be) sleeping on wake_cond, so that
+     * wakers can skip the notification while it is still spinning.
+     */
+    std::atomic<bool> parked;
 
     std::thread thread;
 
@@ -504,7 +565,8 @@ public:
         race(race),
         leg(_leg),
         finished(false),
-        baton(0)
+        baton(nullptr),
+        parked(false)
     {
         /* The fore runner does not need a new thread */
         if (leg) {
@@ -523,20 +585,19 @@ public:
      */
     void
     runRace(void) {
-        std::unique_lock<std::mutex> lock(mutex);
+        if (pinThreads) {
+            os::pinCurrentThread(leg);
+        }
 
         while (1) {
-            while (!finished && !baton) {
-                wake_cond.wait(lock);
-            }
+            waitBaton();
 
             if (finished) {
                 break;
             }
 
-            assert(baton);
-            trace::Call *call = baton;
-            baton = 0;
+            trace::Call *call = baton.exchange(nullptr);
+            assert(call);
 
             runLeg(call);
         }
@@ -548,6 +609,45 @@ public:
         }
     }
 
+    /**
+     * Wait until either the baton is received or the race is finished,
+     * spinning for a while before sleeping, as baton passes between
+     * threads tend to come in quick succession.
+     */
+    void
+    waitBaton(void) {
+        for (unsigned i = 0; i < race->spinCount; ++i) {
+            if (finished || baton) {
+                return;
+            }
+            os::cpuRelax();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        parked = true;
+        while (!finished && !baton) {
+            wake_cond.wait(lock);
+        }
+        parked = false;
+    }
+
+    /**
+     * Wake the runner if it went to sleep.
+     *
+     * The waker's store to baton/finished and the sleeper's store to parked
+     * are both sequentially consistent, so at least one of them sees the
+     * other's; taking the mutex ensures the sleeper is either before its
+     * final check or already waiting.
+     */
+    void
+    wake(void) {
+        if (parked) {
+            mutex.lock();
+            mutex.unlock();
+            wake_cond.notify_one();
+        }
+    }
+
     /**
      * Interpret successive calls.
      */
@@ -594,11 +694,8 @@ public:
     receiveBaton(trace::Call *call) {
         assert (call->thread_id == leg);
 
-        mutex.lock();
         baton = call;
-        mutex.unlock();
-
-        wake_cond.notify_one();
+        wake();
     }
 
     /**
@@ -608,11 +705,8 @@ public:
     finishRace() {
         if (0) std::cerr << "notify finish to leg " << leg << "\n";
 
-        mutex.lock();
         finished = true;
-        mutex.unlock();
-
-        wake_cond.notify_one();
+        wake();
     }
 };
 
@@ -624,6 +718,7 @@ RelayRunner::runnerThread(RelayRunner *_this) {
 
 
 RelayRace::RelayRace() {
+    spinCount = std::thread::hardware_concurrency() > 1 ? 4096 : 0;
     runners.push_back(new RelayRunner(this, 0));
 }
 
@@ -786,6 +881,9 @@ usage(const char *argv0) {
         "      --pframes           frame profiling metrics selection\n"
         "      --pdrawcalls        draw call profiling metrics selection\n"
         "      --list-metrics      list all available metrics for TRACE\n"
+        "      --pformat=FMT       metrics output format (text, csv or binary; default is text)\n"
+        "      --poutput=PREFIX    stream metrics to PREFIX{frames,calls,drawcalls}.{txt,csv,bin} as they become available\n"
+        "                          (with several passes, only during the last one)\n"
         "      --query-handling    How query readbacks should be handled: ('skip', 'run', 'check'), default is 'skip'\n"
         "      --query-tolerance   Set a tolerance when comparing recorded query results to evaluated ones, a value >0 enables query-handling 'check'\n"
         "      --gen-passes        generate profiling passes and output passes number\n"
@@ -801,24 +899,33 @@ usage(const char *argv0) {
         "      --msaa-no-resolve   dump raw sample images of multisampled texture instead of resolved texture\n"
         "  -s, --snapshot-prefix=PREFIX    take snapshots; `-` for PNM stdout output\n"
         "      --snapshot-alpha    Include alpha channel in snapshots.\n"
-        "      --snapshot-format=FMT       use (PNM, RGB, or MD5; default is PNM) when writing to stdout output\n"
+        "      --snapshot-format=FMT       use (PNM, RGB, MD5, or CRC32C; default is PNM) when writing to stdout output;\n"
+        "                          CRC32C with a prefix only writes the PREFIXchecksums.txt manifest\n"
+        "      --snapshot-checksums        also record the CRC-32C of each snapshot in PREFIXchecksums.txt\n"
         "  -S, --snapshot=CALLSET  calls to snapshot (default is every frame)\n"
         "      --snapshot-interval=N    specify a frame interval when generating snaphots (default is 0)\n"
         "  -t, --snapshot-threaded encode screenshots on multiple threads\n"
         "      --snapshot-force-backbuffer always read from the backbuffer when taking a snapshot (default read from the current draw buffer)\n"
+        "      --snapshot-size=N   scale snapshots down to fit in NxN pixels\n"
+        "      --snapshot-ring=FILE        pass PNM stdout snapshots through the shared memory ring in FILE\n"
         "  -v, --verbose           increase output verbosity\n"
         "  -D, --dump-state=CALL   dump state at specific call no\n"
         "      --dump-format=FORMAT dump state format (`json` or `ubjson`)\n"
+        "      --dump-images=DIR   write state images as files into DIR instead of embedding them\n"
         "      --min-frame-duration=MICROSECONDS   specify minimum frame rendering duration\n"
         "      --per-frame-delay=MICROSECONDS   add extra delay after each frame (in addition to min-frame-duration)\n"
         "  -w, --wait              waitOnFinish on final frame\n"
         "      --loop[=N]          loop N times (N<0 continuously) replaying final frame.\n"
         "      --watchdog          invokes abort() if retrace of a single api call will take more than " << retrace::RetraceWatchdog::TimeoutInSec << " seconds\n"
         "      --singlethread      use a single thread to replay command stream\n"
+        "      --pin-threads       pin each replay thread to its own CPU\n"
         "      --ignore-retvals    ignore return values in wglMakeCurrent, etc\n"
         "      --no-context-check  don't check that the actual GL context version matches the requested version\n"
         "      --min-cpu-time=NANOSECONDS  ignore calls with less than this CPU time when profiling (default is 1000)\n"
         "      --ignore-calls=CALLSET    ignore calls in CALLSET\n"
+        "      --fast-forward=FRAME      before FRAME, only replay calls which create resources or change state,\n"
+        "                          skipping draws, clears, dispatches, readbacks, and swaps\n"
+        "      --fast-forward-call=CALL  likewise, but before call number CALL\n"
         "      --version           display version information and exit\n"
     ;
 }
@@ -840,6 +947,8 @@ enum {
     PFRAMES_OPT,
     PDRAWCALLS_OPT,
     PLMETRICS_OPT,
+    PFORMAT_OPT,
+    POUTPUT_OPT,
     GENPASS_OPT,
     MSAA_NO_RESOLVE_OPT,
     SB_OPT,
@@ -848,18 +957,25 @@ enum {
     PER_FRAME_DELAY_OPT,
     LOOP_OPT,
     SINGLETHREAD_OPT,
+    PIN_THREADS_OPT,
     IGNORE_RETVALS_OPT,
     NO_CONTEXT_CHECK,
     SNAPSHOT_ALPHA_OPT,
     SNAPSHOT_FORMAT_OPT,
+    SNAPSHOT_CHECKSUMS_OPT,
     SNAPSHOT_INTERVAL_OPT,
     SNAPSHOT_FORCE_BACKBUFFER_OPT,
+    SNAPSHOT_SIZE_OPT,
+    SNAPSHOT_RING_OPT,
     DUMP_FORMAT_OPT,
+    DUMP_IMAGES_OPT,
     MARKERS_OPT,
     MIN_CPU_TIME_OPT,
     QUERY_HANDLING_OPT,
     QUERY_CHECK_TOLARANCE_OPT,
     IGNORE_CALLS_OPT,
+    FAST_FORWARD_OPT,
+    FAST_FORWARD_CALL_OPT,
     VERSION_OPT,
 };
 
@@ -878,6 +994,7 @@ longOptions[] = {
     {"driver", required_argument, 0, DRIVER_OPT},
     {"dump-state", required_argument, 0, 'D'},
     {"dump-format", required_argument, 0, DUMP_FORMAT_OPT},
+    {"dump-images", required_argument, 0, DUMP_IMAGES_OPT},
     {"fullscreen", no_argument, 0, FULLSCREEN_OPT},
     {"headless", no_argument, 0, HEADLESS_OPT},
     {"help", no_argument, 0, 'h'},
@@ -894,14 +1011,19 @@ longOptions[] = {
     {"query-handling", required_argument, 0, QUERY_HANDLING_OPT},
     {"query-tolerance", required_argument, 0, QUERY_CHECK_TOLARANCE_OPT},
     {"list-metrics", no_argument, 0, PLMETRICS_OPT},
+    {"pformat", required_argument, 0, PFORMAT_OPT},
+    {"poutput", required_argument, 0, POUTPUT_OPT},
     {"gen-passes", no_argument, 0, GENPASS_OPT},
     {"sb", no_argument, 0, SB_OPT},
     {"snapshot", required_argument, 0, 'S'},
     {"snapshot-alpha", no_argument, 0, SNAPSHOT_ALPHA_OPT},
     {"snapshot-format", required_argument, 0, SNAPSHOT_FORMAT_OPT},
+    {"snapshot-checksums", no_argument, 0, SNAPSHOT_CHECKSUMS_OPT},
     {"snapshot-interval", required_argument, 0, SNAPSHOT_INTERVAL_OPT},
     {"snapshot-force-backbuffer", no_argument, 0, SNAPSHOT_FORCE_BACKBUFFER_OPT},
     {"snapshot-prefix", required_argument, 0, 's'},
+    {"snapshot-size", required_argument, 0, SNAPSHOT_SIZE_OPT},
+    {"snapshot-ring", required_argument, 0, SNAPSHOT_RING_OPT},
     {"snapshot-threaded", no_argument, 0, 't'},
     {"verbose", no_argument, 0, 'v'},
     {"wait", no_argument, 0, 'w'},
@@ -910,10 +1032,13 @@ longOptions[] = {
     {"per-frame-delay", required_argument, 0, PER_FRAME_DELAY_OPT},
     {"loop", optional_argument, 0, LOOP_OPT},
     {"singlethread", no_argument, 0, SINGLETHREAD_OPT},
+    {"pin-threads", no_argument, 0, PIN_THREADS_OPT},
     {"ignore-retvals", no_argument, 0, IGNORE_RETVALS_OPT},
     {"no-context-check", no_argument, 0, NO_CONTEXT_CHECK},
     {"min-cpu-time", required_argument, 0, MIN_CPU_TIME_OPT},
     {"ignore-calls", required_argument, 0, IGNORE_CALLS_OPT},
+    {"fast-forward", required_argument, 0, FAST_FORWARD_OPT},
+    {"fast-forward-call", required_argument, 0, FAST_FORWARD_CALL_OPT},
     {"version", no_argument, 0, VERSION_OPT},
     {0, 0, 0, 0}
 };
@@ -1178,6 +1303,16 @@ int main(int argc, char **argv)
                 return EXIT_FAILURE;
             }
             break;
+        case DUMP_IMAGES_OPT:
+            dumpImagesDirectory = optarg;
+            {
+                os::String directory(dumpImagesDirectory);
+                if (!directory.exists() && !os::createDirectory(directory)) {
+                    std::cerr << "error: failed to create `" << dumpImagesDirectory << "` directory\n";
+                    return EXIT_FAILURE;
+                }
+            }
+            break;
         case CORE_OPT:
             retrace::setFeatureLevel("3_2_core");
             break;
@@ -1223,6 +1358,9 @@ int main(int argc, char **argv)
         case SINGLETHREAD_OPT:
             retrace::singleThread = true;
             break;
+        case PIN_THREADS_OPT:
+            pinThreads = true;
+            break;
         case IGNORE_RETVALS_OPT:
             retrace::ignoreRetvals = true;
             break;
@@ -1265,9 +1403,14 @@ int main(int argc, char **argv)
                 snapshotFormat = RAW_RGB;
             else if (strcmp(optarg, "MD5") == 0)
                 snapshotFormat = RAW_MD5;
+            else if (strcmp(optarg, "CRC32C") == 0)
+                snapshotFormat = CRC32C_FMT;
             else
                 snapshotFormat = PNM_FMT;
             break;
+        case SNAPSHOT_CHECKSUMS_OPT:
+            snapshotChecksums = true;
+            break;
         case 'S':
             dumpingSnapshots = true;
             snapshotFrequency.merge(optarg);
@@ -1278,6 +1421,12 @@ int main(int argc, char **argv)
         case SNAPSHOT_FORCE_BACKBUFFER_OPT:
             snapshotForceBackbuffer = true;
             break;
+        case SNAPSHOT_SIZE_OPT:
+            snapshotSize = trace::intOption(optarg, 0);
+            break;
+        case SNAPSHOT_RING_OPT:
+            snapshotRingFilename = optarg;
+            break;
         case 't':
             snapshotThreaded = true;
             break;
@@ -1362,6 +1511,22 @@ int main(int argc, char **argv)
             retrace::profilingWithBackends = true;
             retrace::profilingListMetrics = true;
             break;
+        case PFORMAT_OPT:
+            if (strcasecmp(optarg, "text") == 0) {
+                retrace::profilingMetricsFormat = retrace::METRICS_FORMAT_TEXT;
+            } else if (strcasecmp(optarg, "csv") == 0) {
+                retrace::profilingMetricsFormat = retrace::METRICS_FORMAT_CSV;
+            } else if (strcasecmp(optarg, "binary") == 0) {
+                os::setBinaryMode(stdout);
+                retrace::profilingMetricsFormat = retrace::METRICS_FORMAT_BINARY;
+            } else {
+                std::cerr << "error: unsupported metrics format `" << optarg << "`\n";
+                return EXIT_FAILURE;
+            }
+            break;
+        case POUTPUT_OPT:
+            retrace::profilingMetricsOutput = optarg;
+            break;
         case QUERY_HANDLING_OPT:
             if (strcmp(optarg, "check") == 0)
                 retrace::queryHandling = retrace::QUERY_RUN_AND_CHECK_RESULT;
@@ -1392,6 +1557,12 @@ int main(int argc, char **argv)
 
             retrace::callsToIgnore.merge(optarg);
             break;
+        case FAST_FORWARD_OPT:
+            fastForwardFrameNo = trace::intOption(optarg, 0);
+            break;
+        case FAST_FORWARD_CALL_OPT:
+            fastForwardCallNo = trace::intOption(optarg, 0);
+            break;
         case VERSION_OPT:
             std::cout << "apitrace " APITRACE_VERSION << std::endl;
             return 0;
@@ -1402,6 +1573,16 @@ int main(int argc, char **argv)
         }
     }
 
+    // perf_event counters only count the thread that opened them, so replay
+    // all calls on that thread
+    for (const char *metrics : {retrace::profilingCallsMetricsString,
+                                retrace::profilingFramesMetricsString,
+                                retrace::profilingDrawCallsMetricsString}) {
+        if (metrics && strstr(metrics, "perf_event")) {
+            retrace::singleThread = true;
+        }
+    }
+
     if (loopCount) {
         std::cerr << "warning: --loop blindly repeats the last frame calls, therefore frames might not necessarily render correctly (https://github.com/apitrace/apitrace/issues/800)" << std::endl;
     }
@@ -1427,6 +1608,17 @@ int main(int argc, char **argv)
     } else {
         snapshotter = new Snapshotter();
     }
+    if (dumpingSnapshots &&
+        (snapshotChecksums || snapshotFormat == CRC32C_FMT) &&
+        !(snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0)) {
+        snapshotter->openManifest(snapshotPrefix);
+    }
+    if (snapshotRingFilename) {
+        snapshotRing = SnapshotRing::open(snapshotRingFilename);
+        if (!snapshotRing) {
+            return 1;
+        }
+    }
 
     retrace::setUp();
     if (retrace::profiling && !retrace::profilingWithBackends) {
@@ -1474,6 +1666,7 @@ int main(int argc, char **argv)
     os::resetExceptionCallback();
 
     delete snapshotter;
+    delete snapshotRing;
 
     retrace::cleanUp();
 
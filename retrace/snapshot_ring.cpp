@@ -0,0 +1,184 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "snapshot_ring.hpp"
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "os_time.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// How long to wait for the consumer to free space before giving up on the ring
+static const long long ringTimeout = 10;  // seconds
+
+
+SnapshotRing *
+SnapshotRing::open(const char *filename)
+{
+    void *mapping;
+    size_t size;
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(hFile, &fileSize);
+    size = size_t(fileSize.QuadPart);
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMapping) {
+        std::cerr << "error: failed to map " << filename << "\n";
+        return nullptr;
+    }
+    mapping = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (!mapping) {
+        std::cerr << "error: failed to map " << filename << "\n";
+        return nullptr;
+    }
+#else
+    int fd = ::open(filename, O_RDWR);
+    if (fd < 0) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    size = size_t(st.st_size);
+    mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "error: failed to map " << filename << "\n";
+        return nullptr;
+    }
+#endif
+
+    SnapshotRing *ring = new SnapshotRing;
+    ring->mapping = mapping;
+    ring->mappingSize = size;
+    ring->header = static_cast<image::RingHeader *>(mapping);
+
+    if (size <= image::RING_HEADER_SIZE ||
+        memcmp(ring->header->magic, RING_MAGIC, sizeof ring->header->magic) != 0 ||
+        ring->header->capacity > size - image::RING_HEADER_SIZE) {
+        std::cerr << "error: " << filename << " is not a snapshot ring\n";
+        delete ring;
+        return nullptr;
+    }
+
+    ring->data = static_cast<unsigned char *>(mapping) + image::RING_HEADER_SIZE;
+    ring->capacity = ring->header->capacity;
+    ring->head = ring->header->tail.load(std::memory_order_acquire);
+
+    return ring;
+}
+
+
+SnapshotRing::~SnapshotRing()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, mappingSize);
+#endif
+}
+
+
+bool
+SnapshotRing::write(const image::Image &image, unsigned call_no, std::ostream &os)
+{
+    if (image.channelType != image::TYPE_UNORM8 ||
+        header->detached.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    uint64_t size = uint64_t(image.width) * image.height * 3;
+    if (size > capacity) {
+        return false;
+    }
+
+    uint64_t position = image::ringRecordPosition(head, size, capacity);
+
+    // Wait for the consumer to release enough space, unless it went away
+    long long deadline = os::getTime() + ringTimeout * os::timeFrequency;
+    while (position + size - header->tail.load(std::memory_order_acquire) > capacity) {
+        if (header->detached.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (os::getTime() > deadline) {
+            std::cerr << "warning: snapshot ring consumer stalled\n";
+            header->detached.store(1, std::memory_order_release);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    unsigned char *dst = data + position % capacity;
+    const unsigned char *row = image.start();
+    for (unsigned y = 0; y < image.height; ++y) {
+        const unsigned char *src = row;
+        for (unsigned x = 0; x < image.width; ++x) {
+            if (image.channels >= 3) {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            } else {
+                dst[0] = dst[1] = dst[2] = src[0];
+            }
+            src += image.bytesPerPixel;
+            dst += 3;
+        }
+        row += image.stride();
+    }
+
+    head = position + size;
+
+    // The consumer blocks on this line, so it must not linger in a buffer
+    os << "snapshot " << call_no << " " << image.width << " " << image.height << " " << position << "\n";
+    os.flush();
+
+    return true;
+}
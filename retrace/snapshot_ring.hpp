@@ -0,0 +1,69 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <iostream>
+
+#include "image.hpp"
+#include "image_ring.hpp"
+
+
+/**
+ * Producer side of the shared memory snapshot ring (see image_ring.hpp).
+ */
+class SnapshotRing
+{
+private:
+    image::RingHeader *header = nullptr;
+    unsigned char *data = nullptr;
+    uint64_t capacity = 0;
+    uint64_t head = 0;
+
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+
+    SnapshotRing() = default;
+
+public:
+    ~SnapshotRing();
+
+    /**
+     * Map the ring file created by the consumer, or return nullptr.
+     */
+    static SnapshotRing *
+    open(const char *filename);
+
+    /**
+     * Copy the image into the ring, waiting for the consumer to free space if
+     * needed, and announce it on the given stream.  Returns false if the
+     * image can't be sent through the ring, in which case it should be sent
+     * on the stream itself.
+     */
+    bool
+    write(const image::Image &image, unsigned call_no, std::ostream &os);
+};
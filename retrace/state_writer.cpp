@@ -28,14 +28,47 @@
 #include "state_writer.hpp"
 
 #include <assert.h>
+#include <string.h>
 
+#include <algorithm>
+#include <iostream>
 #include <sstream>
 
 #include "image.hpp"
+#include "os_string.hpp"
+#include "thread_pool.hpp"
 
 
 StateWriter::~StateWriter()
 {
+    // Wait for all pending image files to be written
+    delete imagePool;
+}
+
+
+void
+StateWriter::setImageDirectory(const char *directory, unsigned numThreads)
+{
+    assert(!imagePool);
+    imageDirectory = directory;
+    imagePool = new ThreadPool(std::max(numThreads, 1U));
+}
+
+
+static void
+writeImageFile(const std::string &filename, image::Image *image)
+{
+    // Same formats as embedded images, so that alpha is kept
+    bool ok;
+    if (image->channelType == image::TYPE_UNORM8) {
+        ok = image->writePNG(filename.c_str());
+    } else {
+        ok = image->writePNM(filename.c_str());
+    }
+    if (!ok) {
+        std::cerr << "error: failed to write " << filename << "\n";
+    }
+    delete image;
 }
 
 
@@ -64,6 +97,27 @@ StateWriter::writeImage(image::Image *image,
         writeStringMember("__label__", image->label.c_str());
     }
 
+    if (imagePool) {
+        os::String filename(imageDirectory.c_str());
+        filename.join(os::String::format("%08u.%s", imageCount++,
+                                         image->channelType == image::TYPE_UNORM8 ? "png" : "pnm"));
+
+        beginMember("__file__");
+        writeString(filename.str());
+        endMember(); // __file__
+
+        // The caller retains ownership of the image, so hand a copy of the
+        // pixels to the pool.
+        image::Image *copy = new image::Image(image->width, image->height,
+                                              image->channels, image->flipped,
+                                              image->channelType);
+        memcpy(copy->pixels, image->pixels, image->sizeInBytes());
+        imagePool->enqueue(writeImageFile, std::string(filename.str()), copy);
+
+        endObject();
+        return;
+    }
+
     beginMember("__data__");
     std::stringstream ss;
 
@@ -40,15 +40,30 @@ namespace image {
     class Image;
 }
 
+class ThreadPool;
+
 
 /*
  * Abstract base class for writing state.
  */
 class StateWriter
 {
+private:
+    std::string imageDirectory;
+    ThreadPool *imagePool = nullptr;
+    unsigned imageCount = 0;
+
 public:
     virtual ~StateWriter();
 
+    /**
+     * Write images as files into the given directory, referenced by name
+     * from the state, instead of embedding them as blobs.  Files are written
+     * on numThreads threads, in the same formats as embedded images.
+     */
+    void
+    setImageDirectory(const char *directory, unsigned numThreads);
+
     virtual void
     beginObject(void) = 0;
 
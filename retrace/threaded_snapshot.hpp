@@ -25,7 +25,11 @@
 
 #pragma once
 
+#include <stdio.h>
+
+#include <fstream>
 #include <iostream>
+#include <mutex>
 
 #include "image.hpp"
 #include "os_string.hpp"
@@ -37,10 +41,49 @@ namespace image {
 }
 
 
+/**
+ * Checksums of all snapshots taken, one "CHECKSUM  NAME" line per snapshot,
+ * so that snapshot dumps can be compared without decoding any image.
+ */
+class SnapshotManifest
+{
+private:
+    std::mutex mutex;
+    std::ofstream stream;
+    size_t prefixLength;
+
+public:
+    SnapshotManifest(const char *prefix) :
+        prefixLength(strlen(prefix))
+    {
+        os::String filename = os::String::format("%schecksums.txt", prefix);
+        stream.open(filename.str());
+        if (!stream) {
+            std::cerr << "error: failed to open " << filename << "\n";
+        }
+    }
+
+    void
+    add(const os::String& filename, const image::Image *image) {
+        char line[16];
+        snprintf(line, sizeof line, "%08x  ", image->checksum(!retrace::snapshotAlpha));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stream << line << filename.str() + prefixLength << "\n";
+    }
+};
+
+
 static void
-actuallyWritePNG(const os::String& filename, image::Image *image)
+actuallyWriteSnapshot(const os::String& filename, image::Image *image,
+                      SnapshotManifest *manifest, bool png)
 {
-    if (image->writePNG(filename, !retrace::snapshotAlpha) &&
+    if (manifest) {
+        manifest->add(filename, image);
+    }
+
+    if (png &&
+        image->writePNG(filename, !retrace::snapshotAlpha) &&
         retrace::verbosity >= 0) {
         std::cout << "Wrote " << filename << "\n";
     }
@@ -54,13 +97,35 @@ actuallyWritePNG(const os::String& filename, image::Image *image)
  */
 class Snapshotter
 {
+protected:
+    SnapshotManifest *manifest = nullptr;
+
 public:
     Snapshotter() {}
-    virtual ~Snapshotter() {}
+    virtual ~Snapshotter() {
+        delete manifest;
+    }
+
+    /**
+     * Record the checksum of every snapshot in PREFIXchecksums.txt.
+     */
+    void
+    openManifest(const char *prefix) {
+        assert(!manifest);
+        manifest = new SnapshotManifest(prefix);
+    }
 
     virtual void
     writePNG(const os::String& filename, image::Image *image) {
-        actuallyWritePNG(filename, image);
+        actuallyWriteSnapshot(filename, image, manifest, true);
+    }
+
+    /**
+     * Only record the snapshot checksum in the manifest.
+     */
+    virtual void
+    writeChecksum(const os::String& filename, image::Image *image) {
+        actuallyWriteSnapshot(filename, image, manifest, false);
     }
 };
 
@@ -79,6 +144,11 @@ public:
 
     virtual void
     writePNG(const os::String& filename, image::Image *image) override {
-        pool.enqueue(actuallyWritePNG, filename, image);
+        pool.enqueue(actuallyWriteSnapshot, filename, image, manifest, true);
+    }
+
+    virtual void
+    writeChecksum(const os::String& filename, image::Image *image) override {
+        pool.enqueue(actuallyWriteSnapshot, filename, image, manifest, false);
     }
 };
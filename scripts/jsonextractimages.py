@@ -39,8 +39,12 @@ pngSignature = b"\x89\x50\x4E\x47\x0D\x0A\x1A\x0A"
 
 def dumpSurfaces(state, memberName):
     for name, imageObj in state[memberName].items():
-        data = imageObj['__data__']
-        data = base64.b64decode(data)
+        if '__file__' in imageObj:
+            # Dumped with --dump-images
+            data = open(imageObj['__file__'], 'rb').read()
+        else:
+            data = imageObj['__data__']
+            data = base64.b64decode(data)
 
         if data.startswith(pngSignature):
             extName = 'png'
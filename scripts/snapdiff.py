@@ -175,6 +175,19 @@ def find_images(prefix):
     return images
 
 
+def read_manifest(prefix):
+    # Checksums written by `apitrace replay --snapshot-prefix=PREFIX`
+    checksums = {}
+    try:
+        stream = open(prefix + 'checksums.txt', 'rt')
+    except IOError:
+        return checksums
+    for line in stream:
+        checksum, image = line.rstrip('\n').split('  ', 1)
+        checksums[image] = checksum
+    return checksums
+
+
 def main():
     global options
 
@@ -213,8 +226,11 @@ def main():
     ref_prefix = args[0]
     src_prefix = args[1]
 
-    ref_images = find_images(ref_prefix)
-    src_images = find_images(src_prefix)
+    ref_checksums = read_manifest(ref_prefix)
+    src_checksums = read_manifest(src_prefix)
+
+    ref_images = find_images(ref_prefix) + list(ref_checksums.keys())
+    src_images = find_images(src_prefix) + list(src_checksums.keys())
     images = list(set(ref_images).union(set(src_images)))
     images.sort()
 
@@ -232,7 +248,15 @@ def main():
         src_image = src_prefix + image
         root, ext = os.path.splitext(src_image)
         delta_image = "%s.diff.png" % (root, )
-        if os.path.exists(ref_image) and os.path.exists(src_image):
+        ref_checksum = ref_checksums.get(image)
+        src_checksum = src_checksums.get(image)
+        if ref_checksum is not None and ref_checksum == src_checksum:
+            # Identical pixels -- no need to decode anything
+            comparer = None
+            match = True
+            result = 'MATCH'
+            bgcolor = '#20ff20'
+        elif os.path.exists(ref_image) and os.path.exists(src_image):
             if options.verbose:
                 sys.stdout.write('Comparing %s and %s ...' % (ref_image, src_image))
             comparer = Comparer(ref_image, src_image, options.alpha)
@@ -244,6 +268,12 @@ def main():
                 result = 'MISMATCH'
                 failures += 1
                 bgcolor = '#ff2020'
+        elif ref_checksum is not None and src_checksum is not None:
+            comparer = None
+            match = False
+            result = 'MISMATCH'
+            failures += 1
+            bgcolor = '#ff2020'
         else:
             comparer = None
             match = None
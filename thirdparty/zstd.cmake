@@ -38,10 +38,16 @@ target_include_directories(zstd_bundled PUBLIC
 target_compile_definitions(zstd_bundled PRIVATE
     NDEBUG
 
+    # Needed for ZSTD_c_nbWorkers, which the tracer's zstd output uses when
+    # TRACE_COMPRESSION asks for threads.
+    ZSTD_MULTITHREAD
+
     # Would be better to copy their logic for enabling this asm support.
     DYNAMIC_BMI2=0
 )
 
+target_link_libraries(zstd_bundled PUBLIC Threads::Threads)
+
 target_optimize(zstd_bundled)
 
 # Platform-specific compiler flags
@@ -43,6 +43,7 @@
 #include "gltrace.hpp"
 #include "os_thread.hpp"
 #include "os.hpp"
+#include "trace_writer_local.hpp"
 
 static bool sInitialized = false;
 
@@ -186,6 +187,17 @@ GLMemoryShadow::~GLMemoryShadow()
         sPages.erase(startPage + i);
     }
 
+    // Writes to buffers no draw reached yet may still be pending
+    if (isDirty) {
+        shared_context_res_ptr_t res = sharedRes.lock();
+        if (res) {
+            auto it = std::find(res->dirtyShadows.begin(), res->dirtyShadows.end(), this);
+            if (it != res->dirtyShadows.end()) {
+                res->dirtyShadows.erase(it);
+            }
+        }
+    }
+
 #ifdef _WIN32
     VirtualFree(shadowMemory, nPages * sPageSize, MEM_RELEASE);
 #else
@@ -193,7 +205,7 @@ GLMemoryShadow::~GLMemoryShadow()
 #endif
 }
 
-bool GLMemoryShadow::init(const void *data, size_t size)
+bool GLMemoryShadow::init(GLuint _buffer, const void *data, size_t size)
 {
     if (!sInitialized) {
         initializeGlobals();
@@ -229,13 +241,17 @@ bool GLMemoryShadow::init(const void *data, size_t size)
         }
     }
 
+    buffer = _buffer;
     dirtyPages.resize(divRoundUp(nPages, 32));
+    committedPages.resize(divRoundUp(nPages, 32));
 
     return true;
 }
 
 void *GLMemoryShadow::map(gltrace::Context *_ctx, void *_glMemory, GLbitfield _flags, size_t start, size_t size)
 {
+    trace::ShadowOverheadScope overheadScope;
+
     sharedRes = _ctx->sharedRes;
     glMemory = reinterpret_cast<uint8_t*>(_glMemory);
     flags = _flags;
@@ -245,6 +261,9 @@ void *GLMemoryShadow::map(gltrace::Context *_ctx, void *_glMemory, GLbitfield _f
     mappedStartPage = start / sPageSize;
     mappedEndPage = divRoundUp(start + size, sPageSize);
 
+    // GPU may have written to the buffer since the last mapping
+    std::fill(committedPages.begin(), committedPages.end(), 0);
+
     uint8_t *protectStart = shadowMemory + mappedStartPage * sPageSize;
     const size_t protectSize = (mappedEndPage - mappedStartPage) * sPageSize;
 
@@ -262,6 +281,8 @@ void *GLMemoryShadow::map(gltrace::Context *_ctx, void *_glMemory, GLbitfield _f
 
 void GLMemoryShadow::unmap(Callback callback)
 {
+    trace::ShadowOverheadScope overheadScope;
+
     if (isDirty) {
         std::unique_lock<std::mutex> lock(mutex);
         commitWrites(callback);
@@ -293,6 +314,8 @@ void GLMemoryShadow::unmap(Callback callback)
 
 void GLMemoryShadow::onAddressWrite(uintptr_t addr, size_t page)
 {
+    trace::ShadowOverheadScope overheadScope;
+
     const size_t relativePage = (addr - reinterpret_cast<uintptr_t>(shadowMemory)) / sPageSize;
     if (isPageDirty(relativePage)) {
         // It is possible if writing to the same buffer from two threads
@@ -346,13 +369,59 @@ bool GLMemoryShadow::isPageDirty(size_t relativePage)
     return dirtyPages[relativePage / 32] & (1U << (relativePage % 32));
 }
 
+void GLMemoryShadow::setGpuWritable()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    gpuWritable = true;
+    committedMemory.clear();
+    committedMemory.shrink_to_fit();
+}
+
+bool GLMemoryShadow::updateCommittedPage(size_t relativePage)
+{
+    assert(relativePage < nPages);
+
+    if (gpuWritable) {
+        return true;
+    }
+
+    if (committedMemory.empty()) {
+        committedMemory.resize(nPages * sPageSize);
+    }
+
+    const uint8_t *src = shadowMemory + relativePage * sPageSize;
+    uint8_t *dst = &committedMemory[relativePage * sPageSize];
+
+    const uint32_t committedBit = 1U << (relativePage % 32);
+    if ((committedPages[relativePage / 32] & committedBit) &&
+        memcmp(dst, src, sPageSize) == 0) {
+        return false;
+    }
+
+    memcpy(dst, src, sPageSize);
+    committedPages[relativePage / 32] |= committedBit;
+    return true;
+}
+
+bool GLMemoryShadow::clipPages(size_t startPage, size_t endPage, size_t &offset, size_t &size) const
+{
+    // Page bounds are relative to shadowMemory, while the mapping may start
+    // and end anywhere within a page
+    const size_t begin = std::max(startPage * sPageSize, mappedStart);
+    const size_t end = std::min(endPage * sPageSize, mappedStart + mappedSize);
+    if (begin >= end) {
+        return false;
+    }
+    offset = begin;
+    size = end - begin;
+    return true;
+}
+
 void GLMemoryShadow::commitWrites(Callback callback)
 {
     assert(isDirty);
 
-    uint8_t *shadowSlice = shadowMemory + mappedStartPage * sPageSize;
-    const size_t glStartOffset = mappedStart % sPageSize;
-
     /* Other thread may write to the buffers at this very moment
      * so we need to protect pages before we read from them.
      * The other thread will have to wait until we commit all writes we want.
@@ -369,19 +438,24 @@ void GLMemoryShadow::commitWrites(Callback callback)
             size_t firstDirty = i;
             while (++i < mappedEndPage && isPageDirty(i)) { }
 
-            const size_t pages = i - firstDirty;
-            if (firstDirty != mappedStartPage) {
-                const size_t shadowOffset = (firstDirty - mappedStartPage) * sPageSize;
-                const size_t glOffset = shadowOffset - glStartOffset;
-                const size_t size = std::min(glStartOffset + mappedSize - shadowOffset, sPageSize * pages);
+            size_t offset, size;
+            if (!clipPages(firstDirty, i, offset, size)) {
+                continue;
+            }
+
+            memcpy(glMemory + (offset - mappedStart), shadowMemory + offset, size);
 
-                memcpy(glMemory + glOffset, shadowSlice + shadowOffset, size);
-                callback(shadowSlice + shadowOffset, size);
-            } else {
-                const size_t size = std::min(sPageSize * pages - glStartOffset, mappedSize);
+            // Only emit the pages whose contents actually changed since they
+            // were last committed, again coalescing consecutive ones
+            for (size_t j = firstDirty; j < i; j++) {
+                if (updateCommittedPage(j)) {
+                    size_t firstChanged = j;
+                    while (++j < i && updateCommittedPage(j)) { }
 
-                memcpy(glMemory, shadowSlice + glStartOffset, size);
-                callback(shadowSlice + glStartOffset, size);
+                    if (clipPages(firstChanged, j, offset, size)) {
+                        callback(shadowMemory + offset, size);
+                    }
+                }
             }
         }
     }
@@ -400,12 +474,15 @@ void GLMemoryShadow::updateForReads()
     memProtect(protectStart, protectSize, MemProtection::READ_WRITE);
 
     memcpy(shadowMemory + mappedStart, glMemory, mappedSize);
+    std::fill(committedPages.begin(), committedPages.end(), 0);
 
     memProtect(protectStart, protectSize, MemProtection::READ_ONLY);
 }
 
 void GLMemoryShadow::commitAllWrites(gltrace::Context *_ctx, Callback callback)
 {
+    trace::ShadowOverheadScope overheadScope;
+
     if (!_ctx->sharedRes->dirtyShadows.empty()) {
         std::unique_lock<std::mutex> lock(mutex);
 
@@ -417,8 +494,71 @@ void GLMemoryShadow::commitAllWrites(gltrace::Context *_ctx, Callback callback)
     }
 }
 
+void GLMemoryShadow::commitReachableWrites(gltrace::Context *_ctx, Callback callback, unsigned reach)
+{
+    trace::ShadowOverheadScope overheadScope;
+
+    auto &dirtyShadows = _ctx->sharedRes->dirtyShadows;
+    if (dirtyShadows.empty()) {
+        return;
+    }
+
+    // Bindings are only tracked once the context is current, and legacy
+    // client arrays (glVertexPointer & co.) are not tracked at all.
+    const glfeatures::Profile &profile = _ctx->profile;
+    const GLint maxVertexAttribs = (reach & REACH_VERTICES) ? _ctx->getMaxVertexAttribs() : 0;
+    if (!_ctx->bound ||
+        (profile.desktop() && !profile.core) ||
+        (profile.es() && profile.major < 2) ||
+        maxVertexAttribs > 64) {
+        commitAllWrites(_ctx, callback);
+        return;
+    }
+
+    GLint reachable[64 + 4];
+    unsigned numReachable = 0;
+
+    if (reach & REACH_VERTICES) {
+        for (GLint index = 0; index < maxVertexAttribs; ++index) {
+            if (_ctx->isVertexAttribArrayEnabled(index)) {
+                reachable[numReachable++] = _ctx->getVertexAttribBufferBinding(index);
+            }
+        }
+    }
+    if (reach & REACH_INDICES) {
+        reachable[numReachable++] = _ctx->getBufferBinding(GL_ELEMENT_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER_BINDING);
+    }
+    if (reach & REACH_DRAW_INDIRECT) {
+        reachable[numReachable++] = _ctx->getBufferBinding(GL_DRAW_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER_BINDING);
+    }
+    if (reach & REACH_PARAMETERS) {
+        reachable[numReachable++] = _ctx->getBufferBinding(GL_PARAMETER_BUFFER, GL_PARAMETER_BUFFER_BINDING);
+    }
+    if (reach & REACH_DISPATCH_INDIRECT) {
+        reachable[numReachable++] = _ctx->getBufferBinding(GL_DISPATCH_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER_BINDING);
+    }
+
+    const auto &indirectlyBound = _ctx->sharedRes->indirectlyBoundBuffers;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto pending = dirtyShadows.begin();
+    for (GLMemoryShadow *memoryShadow : dirtyShadows) {
+        const GLint buffer = memoryShadow->buffer;
+        if (std::find(reachable, reachable + numReachable, buffer) != reachable + numReachable ||
+            indirectlyBound.count(buffer)) {
+            memoryShadow->commitWrites(callback);
+        } else {
+            *pending++ = memoryShadow;
+        }
+    }
+    dirtyShadows.erase(pending, dirtyShadows.end());
+}
+
 void GLMemoryShadow::syncAllForReads(gltrace::Context *_ctx)
 {
+    trace::ShadowOverheadScope overheadScope;
+
     if (!_ctx->sharedRes->bufferToShadowMemory.empty()) {
         std::unique_lock<std::mutex> lock(mutex);
 
@@ -45,6 +45,7 @@ private:
 
     shared_context_res_wptr_t sharedRes;
 
+    GLuint buffer = 0;
     GLbitfield flags = 0;
 
     uint8_t *glMemory = nullptr;
@@ -63,13 +64,23 @@ private:
     uint32_t pagesToDirtyOnConsecutiveWrites = 1;
     uint32_t lastDirtiedRelativePage = UINT32_MAX - 1;
 
+    // Copy of the content last committed to the trace, valid for the pages
+    // flagged in committedPages.  Pages rewritten with the same content
+    // (common with streaming ring buffers) are then not emitted again.
+    std::vector<uint8_t> committedMemory;
+    std::vector<uint32_t> committedPages;
+
+    // Whether the GPU may write to the buffer, in which case the committed
+    // copy can't be trusted and every written page is emitted.
+    bool gpuWritable = false;
+
 public:
 
     typedef void (*Callback)(const void *ptr, size_t size);
 
     ~GLMemoryShadow();
 
-    bool init(const void *data, size_t size);
+    bool init(GLuint buffer, const void *data, size_t size);
 
     void *map(gltrace::Context *_ctx, void *_glMemory, GLbitfield _flags, size_t start, size_t size);
     void unmap(Callback callback);
@@ -81,11 +92,33 @@ public:
 
     GLbitfield getMapFlags() const;
 
+    void setGpuWritable();
+
+    /**
+     * What a draw or dispatch may read, besides buffers bound to indexed
+     * targets, buffer textures, or by GPU address, which are always assumed
+     * reachable.
+     */
+    enum Reach {
+        REACH_VERTICES = 1 << 0,         /**< enabled vertex attrib arrays */
+        REACH_INDICES = 1 << 1,          /**< GL_ELEMENT_ARRAY_BUFFER */
+        REACH_DRAW_INDIRECT = 1 << 2,    /**< GL_DRAW_INDIRECT_BUFFER */
+        REACH_PARAMETERS = 1 << 3,       /**< GL_PARAMETER_BUFFER */
+        REACH_DISPATCH_INDIRECT = 1 << 4 /**< GL_DISPATCH_INDIRECT_BUFFER */
+    };
+
     static void commitAllWrites(gltrace::Context *_ctx, Callback callback);
+    /**
+     * Commit only the writes to buffers the next draw or dispatch may read,
+     * leaving the others dirty until they are.
+     */
+    static void commitReachableWrites(gltrace::Context *_ctx, Callback callback, unsigned reach);
     static void syncAllForReads(gltrace::Context *_ctx);
 
 private:
 
     void setPageDirty(size_t relativePage);
     bool isPageDirty(size_t relativePage);
+    bool updateCommittedPage(size_t relativePage);
+    bool clipPages(size_t startPage, size_t endPage, size_t &offset, size_t &size) const;
 };
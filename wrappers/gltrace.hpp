@@ -33,6 +33,8 @@
 #include "glmemshadow.hpp"
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <memory>
 
@@ -41,11 +43,32 @@ void APIENTRY _fake_glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
 
 namespace gltrace {
 
+// Buffer mapping parameters, as passed to/returned by glMap*BufferRange
+struct BufferMapping {
+    void *pointer;
+    GLbitfield access;
+    GLintptr offset;
+    GLsizeiptr length;
+};
+
 class ShareableContextResources {
 public:
-    std::map<GLint, std::unique_ptr<GLMemoryShadow>> bufferToShadowMemory;
+    // Looked up on every buffer map, unmap and flush
+    std::unordered_map<GLint, std::unique_ptr<GLMemoryShadow>> bufferToShadowMemory;
+
+    std::unordered_map<GLint, BufferMapping> bufferMappings;
 
     std::vector<GLMemoryShadow*> dirtyShadows;
+
+    // Buffers ever bound to indexed targets, buffer textures, or made
+    // resident, which any draw or dispatch may read.
+    std::unordered_set<GLint> indirectlyBoundBuffers;
+
+    // Buffers ever written by the GPU or bound where it may write to them:
+    // copy and clear destinations, pack and query buffers, shader storage,
+    // transform feedback and atomic counter bindings, buffer textures (image
+    // stores), and buffers made resident for writing.
+    std::unordered_set<GLint> gpuWritableBuffers;
 };
 
 class Context {
@@ -69,10 +92,103 @@ public:
     // the data which can be shared between shared contexts
     std::shared_ptr<ShareableContextResources> sharedRes;
 
+    /*
+     * Shadowed state.  The tracer inspects some state on every draw or buffer
+     * map, so instead of querying the driver every time, it is tracked as the
+     * application changes it.  -1 (or a missing entry) stands for unknown, in
+     * which case the driver is queried, and the answer remembered.
+     */
+    std::map<GLenum, GLint> bufferBindings;
+    GLint maxVertexAttribs = -1;
+    // Vertex array object state
+    GLint elementArrayBufferBinding = -1;
+    std::vector<GLint> vertexAttribEnabled;
+    std::vector<GLint> vertexAttribBufferBinding;
+    // Fixed function arrays, keyed by array and texture unit (0 for all but
+    // GL_TEXTURE_COORD_ARRAY)
+    std::map<std::pair<GLenum, GLint>, GLint> clientArrayEnabled;
+    std::map<std::pair<GLenum, GLint>, GLint> clientArrayBufferBinding;
+    GLint maxTextureCoords = -1;
+    GLint clientActiveTexture = -1;
+    GLint primitiveRestart = -1;
+    GLint64 primitiveRestartIndex = -1;
+    // Mode of the display list being compiled, if any.  Server state changes
+    // made while compiling with GL_COMPILE are not executed.
+    GLenum listMode = 0;
+
     Context(void) :
         profile(glfeatures::API_GL, 1, 0),
         sharedRes(std::make_shared<ShareableContextResources>())
     { }
+
+    GLint
+    getBufferBinding(GLenum target, GLenum binding);
+
+    void
+    setBufferBinding(GLenum target, GLint buffer);
+
+    void
+    invalidateBufferBinding(GLenum target);
+
+    void
+    deleteBuffers(GLsizei n, const GLuint *buffers);
+
+    void
+    setBufferGpuWritable(GLint buffer);
+
+    GLint
+    getMaxVertexAttribs(void);
+
+    bool
+    isVertexAttribArrayEnabled(GLuint index);
+
+    GLint
+    getVertexAttribBufferBinding(GLuint index);
+
+    void
+    setVertexAttribArrayEnabled(GLuint index, bool enabled);
+
+    void
+    setVertexAttribPointer(GLuint index);
+
+    GLint
+    getMaxTextureCoords(void);
+
+    bool
+    isClientArrayEnabled(GLenum array, GLint unit = 0);
+
+    GLint
+    getClientArrayBufferBinding(GLenum array, GLenum binding, GLint unit = 0);
+
+    void
+    setClientArrayEnabled(GLenum array, bool enabled);
+
+    void
+    setClientArrayEnabledIndexed(GLenum array, GLuint index, bool enabled);
+
+    void
+    setClientArrayPointer(GLenum array, GLint unit = -1);
+
+    void
+    setClientActiveTexture(GLenum texture);
+
+    void
+    invalidateVertexArray(void);
+
+    void
+    invalidateClientState(void);
+
+    bool
+    isPrimitiveRestartEnabled(void);
+
+    GLuint
+    getPrimitiveRestartIndex(void);
+
+    void *
+    getBufferMapPointer(GLint buffer);
+
+    bool
+    takeBufferMapping(GLint buffer, BufferMapping &mapping);
 };
 
 void
@@ -173,15 +173,22 @@ class GlTracer(Tracer):
             enable_name = 'GL_%s_ARRAY' % uppercase_name
             binding_name = 'GL_%s_ARRAY_BUFFER_BINDING' % uppercase_name
             print('    // %s' % function_name)
-            print('  if (%s) {' % profile_check)
-            self.array_prolog(api, uppercase_name)
-            print('    if (_glIsEnabled(%s) &&' % enable_name)
-            print('        _glGetInteger(%s) == 0) {' % binding_name)
-            self.array_cleanup(api, uppercase_name)
-            print('        return true;')
+            print('    if (%s) {' % profile_check)
+            if uppercase_name == 'TEXTURE_COORD':
+                print('        GLint max_units = _ctx->getMaxTextureCoords();')
+                print('        GLint unit = 0;')
+                print('        do {')
+                print('            if (_ctx->isClientArrayEnabled(%s, unit) &&' % enable_name)
+                print('                _ctx->getClientArrayBufferBinding(%s, %s, unit) == 0) {' % (enable_name, binding_name))
+                print('                return true;')
+                print('            }')
+                print('        } while (++unit < max_units);')
+            else:
+                print('        if (_ctx->isClientArrayEnabled(%s) &&' % enable_name)
+                print('            _ctx->getClientArrayBufferBinding(%s, %s) == 0) {' % (enable_name, binding_name))
+                print('            return true;')
+                print('        }')
             print('    }')
-            self.array_epilog(api, uppercase_name)
-            print('  }')
             print()
 
         print('    // ES1 does not support generic vertex attributes')
@@ -189,10 +196,10 @@ class GlTracer(Tracer):
         print('        return false;')
         print()
         print('    // glVertexAttribPointer')
-        print('    GLint _max_vertex_attribs = _glGetInteger(GL_MAX_VERTEX_ATTRIBS);')
+        print('    GLint _max_vertex_attribs = _ctx->getMaxVertexAttribs();')
         print('    for (GLint index = 0; index < _max_vertex_attribs; ++index) {')
-        print('        if (_glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED) &&')
-        print('            _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING) == 0) {')
+        print('        if (_ctx->isVertexAttribArrayEnabled(index) &&')
+        print('            _ctx->getVertexAttribBufferBinding(index) == 0) {')
         print('            return true;')
         print('        }')
         print('    }')
@@ -280,9 +287,8 @@ class GlTracer(Tracer):
         print()
 
         print('static GLint')
-        print('getBufferName(GLenum target) {')
-        print('    GLint bufferName = 0;')
-        print('    _glGetIntegerv(getBufferBinding(target), &bufferName);')
+        print('getBufferName(gltrace::Context *_ctx, GLenum target) {')
+        print('    GLint bufferName = _ctx->getBufferBinding(target, getBufferBinding(target));')
         print('    assert(bufferName != 0);')
         print('    return bufferName;')
         print('}')
@@ -406,14 +412,14 @@ class GlTracer(Tracer):
     def traceFunctionImplBody(self, function):
         # Defer tracing of user array pointers...
         if function.name in self.array_pointer_function_names:
-            print('    GLint _array_buffer = _glGetInteger(GL_ARRAY_BUFFER_BINDING);')
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    GLint _array_buffer = _ctx->getBufferBinding(GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING);')
             print('    if (!_array_buffer) {')
             print('        static bool warned = false;')
             print('        if (!warned) {')
             print('            warned = true;')
             print('            os::log("apitrace: warning: %s: call will be faked due to pointer to user memory (https://git.io/JOMRv)\\n", __FUNCTION__);')
             print('        }')
-            print('        gltrace::Context *_ctx = gltrace::getContext();')
             print('        _ctx->user_arrays = true;')
             if function.name == "glVertexAttribPointerNV":
                 print(r'        os::log("apitrace: warning: %s: user memory arrays with NV_vertex_program longer supported\n", __FUNCTION__);')
@@ -483,7 +489,15 @@ class GlTracer(Tracer):
             functionRadical = mo.group('radical')
             print('    gltrace::Context *_ctx = gltrace::getContext();')
 
-            print('    GLMemoryShadow::commitAllWrites(_ctx, trace::fakeMemcpy);')
+            # Only commit the coherent buffers this draw may source from
+            reach = ['GLMemoryShadow::REACH_VERTICES']
+            if 'Elements' in functionRadical:
+                reach.append('GLMemoryShadow::REACH_INDICES')
+            if 'Indirect' in function.name:
+                reach.append('GLMemoryShadow::REACH_DRAW_INDIRECT')
+            if 'IndirectCount' in function.name:
+                reach.append('GLMemoryShadow::REACH_PARAMETERS')
+            print('    GLMemoryShadow::commitReachableWrites(_ctx, trace::fakeMemcpy, %s);' % ' | '.join(reach))
 
             print('    if (_need_user_arrays(_ctx)) {')
             if 'Indirect' in function.name:
@@ -519,6 +533,15 @@ class GlTracer(Tracer):
 
         if function.name.startswith("glDispatchCompute"):
             print('    gltrace::Context *_ctx = gltrace::getContext();')
+            if function.name.startswith("glDispatchComputeIndirect"):
+                print('    GLMemoryShadow::commitReachableWrites(_ctx, trace::fakeMemcpy, GLMemoryShadow::REACH_DISPATCH_INDIRECT);')
+            else:
+                print('    GLMemoryShadow::commitReachableWrites(_ctx, trace::fakeMemcpy, 0);')
+
+        # Buffer to buffer copies and readbacks may read any coherent buffer
+        if function.name in ('glCopyBufferSubData', 'glCopyNamedBufferSubData', 'glNamedCopyBufferSubDataEXT',
+                             'glGetBufferSubData', 'glGetBufferSubDataARB', 'glGetNamedBufferSubData', 'glGetNamedBufferSubDataEXT'):
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
             print('    GLMemoryShadow::commitAllWrites(_ctx, trace::fakeMemcpy);')
 
         if function.name == 'glLockArraysEXT':
@@ -554,11 +577,18 @@ class GlTracer(Tracer):
                 suffix = 'ARB'
             else:
                 suffix = ''
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    GLint _buffer = _ctx->getBufferBinding(target, getBufferBinding(target));')
+            print('    gltrace::BufferMapping _mapping;')
+            print('    bool _mapping_known = _ctx->takeBufferMapping(_buffer, _mapping);')
             print('    GLint access_flags = 0;')
             print('    GLint access = 0;')
             print('    bool flush;')
             print('    // GLES3 does not have GL_BUFFER_ACCESS;')
-            print('    if (_checkBufferMapRange) {')
+            print('    if (_mapping_known) {')
+            print('        access_flags = (GLint)_mapping.access;')
+            print('        flush = (access_flags & GL_MAP_WRITE_BIT) && !(access_flags & (GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_PERSISTENT_BIT));')
+            print('    } else if (_checkBufferMapRange) {')
             print('        _glGetBufferParameteriv%s(target, GL_BUFFER_ACCESS_FLAGS, &access_flags);' % suffix)
             print('        flush = (access_flags & GL_MAP_WRITE_BIT) && !(access_flags & (GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_PERSISTENT_BIT));')
             print('    } else {')
@@ -566,9 +596,7 @@ class GlTracer(Tracer):
             print('        flush = access != GL_READ_ONLY;')
             print('    }')
             print('    if (gltrace::is_coherent_write_map(access_flags)) {')
-            print('        gltrace::Context *_ctx = gltrace::getContext();')
-            print('        GLint buffer = getBufferName(target);')
-            print('        auto it = _ctx->sharedRes->bufferToShadowMemory.find(buffer);')
+            print('        auto it = _ctx->sharedRes->bufferToShadowMemory.find(_buffer);')
             print('        if (it != _ctx->sharedRes->bufferToShadowMemory.end()) {')
             print('            it->second->unmap(trace::fakeMemcpy);')
             print('        } else {')
@@ -578,10 +606,16 @@ class GlTracer(Tracer):
             print('    }')
             print('    if (flush) {')
             print('        GLvoid *map = NULL;')
-            print('        _glGetBufferPointerv%s(target, GL_BUFFER_MAP_POINTER, &map);'  % suffix)
+            print('        if (_mapping_known) {')
+            print('            map = _mapping.pointer;')
+            print('        } else {')
+            print('            _glGetBufferPointerv%s(target, GL_BUFFER_MAP_POINTER, &map);'  % suffix)
+            print('        }')
             print('        if (map) {')
             print('            GLint length = -1;')
-            print('            if (_checkBufferMapRange) {')
+            print('            if (_mapping_known) {')
+            print('                length = (GLint)_mapping.length;')
+            print('            } else if (_checkBufferMapRange) {')
             print('                _glGetBufferParameteriv%s(target, GL_BUFFER_MAP_LENGTH, &length);' % suffix)
             print('                if (length == -1) {')
             print('                    // Mesa drivers refuse GL_BUFFER_MAP_LENGTH without GL 3.0 up-to')
@@ -636,10 +670,16 @@ class GlTracer(Tracer):
             print('        }')
             print('    }')
         if function.name == 'glUnmapNamedBuffer':
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    gltrace::BufferMapping _mapping;')
+            print('    bool _mapping_known = _ctx->takeBufferMapping(buffer, _mapping);')
             print('    GLint access_flags = 0;')
-            print('    _glGetNamedBufferParameteriv(buffer, GL_BUFFER_ACCESS_FLAGS, &access_flags);')
+            print('    if (_mapping_known) {')
+            print('        access_flags = (GLint)_mapping.access;')
+            print('    } else {')
+            print('        _glGetNamedBufferParameteriv(buffer, GL_BUFFER_ACCESS_FLAGS, &access_flags);')
+            print('    }')
             print('    if (gltrace::is_coherent_write_map(access_flags)) {')
-            print('        gltrace::Context *_ctx = gltrace::getContext();')
             print('        auto it = _ctx->sharedRes->bufferToShadowMemory.find(buffer);')
             print('        if (it != _ctx->sharedRes->bufferToShadowMemory.end()) {')
             print('            it->second->unmap(trace::fakeMemcpy);')
@@ -649,18 +689,29 @@ class GlTracer(Tracer):
             print('    } else if ((access_flags & GL_MAP_WRITE_BIT) &&')
             print('               !(access_flags & (GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_PERSISTENT_BIT))) {')
             print('        GLvoid *map = NULL;')
-            print('        _glGetNamedBufferPointerv(buffer, GL_BUFFER_MAP_POINTER, &map);')
             print('        GLint length = 0;')
-            print('        _glGetNamedBufferParameteriv(buffer, GL_BUFFER_MAP_LENGTH, &length);')
+            print('        if (_mapping_known) {')
+            print('            map = _mapping.pointer;')
+            print('            length = (GLint)_mapping.length;')
+            print('        } else {')
+            print('            _glGetNamedBufferPointerv(buffer, GL_BUFFER_MAP_POINTER, &map);')
+            print('            _glGetNamedBufferParameteriv(buffer, GL_BUFFER_MAP_LENGTH, &length);')
+            print('        }')
             print('        if (map && length > 0) {')
             self.emit_memcpy('map', 'length')
             print('        }')
             print('    }')
         if function.name == 'glUnmapNamedBufferEXT':
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    gltrace::BufferMapping _mapping;')
+            print('    bool _mapping_known = _ctx->takeBufferMapping(buffer, _mapping);')
             print('    GLint access_flags = 0;')
-            print('    _glGetNamedBufferParameterivEXT(buffer, GL_BUFFER_ACCESS_FLAGS, &access_flags);')
+            print('    if (_mapping_known) {')
+            print('        access_flags = (GLint)_mapping.access;')
+            print('    } else {')
+            print('        _glGetNamedBufferParameterivEXT(buffer, GL_BUFFER_ACCESS_FLAGS, &access_flags);')
+            print('    }')
             print('    if (gltrace::is_coherent_write_map(access_flags)) {')
-            print('        gltrace::Context *_ctx = gltrace::getContext();')
             print('        auto it = _ctx->sharedRes->bufferToShadowMemory.find(buffer);')
             print('        if (it != _ctx->sharedRes->bufferToShadowMemory.end()) {')
             print('            it->second->unmap(trace::fakeMemcpy);')
@@ -670,22 +721,33 @@ class GlTracer(Tracer):
             print('    } else if ((access_flags & GL_MAP_WRITE_BIT) &&')
             print('               !(access_flags & (GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_PERSISTENT_BIT))) {')
             print('        GLvoid *map = NULL;')
-            print('        _glGetNamedBufferPointervEXT(buffer, GL_BUFFER_MAP_POINTER, &map);')
             print('        GLint length = 0;')
-            print('        _glGetNamedBufferParameterivEXT(buffer, GL_BUFFER_MAP_LENGTH, &length);')
+            print('        if (_mapping_known) {')
+            print('            map = _mapping.pointer;')
+            print('            length = (GLint)_mapping.length;')
+            print('        } else {')
+            print('            _glGetNamedBufferPointervEXT(buffer, GL_BUFFER_MAP_POINTER, &map);')
+            print('            _glGetNamedBufferParameterivEXT(buffer, GL_BUFFER_MAP_LENGTH, &length);')
+            print('        }')
             print('        if (map && length > 0) {')
             self.emit_memcpy('map', 'length')
             print('        }')
             print('    }')
         if function.name == 'glFlushMappedBufferRange':
-            print('    GLvoid *map = NULL;')
-            print('    _glGetBufferPointerv(target, GL_BUFFER_MAP_POINTER, &map);')
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    GLvoid *map = _ctx->getBufferMapPointer(_ctx->getBufferBinding(target, getBufferBinding(target)));')
+            print('    if (!map) {')
+            print('        _glGetBufferPointerv(target, GL_BUFFER_MAP_POINTER, &map);')
+            print('    }')
             print('    if (map && length > 0) {')
             self.emit_memcpy('(const char *)map + offset', 'length')
             print('    }')
         if function.name == 'glFlushMappedBufferRangeEXT':
-            print('    GLvoid *map = NULL;')
-            print('    _glGetBufferPointervOES(target, GL_BUFFER_MAP_POINTER_OES, &map);')
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    GLvoid *map = _ctx->getBufferMapPointer(_ctx->getBufferBinding(target, getBufferBinding(target)));')
+            print('    if (!map) {')
+            print('        _glGetBufferPointervOES(target, GL_BUFFER_MAP_POINTER_OES, &map);')
+            print('    }')
             print('    if (map && length > 0) {')
             self.emit_memcpy('(const char *)map + offset', 'length')
             print('    }')
@@ -696,14 +758,20 @@ class GlTracer(Tracer):
             self.emit_memcpy('(const char *)map + offset', 'size')
             print('    }')
         if function.name == 'glFlushMappedNamedBufferRange':
-            print('    GLvoid *map = NULL;')
-            print('    _glGetNamedBufferPointerv(buffer, GL_BUFFER_MAP_POINTER, &map);')
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    GLvoid *map = _ctx->getBufferMapPointer(buffer);')
+            print('    if (!map) {')
+            print('        _glGetNamedBufferPointerv(buffer, GL_BUFFER_MAP_POINTER, &map);')
+            print('    }')
             print('    if (map && length > 0) {')
             self.emit_memcpy('(const char *)map + offset', 'length')
             print('    }')
         if function.name == 'glFlushMappedNamedBufferRangeEXT':
-            print('    GLvoid *map = NULL;')
-            print('    _glGetNamedBufferPointervEXT(buffer, GL_BUFFER_MAP_POINTER, &map);')
+            print('    gltrace::Context *_ctx = gltrace::getContext();')
+            print('    GLvoid *map = _ctx->getBufferMapPointer(buffer);')
+            print('    if (!map) {')
+            print('        _glGetNamedBufferPointervEXT(buffer, GL_BUFFER_MAP_POINTER, &map);')
+            print('    }')
             print('    if (map && length > 0) {')
             self.emit_memcpy('(const char *)map + offset', 'length')
             print('    }')
@@ -723,10 +791,13 @@ class GlTracer(Tracer):
             print(r'    if (gltrace::is_coherent_write_map(flags)) {')
             print(r'        gltrace::Context *_ctx = gltrace::getContext();')
             if function.name in ('glBufferStorage', 'glBufferStorageEXT'):
-                print(r'        GLint buffer = getBufferName(target);')
+                print(r'        GLint buffer = getBufferName(_ctx, target);')
             print(r'        auto memoryShadow = std::make_unique<GLMemoryShadow>();')
-            print(r'        const bool success = memoryShadow->init(data, size);')
+            print(r'        const bool success = memoryShadow->init(buffer, data, size);')
             print(r'        if (success) {')
+            print(r'            if (_ctx->sharedRes->gpuWritableBuffers.count(buffer)) {')
+            print(r'                memoryShadow->setGpuWritable();')
+            print(r'            }')
             print(r'            _ctx->sharedRes->bufferToShadowMemory.insert_or_assign(buffer, std::move(memoryShadow));')
             print(r'        } else {')
             print(r'            os::log("apitrace: error: %s: cannot create memory shadow\n", __FUNCTION__);')
@@ -920,11 +991,13 @@ class GlTracer(Tracer):
 
         Tracer.doInvokeFunction(self, function)
 
+        self.updateShadowedState(function)
+
         if function.name in ('glMapBufferRange', 'glMapBufferRangeEXT', 'glMapNamedBufferRange', 'glMapNamedBufferRangeEXT'):
             print(r'    if (gltrace::is_coherent_write_map(access)) {')
             print(r'        gltrace::Context *_ctx = gltrace::getContext();')
             if function.name in ('glMapBufferRange', 'glMapBufferRangeEXT'):
-                print(r'        GLint buffer = getBufferName(target);')
+                print(r'        GLint buffer = getBufferName(_ctx, target);')
             print(r'        auto it = _ctx->sharedRes->bufferToShadowMemory.find(buffer);')
             print(r'        if (it != _ctx->sharedRes->bufferToShadowMemory.end()) {')
             print(r'            _result = it->second->map(_ctx, _result, access, offset, length);')
@@ -964,6 +1037,234 @@ class GlTracer(Tracer):
             print(r'        *length = 0;')
             print(r'    }')
 
+    # Regular expression for the names of the functions that modify vertex
+    # array object state in ways not worth tracking precisely.
+    vertex_array_function_regex = re.compile(r'^gl(' + r'|'.join([
+        r'BindVertexArray',
+        r'DeleteVertexArrays',
+        r'BindVertexBuffers?',
+        r'VertexAttribBinding',
+        r'VertexAttribI?L?Format',
+        r'VertexBindingDivisor',
+        r'VertexArray[A-Z][a-zA-Z]*',
+        r'(Enable|Disable)VertexArray(Attrib)?',
+        r'VertexAttribPointerNV',
+        r'InterleavedArrays',
+        r'[A-Za-z]+PointerListIBM',
+    ]) + r')[0-9A-Z]*$')
+
+    # Regular expression for the names of the fixed function array pointer
+    # functions, capturing the array name.
+    client_array_pointer_function_regex = re.compile(r'^gl(Vertex|Normal|Color|Index|TexCoord|EdgeFlag|FogCoord|SecondaryColor)Pointer(EXT|OES)?$')
+
+    def updateShadowedState(self, function):
+        # Keep gltrace::Context's shadow of the state the tracer itself
+        # inspects in sync with the application's changes.
+        if function.name in ('glBindBuffer', 'glBindBufferARB'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setBufferBinding(target, buffer);')
+            print(r'    }')
+        if function.name in ('glBindBufferBase', 'glBindBufferBaseEXT', 'glBindBufferBaseNV',
+                             'glBindBufferRange', 'glBindBufferRangeEXT', 'glBindBufferRangeNV'):
+            # Also changes the generic binding point
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setBufferBinding(target, buffer);')
+            print(r'    }')
+        if function.name in ('glBindBuffersBase', 'glBindBuffersRange'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->invalidateBufferBinding(target);')
+            print(r'        for (GLsizei _i = 0; buffers && _i < count; ++_i) {')
+            print(r'            _ctx->sharedRes->indirectlyBoundBuffers.insert(buffers[_i]);')
+            print(r'        }')
+            print(r'    }')
+
+        # Buffers shaders may read through indexed bindings, buffer textures,
+        # or GPU addresses are not tracked precisely; once seen, they are
+        # committed on every draw and dispatch.
+        if function.name in ('glBindBufferBase', 'glBindBufferBaseEXT', 'glBindBufferBaseNV',
+                             'glBindBufferRange', 'glBindBufferRangeEXT', 'glBindBufferRangeNV',
+                             'glTexBuffer', 'glTexBufferARB', 'glTexBufferEXT', 'glTexBufferOES',
+                             'glTexBufferRange', 'glTexBufferRangeEXT', 'glTexBufferRangeOES',
+                             'glTextureBuffer', 'glTextureBufferEXT',
+                             'glTextureBufferRange', 'glTextureBufferRangeEXT',
+                             'glMakeBufferResidentNV', 'glMakeNamedBufferResidentNV',
+                             'glGetBufferParameterui64vNV', 'glGetNamedBufferParameterui64vNV'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            if function.name in ('glMakeBufferResidentNV', 'glGetBufferParameterui64vNV'):
+                print(r'        GLint _buffer = getBufferName(_ctx, target);')
+            else:
+                print(r'        GLint _buffer = buffer;')
+            print(r'        if (_buffer) {')
+            print(r'            _ctx->sharedRes->indirectlyBoundBuffers.insert(_buffer);')
+            print(r'        }')
+            print(r'    }')
+
+        # Buffers the GPU may write to can't have their coherent mappings
+        # deduplicated against what was last committed.
+        if function.name in ('glBindBuffer', 'glBindBufferARB'):
+            print(r'    if (target == GL_PIXEL_PACK_BUFFER || target == GL_QUERY_BUFFER) {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setBufferGpuWritable(buffer);')
+            print(r'    }')
+        if function.name in ('glBindBufferBase', 'glBindBufferBaseEXT', 'glBindBufferBaseNV',
+                             'glBindBufferRange', 'glBindBufferRangeEXT', 'glBindBufferRangeNV',
+                             'glBindBuffersBase', 'glBindBuffersRange'):
+            print(r'    if (target == GL_SHADER_STORAGE_BUFFER ||')
+            print(r'        target == GL_TRANSFORM_FEEDBACK_BUFFER ||')
+            print(r'        target == GL_ATOMIC_COUNTER_BUFFER) {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            if function.name.startswith('glBindBuffers'):
+                print(r'        for (GLsizei _i = 0; buffers && _i < count; ++_i) {')
+                print(r'            _ctx->setBufferGpuWritable(buffers[_i]);')
+                print(r'        }')
+            else:
+                print(r'        _ctx->setBufferGpuWritable(buffer);')
+            print(r'    }')
+        if function.name in ('glTransformFeedbackBufferBase', 'glTransformFeedbackBufferRange',
+                             'glBindBufferOffsetEXT', 'glBindBufferOffsetNV',
+                             'glTexBuffer', 'glTexBufferARB', 'glTexBufferEXT', 'glTexBufferOES',
+                             'glTexBufferRange', 'glTexBufferRangeEXT', 'glTexBufferRangeOES',
+                             'glTextureBuffer', 'glTextureBufferEXT',
+                             'glTextureBufferRange', 'glTextureBufferRangeEXT',
+                             'glClearNamedBufferData', 'glClearNamedBufferSubData',
+                             'glClearNamedBufferDataEXT', 'glClearNamedBufferSubDataEXT'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setBufferGpuWritable(buffer);')
+            print(r'    }')
+        if function.name in ('glCopyNamedBufferSubData', 'glNamedCopyBufferSubDataEXT'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setBufferGpuWritable(writeBuffer);')
+            print(r'    }')
+        if function.name in ('glCopyBufferSubData', 'glClearBufferData', 'glClearBufferSubData'):
+            _target = 'writeTarget' if function.name == 'glCopyBufferSubData' else 'target'
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setBufferGpuWritable(_ctx->getBufferBinding(%s, getBufferBinding(%s)));' % (_target, _target))
+            print(r'    }')
+        if function.name in ('glMakeBufferResidentNV', 'glMakeNamedBufferResidentNV'):
+            print(r'    if (access != GL_READ_ONLY) {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            if function.name == 'glMakeBufferResidentNV':
+                print(r'        _ctx->setBufferGpuWritable(getBufferName(_ctx, target));')
+            else:
+                print(r'        _ctx->setBufferGpuWritable(buffer);')
+            print(r'    }')
+
+        if function.name in ('glDeleteBuffers', 'glDeleteBuffersARB'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->deleteBuffers(n, buffers);')
+            print(r'    }')
+        if function.name in ('glEnableVertexAttribArray', 'glEnableVertexAttribArrayARB',
+                             'glDisableVertexAttribArray', 'glDisableVertexAttribArrayARB'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setVertexAttribArrayEnabled(index, %s);' % ('true' if function.name.startswith('glEnable') else 'false'))
+            print(r'    }')
+        if function.name in ('glVertexAttribPointer', 'glVertexAttribPointerARB',
+                             'glVertexAttribIPointer', 'glVertexAttribIPointerEXT',
+                             'glVertexAttribLPointer', 'glVertexAttribLPointerEXT'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setVertexAttribPointer(index);')
+            print(r'    }')
+        if function.name in ('glEnableClientState', 'glDisableClientState'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setClientArrayEnabled(array, %s);' % ('true' if function.name.startswith('glEnable') else 'false'))
+            print(r'    }')
+        if function.name in ('glEnableClientStateIndexedEXT', 'glEnableClientStateiEXT',
+                             'glDisableClientStateIndexedEXT', 'glDisableClientStateiEXT'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setClientArrayEnabledIndexed(array, index, %s);' % ('true' if function.name.startswith('glEnable') else 'false'))
+            print(r'    }')
+        if function.name in ('glClientActiveTexture', 'glClientActiveTextureARB'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setClientActiveTexture(texture);')
+            print(r'    }')
+        mo = self.client_array_pointer_function_regex.match(function.name)
+        if mo:
+            uppercase_name = dict(self.arrays)[mo.group(1)]
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setClientArrayPointer(GL_%s_ARRAY);' % uppercase_name)
+            print(r'    }')
+        if function.name == 'glMultiTexCoordPointerEXT':
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->setClientArrayPointer(GL_TEXTURE_COORD_ARRAY, texunit - GL_TEXTURE0);')
+            print(r'    }')
+        if self.vertex_array_function_regex.match(function.name):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->invalidateVertexArray();')
+            print(r'    }')
+        if function.name in ('glPopClientAttrib', 'glClientAttribDefaultEXT', 'glPushClientAttribDefaultEXT'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->invalidateClientState();')
+            print(r'    }')
+        if function.name == 'glNewList':
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->listMode = mode;')
+            print(r'    }')
+        if function.name == 'glEndList':
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->listMode = 0;')
+            print(r'    }')
+        if function.name in ('glEnable', 'glDisable'):
+            print(r'    if (cap == GL_PRIMITIVE_RESTART) {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        if (_ctx->listMode != GL_COMPILE) {')
+            print(r'            _ctx->primitiveRestart = %s;' % ('1' if function.name == 'glEnable' else '0'))
+            print(r'        }')
+            print(r'    }')
+        if function.name == 'glPrimitiveRestartIndex':
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        if (_ctx->listMode != GL_COMPILE) {')
+            print(r'            _ctx->primitiveRestartIndex = index;')
+            print(r'        }')
+            print(r'    }')
+        if function.name in ('glPopAttrib', 'glCallList', 'glCallLists'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->primitiveRestart = -1;')
+            print(r'        _ctx->primitiveRestartIndex = -1;')
+            print(r'    }')
+
+        # Remember the mapping parameters, so they need not be queried back on
+        # flush/unmap
+        if function.name in ('glMapBufferRange', 'glMapBufferRangeEXT', 'glMapNamedBufferRange', 'glMapNamedBufferRangeEXT'):
+            print(r'    if (_result) {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            if function.name in ('glMapBufferRange', 'glMapBufferRangeEXT'):
+                print(r'        GLint _buffer = getBufferName(_ctx, target);')
+            else:
+                print(r'        GLint _buffer = buffer;')
+            print(r'        _ctx->sharedRes->bufferMappings[_buffer] = {_result, access, offset, length};')
+            print(r'    }')
+        if function.name in ('glMapBuffer', 'glMapBufferARB', 'glMapBufferOES'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->sharedRes->bufferMappings.erase(_ctx->getBufferBinding(target, getBufferBinding(target)));')
+            print(r'    }')
+        if function.name in ('glMapNamedBuffer', 'glMapNamedBufferEXT'):
+            print(r'    {')
+            print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+            print(r'        _ctx->sharedRes->bufferMappings.erase(buffer);')
+            print(r'    }')
+
     def wrapRet(self, function, instance):
         Tracer.wrapRet(self, function, instance)
 
@@ -1010,7 +1311,7 @@ class GlTracer(Tracer):
             print('            trace::localWriter.writePointer((uintptr_t)%s);' % arg.name)
             print('        } else {')
             if self.compressed_image_function_regex.match(function.name):
-                print('            %s;' % arg.type.size.format('[](const void* data, GLsizei size){ trace::localWriter.writeBlob(data, size); }'))
+                print('            %s;' % arg.type.size.format('trace::localWriter'))
             else:
                 Tracer.serializeArgValue(self, function, arg)
             print('        }')
@@ -1090,7 +1391,7 @@ class GlTracer(Tracer):
         print()
 
         # Temporarily unbind the array buffer
-        print('    GLint _array_buffer = _glGetInteger(GL_ARRAY_BUFFER_BINDING);')
+        print('    GLint _array_buffer = _ctx->getBufferBinding(GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING);')
         print('    if (_array_buffer) {')
         print('        _fake_glBindBuffer(GL_ARRAY_BUFFER, 0);')
         print('    }')
@@ -1166,13 +1467,10 @@ class GlTracer(Tracer):
         function = api.getFunctionByName(function_name)
 
         print('    // %s' % function.prototype())
-        print('    GLint _max_vertex_attribs = _glGetInteger(GL_MAX_VERTEX_ATTRIBS);')
+        print('    GLint _max_vertex_attribs = _ctx->getMaxVertexAttribs();')
         print('    for (GLint index = 0; index < _max_vertex_attribs; ++index) {')
-        print('        GLint _enabled = 0;')
-        print('        _glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &_enabled);')
-        print('        if (_enabled) {')
-        print('            GLint _binding = 0;')
-        print('            _glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &_binding);')
+        print('        if (_ctx->isVertexAttribArrayEnabled(index)) {')
+        print('            GLint _binding = _ctx->getVertexAttribBufferBinding(index);')
         print('            if (!_binding) {')
 
         print('                GLint divisor = 0;')
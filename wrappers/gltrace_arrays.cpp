@@ -63,7 +63,7 @@ _glDraw_count(gltrace::Context *ctx, const DrawElementsParams &params)
         return 0;
     }
 
-    GLint element_array_buffer = _element_array_buffer_binding();
+    GLint element_array_buffer = ctx->getBufferBinding(GL_ELEMENT_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER_BINDING);
     if (element_array_buffer) {
         // Read indices from index buffer object
         if (ctx->profile.es()) {
@@ -89,12 +89,12 @@ _glDraw_count(gltrace::Context *ctx, const DrawElementsParams &params)
 
     GLuint maxindex = 0;
 
-    GLboolean restart_enabled = GL_FALSE;
+    bool restart_enabled = false;
     GLuint restart_index = 0;
     if (ctx->features.primitive_restart) {
-        _glIsEnabled(GL_PRIMITIVE_RESTART);
+        restart_enabled = ctx->isPrimitiveRestartEnabled();
         if (restart_enabled) {
-            restart_index = (GLuint)_glGetInteger(GL_PRIMITIVE_RESTART_INDEX);
+            restart_index = ctx->getPrimitiveRestartIndex();
         }
     }
 
@@ -27,10 +27,11 @@
 
 #include <assert.h>
 
-#include <map>
+#include <atomic>
 #include <memory>
 
 #include <os_thread.hpp>
+#include <sharded_map.hpp>
 #include <glproc.hpp>
 #include <gltrace.hpp>
 #include <os.hpp>
@@ -38,8 +39,12 @@
 namespace gltrace {
 
 typedef std::shared_ptr<Context> context_ptr_t;
-static std::map<uintptr_t, context_ptr_t> context_map;
-static std::recursive_mutex context_map_mutex;
+
+/*
+ * Contexts are looked up on every make-current, often from many threads at
+ * once, so they are kept in a sharded map rather than behind a single lock.
+ */
+static ShardedMap<uintptr_t, context_ptr_t> context_map;
 
 class ThreadState {
 public:
@@ -74,10 +79,11 @@ static void _retainContext(context_ptr_t ctx)
 
 void retainContext(uintptr_t context_id)
 {
-    context_map_mutex.lock();
-    if (context_map.find(context_id) != context_map.end())
-        _retainContext(context_map[context_id]);
-    context_map_mutex.unlock();
+    context_map.withShard(context_id, [&] (std::unordered_map<uintptr_t, context_ptr_t> &map) {
+        auto it = map.find(context_id);
+        if (it != map.end())
+            _retainContext(it->second);
+    });
 }
 
 static bool _releaseContext(context_ptr_t ctx)
@@ -92,52 +98,48 @@ static bool _releaseContext(context_ptr_t ctx)
  */
 bool releaseContext(uintptr_t context_id)
 {
-    bool res = false;
-
-    context_map_mutex.lock();
-    /*
-     * This can potentially called (from glX) with an invalid context_id,
-     * so don't assert on it being valid.
-     */
-    if (context_map.find(context_id) != context_map.end()) {
-        res = _releaseContext(context_map[context_id]);
+    return context_map.withShard(context_id, [&] (std::unordered_map<uintptr_t, context_ptr_t> &map) {
+        /*
+         * This can potentially called (from glX) with an invalid context_id,
+         * so don't assert on it being valid.
+         */
+        auto it = map.find(context_id);
+        if (it == map.end())
+            return false;
+        bool res = _releaseContext(it->second);
         if (res)
-            context_map.erase(context_id);
-    }
-    context_map_mutex.unlock();
-
-    return res;
+            map.erase(it);
+        return res;
+    });
 }
 
-static bool
-contextCreated = false;
+static std::atomic<bool>
+contextCreated(false);
 
 void createContext(uintptr_t context_id, uintptr_t shared_context_id)
 {
+    context_ptr_t ctx;
+
     // wglCreateContextAttribsARB causes internal calls to wglCreateContext to be
     // traced, causing context to be defined twice.
-    if (context_map.find(context_id) != context_map.end()) {
+    if (context_map.find(context_id, ctx)) {
         return;
     }
 
     contextCreated = true;
 
-    context_ptr_t ctx(new Context);
-
-    context_map_mutex.lock();
+    ctx = std::make_shared<Context>();
 
     if (shared_context_id) {
-        auto shredIt = context_map.find(shared_context_id);
-        if (shredIt != context_map.end())
-            ctx->sharedRes = (*shredIt).second->sharedRes;
+        context_ptr_t sharedCtx;
+        if (context_map.find(shared_context_id, sharedCtx))
+            ctx->sharedRes = sharedCtx->sharedRes;
         else
             os::log("apitrace: error: %s: shared context wasn't found\n", __FUNCTION__);
     }
 
     _retainContext(ctx);
-    context_map[context_id] = ctx;
-
-    context_map_mutex.unlock();
+    context_map.insert(context_id, ctx);
 }
 
 void setContext(uintptr_t context_id)
@@ -145,12 +147,9 @@ void setContext(uintptr_t context_id)
     ThreadState *ts = get_ts();
     context_ptr_t ctx;
 
-    context_map_mutex.lock();
-
-    assert(context_map.find(context_id) != context_map.end());
-    ctx = context_map[context_id];
-
-    context_map_mutex.unlock();
+    bool found = context_map.find(context_id, ctx);
+    assert(found);
+    (void)found;
 
     ts->current_context = ctx;
 
@@ -208,4 +207,362 @@ Context *getContext(void)
     return get_ts()->current_context.get();
 }
 
+
+
+/*
+ * Shadowed state.
+ *
+ * Nothing is remembered for the per-thread dummy contexts, as there is no
+ * telling which context the application actually has current.
+ */
+
+static inline GLint
+_getInteger(GLenum pname)
+{
+    GLint param = 0;
+    _glGetIntegerv(pname, &param);
+    return param;
+}
+
+static inline GLint
+_getVertexAttribInteger(GLuint index, GLenum pname)
+{
+    GLint param = 0;
+    _glGetVertexAttribiv(index, pname, &param);
+    return param;
+}
+
+GLint
+Context::getBufferBinding(GLenum target, GLenum binding)
+{
+    if (!bound) {
+        return _getInteger(binding);
+    }
+
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        if (elementArrayBufferBinding < 0) {
+            elementArrayBufferBinding = _getInteger(binding);
+        }
+        return elementArrayBufferBinding;
+    }
+
+    auto it = bufferBindings.find(target);
+    if (it != bufferBindings.end()) {
+        return it->second;
+    }
+
+    GLint buffer = _getInteger(binding);
+    bufferBindings[target] = buffer;
+    return buffer;
+}
+
+void
+Context::setBufferBinding(GLenum target, GLint buffer)
+{
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        elementArrayBufferBinding = buffer;
+    } else {
+        bufferBindings[target] = buffer;
+    }
+}
+
+void
+Context::invalidateBufferBinding(GLenum target)
+{
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        elementArrayBufferBinding = -1;
+    } else {
+        bufferBindings.erase(target);
+    }
+}
+
+void
+Context::deleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    if (!buffers) {
+        return;
+    }
+
+    // Deleted buffers are implicitly unbound from the current context
+    for (GLsizei i = 0; i < n; ++i) {
+        GLint buffer = buffers[i];
+        if (!buffer) {
+            continue;
+        }
+        for (auto & kv : bufferBindings) {
+            if (kv.second == buffer) {
+                kv.second = 0;
+            }
+        }
+        if (elementArrayBufferBinding == buffer) {
+            elementArrayBufferBinding = 0;
+        }
+        for (auto & binding : vertexAttribBufferBinding) {
+            if (binding == buffer) {
+                binding = 0;
+            }
+        }
+        for (auto & kv : clientArrayBufferBinding) {
+            if (kv.second == buffer) {
+                kv.second = 0;
+            }
+        }
+        sharedRes->bufferMappings.erase(buffer);
+    }
+}
+
+void
+Context::setBufferGpuWritable(GLint buffer)
+{
+    if (!buffer || !sharedRes->gpuWritableBuffers.insert(buffer).second) {
+        return;
+    }
+
+    // Coherent shadows must then emit rewritten pages even when they match
+    // what was last committed, as the GPU may have changed them meanwhile
+    auto it = sharedRes->bufferToShadowMemory.find(buffer);
+    if (it != sharedRes->bufferToShadowMemory.end()) {
+        it->second->setGpuWritable();
+    }
+}
+
+GLint
+Context::getMaxVertexAttribs(void)
+{
+    if (!bound) {
+        return _getInteger(GL_MAX_VERTEX_ATTRIBS);
+    }
+    if (maxVertexAttribs < 0) {
+        maxVertexAttribs = _getInteger(GL_MAX_VERTEX_ATTRIBS);
+    }
+    return maxVertexAttribs;
+}
+
+bool
+Context::isVertexAttribArrayEnabled(GLuint index)
+{
+    if (!bound) {
+        return _getVertexAttribInteger(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED) != 0;
+    }
+    if (index >= vertexAttribEnabled.size()) {
+        vertexAttribEnabled.resize(index + 1, -1);
+    }
+    GLint &enabled = vertexAttribEnabled[index];
+    if (enabled < 0) {
+        enabled = _getVertexAttribInteger(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED) != 0;
+    }
+    return enabled;
+}
+
+GLint
+Context::getVertexAttribBufferBinding(GLuint index)
+{
+    if (!bound) {
+        return _getVertexAttribInteger(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING);
+    }
+    if (index >= vertexAttribBufferBinding.size()) {
+        vertexAttribBufferBinding.resize(index + 1, -1);
+    }
+    GLint &binding = vertexAttribBufferBinding[index];
+    if (binding < 0) {
+        binding = _getVertexAttribInteger(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING);
+    }
+    return binding;
+}
+
+void
+Context::setVertexAttribArrayEnabled(GLuint index, bool enabled)
+{
+    if (index >= vertexAttribEnabled.size()) {
+        vertexAttribEnabled.resize(index + 1, -1);
+    }
+    vertexAttribEnabled[index] = enabled;
+}
+
+void
+Context::setVertexAttribPointer(GLuint index)
+{
+    // The attribute sources from whatever is bound to GL_ARRAY_BUFFER
+    if (index >= vertexAttribBufferBinding.size()) {
+        vertexAttribBufferBinding.resize(index + 1, -1);
+    }
+    auto it = bufferBindings.find(GL_ARRAY_BUFFER);
+    vertexAttribBufferBinding[index] = it != bufferBindings.end() ? it->second : -1;
+}
+
+GLint
+Context::getMaxTextureCoords(void)
+{
+    if (!bound || maxTextureCoords < 0) {
+        GLint maxUnits = _getInteger(profile.desktop() ? GL_MAX_TEXTURE_COORDS : GL_MAX_TEXTURE_UNITS);
+        if (!bound) {
+            return maxUnits;
+        }
+        maxTextureCoords = maxUnits;
+    }
+    return maxTextureCoords;
+}
+
+// Query fixed function array state, switching the client active texture
+// unit for texture coordinate arrays.
+static GLint
+_getClientArrayInteger(Context *ctx, GLenum array, GLenum pname, GLint unit)
+{
+    GLint clientActiveTexture = GL_TEXTURE0;
+    bool switchUnit = array == GL_TEXTURE_COORD_ARRAY && ctx->getMaxTextureCoords() > 0;
+    if (switchUnit) {
+        clientActiveTexture = _getInteger(GL_CLIENT_ACTIVE_TEXTURE);
+        _glClientActiveTexture(GL_TEXTURE0 + unit);
+    }
+    GLint param = pname == array ? _glIsEnabled(array) : _getInteger(pname);
+    if (switchUnit) {
+        _glClientActiveTexture(clientActiveTexture);
+    }
+    return param;
+}
+
+bool
+Context::isClientArrayEnabled(GLenum array, GLint unit)
+{
+    if (!bound) {
+        return _getClientArrayInteger(this, array, array, unit) != GL_FALSE;
+    }
+    auto key = std::make_pair(array, unit);
+    auto it = clientArrayEnabled.find(key);
+    if (it == clientArrayEnabled.end()) {
+        GLint enabled = _getClientArrayInteger(this, array, array, unit) != GL_FALSE;
+        it = clientArrayEnabled.emplace(key, enabled).first;
+    }
+    return it->second;
+}
+
+GLint
+Context::getClientArrayBufferBinding(GLenum array, GLenum binding, GLint unit)
+{
+    if (!bound) {
+        return _getClientArrayInteger(this, array, binding, unit);
+    }
+    auto key = std::make_pair(array, unit);
+    auto it = clientArrayBufferBinding.find(key);
+    if (it == clientArrayBufferBinding.end()) {
+        it = clientArrayBufferBinding.emplace(key, _getClientArrayInteger(this, array, binding, unit)).first;
+    }
+    return it->second;
+}
+
+// The unit texture coordinate array commands apply to.
+static GLint
+_getClientArrayUnit(Context *ctx, GLenum array)
+{
+    if (array != GL_TEXTURE_COORD_ARRAY) {
+        return 0;
+    }
+    if (ctx->clientActiveTexture < 0) {
+        ctx->clientActiveTexture = _getInteger(GL_CLIENT_ACTIVE_TEXTURE);
+    }
+    return ctx->clientActiveTexture - GL_TEXTURE0;
+}
+
+void
+Context::setClientArrayEnabled(GLenum array, bool enabled)
+{
+    clientArrayEnabled[std::make_pair(array, _getClientArrayUnit(this, array))] = enabled;
+}
+
+void
+Context::setClientArrayEnabledIndexed(GLenum array, GLuint index, bool enabled)
+{
+    // Only texture coordinate arrays are indexed, by texture unit
+    if (array == GL_TEXTURE_COORD_ARRAY) {
+        clientArrayEnabled[std::make_pair(array, GLint(index))] = enabled;
+    }
+}
+
+void
+Context::setClientArrayPointer(GLenum array, GLint unit)
+{
+    // The array sources from whatever is bound to GL_ARRAY_BUFFER
+    if (unit < 0) {
+        unit = _getClientArrayUnit(this, array);
+    }
+    auto key = std::make_pair(array, unit);
+    auto it = bufferBindings.find(GL_ARRAY_BUFFER);
+    if (it != bufferBindings.end()) {
+        clientArrayBufferBinding[key] = it->second;
+    } else {
+        clientArrayBufferBinding.erase(key);
+    }
+}
+
+void
+Context::setClientActiveTexture(GLenum texture)
+{
+    clientActiveTexture = texture;
+}
+
+void
+Context::invalidateVertexArray(void)
+{
+    elementArrayBufferBinding = -1;
+    vertexAttribEnabled.clear();
+    vertexAttribBufferBinding.clear();
+    clientArrayEnabled.clear();
+    clientArrayBufferBinding.clear();
+}
+
+void
+Context::invalidateClientState(void)
+{
+    invalidateVertexArray();
+    bufferBindings.erase(GL_ARRAY_BUFFER);
+    clientActiveTexture = -1;
+}
+
+bool
+Context::isPrimitiveRestartEnabled(void)
+{
+    if (!bound) {
+        return _glIsEnabled(GL_PRIMITIVE_RESTART);
+    }
+    if (primitiveRestart < 0) {
+        primitiveRestart = _glIsEnabled(GL_PRIMITIVE_RESTART) != GL_FALSE;
+    }
+    return primitiveRestart;
+}
+
+GLuint
+Context::getPrimitiveRestartIndex(void)
+{
+    if (!bound) {
+        return (GLuint)_getInteger(GL_PRIMITIVE_RESTART_INDEX);
+    }
+    if (primitiveRestartIndex < 0) {
+        primitiveRestartIndex = (GLuint)_getInteger(GL_PRIMITIVE_RESTART_INDEX);
+    }
+    return (GLuint)primitiveRestartIndex;
+}
+
+void *
+Context::getBufferMapPointer(GLint buffer)
+{
+    auto it = sharedRes->bufferMappings.find(buffer);
+    if (it == sharedRes->bufferMappings.end()) {
+        return nullptr;
+    }
+    return it->second.pointer;
+}
+
+// Retrieve and forget what was recorded when the buffer was mapped.
+bool
+Context::takeBufferMapping(GLint buffer, BufferMapping &mapping)
+{
+    auto it = sharedRes->bufferMappings.find(buffer);
+    if (it == sharedRes->bufferMappings.end()) {
+        return false;
+    }
+    mapping = it->second;
+    sharedRes->bufferMappings.erase(it);
+    return true;
+}
+
 }
@@ -0,0 +1,149 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures how fast compressed texture uploads are written to the trace,
+ * for whole atlases and for tiles picked out of them with the unpack
+ * sub-image state.  The GL unpack state is faked, and the trace goes
+ * nowhere.  Tile blobs keep the atlas row pitch, so they are larger than the
+ * tile itself.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "gltrace_unpack_compressed.hpp"
+#include "trace_ostream.hpp"
+#include "trace_writer.hpp"
+
+
+static GLint unpackState[6];
+
+
+static void APIENTRY
+fakeGetIntegerv(GLenum pname, GLint *params)
+{
+    switch (pname) {
+    case GL_UNPACK_SKIP_PIXELS:               *params = unpackState[0]; break;
+    case GL_UNPACK_ROW_LENGTH:                *params = unpackState[1]; break;
+    case GL_UNPACK_SKIP_ROWS:                 *params = unpackState[2]; break;
+    case GL_UNPACK_COMPRESSED_BLOCK_SIZE:     *params = unpackState[3]; break;
+    case GL_UNPACK_COMPRESSED_BLOCK_WIDTH:
+    case GL_UNPACK_COMPRESSED_BLOCK_HEIGHT:   *params = unpackState[4]; break;
+    case GL_UNPACK_COMPRESSED_BLOCK_DEPTH:    *params = unpackState[5]; break;
+    default:                                  *params = 0; break;
+    }
+}
+
+PFN_GLGETINTEGERV _glGetIntegerv = &fakeGetIntegerv;
+
+
+// Copies into a scratch buffer, like the compressing streams' caches do.
+class NullStream : public trace::OutStream {
+    std::vector<uint8_t> cache = std::vector<uint8_t>(1024 * 1024);
+
+public:
+    size_t bytes = 0;
+
+    bool
+    write(const void *buffer, size_t length) override {
+        const uint8_t *src = static_cast<const uint8_t *>(buffer);
+        bytes += length;
+        while (length) {
+            size_t chunk = std::min(length, cache.size());
+            memcpy(cache.data(), src, chunk);
+            src += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+
+    void
+    flush(void) override {}
+};
+
+
+struct Case {
+    const char *name;
+    GLint blockSize;
+    GLsizei atlasSize;
+    GLsizei tileSize;
+};
+
+
+static const Case cases[] = {
+    { "BC1 2048 atlas",         8, 2048, 2048 },
+    { "BC7 4096 atlas",        16, 4096, 4096 },
+    { "BC1 256 tile of 4096",   8, 4096,  256 },
+    { "BC7 256 tile of 4096",  16, 4096,  256 },
+    { "BC7 1024 tile of 4096", 16, 4096, 1024 },
+};
+
+
+int
+main(int argc, char **argv)
+{
+    NullStream *stream = new NullStream;
+    trace::Writer writer;
+    writer.open(stream, 0, trace::Properties());
+
+    printf("%-24s %12s %12s\n", "case", "MB/upload", "GB/s");
+    for (const Case &c : cases) {
+        const size_t atlasBlocks = c.atlasSize / 4;
+        std::vector<uint8_t> atlas(atlasBlocks * atlasBlocks * c.blockSize, 0x5a);
+
+        bool tile = c.tileSize < c.atlasSize;
+        unpackState[0] = tile ? c.tileSize : 0;
+        unpackState[1] = tile ? c.atlasSize : 0;
+        unpackState[2] = tile ? c.tileSize : 0;
+        unpackState[3] = c.blockSize;
+        unpackState[4] = 4;
+        unpackState[5] = 1;
+
+        const GLsizei imageSize = (c.tileSize / 4) * (c.tileSize / 4) * c.blockSize;
+        const unsigned iterations = std::max(1U, 64U * 1024 * 1024 / imageSize);
+
+        size_t start_bytes = stream->bytes;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < iterations; ++i) {
+            writeCompressedTex(atlas.data(), GL_COMPRESSED_RGBA_BPTC_UNORM,
+                               c.tileSize, c.tileSize, 0, imageSize, GL_TRUE, writer);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double bytes = double(stream->bytes - start_bytes);
+        printf("%-24s %12.2f %12.2f\n", c.name, bytes / iterations / (1024 * 1024), bytes / elapsed.count() / 1e9);
+    }
+
+    writer.close();
+
+    return 0;
+}
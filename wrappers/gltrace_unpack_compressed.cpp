@@ -22,8 +22,13 @@
  */
 
 
+#include <string.h>
+
+#include <algorithm>
+
 #include "gltrace_unpack_compressed.hpp"
 #include "gltrace.hpp"
+#include "trace_writer.hpp"
 
 
 template<typename X, typename Y>
@@ -111,9 +116,78 @@ canTakeFastPath(const UnpackParams& unpack_params, GLsizei width, GLsizei height
   return true;
 }
 
+namespace {
+
+/*
+ * Gathers the block rows selected by the unpack state into a blob of the
+ * given size, zero filling the gaps between them.  Short rows and gaps are
+ * batched through a staging buffer so they don't each become a separate
+ * write, while long runs go to the writer directly.
+ */
+class BlockGather
+{
+    trace::Writer &writer;
+    size_t remaining;
+    size_t used = 0;
+    uint8_t staging[16 * 1024];
+
+    void
+    flush(void) {
+        writer.writeBlobData(staging, used);
+        used = 0;
+    }
+
+public:
+    BlockGather(trace::Writer &_writer, size_t size) :
+        writer(_writer),
+        remaining(size)
+    {
+        writer.beginBlob(size);
+    }
+
+    void
+    copy(const uint8_t *src, size_t size) {
+        size = std::min(size, remaining);
+        remaining -= size;
+        if (used + size > sizeof staging) {
+            flush();
+            if (size >= sizeof staging) {
+                writer.writeBlobData(src, size);
+                return;
+            }
+        }
+        memcpy(staging + used, src, size);
+        used += size;
+    }
+
+    void
+    zero(size_t size) {
+        size = std::min(size, remaining);
+        remaining -= size;
+        while (size) {
+            size_t chunk = std::min(size, sizeof staging - used);
+            memset(staging + used, 0, chunk);
+            used += chunk;
+            size -= chunk;
+            if (used == sizeof staging) {
+                flush();
+            }
+        }
+    }
+
+    void
+    finish(void) {
+        zero(remaining);
+        flush();
+        writer.endBlob();
+    }
+};
+
+} /* anonymous namespace */
+
 void
 writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei height, GLsizei depth,
-                   GLsizei imageSize, GLboolean has_unpack_subimage, std::function<void(const void*, GLsizei)> callback)
+                   GLsizei imageSize, GLboolean has_unpack_subimage, trace::Writer &writer)
 {
    /* imageSize may not be the amount of bytes we must copy from user's ptr
     * if the pixel storage modes were set by user. Supplied imageSize​ has to be
@@ -123,15 +197,15 @@ writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei heig
     * much bytes we should copy.
     */
 
-    if (!has_unpack_subimage) {
-        callback(data, imageSize);
+    if (!data || !has_unpack_subimage) {
+        writer.writeBlob(data, imageSize);
         return;
     }
 
     UnpackParams unpack_params = getUnpackParams(true);
 
     if (canTakeFastPath(unpack_params, width, height, depth)) {
-        callback(data, imageSize);
+        writer.writeBlob(data, imageSize);
         return;
     }
 
@@ -142,7 +216,7 @@ writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei heig
     size_t copy_rows_per_slice = height > 0 ? _div_round_up(height, unpack_params.block_height) : 1;
     size_t total_rows_per_slice = copy_rows_per_slice;
 
-    size_t copy_slices = depth > 0 ? _div_round_up(depth, unpack_params.block_depth) : 1;
+    size_t copy_slices = depth > 0 ? _div_round_up(depth, std::max(unpack_params.block_depth, 1)) : 1;
 
     /* OpenGL 4.6, 8.7 Compressed Texture Images:
      *
@@ -198,25 +272,23 @@ writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei heig
 
     size_t alloc_size = skip_bytes + depth * total_bytes_per_row * total_rows_per_slice / std::max(unpack_params.block_depth, 1);
     alloc_size += total_bytes_per_row * copy_rows_per_slice;
-    std::vector<uint8_t> copied_data(alloc_size, 0);
 
-    uint8_t* dst_pointer = copied_data.data();
+    /* The blob keeps the layout described by the unpack state, so it replays
+     * with the same state, but anything outside the sub-image reads as zero.
+     */
+    BlockGather gather(writer, alloc_size);
+
     const uint8_t* src_pointer = reinterpret_cast<const uint8_t*>(data);
 
     src_pointer += skip_bytes;
-    dst_pointer += skip_bytes;
+    gather.zero(skip_bytes);
 
     for (size_t slice = 0; slice < copy_slices; slice++) {
-         assert(dst_pointer < (copied_data.data() + copied_data.size()));
-
          if (total_bytes_per_row == copy_bytes_per_row) {
-            assert(dst_pointer < (copied_data.data() + copied_data.size()));
-
             // No skips between rows so we can get away with one copy
             size_t to_copy = copy_bytes_per_row * copy_rows_per_slice;
-            memcpy(reinterpret_cast<void*>(dst_pointer), src_pointer, to_copy);
+            gather.copy(src_pointer, to_copy);
             src_pointer += to_copy;
-            dst_pointer += to_copy;
          } else {
             /* OpenGL 4.6, 8.7 Compressed Texture Images:
              *
@@ -225,11 +297,9 @@ writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei heig
              * height / b_h sets of width / b_w blocks are obtained this way.
              */
             for (size_t row = 0; row < copy_rows_per_slice; row++) {
-               assert(dst_pointer < (copied_data.data() + copied_data.size()));
-
-               memcpy(reinterpret_cast<void*>(dst_pointer), src_pointer, copy_bytes_per_row);
+               gather.copy(src_pointer, copy_bytes_per_row);
+               gather.zero(total_bytes_per_row - copy_bytes_per_row);
                src_pointer += total_bytes_per_row;
-               dst_pointer += total_bytes_per_row;
             }
          }
 
@@ -243,8 +313,8 @@ writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei heig
           */
          size_t advance = total_bytes_per_row * (total_rows_per_slice - copy_rows_per_slice);
          src_pointer += advance;
-         dst_pointer += advance;
+         gather.zero(advance);
     }
 
-    callback(copied_data.data(), copied_data.size());
-}
\ No newline at end of file
+    gather.finish();
+}
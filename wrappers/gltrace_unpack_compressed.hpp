@@ -27,9 +27,16 @@
 #include "glproc.hpp"
 #include "glsize.hpp"
 
-#include <functional>
 
+namespace trace {
+    class Writer;
+}
+
+
+/**
+ * Write the blob of a compressed texture upload, honouring the unpack
+ * sub-image state, straight to the writer.
+ */
 void
 writeCompressedTex(const void * data, GLenum format, GLsizei width, GLsizei height, GLsizei depth,
-                   GLsizei imageSize, GLboolean has_unpack_subimage, std::function<void(const void*, GLsizei)> callback);
-
+                   GLsizei imageSize, GLboolean has_unpack_subimage, trace::Writer &writer);
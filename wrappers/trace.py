@@ -208,6 +208,12 @@ class ValueSerializer(stdapi.Visitor, stdapi.ExpanderMixin):
         array_length = self.expand(array.length)
         print('    if (%s) {' % instance)
         print('        size_t %s = %s > 0 ? %s : 0;' % (length, array_length, array_length))
+        if self.isPackable(array.type):
+            print('        trace::localWriter.writePackedArray(%s, %s);' % (instance, length))
+            print('    } else {')
+            print('        trace::localWriter.writeNull();')
+            print('    }')
+            return
         print('        trace::localWriter.beginArray(%s);' % length)
         print('        for (size_t %s = 0; %s < %s; ++%s) {' % (index, index, length, index))
         print('            trace::localWriter.beginElement();')
@@ -219,6 +225,13 @@ class ValueSerializer(stdapi.Visitor, stdapi.ExpanderMixin):
         print('        trace::localWriter.writeNull();')
         print('    }')
 
+    def isPackable(self, type):
+        '''Whether arrays of this type can be written as packed arrays, i.e.,
+        whether elements are plain integer or floating point numbers.'''
+        while isinstance(type, (stdapi.Const, stdapi.Alias)):
+            type = type.type
+        return isinstance(type, stdapi.Literal) and type.kind in ('SInt', 'UInt', 'Float', 'Double')
+
     def visitAttribArray(self, array, instance):
         # For each element, decide if it is a key or a value (which depends on the previous key).
         # If it is a value, store it as the right type - usually int, some bitfield, or some enum.
@@ -562,6 +575,8 @@ class Tracer:
         else:
             print('extern "C" PRIVATE')
         print(function.prototype() + ' {')
+        if not function.internal:
+            print('    trace::WrapperOverheadScope _overhead(&_%s_sig);' % (function.name,))
         if function.type is not stdapi.Void:
             print('    %s _result;' % function.type)
 
@@ -602,7 +617,11 @@ class Tracer:
             print('    trace::localWriter.endLeave();')
 
     def invokeFunction(self, function):
+        if not function.internal:
+            print('    _overhead.beginInvoke();')
         self.doInvokeFunction(function)
+        if not function.internal:
+            print('    _overhead.endInvoke();')
 
     def doInvokeFunction(self, function, prefix='_', suffix=''):
         # Same as invokeFunction() but called both when trace is enabled or disabled.
@@ -898,6 +917,7 @@ class Tracer:
         numArgs = len(method.args) + 1
         print('    static const char * _args[%u] = {%s};' % (numArgs, ', '.join(['"this"'] + ['"%s"' % arg.name for arg in method.args])))
         print('    static const trace::FunctionSig _sig = {%u, "%s", %u, _args};' % (self.getFunctionSigId(), sigName, numArgs))
+        print('    trace::WrapperOverheadScope _overhead(&_sig);')
 
         print('    unsigned _call = trace::localWriter.beginEnter(&_sig);')
         print('    trace::localWriter.beginArg(0);')
@@ -993,7 +1013,9 @@ class Tracer:
             result = ''
         else:
             result = '_result = '
+        print('    _overhead.beginInvoke();')
         print('    %s_this->%s(%s);' % (result, method.name, ', '.join([str(arg.name) for arg in method.args])))
+        print('    _overhead.endInvoke();')
     
     def emit_memcpy(self, ptr, size):
         print('    trace::fakeMemcpy(%s, %s);' % (ptr, size))